@@ -0,0 +1,243 @@
+#pragma once
+
+/**
+ * Minimal micro-benchmark harness, see benchmarks.cpp for usage.
+ *
+ * For each benchmark the functor is first run for some warmup time, then the
+ * number of iterations per sample is doubled until one sample takes at least
+ * minSampleTime, so that the clock resolution and call overhead don't matter.
+ * Then samples are taken until the median absolute deviation relative to the
+ * median drops below maxRelativeMad or the time budget is exhausted.
+ */
+
+#include <algorithm>                    // sort
+#include <chrono>
+#include <cmath>
+#include <cstddef>                      // size_t
+#include <iomanip>                      // setw, setprecision
+#include <limits>                       // quiet_NaN
+#include <ostream>
+#include <string>
+#include <utility>                      // move
+#include <vector>
+
+#include "Fundamental.hpp"              // now, diffNow
+
+
+namespace Benchmark {
+
+
+/**
+ * Forces the compiler to assume that value is read, so that calculations
+ * yielding it can't be optimized away.
+ * @see https://github.com/google/benchmark/blob/main/include/benchmark/benchmark.h
+ */
+template< typename T >
+inline void doNotOptimize( T const & value )
+{
+#if defined( __GNUC__ )
+    asm volatile( "" : : "r,m"( value ) : "memory" );
+#else
+    static volatile char sink;
+    sink = *reinterpret_cast< char const volatile * >( &value );
+#endif
+}
+
+/**
+ * Forces the compiler to assume that all memory may have been read and
+ * written, e.g. to avoid results written into arrays being optimized away.
+ */
+inline void clobberMemory( void )
+{
+#if defined( __GNUC__ )
+    asm volatile( "" : : : "memory" );
+#endif
+}
+
+
+struct Options
+{
+    double warmupTime     = 0.05;   /**< seconds */
+    double minSampleTime  = 1e-3;   /**< seconds */
+    double maxTotalTime   = 1.0;    /**< seconds per benchmark after warmup */
+    size_t nMinSamples    = 10;
+    size_t nMaxSamples    = 1000;
+    double maxRelativeMad = 0.01;   /**< stop criterion for stable results */
+};
+
+
+/**
+ * @param[in] sorted ascendingly sorted values
+ * @param[in] p percentile in [0,100], values inbetween ranks are interpolated
+ */
+inline double percentile( std::vector< double > const & sorted, double const p )
+{
+    if ( sorted.empty() )
+        return std::numeric_limits< double >::quiet_NaN();
+    auto const rank = p / 100. * ( sorted.size() - 1 );
+    auto const iLow = size_t( std::floor( rank ) );
+    auto const iHigh = std::min( iLow + 1, sorted.size() - 1 );
+    return sorted[iLow] + ( rank - iLow ) * ( sorted[iHigh] - sorted[iLow] );
+}
+
+/**
+ * median absolute deviation, a robust alternative to the standard deviation
+ * which isn't spoiled by the occasional context switch
+ */
+inline double medianAbsoluteDeviation( std::vector< double > const & sorted )
+{
+    auto const median = percentile( sorted, 50 );
+    std::vector< double > deviations;
+    deviations.reserve( sorted.size() );
+    for ( auto const x : sorted )
+        deviations.push_back( std::abs( x - median ) );
+    std::sort( deviations.begin(), deviations.end() );
+    return percentile( deviations, 50 );
+}
+
+
+struct Result
+{
+    std::string name;
+    size_t nItemsPerIteration;      /**< e.g. array length, for time per item */
+    size_t nIterationsPerSample;
+    std::vector< double > samples;  /**< sorted seconds per iteration */
+
+    double percentile( double const p ) const { return Benchmark::percentile( samples, p ); }
+    double median    ( void           ) const { return percentile( 50 ); }
+    double mad       ( void           ) const { return medianAbsoluteDeviation( samples ); }
+};
+
+
+/**
+ * @param[in] functor called once per iteration without arguments. Use
+ *            doNotOptimize on results to keep them from being optimized away.
+ */
+template< typename T_Functor >
+inline Result run
+(
+    std::string         name,
+    T_Functor        && functor,
+    size_t      const   nItemsPerIteration = 1,
+    Options     const & options = Options()
+)
+{
+    Result result;
+    result.name = std::move( name );
+    result.nItemsPerIteration = nItemsPerIteration;
+
+    auto const timeIterations = [&functor] ( size_t const nIterations )
+    {
+        auto const t0 = now();
+        for ( size_t i = 0u; i < nIterations; ++i )
+            functor();
+        return diffNow( t0, now() );
+    };
+
+    /* warmup caches, branch predictors and CPU frequency while calibrating */
+    size_t nIterations = 1;
+    double tWarmup = 0;
+    while ( true )
+    {
+        auto const t = timeIterations( nIterations );
+        tWarmup += t;
+        if ( ( t >= options.minSampleTime ) && ( tWarmup >= options.warmupTime ) )
+            break;
+        if ( t < options.minSampleTime )
+            nIterations *= 2;
+    }
+    result.nIterationsPerSample = nIterations;
+
+    double tTotal = 0;
+    while ( result.samples.size() < options.nMaxSamples )
+    {
+        auto const t = timeIterations( nIterations );
+        tTotal += t;
+        result.samples.push_back( t / nIterations );
+
+        if ( result.samples.size() < options.nMinSamples )
+            continue;
+        if ( tTotal >= options.maxTotalTime )
+            break;
+        /* checking the stop criterion is O(n log n), so don't do it always */
+        if ( result.samples.size() % options.nMinSamples == 0 )
+        {
+            auto sorted = result.samples;
+            std::sort( sorted.begin(), sorted.end() );
+            if ( medianAbsoluteDeviation( sorted ) <= options.maxRelativeMad * percentile( sorted, 50 ) )
+                break;
+        }
+    }
+
+    std::sort( result.samples.begin(), result.samples.end() );
+    return result;
+}
+
+/**
+ * Human-readable table with times per item in nanoseconds
+ */
+inline void printTable( std::ostream & out, std::vector< Result > const & results )
+{
+    size_t nameWidth = 4;
+    for ( auto const & result : results )
+        nameWidth = std::max( nameWidth, result.name.size() );
+
+    out << std::left << std::setw( nameWidth ) << "name" << std::right
+        << std::setw( 12 ) << "median/ns" << std::setw( 12 ) << "p5/ns"
+        << std::setw( 12 ) << "p95/ns" << std::setw( 10 ) << "MAD/%"
+        << std::setw( 10 ) << "samples" << "\n";
+    for ( auto const & result : results )
+    {
+        auto const toNs = 1e9 / result.nItemsPerIteration;
+        out << std::left << std::setw( nameWidth ) << result.name << std::right
+            << std::fixed << std::setprecision( 3 )
+            << std::setw( 12 ) << result.median() * toNs
+            << std::setw( 12 ) << result.percentile(  5 ) * toNs
+            << std::setw( 12 ) << result.percentile( 95 ) * toNs
+            << std::setprecision( 2 )
+            << std::setw( 10 ) << 100. * result.mad() / result.median()
+            << std::setw( 10 ) << result.samples.size() << "\n";
+    }
+    out << std::defaultfloat;
+}
+
+/**
+ * One JSON object per line (JSON Lines) with times in seconds per item
+ */
+inline void printJson( std::ostream & out, std::vector< Result > const & results )
+{
+    auto const escape = [] ( std::string const & s )
+    {
+        std::string escaped;
+        for ( auto const c : s )
+        {
+            if ( ( c == '"' ) || ( c == '\\' ) )
+                escaped += '\\';
+            escaped += c;
+        }
+        return escaped;
+    };
+
+    out << std::scientific << std::setprecision( 6 );
+    for ( auto const & result : results )
+    {
+        auto const perItem = 1. / result.nItemsPerIteration;
+        out << "{\"name\": \"" << escape( result.name ) << "\""
+            << ", \"items_per_iteration\": " << result.nItemsPerIteration
+            << ", \"iterations_per_sample\": " << result.nIterationsPerSample
+            << ", \"samples\": " << result.samples.size()
+            << ", \"median\": " << result.median() * perItem
+            << ", \"p5\": "     << result.percentile(  5 ) * perItem
+            << ", \"p25\": "    << result.percentile( 25 ) * perItem
+            << ", \"p75\": "    << result.percentile( 75 ) * perItem
+            << ", \"p95\": "    << result.percentile( 95 ) * perItem
+            << ", \"min\": "    << result.samples.front() * perItem
+            << ", \"max\": "    << result.samples.back() * perItem
+            << ", \"mad\": "    << result.mad() * perItem
+            << "}\n";
+    }
+    out << std::defaultfloat;
+}
+
+
+} // namespace Benchmark
@@ -119,11 +119,36 @@ template< typename T, NBits N > struct Ones { static T constexpr value = Step<T,
 } // namespace BitPatterns
 
 
+#include <array>
 #include <bitset>
 #include <cassert>
+#include <cstddef>                  // size_t
 #include <iomanip>
 #include <iostream>
 
+/**
+ * PDEP and PEXT do exactly what diluteBitsRecursive and compactBitsRecursive
+ * do given the mask with every (nSpacing+1)-th bit set, each in one
+ * instruction (3 cycles latency on Intel since Haswell, but microcoded and
+ * therefore very slow on AMD before Zen 3!).
+ * Define BITSCOMPILETIME_NO_BMI2 to force the shift and mask cascades.
+ */
+#if defined( __BMI2__ ) && ! defined( BITSCOMPILETIME_NO_BMI2 )
+#   define BITSCOMPILETIME_HAS_BMI2 1
+#else
+#   define BITSCOMPILETIME_HAS_BMI2 0
+#endif
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#   define BITSCOMPILETIME_HAS_BMI2_64 BITSCOMPILETIME_HAS_BMI2
+#else
+#   define BITSCOMPILETIME_HAS_BMI2_64 0
+#endif
+
+#if BITSCOMPILETIME_HAS_BMI2
+#   include <immintrin.h>
+#endif
+
 
 namespace BitFunctions {
 
@@ -271,14 +296,15 @@ struct DiluteBitsCrumble<T,nSpacing,nStepsNeeded,0> { inline static T apply( T c
 
 
 /**
- * Interleaves bits with specified amount N of 0-Bits.
+ * Interleaves bits with specified amount N of 0-Bits using only shifts and
+ * masks. Used by diluteBitsRecursive if BMI2 is not available.
  * Should be called * with the input casted to the expected output data type.
  *
  * @tparam N the spacing, i.e. 0 returns identity and 1 interleaves one 0
  *           and N=2 two 0s for each input bit.
  */
 template< typename T, unsigned char nSpacing >
-T inline diluteBitsRecursive( T const & rx )
+T inline diluteBitsCascade( T const & rx )
 {
     static_assert( nSpacing > 0, "" );
     /**
@@ -381,6 +407,201 @@ T inline diluteBitsRecursive( T const & rx )
 }
 
 
+/**
+ * Reverses diluteBitsCascade by applying the same steps in reverse order:
+ * for 32 Bit and nSpacing=1 this expands to
+ *   n&= 0x55555555;
+ *   n = (n | (n >> 1)) & 0x33333333;
+ *   n = (n | (n >> 2)) & 0x0F0F0F0F;
+ *   n = (n | (n >> 4)) & 0x00FF00FF;
+ *   n = (n | (n >> 8)) & 0x0000FFFF;
+ * I.e. in step i the rectangles of length p = 2**(i-1) are moved p*nSpacing
+ * bits to the right, which makes them touch the neighboring rectangle,
+ * resulting in rectangles of length 2p with spacing 2p*nSpacing.
+ */
+template< typename T, unsigned char nSpacing, unsigned char iStep >
+struct CompactBitsCrumble { inline static T apply( T const & xOriginal )
+{
+    auto x = CompactBitsCrumble<T,nSpacing,iStep-1>::apply( xOriginal );
+    auto constexpr iStep2Pow = 1llu << ( iStep - 1 );
+    auto constexpr mask = BitPatterns::RectangularWave< T, 2 * iStep2Pow, 2 * iStep2Pow * nSpacing >::value;
+    return ( x | ( x >> ( iStep2Pow * nSpacing ) ) ) & mask;
+} };
+
+template< typename T, unsigned char nSpacing >
+struct CompactBitsCrumble<T,nSpacing,0> { inline static T apply( T const & x )
+{
+    return x & BitPatterns::RectangularWave< T, 1, nSpacing >::value;
+} };
+
+/**
+ * Inverse of diluteBitsCascade, i.e. keeps only every (nSpacing+1)-th bit
+ * and packs them together, e.g. 0b1001001 becomes 0b111 for nSpacing=2.
+ */
+template< typename T, unsigned char nSpacing >
+T inline compactBitsCascade( T const & x )
+{
+    static_assert( nSpacing > 0, "" );
+    auto constexpr nBitsAvailable = sizeof(T) * CHAR_BIT;
+    auto constexpr nBitsAllowed = CompileTimeFunctions::ceilDiv( nBitsAvailable, nSpacing + 1 );
+    auto constexpr nShifts = CompileTimeFunctions::CeilLog< 2, nBitsAllowed >::value;
+    return CompactBitsCrumble< T, nSpacing, nShifts >::apply( x )
+           & BitPatterns::Ones< T, nBitsAllowed >::value;
+}
+
+
+/**
+ * Selects the implementation depending on the availability of BMI2 for the
+ * size of T. The primary template is the cascade fallback.
+ */
+template<
+    typename T,
+    unsigned char nSpacing,
+    unsigned char nBmi2Bits = (
+        sizeof(T) <= 4 && BITSCOMPILETIME_HAS_BMI2    ? 32 :
+        sizeof(T) <= 8 && BITSCOMPILETIME_HAS_BMI2_64 ? 64 : 0 )
+>
+struct DiluteBitsBackend
+{
+    inline static T dilute ( T const & x ){ return diluteBitsCascade < T, nSpacing >( x ); }
+    inline static T compact( T const & x ){ return compactBitsCascade< T, nSpacing >( x ); }
+};
+
+#if BITSCOMPILETIME_HAS_BMI2
+template< typename T, unsigned char nSpacing >
+struct DiluteBitsBackend<T,nSpacing,32>
+{
+    static unsigned int constexpr mask = T( BitPatterns::RectangularWave< T, 1, nSpacing >::value );
+    inline static T dilute ( T const & x ){ return T( _pdep_u32( (unsigned int) x, mask ) ); }
+    inline static T compact( T const & x ){ return T( _pext_u32( (unsigned int) x, mask ) ); }
+};
+#endif
+
+#if BITSCOMPILETIME_HAS_BMI2_64
+template< typename T, unsigned char nSpacing >
+struct DiluteBitsBackend<T,nSpacing,64>
+{
+    static unsigned long long int constexpr mask = T( BitPatterns::RectangularWave< T, 1, nSpacing >::value );
+    inline static T dilute ( T const & x ){ return T( _pdep_u64( (unsigned long long int) x, mask ) ); }
+    inline static T compact( T const & x ){ return T( _pext_u64( (unsigned long long int) x, mask ) ); }
+};
+#endif
+
+
+/**
+ * Interleaves bits with specified amount N of 0-Bits, i.e. 0b111 becomes
+ * 0b10101 for nSpacing=1. Input bits which wouldn't fit into T after the
+ * dilution are discarded.
+ * Uses PDEP if BMI2 is available at compile time, else diluteBitsCascade
+ *
+ * @tparam N the spacing, i.e. 0 returns identity and 1 interleaves one 0
+ *           and N=2 two 0s for each input bit.
+ */
+template< typename T, unsigned char nSpacing >
+T inline diluteBitsRecursive( T const & x )
+{
+    static_assert( nSpacing > 0, "" );
+    return DiluteBitsBackend< T, nSpacing >::dilute( x );
+}
+
+/**
+ * Inverse of diluteBitsRecursive, i.e. 0b10101 becomes 0b111 for nSpacing=1.
+ * Bits inbetween the kept bits are ignored.
+ * Uses PEXT if BMI2 is available at compile time, else compactBitsCascade
+ */
+template< typename T, unsigned char nSpacing >
+T inline compactBitsRecursive( T const & x )
+{
+    static_assert( nSpacing > 0, "" );
+    return DiluteBitsBackend< T, nSpacing >::compact( x );
+}
+
+
+/**
+ * Usable bits per coordinate for D-dimensional Morton keys of type T, e.g.
+ * 21 for 3D and 64-bit keys. Note that diluteBitsRecursive< T, D-1 > could
+ * keep more bits for the first coordinate, but not for the shifted ones.
+ */
+template< typename T, std::size_t D >
+struct MortonBits
+{
+    static_assert( D > 0, "" );
+    static_assert( D <= sizeof(T) * CHAR_BIT, "" );
+    static BitPatterns::NBits constexpr nBitsPerCoordinate = sizeof(T) * CHAR_BIT / D;
+    static T constexpr coordinateMask = BitPatterns::Ones< T, nBitsPerCoordinate >::value;
+};
+
+/**
+ * Compile-time check for whether coordinates in [0,nMaxExtent) can be
+ * encoded into D-dimensional Morton keys of type T, e.g.
+ *   static_assert( MortonKeyFits< uint32_t, 3, 1024 >::value, "" );
+ */
+template< typename T, std::size_t D, unsigned long long int nMaxExtent >
+struct MortonKeyFits
+{
+    static bool constexpr value =
+        CompileTimeFunctions::CeilLog< 2, nMaxExtent >::value <= MortonBits< T, D >::nBitsPerCoordinate;
+};
+
+/**
+ * Needed, because diluteBitsRecursive and compactBitsRecursive don't allow
+ * nSpacing = 0, which is what we need for 1D Morton keys.
+ */
+template< typename T, unsigned char nSpacing >
+struct MortonDilution
+{
+    inline static T dilute ( T const & x ){ return diluteBitsRecursive < T, nSpacing >( x ); }
+    inline static T compact( T const & x ){ return compactBitsRecursive< T, nSpacing >( x ); }
+};
+
+template< typename T >
+struct MortonDilution<T,0>
+{
+    inline static T dilute ( T const & x ){ return x; }
+    inline static T compact( T const & x ){ return x; }
+};
+
+/**
+ * Interleaves the bits of D coordinates into one Z-order key, i.e. bit i of
+ * coordinate k becomes bit i*D+k of the key. This is the same convention as
+ *   part1by2(x) | (part1by2(y) << 1) | (part1by2(z) << 2)
+ *
+ * @tparam T unsigned key type. Only MortonBits< T, D >::nBitsPerCoordinate
+ *         bits of each coordinate are used, for larger coordinates an
+ *         assert is triggered in debug builds.
+ */
+template< typename T, std::size_t D, typename T_Coord >
+T inline mortonEncode( std::array< T_Coord, D > const & coordinates )
+{
+    static_assert( std::numeric_limits< T >::is_integer && ! std::numeric_limits< T >::is_signed, "" );
+    using Bits = MortonBits< T, D >;
+
+    auto key = T(0);
+    for ( std::size_t i = 0u; i < D; ++i )
+    {
+        auto const x = T( coordinates[i] );
+        assert( x <= Bits::coordinateMask && "Coordinate too large for Morton key!" );
+        key |= T( MortonDilution< T, D-1 >::dilute( x & Bits::coordinateMask ) << i );
+    }
+    return key;
+}
+
+/**
+ * Inverse of mortonEncode
+ */
+template< typename T, std::size_t D, typename T_Coord = T >
+std::array< T_Coord, D > inline mortonDecode( T const & key )
+{
+    static_assert( std::numeric_limits< T >::is_integer && ! std::numeric_limits< T >::is_signed, "" );
+    using Bits = MortonBits< T, D >;
+
+    std::array< T_Coord, D > coordinates;
+    for ( std::size_t i = 0u; i < D; ++i )
+        coordinates[i] = T_Coord( MortonDilution< T, D-1 >::compact( T( key >> i ) ) & Bits::coordinateMask );
+    return coordinates;
+}
+
+
 } // namespace BitFunctions
 
 
@@ -491,7 +712,91 @@ template< typename T > void testDilution( void )
     #undef TMP
 }
 
-#include <chrono>
+template< typename T, unsigned char nSpacing > bool testCompaction( void )
+{
+    auto constexpr nBitsAllowed = CompileTimeFunctions::ceilDiv( sizeof(T) * CHAR_BIT, nSpacing + 1 );
+    auto constexpr allowed = BitPatterns::Ones< T, nBitsAllowed >::value;
+    bool success = true;
+    for ( auto i = 0u; i < 1000; ++i )
+    {
+        auto const x = T( T( std::rand() ) * T( 2654435761u ) ^ T( std::rand() ) );
+        auto const y = BitFunctions::diluteBitsRecursive< T, nSpacing >( x );
+        success &= y == BitFunctions::diluteBitsCascade< T, nSpacing >( x );
+        success &= BitFunctions::compactBitsRecursive< T, nSpacing >( y ) == T( x & allowed );
+        success &= BitFunctions::compactBitsCascade  < T, nSpacing >( y ) == T( x & allowed );
+        /* bits which are not on the dilution grid must be ignored */
+        success &= BitFunctions::compactBitsRecursive< T, nSpacing >( x ) ==
+                   BitFunctions::compactBitsCascade  < T, nSpacing >( x );
+    }
+    std::cout << "Compaction for " << sizeof(T) * CHAR_BIT << " bits with spacing "
+              << (int) nSpacing << ( success ? " OK" : " FAILED" ) << "\n";
+    return success;
+}
+
+template< typename T > void testCompactions( void )
+{
+    testCompaction< T, 1 >();
+    testCompaction< T, 2 >();
+    testCompaction< T, 3 >();
+    testCompaction< T, 5 >();
+}
+
+void testCompactionAgainstUnpart( void )
+{
+    bool success = true;
+    for ( auto i = 0u; i < 1000; ++i )
+    {
+        auto const x = uint32_t( std::rand() ) * 2654435761u;
+        success &= unpart1by1( x ) == BitFunctions::compactBitsRecursive< uint32_t, 1 >( x );
+        /* part1by2 and unpart1by2 only use 10 bits, although 11 would fit */
+        success &= unpart1by2( x ) == ( BitFunctions::compactBitsRecursive< uint32_t, 2 >( x ) & 0x3FFu );
+        success &= deinterleave3_Y( x ) == ( BitFunctions::compactBitsRecursive< uint32_t, 2 >( x >> 1 ) & 0x3FFu );
+    }
+    std::cout << "Compaction against unpart1by1, unpart1by2" << ( success ? " OK" : " FAILED" ) << "\n";
+}
+
+template< typename T, std::size_t D > bool testMortonRoundTrip( void )
+{
+    static_assert( BitFunctions::MortonKeyFits< T, D, ( 1ull << ( sizeof(T) * CHAR_BIT / D ) ) >::value, "" );
+    static_assert( ! BitFunctions::MortonKeyFits< T, D, ( 1ull << ( sizeof(T) * CHAR_BIT / D ) ) + 1 >::value, "" );
+
+    bool success = true;
+    for ( auto i = 0u; i < 1000; ++i )
+    {
+        std::array< T, D > x;
+        for ( auto & coordinate : x )
+            coordinate = T( T( std::rand() ) * T( 2654435761u ) ) & BitFunctions::MortonBits< T, D >::coordinateMask;
+        success &= BitFunctions::mortonDecode< T, D >( BitFunctions::mortonEncode< T >( x ) ) == x;
+    }
+    std::cout << D << "D Morton keys with " << sizeof(T) * CHAR_BIT << " bits"
+              << ( success ? " OK" : " FAILED" ) << "\n";
+    return success;
+}
+
+void testMorton( void )
+{
+    bool success = true;
+    for ( auto i = 0u; i < 1000; ++i )
+    {
+        std::array< uint32_t, 3 > const x = {{
+            uint32_t( std::rand() ) & 0x3FFu,
+            uint32_t( std::rand() ) & 0x3FFu,
+            uint32_t( std::rand() ) & 0x3FFu
+        }};
+        auto const key = BitFunctions::mortonEncode< uint32_t >( x );
+        success &= key == interleave3( x[0], x[1], x[2] );
+        auto const y = BitFunctions::mortonDecode< uint32_t, 3 >( key );
+        success &= y[0] == deinterleave3_X( key ) && y[1] == deinterleave3_Y( key ) && y[2] == deinterleave3_Z( key );
+    }
+    std::cout << "Morton keys against interleave3" << ( success ? " OK" : " FAILED" ) << "\n";
+
+    testMortonRoundTrip< uint32_t, 1 >();
+    testMortonRoundTrip< uint32_t, 2 >();
+    testMortonRoundTrip< uint32_t, 3 >();
+    testMortonRoundTrip< uint64_t, 2 >();
+    testMortonRoundTrip< uint64_t, 3 >();
+    testMortonRoundTrip< uint64_t, 4 >();
+}
 
 void testDilution2( void )
 {
@@ -506,144 +811,20 @@ void testDilution2( void )
         auto const x2 = x & 0x03FFul;
         auto const y1 = part1by1( x );
         auto const y2 = BitFunctions::diluteBitsRecursive< T, 1 >( x );
-        auto const z1 = part1by2( x );
-        auto const z2 = BitFunctions::diluteBitsRecursive< T, 2 >( x );
+        /* part1by2 only uses 10 bits, although 11 would fit */
+        auto const z1 = part1by2( x2 );
+        auto const z2 = BitFunctions::diluteBitsRecursive< T, 2 >( x2 );
         std::cout
         << "0x" << std::setw( sizeof(T) * 2 ) << x1 << " -> "
         << "0x" << std::setw( sizeof(T) * 2 ) << y1 << " =? "
         << "0x" << std::setw( sizeof(T) * 2 ) << y2 << ( y1 != y2 ? " FAILED" : " OK" ) << "\n"
         << "0x" << std::setw( sizeof(T) * 2 ) << x2 << " -> "
         << "0x" << std::setw( sizeof(T) * 2 ) << z1 << " =? "
-        << "0x" << std::setw( sizeof(T) * 2 ) << z2 << ( y1 != y2 ? " FAILED" : " OK" ) << "\n";
+        << "0x" << std::setw( sizeof(T) * 2 ) << z2 << ( z1 != z2 ? " FAILED" : " OK" ) << "\n";
     }
     std::cout << std::setfill(' ') << std::dec;
 
-    auto const nIterations = 1234567890lu;
-    std::srand( std::chrono::duration_cast< std::chrono::duration< double > >(
-                std::chrono::high_resolution_clock::now().time_since_epoch() ).count() );
-    auto result = std::rand();
-
-    /* benchmark part1by1 */
-    auto const ta0 = std::chrono::high_resolution_clock::now();
-    for ( auto i = 0lu; i < nIterations; ++i )
-        result ^= part1by1( result ) | 0x12345;
-    auto const ta1 = std::chrono::high_resolution_clock::now();
-    std::cout
-    << nIterations <<  " using part1by1 (OLD) took "
-    << std::chrono::duration_cast< std::chrono::duration< double > >( ta1 - ta0 ).count()
-    << "s\n";
-
-    /* benchmark part1by1 using template function */
-    auto const tb0 = std::chrono::high_resolution_clock::now();
-    for ( auto i = 0lu; i < nIterations; ++i )
-        result ^= BitFunctions::diluteBitsRecursive< T, 1 >( result ) | 0x12345;
-    auto const tb1 = std::chrono::high_resolution_clock::now();
-    std::cout
-    << nIterations <<  " using part1by1 (NEW) took "
-    << std::chrono::duration_cast< std::chrono::duration< double > >( tb1 - tb0 ).count()
-    << "s\n";
-
-    /* benchmark part1by2 */
-    auto const tc0 = std::chrono::high_resolution_clock::now();
-    for ( auto i = 0lu; i < nIterations; ++i )
-        result ^= part1by2( result ) | 0x12345;
-    auto const tc1 = std::chrono::high_resolution_clock::now();
-    std::cout
-    << nIterations <<  " using part1by2 (OLD) took "
-    << std::chrono::duration_cast< std::chrono::duration< double > >( tc1 - tc0 ).count()
-    << "s\n";
-
-    /* benchmark part1by2 using template function */
-    auto const td0 = std::chrono::high_resolution_clock::now();
-    for ( auto i = 0lu; i < nIterations; ++i )
-        result ^= BitFunctions::diluteBitsRecursive< T, 2 >( result ) | 0x12345;
-    auto const td1 = std::chrono::high_resolution_clock::now();
-    std::cout
-    << nIterations <<  " using part1by2 (NEW) took "
-    << std::chrono::duration_cast< std::chrono::duration< double > >( td1 - td0 ).count()
-    << "s\n";
-
-    std::cout << "(result = " << result << ")\n";
-
-    /**
-     * for GPP in g++-5 g++-6; do echo "$GPP:"; for flag in '   ' -O0 -O1 -O2 -O3; do echo "  $flag:"; $GPP -x c++ $flag -Wall -Wextra -std=c++11 BitsCompileTime.hpp -DMAIN_TEST_BITSCOMPILETIME 2>/dev/null && ./a.out 2>&1 | sed -nr '/ took /p'; done; done
-     * @verbatim
-     * g++-5:
-     *   No Flags:
-     *     1234567890 using part1by1 (OLD) took 19.1245s
-     *     1234567890 using part1by1 (NEW) took 30.1481s
-     *     1234567890 using part1by2 (OLD) took 19.1973s
-     *     1234567890 using part1by2 (NEW) took 29.8871s
-     *   -O0:
-     *     1234567890 using part1by1 (OLD) took 19.2118s
-     *     1234567890 using part1by1 (NEW) took 29.5715s
-     *     1234567890 using part1by2 (OLD) took 19.1993s
-     *     1234567890 using part1by2 (NEW) took 29.7324s
-     *   -O1:
-     *     1234567890 using part1by1 (OLD) took 5.66236s
-     *     1234567890 using part1by1 (NEW) took 5.62838s
-     *     1234567890 using part1by2 (OLD) took 5.65219s
-     *     1234567890 using part1by2 (NEW) took 5.63415s
-     *   -O2:
-     *     1234567890 using part1by1 (OLD) took 5.66398s
-     *     1234567890 using part1by1 (NEW) took 5.63201s
-     *     1234567890 using part1by2 (OLD) took 5.64173s
-     *     1234567890 using part1by2 (NEW) took 5.66007s
-     *   -O3:
-     *     1234567890 using part1by1 (OLD) took 5.68837s
-     *     1234567890 using part1by1 (NEW) took 5.64835s
-     *     1234567890 using part1by2 (OLD) took 5.64818s
-     *     1234567890 using part1by2 (NEW) took 5.69607s
-     * g++-6:
-     *   No Flags:
-     *     1234567890 using part1by1 (OLD) took 19.2545s
-     *     1234567890 using part1by1 (NEW) took 29.9512s
-     *     1234567890 using part1by2 (OLD) took 19.1396s
-     *     1234567890 using part1by2 (NEW) took 29.6569s
-     *   -O0:
-     *     1234567890 using part1by1 (OLD) took 19.0805s
-     *     1234567890 using part1by1 (NEW) took 29.5035s
-     *     1234567890 using part1by2 (OLD) took 19.1712s
-     *     1234567890 using part1by2 (NEW) took 29.5699s
-     *   -O1:
-     *     1234567890 using part1by1 (OLD) took 5.63171s
-     *     1234567890 using part1by1 (NEW) took 5.63261s
-     *     1234567890 using part1by2 (OLD) took 5.65188s
-     *     1234567890 using part1by2 (NEW) took 6.12264s -> SLOWER than g++5
-     *   -O2:
-     *     1234567890 using part1by1 (OLD) took 5.67073s
-     *     1234567890 using part1by1 (NEW) took 5.66181s
-     *     1234567890 using part1by2 (OLD) took 6.1471s  -> SLOWER than -O1
-     *     1234567890 using part1by2 (NEW) took 6.13563s
-     *   -O3:
-     *     1234567890 using part1by1 (OLD) took 5.7056s
-     *     1234567890 using part1by1 (NEW) took 5.65694s
-     *     1234567890 using part1by2 (OLD) took 6.13513s
-     *     1234567890 using part1by2 (NEW) took 6.13791s
-     * @endverbatim
-     * Each of the above results were run 3 times to ensure we have not just
-     * an outlier for whatever reason
-     * => The inline keyword or -finline-small-functions as included in -O
-     *    slows down the dilute by two bits for whatever reason since g++6 -.-
-     * @see https://gcc.gnu.org/bugzilla/show_bug.cgi?id=84327
-     * @see https://gcc.gnu.org/bugzilla/show_bug.cgi?id=84328
-     *
-     * Unfortunately it seems I won't ever find out where the 3x speedup
-     * comes from, as even using -fno-optimization for all listed optimizations
-     * is still 5.6s fast :/
-     *
-     * antiO1Flags=$( g++ -O1 -Q --help=optimizers 2>/dev/null | sed -nr 's| -f|-fno-|; s|[ \t]*\[disabled\]||p;' | sed '/stack-protector/d' )
-     * g++ -x c++ -Wall -Wextra -O1 $antiO1Flags -std=c++11 BitsCompileTime.hpp -DMAIN_TEST_BITSCOMPILETIME && ./a.out
-     *  1234567890 using part1by1 (OLD) took 5.64657s
-     *  1234567890 using part1by1 (NEW) took 5.6359s
-     *  1234567890 using part1by2 (OLD) took 5.66952s
-     *  1234567890 using part1by2 (NEW) took 6.23457s
-     *
-     * The 'stack-protector' filter seems to be needed, because it can't be turned off:
-     *   g++: error: unrecognized command line option ‘-fno-stack-protector-all’; did you mean ‘-fstack-protector-all’?
-     *   g++: error: unrecognized command line option ‘-fno-stack-protector-explicit’; did you mean ‘-fstack-protector-explicit’?
-     *   g++: error: unrecognized command line option ‘-fno-stack-protector-strong’; did you mean ‘-fstack-protector-strong’?
-     */
+    /* Timings moved to benchmarks.cpp */
 }
 
 template< typename T > void testLog( void )
@@ -699,6 +880,16 @@ int main()
     std::cout << "== Bit Dilution for unsigned long ==\n";
     testDilution< unsigned long >();
 
+    std::cout << "== Bit Compaction (BMI2: " << BITSCOMPILETIME_HAS_BMI2 << ") ==\n";
+    testCompactions< unsigned char  >();
+    testCompactions< unsigned short >();
+    testCompactions< unsigned int   >();
+    testCompactions< unsigned long  >();
+    testCompactionAgainstUnpart();
+
+    std::cout << "== Morton Keys ==\n";
+    testMorton();
+
     testDilution2();
 }
 
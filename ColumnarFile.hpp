@@ -0,0 +1,587 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 ColumnarFile.hpp -DMAIN_TEST_COLUMNARFILE && ./a.out
+*/
+#pragma once
+
+/**
+ * Binary counterpart to dumpData: named columns of raw values which can be
+ * memory-mapped and used in place, i.e. reloading costs only page faults
+ * instead of parsing text, and processes mapping the same file share the
+ * pages of the page cache.
+ *
+ * Layout, all integers in the byte order of the writing machine, which is
+ * checked by the reader:
+ *
+ *   offset 0   FileHeader
+ *              ColumnEntry[ nColumns ]
+ *              column names, not null-terminated
+ *              padding up to a multiple of columnAlignment
+ *   entry.offset   entry.nElements raw values of the column, padded with
+ *                  zeros up to a multiple of columnAlignment
+ *   ...
+ *
+ * Each column starts at a multiple of columnAlignment, which is a multiple
+ * of the cache line and AVX-512 register size, so that the mapped columns can
+ * be used with aligned vector loads.
+ */
+
+#include <cstddef>                      // size_t
+#include <cstdint>
+#include <cstring>                      // memcmp, memcpy
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>                      // pair, swap
+#include <vector>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#   define COLUMNARFILE_MMAP 1
+#   include <fcntl.h>                   // open
+#   include <sys/mman.h>                // mmap, munmap
+#   include <sys/stat.h>                // fstat
+#   include <unistd.h>                  // close
+#else
+#   define COLUMNARFILE_MMAP 0
+#endif
+
+
+namespace Fundamental {
+
+
+enum class ColumnType : uint8_t
+{
+    Invalid = 0,
+    Int8, UInt8, Int16, UInt16, Int32, UInt32, Int64, UInt64,
+    Float32, Float64
+};
+
+/** @return the ColumnType for the arithmetic type T or Invalid */
+template< typename T >
+inline constexpr ColumnType columnTypeOf( void )
+{
+    return std::is_floating_point< T >::value
+           ? ( sizeof( T ) == 4 && std::numeric_limits< T >::is_iec559 ? ColumnType::Float32 :
+               sizeof( T ) == 8 && std::numeric_limits< T >::is_iec559 ? ColumnType::Float64 : ColumnType::Invalid )
+         : ! std::is_integral< T >::value || std::is_same< T, bool >::value ? ColumnType::Invalid
+         : sizeof( T ) == 1 ? ( std::is_signed< T >::value ? ColumnType::Int8  : ColumnType::UInt8  )
+         : sizeof( T ) == 2 ? ( std::is_signed< T >::value ? ColumnType::Int16 : ColumnType::UInt16 )
+         : sizeof( T ) == 4 ? ( std::is_signed< T >::value ? ColumnType::Int32 : ColumnType::UInt32 )
+         : sizeof( T ) == 8 ? ( std::is_signed< T >::value ? ColumnType::Int64 : ColumnType::UInt64 )
+         : ColumnType::Invalid;
+}
+
+/** @return bytes per value or 0 for invalid types */
+inline size_t columnTypeSize( ColumnType const type )
+{
+    switch ( type )
+    {
+        case ColumnType::Int8   :
+        case ColumnType::UInt8  : return 1;
+        case ColumnType::Int16  :
+        case ColumnType::UInt16 : return 2;
+        case ColumnType::Int32  :
+        case ColumnType::UInt32 :
+        case ColumnType::Float32: return 4;
+        case ColumnType::Int64  :
+        case ColumnType::UInt64 :
+        case ColumnType::Float64: return 8;
+        default: return 0;
+    }
+}
+
+
+namespace detail {
+
+
+constexpr size_t columnAlignment = 64;
+
+struct ColumnarFileHeader
+{
+    char     magic[8];
+    uint32_t byteOrderMark;
+    uint32_t version;
+    uint64_t nColumns;
+    uint64_t fileSize;      /**< for detecting truncated files */
+};
+
+struct ColumnarFileEntry
+{
+    uint64_t offset;        /**< of the first value from the beginning of the file */
+    uint64_t nElements;
+    uint64_t nameOffset;    /**< from the beginning of the file */
+    uint32_t nameLength;
+    uint8_t  type;          /**< ColumnType */
+    uint8_t  reserved[3];
+};
+
+static_assert( sizeof( ColumnarFileHeader ) == 32, "The file format must not depend on the compiler!" );
+static_assert( sizeof( ColumnarFileEntry  ) == 32, "The file format must not depend on the compiler!" );
+
+constexpr char     columnarFileMagic[8]    = { 'F', 'C', 'O', 'L', 'U', 'M', 'N', 'S' };
+constexpr uint32_t columnarFileByteOrder   = 0x01020304u;
+constexpr uint32_t columnarFileVersion     = 1;
+
+inline uint64_t alignColumnOffset( uint64_t const offset )
+{
+    return ( offset + columnAlignment - 1 ) / columnAlignment * columnAlignment;
+}
+
+
+} // namespace detail
+
+
+/** non-owning description of a column to write with writeColumnarFile */
+struct ColumnData
+{
+    std::string  name;
+    ColumnType   type;
+    void const * pData;
+    size_t       nElements;
+};
+
+template< typename T >
+inline ColumnData makeColumn( std::string name, T const * const pData, size_t const nElements )
+{
+    static_assert( columnTypeOf< T >() != ColumnType::Invalid, "Only 8 to 64-bit integers, float and double can be stored!" );
+    return ColumnData{ std::move( name ), columnTypeOf< T >(), pData, nElements };
+}
+
+template< typename T >
+inline ColumnData makeColumn( std::string name, std::vector< T > const & values )
+{
+    return makeColumn( std::move( name ), values.data(), values.size() );
+}
+
+
+/**
+ * Writes columns of possibly different types and lengths in one pass with
+ * one write per column.
+ */
+inline void writeColumnarFile( std::string const & filePath, std::vector< ColumnData > const & columns )
+{
+    using namespace detail;
+
+    std::vector< ColumnarFileEntry > entries( columns.size() );
+    uint64_t offset = sizeof( ColumnarFileHeader ) + columns.size() * sizeof( ColumnarFileEntry );
+    for ( size_t i = 0; i < columns.size(); ++i )
+    {
+        if ( columnTypeSize( columns[i].type ) == 0 )
+            throw std::invalid_argument( "[writeColumnarFile] Invalid column type!" );
+        if ( columns[i].name.size() > std::numeric_limits< uint32_t >::max() )
+            throw std::invalid_argument( "[writeColumnarFile] Column name too long!" );
+
+        std::memset( &entries[i], 0, sizeof( entries[i] ) );
+        entries[i].nameOffset = offset;
+        entries[i].nameLength = uint32_t( columns[i].name.size() );
+        entries[i].type       = uint8_t( columns[i].type );
+        entries[i].nElements  = columns[i].nElements;
+        offset += columns[i].name.size();
+    }
+    for ( size_t i = 0; i < columns.size(); ++i )
+    {
+        offset = alignColumnOffset( offset );
+        entries[i].offset = offset;
+        offset += columns[i].nElements * columnTypeSize( columns[i].type );
+    }
+
+    ColumnarFileHeader header;
+    std::memset( &header, 0, sizeof( header ) );
+    std::memcpy( header.magic, columnarFileMagic, sizeof( header.magic ) );
+    header.byteOrderMark = columnarFileByteOrder;
+    header.version       = columnarFileVersion;
+    header.nColumns      = columns.size();
+    header.fileSize      = alignColumnOffset( offset );
+
+    std::ofstream file( filePath, std::ios::out | std::ios::binary );
+    if ( file.fail() )
+        throw std::invalid_argument( "Couldn't open file!" );
+
+    char const zeros[ columnAlignment ] = {};
+    auto const pad = [&] () {
+        auto const position = uint64_t( file.tellp() );
+        file.write( zeros, std::streamsize( alignColumnOffset( position ) - position ) );
+    };
+
+    file.write( reinterpret_cast< char const * >( &header ), sizeof( header ) );
+    file.write( reinterpret_cast< char const * >( entries.data() ), std::streamsize( entries.size() * sizeof( entries[0] ) ) );
+    for ( auto const & column : columns )
+        file.write( column.name.data(), std::streamsize( column.name.size() ) );
+    for ( auto const & column : columns )
+    {
+        pad();
+        file.write( static_cast< char const * >( column.pData ),
+                    std::streamsize( column.nElements * columnTypeSize( column.type ) ) );
+    }
+    pad();
+
+    file.close();
+    if ( file.fail() )
+        throw std::invalid_argument( "Couldn't write to file!" );
+}
+
+/**
+ * Binary version of dumpData for the same input, which can be reloaded
+ * without parsing with MappedColumnarFile or loadBinaryData.
+ */
+template< typename T_Prec >
+inline void dumpBinaryData
+(
+    std::string const & filePath,
+    std::vector< std::pair< std::string, std::vector< T_Prec > > > const & data
+)
+{
+    std::vector< ColumnData > columns;
+    columns.reserve( data.size() );
+    for ( auto const & kv : data )
+        columns.push_back( makeColumn( kv.first, kv.second ) );
+    writeColumnarFile( filePath, columns );
+}
+
+
+/** read-only contiguous values of a column, which point into the mapping */
+template< typename T >
+class ColumnView
+{
+private:
+    T const * pData;
+    size_t    nElements;
+
+public:
+    inline ColumnView( void ) : pData( nullptr ), nElements( 0 ) {}
+    inline ColumnView( T const * const rpData, size_t const rnElements ) : pData( rpData ), nElements( rnElements ) {}
+
+    inline T const * data ( void ) const { return pData; }
+    inline size_t    size ( void ) const { return nElements; }
+    inline bool      empty( void ) const { return nElements == 0; }
+    inline T const * begin( void ) const { return pData; }
+    inline T const * end  ( void ) const { return pData + nElements; }
+    inline T const & operator[]( size_t const i ) const { return pData[i]; }
+
+    inline std::vector< T > toVector( void ) const { return std::vector< T >( begin(), end() ); }
+};
+
+
+/**
+ * Maps a file written by writeColumnarFile read-only into memory and gives
+ * out its columns without copying. The views stay valid as long as this
+ * object lives. Files are validated when opened, so that a malformed or
+ * truncated file can't lead to reads out of the mapping.
+ */
+class MappedColumnarFile
+{
+public:
+    struct ColumnInfo
+    {
+        std::string name;
+        ColumnType  type;
+        size_t      nElements;
+        size_t      offset;
+    };
+
+private:
+    char const *              pMapping;
+    size_t                    nBytes;
+    std::vector< char >       contents;    /**< owns the data if mmap is not available */
+    std::vector< ColumnInfo > columnInfos;
+
+    inline void unmap( void )
+    {
+#if COLUMNARFILE_MMAP
+        if ( pMapping != nullptr && contents.empty() )
+            munmap( const_cast< char * >( pMapping ), nBytes );
+#endif
+        pMapping = nullptr;
+        nBytes   = 0;
+        contents.clear();
+    }
+
+    inline void map( std::string const & filePath )
+    {
+#if COLUMNARFILE_MMAP
+        auto const fileDescriptor = ::open( filePath.c_str(), O_RDONLY );
+        if ( fileDescriptor < 0 )
+            throw std::invalid_argument( "Couldn't open file!" );
+        struct stat status;
+        if ( fstat( fileDescriptor, &status ) != 0 || status.st_size < off_t( sizeof( detail::ColumnarFileHeader ) ) )
+        {
+            ::close( fileDescriptor );
+            throw std::invalid_argument( "[MappedColumnarFile] File is too small!" );
+        }
+        nBytes = size_t( status.st_size );
+        auto const pAddress = mmap( nullptr, nBytes, PROT_READ, MAP_SHARED, fileDescriptor, 0 );
+        ::close( fileDescriptor );  // the mapping stays valid
+        if ( pAddress == MAP_FAILED )
+            throw std::invalid_argument( "[MappedColumnarFile] Couldn't map file!" );
+        pMapping = static_cast< char const * >( pAddress );
+#else
+        std::ifstream file( filePath, std::ios::in | std::ios::binary | std::ios::ate );
+        if ( file.fail() )
+            throw std::invalid_argument( "Couldn't open file!" );
+        contents.resize( size_t( file.tellg() ) );
+        file.seekg( 0 );
+        file.read( contents.data(), std::streamsize( contents.size() ) );
+        if ( file.fail() || contents.size() < sizeof( detail::ColumnarFileHeader ) )
+            throw std::invalid_argument( "[MappedColumnarFile] File is too small!" );
+        pMapping = contents.data();
+        nBytes   = contents.size();
+#endif
+    }
+
+    inline void parse( void )
+    {
+        using namespace detail;
+
+        ColumnarFileHeader header;
+        std::memcpy( &header, pMapping, sizeof( header ) );
+        if ( std::memcmp( header.magic, columnarFileMagic, sizeof( header.magic ) ) != 0 )
+            throw std::invalid_argument( "[MappedColumnarFile] Not a columnar file!" );
+        if ( header.byteOrderMark != columnarFileByteOrder )
+            throw std::invalid_argument( "[MappedColumnarFile] File was written with a different byte order!" );
+        if ( header.version != columnarFileVersion )
+            throw std::invalid_argument( "[MappedColumnarFile] Unsupported file version!" );
+        if ( header.fileSize != nBytes )
+            throw std::invalid_argument( "[MappedColumnarFile] File is truncated!" );
+        if ( header.nColumns > ( nBytes - sizeof( header ) ) / sizeof( ColumnarFileEntry ) )
+            throw std::invalid_argument( "[MappedColumnarFile] Invalid number of columns!" );
+
+        columnInfos.resize( size_t( header.nColumns ) );
+        for ( size_t i = 0; i < columnInfos.size(); ++i )
+        {
+            ColumnarFileEntry entry;
+            std::memcpy( &entry, pMapping + sizeof( header ) + i * sizeof( entry ), sizeof( entry ) );
+
+            auto const type        = ColumnType( entry.type );
+            auto const elementSize = columnTypeSize( type );
+            /* written so that none of the checks can overflow */
+            if ( elementSize == 0 ||
+                 entry.nameOffset > nBytes || entry.nameLength > nBytes - entry.nameOffset ||
+                 entry.offset % columnAlignment != 0 || entry.offset > nBytes ||
+                 entry.nElements > ( nBytes - entry.offset ) / elementSize )
+                throw std::invalid_argument( "[MappedColumnarFile] Invalid column entry!" );
+
+            columnInfos[i].name.assign( pMapping + entry.nameOffset, entry.nameLength );
+            columnInfos[i].type      = type;
+            columnInfos[i].nElements = size_t( entry.nElements );
+            columnInfos[i].offset    = size_t( entry.offset );
+        }
+    }
+
+public:
+    inline explicit MappedColumnarFile( std::string const & filePath ) : pMapping( nullptr ), nBytes( 0 )
+    {
+        map( filePath );
+        try
+        {
+            parse();
+        }
+        catch ( ... )
+        {
+            unmap();
+            throw;
+        }
+    }
+
+    inline ~MappedColumnarFile() { unmap(); }
+
+    MappedColumnarFile( MappedColumnarFile const & ) = delete;
+    MappedColumnarFile & operator=( MappedColumnarFile const & ) = delete;
+
+    inline MappedColumnarFile( MappedColumnarFile && other ) : pMapping( nullptr ), nBytes( 0 )
+    {
+        *this = std::move( other );
+    }
+
+    inline MappedColumnarFile & operator=( MappedColumnarFile && other )
+    {
+        if ( this != &other )
+        {
+            unmap();
+            std::swap( pMapping, other.pMapping );
+            std::swap( nBytes  , other.nBytes   );
+            contents.swap( other.contents );
+            columnInfos.swap( other.columnInfos );
+        }
+        return *this;
+    }
+
+    inline size_t size( void ) const { return columnInfos.size(); }
+    inline std::vector< ColumnInfo > const & columns( void ) const { return columnInfos; }
+
+    /** @return index of the first column with that name or size() if there is none */
+    inline size_t find( std::string const & name ) const
+    {
+        size_t i = 0;
+        while ( i < columnInfos.size() && columnInfos[i].name != name )
+            ++i;
+        return i;
+    }
+
+    /** @throws std::invalid_argument if T doesn't match the stored type */
+    template< typename T >
+    inline ColumnView< T > column( size_t const i ) const
+    {
+        if ( i >= columnInfos.size() )
+            throw std::invalid_argument( "[MappedColumnarFile::column] Index out of range!" );
+        auto const & info = columnInfos[i];
+        if ( info.type != columnTypeOf< T >() )
+            throw std::invalid_argument( "[MappedColumnarFile::column] Requested type doesn't match the stored type!" );
+        return ColumnView< T >( reinterpret_cast< T const * >( pMapping + info.offset ), info.nElements );
+    }
+
+    template< typename T >
+    inline ColumnView< T > column( std::string const & name ) const
+    {
+        auto const i = find( name );
+        if ( i >= columnInfos.size() )
+            throw std::invalid_argument( "[MappedColumnarFile::column] No column named '" + name + "'!" );
+        return column< T >( i );
+    }
+};
+
+
+/** inverse of dumpBinaryData which copies the columns into memory */
+template< typename T_Prec >
+inline std::vector< std::pair< std::string, std::vector< T_Prec > > >
+loadBinaryData( std::string const & filePath )
+{
+    MappedColumnarFile const file( filePath );
+    std::vector< std::pair< std::string, std::vector< T_Prec > > > data;
+    data.reserve( file.size() );
+    for ( size_t i = 0; i < file.size(); ++i )
+        data.emplace_back( file.columns()[i].name, file.column< T_Prec >( i ).toVector() );
+    return data;
+}
+
+
+} // namespace Fundamental
+
+
+#ifdef MAIN_TEST_COLUMNARFILE
+
+
+#include <cmath>                        // nan
+#include <cstdio>                       // remove
+#include <cstdlib>                      // rand
+#include <iostream>
+#include <iterator>                     // istreambuf_iterator
+
+
+template< typename T >
+inline bool equalBits( Fundamental::ColumnView< T > const & view, std::vector< T > const & expected )
+{
+    return view.size() == expected.size() &&
+           ( expected.empty() || std::memcmp( view.data(), expected.data(), expected.size() * sizeof( T ) ) == 0 );
+}
+
+inline bool expectThrow( void ( *f )( void ) )
+{
+    try
+    {
+        f();
+    }
+    catch ( std::invalid_argument const & )
+    {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    using namespace Fundamental;
+
+    std::string const filePath = "/tmp/columnarFile-test.bin";
+    bool success = true;
+
+    std::vector< double > doubles( 1001 );
+    for ( auto & x : doubles )
+        x = ( std::rand() - RAND_MAX / 2 ) / 1e3;
+    doubles[3] = std::nan( "" );
+    doubles[4] = -0.0;
+    std::vector< float > floats( 17, 1.5f );
+    std::vector< int64_t > integers = { std::numeric_limits< int64_t >::min(), -1, 0, 1, std::numeric_limits< int64_t >::max() };
+    std::vector< uint8_t > bytes = { 0, 7, 255 };
+    std::vector< int32_t > empty;
+
+    writeColumnarFile( filePath, {
+        makeColumn( "price", doubles ), makeColumn( "", floats ), makeColumn( "volume", integers ),
+        makeColumn( "flags", bytes ), makeColumn( "empty", empty ), makeColumn( "price", floats.data(), 3 )
+    } );
+
+    {
+        MappedColumnarFile file( filePath );
+        success &= file.size() == 6;
+        success &= file.columns()[1].name.empty() && file.columns()[2].type == ColumnType::Int64;
+        success &= equalBits( file.column< double >( "price" ), doubles );
+        success &= equalBits( file.column< float >( 1 ), floats );
+        success &= equalBits( file.column< int64_t >( "volume" ), integers );
+        success &= equalBits( file.column< uint8_t >( "flags" ), bytes );
+        success &= file.column< int32_t >( "empty" ).empty();
+        success &= file.column< float >( 5 ).toVector() == std::vector< float >( 3, 1.5f );
+        success &= file.find( "missing" ) == file.size();
+        for ( size_t i = 0; i < file.size(); ++i )
+            success &= file.columns()[i].offset % detail::columnAlignment == 0;
+        success &= reinterpret_cast< uintptr_t >( file.column< double >( 0 ).data() ) % detail::columnAlignment == 0;
+
+        /* views stay valid after moving the mapping */
+        auto const view = file.column< int64_t >( 2 );
+        MappedColumnarFile moved( std::move( file ) );
+        success &= file.size() == 0 && moved.size() == 6 && equalBits( view, integers );
+
+        /* several mappings of the same file */
+        MappedColumnarFile const other( filePath );
+        success &= equalBits( other.column< double >( 0 ), doubles );
+    }
+
+    success &= expectThrow( [] () { MappedColumnarFile( "/tmp/columnarFile-test.bin" ).column< float >( "price" ); } );
+    success &= expectThrow( [] () { MappedColumnarFile( "/tmp/columnarFile-test.bin" ).column< double >( "missing" ); } );
+    success &= expectThrow( [] () { MappedColumnarFile( "/tmp/columnarFile-test.bin" ).column< double >( 6 ); } );
+    success &= expectThrow( [] () { MappedColumnarFile( "/tmp/columnarFile-nonexistent.bin" ); } );
+
+    /* every truncation and every corrupted header byte has to be detected or be harmless */
+    std::string contents;
+    {
+        std::ifstream file( filePath, std::ios::binary );
+        contents.assign( std::istreambuf_iterator< char >( file ), std::istreambuf_iterator< char >() );
+    }
+    auto const writeContents = [&] ( std::string const & newContents ) {
+        std::ofstream file( filePath, std::ios::binary );
+        file.write( newContents.data(), std::streamsize( newContents.size() ) );
+    };
+    for ( size_t n : { size_t( 0 ), size_t( 31 ), size_t( 32 ), contents.size() - 64, contents.size() - 1 } )
+    {
+        writeContents( contents.substr( 0, n ) );
+        success &= expectThrow( [] () { MappedColumnarFile( "/tmp/columnarFile-test.bin" ); } );
+    }
+    auto const nHeaderBytes = sizeof( detail::ColumnarFileHeader ) + 6 * sizeof( detail::ColumnarFileEntry );
+    for ( size_t i = 0; i < nHeaderBytes; ++i )
+    {
+        auto corrupted = contents;
+        corrupted[i] = char( corrupted[i] ^ 0x80 );
+        writeContents( corrupted );
+        try
+        {
+            MappedColumnarFile const file( filePath );
+            /* e.g. changed names or reserved bytes, the columns have to be inside the file */
+            for ( auto const & info : file.columns() )
+                success &= info.offset + info.nElements * columnTypeSize( info.type ) <= contents.size();
+        }
+        catch ( std::invalid_argument const & ) {}
+    }
+
+    /* round trip of the dumpData input format */
+    std::vector< std::pair< std::string, std::vector< double > > > const data = {
+        { "t", { 1, 2, 3 } }, { "x", { 0.5 } }, { "v", {} }
+    };
+    dumpBinaryData( filePath, data );
+    success &= loadBinaryData< double >( filePath ) == data;
+    success &= expectThrow( [] () { loadBinaryData< float >( "/tmp/columnarFile-test.bin" ); } );
+
+    std::remove( filePath.c_str() );
+    std::cout << "Columnar file " << ( success ? "OK" : "FAILED" ) << "\n";
+}
+
+
+#endif
@@ -0,0 +1,725 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 CsvReader.hpp -DMAIN_TEST_CSVREADER timeExtensions.cpp -pthread && ./a.out
+*/
+#pragma once
+
+/**
+ * Streaming reader for delimiter-separated files of numbers and dates, e.g.
+ * exchange data, which hands out the values as batches of columns, so that
+ * files larger than the memory can be processed in bounded memory, e.g. with
+ * RollingLineFit or TimeSeriesNormalizer.
+ *
+ * The file is read in chunks into two alternating buffers, the next chunk
+ * being read in the background while the current one is parsed. Field and
+ * line boundaries are found by comparing 64 characters at a time with SIMD
+ * instructions and collecting the set bits of the resulting mask like in
+ * simdjson, before the fields are parsed with parseDouble, i.e.
+ * std::from_chars if available, or with a CompiledDateFormat.
+ * @see G. Langdale, D. Lemire, "Parsing Gigabytes of JSON per Second", 2019
+ *
+ * Quoting is not supported, i.e. fields must not contain the delimiter or
+ * line breaks.
+ */
+
+#include <algorithm>                    // min
+#include <cstddef>                      // size_t
+#include <cstdint>
+#include <cstring>                      // memcpy
+#include <ctime>                        // tm
+#include <fstream>
+#include <future>                       // async
+#include <limits>
+#include <memory>                       // unique_ptr
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Fundamental.hpp"              // parseNumberField
+#include "SimdDispatch.hpp"
+#include "timeExtensions.hpp"           // CompiledDateFormat, timegm
+
+#if SIMD_X86
+#   include <immintrin.h>
+#endif
+
+
+namespace Fundamental {
+
+
+namespace detail {
+
+
+/** stores offset + the index of each set bit of mask in ascending order */
+inline size_t appendBitPositions( uint64_t mask, uint32_t const offset, uint32_t * const positions )
+{
+    size_t n = 0;
+    while ( mask != 0 )
+    {
+    #if defined( __GNUC__ )
+        positions[ n++ ] = offset + uint32_t( __builtin_ctzll( mask ) );
+    #else
+        uint32_t i = 0;
+        while ( ( ( mask >> i ) & 1u ) == 0 )
+            ++i;
+        positions[ n++ ] = offset + i;
+    #endif
+        mask &= mask - 1u;
+    }
+    return n;
+}
+
+/**
+ * Stores the positions of all delimiters and newlines in p[ iBegin, iEnd ).
+ * @param[out] positions needs space for iEnd - iBegin elements
+ * @return number of stored positions
+ */
+inline size_t findSeparatorsScalar
+(
+    char     const * const p,
+    size_t           const iBegin,
+    size_t           const iEnd,
+    char             const delimiter,
+    uint32_t       * const positions
+)
+{
+    size_t n = 0;
+    for ( auto i = iBegin; i < iEnd; ++i )
+    {
+        /* branchless, because separators are too frequent to be predicted */
+        positions[n] = uint32_t( i );
+        n += ( p[i] == delimiter ) | ( p[i] == '\n' );
+    }
+    return n;
+}
+
+#if SIMD_X86 && SIMD_VECTOR128
+inline uint64_t separatorMaskSse2( char const * const p, __m128i const & delimiters, __m128i const & newlines )
+{
+    uint64_t mask = 0;
+    for ( int k = 0; k < 4; ++k )
+    {
+        auto const chars = _mm_loadu_si128( reinterpret_cast< __m128i const * >( p + 16 * k ) );
+        auto const found = _mm_or_si128( _mm_cmpeq_epi8( chars, delimiters ), _mm_cmpeq_epi8( chars, newlines ) );
+        mask |= uint64_t( uint32_t( _mm_movemask_epi8( found ) ) & 0xFFFFu ) << ( 16 * k );
+    }
+    return mask;
+}
+
+inline size_t findSeparatorsSse2( char const * const p, size_t const iBegin, size_t const iEnd, char const delimiter, uint32_t * const positions )
+{
+    auto const delimiters = _mm_set1_epi8( delimiter );
+    auto const newlines   = _mm_set1_epi8( '\n' );
+    size_t n = 0;
+    auto i = iBegin;
+    for ( ; i + 64 <= iEnd; i += 64 )
+        n += appendBitPositions( separatorMaskSse2( p + i, delimiters, newlines ), uint32_t( i ), positions + n );
+    return n + findSeparatorsScalar( p, i, iEnd, delimiter, positions + n );
+}
+#endif
+
+#if SIMD_X86
+SIMD_TARGET_AVX2 inline uint64_t separatorMaskAvx2( char const * const p, __m256i const & delimiters, __m256i const & newlines )
+{
+    uint64_t mask = 0;
+    for ( int k = 0; k < 2; ++k )
+    {
+        auto const chars = _mm256_loadu_si256( reinterpret_cast< __m256i const * >( p + 32 * k ) );
+        auto const found = _mm256_or_si256( _mm256_cmpeq_epi8( chars, delimiters ), _mm256_cmpeq_epi8( chars, newlines ) );
+        mask |= uint64_t( uint32_t( _mm256_movemask_epi8( found ) ) ) << ( 32 * k );
+    }
+    return mask;
+}
+
+SIMD_TARGET_AVX2 inline size_t findSeparatorsAvx2( char const * const p, size_t const iBegin, size_t const iEnd, char const delimiter, uint32_t * const positions )
+{
+    auto const delimiters = _mm256_set1_epi8( delimiter );
+    auto const newlines   = _mm256_set1_epi8( '\n' );
+    size_t n = 0;
+    auto i = iBegin;
+    for ( ; i + 64 <= iEnd; i += 64 )
+        n += appendBitPositions( separatorMaskAvx2( p + i, delimiters, newlines ), uint32_t( i ), positions + n );
+    return n + findSeparatorsScalar( p, i, iEnd, delimiter, positions + n );
+}
+#endif
+
+/** @see findSeparatorsScalar */
+inline size_t findSeparators
+(
+    char     const * const p,
+    size_t           const iBegin,
+    size_t           const iEnd,
+    char             const delimiter,
+    uint32_t       * const positions,
+    Simd::InstructionSet const instructionSet = Simd::instructionSet()
+)
+{
+    switch ( instructionSet )
+    {
+    #if SIMD_X86
+        /* comparing bytes would need AVX-512BW and AVX2 is already much faster than parsing the fields */
+        case Simd::InstructionSet::Avx512:
+        case Simd::InstructionSet::Avx2:
+            return findSeparatorsAvx2( p, iBegin, iEnd, delimiter, positions );
+    #endif
+    #if SIMD_X86 && SIMD_VECTOR128
+        case Simd::InstructionSet::Sse2:
+            return findSeparatorsSse2( p, iBegin, iEnd, delimiter, positions );
+    #endif
+        default:
+            return findSeparatorsScalar( p, iBegin, iEnd, delimiter, positions );
+    }
+}
+
+
+} // namespace detail
+
+
+/** values of consecutive rows stored as columns[ iColumn ][ iRow ] */
+struct CsvBatch
+{
+    size_t                               iFirstRow;  /**< index in the file not counting the header and empty lines */
+    size_t                               nRows;
+    std::vector< std::vector< double > > columns;    /**< nRows values each, NaN for empty or invalid fields */
+};
+
+
+/**
+ * Reads batches of rows, which are given as columns of doubles, from a file.
+ * Memory is bounded by 4 * nChunkBytes for the buffers, i.e. lines must not be
+ * longer than nChunkBytes, plus the batch.
+ *
+ * Fields are numbers by default and can be set to be dates, which are
+ * converted to unix time stamps like with parseTimes. Missing fields of
+ * short lines, empty fields and fields which couldn't be parsed are NaN.
+ * Fields beyond the number of columns are ignored. Empty lines are skipped,
+ * "\r\n" line endings are supported.
+ */
+class CsvReader
+{
+private:
+    enum class LineStatus { Complete, Empty, Incomplete };
+
+    struct DateColumn
+    {
+        CompiledDateFormat format;
+        double             timeZone;
+    };
+
+    std::ifstream              file;
+    char                       delimiter;
+    size_t                     nRowsPerBatch;
+    size_t                     nChunkBytes;
+    bool                       readAhead;
+    size_t                     nColumns;
+    std::vector< std::string > names;
+    std::vector< int >         iDateColumns;    /**< per column the index into dateColumns or -1 for numbers */
+    std::vector< DateColumn >  dateColumns;
+    size_t                     nRowsRead;
+
+    /* each buffer has nChunkBytes in front of the chunk to carry over the incomplete last line of the other one */
+    std::unique_ptr< char[] >  buffers[2];      /**< not std::vector to not initialize, i.e. touch, the memory */
+    int                        iBuffer;         /**< buffer being parsed */
+    size_t                     iBegin;          /**< beginning of the next line */
+    size_t                     iEnd;            /**< end of the valid data in the buffer */
+    bool                       endOfFile;       /**< there is no more data than in the current buffer */
+
+    std::vector< uint32_t >    separators;      /**< positions of all delimiters and newlines in a part of the buffer */
+    size_t                     iSeparator;
+    size_t                     nSeparators;
+    size_t                     iScanned;        /**< end of the part of the buffer scanned for separators */
+
+    /* declared last, so that it is destroyed and waited for before the buffers and the file */
+    std::future< size_t >      pendingRead;
+
+    static size_t constexpr nScanBytes = 64 * 1024;
+
+    inline size_t readChunk( char * const p )
+    {
+        file.read( p, std::streamsize( nChunkBytes ) );
+        return size_t( file.gcount() );
+    }
+
+    /* starts reading the next chunk into the other buffer */
+    inline void startRead( void )
+    {
+        if ( readAhead )
+        {
+            auto const p = buffers[ iBuffer ^ 1 ].get() + nChunkBytes;
+            pendingRead = std::async( std::launch::async, [this, p] () { return readChunk( p ); } );
+        }
+    }
+
+    inline void resetScan( void )
+    {
+        iScanned    = iBegin;
+        iSeparator  = 0;
+        nSeparators = 0;
+    }
+
+    /**
+     * Switches to the other buffer, which contains the unparsed rest of the
+     * current buffer followed by the next chunk.
+     * @return false if there is no more data
+     */
+    inline bool refill( void )
+    {
+        if ( endOfFile )
+            return false;
+
+        auto const next = buffers[ iBuffer ^ 1 ].get();
+        auto const nRead = readAhead ? pendingRead.get() : readChunk( next + nChunkBytes );
+        if ( nRead < nChunkBytes )
+            endOfFile = true;
+        if ( nRead == 0 )
+            return false;
+
+        auto const nCarried = iEnd - iBegin;
+        if ( nCarried > nChunkBytes )
+            throw std::invalid_argument( "[CsvReader] Line is longer than the chunk size!" );
+        std::memcpy( next + nChunkBytes - nCarried, buffers[ iBuffer ].get() + iBegin, nCarried );
+
+        iBuffer ^= 1;
+        iBegin = nChunkBytes - nCarried;
+        iEnd   = nChunkBytes + nRead;
+        resetScan();
+        if ( ! endOfFile )
+            startRead();
+        return true;
+    }
+
+    /** @return position of the next delimiter or newline or iEnd if there is none */
+    inline size_t nextSeparator( void )
+    {
+        while ( iSeparator == nSeparators )
+        {
+            if ( iScanned >= iEnd )
+                return iEnd;
+            auto const iScanEnd = std::min( iEnd, iScanned + nScanBytes );
+            nSeparators = detail::findSeparators( buffers[ iBuffer ].get(), iScanned, iScanEnd, delimiter, separators.data() );
+            iSeparator  = 0;
+            iScanned    = iScanEnd;
+        }
+        return separators[ iSeparator++ ];
+    }
+
+    /**
+     * Calls f( iField, first, last ) for each field of the next line and moves
+     * past it, if it is complete. A line is incomplete if the buffer ends
+     * before the newline and the file doesn't, in which case f may already
+     * have been called for some of its fields.
+     */
+    template< typename T_Functor >
+    inline LineStatus forEachField( T_Functor && f )
+    {
+        auto const p = buffers[ iBuffer ].get();
+        auto iField = iBegin;
+        for ( size_t i = 0; ; ++i )
+        {
+            auto const iSeparator = nextSeparator();
+            if ( iSeparator == iEnd && ! endOfFile )
+            {
+                resetScan();
+                return LineStatus::Incomplete;
+            }
+
+            bool const isLast = iSeparator == iEnd || p[ iSeparator ] == '\n';
+            auto iFieldEnd = iSeparator;
+            if ( isLast && iFieldEnd > iField && p[ iFieldEnd - 1 ] == '\r' )
+                --iFieldEnd;
+
+            if ( isLast && i == 0 && iFieldEnd == iField )
+            {
+                iBegin = std::min( iEnd, iSeparator + 1 );
+                return LineStatus::Empty;
+            }
+            f( i, p + iField, p + iFieldEnd );
+
+            if ( isLast )
+            {
+                iBegin = std::min( iEnd, iSeparator + 1 );
+                return LineStatus::Complete;
+            }
+            iField = iSeparator + 1;
+        }
+    }
+
+    /**
+     * Like forEachField, but skips empty lines and refills the buffer if
+     * necessary. If consume is false, the line will be parsed again.
+     */
+    template< typename T_Functor >
+    inline bool forEachFieldOfNextLine( T_Functor && f, bool const consume = true )
+    {
+        for ( ;; )
+        {
+            if ( iBegin == iEnd && ! refill() )
+                return false;
+            auto const iLineBegin = iBegin;
+            auto const status = forEachField( f );
+            if ( status == LineStatus::Complete )
+            {
+                if ( ! consume )
+                {
+                    iBegin = iLineBegin;
+                    resetScan();
+                }
+                return true;
+            }
+            if ( status == LineStatus::Incomplete && ! refill() )
+                /* the file ended exactly at the end of the chunk, i.e. endOfFile is set now */
+                continue;
+        }
+    }
+
+    inline double parseField( size_t const iColumn, char const * const first, char const * const last ) const
+    {
+        auto const iDateColumn = iDateColumns[ iColumn ];
+        if ( iDateColumn < 0 )
+            return ::detail::parseNumberField( first, last );
+
+        auto const & dateColumn = dateColumns[ iDateColumn ];
+        std::tm date = {};
+        return dateColumn.format.parse( first, last, date ) ? timegm( date ) - dateColumn.timeZone
+                                                            : std::numeric_limits< double >::quiet_NaN();
+    }
+
+public:
+    /**
+     * @param[in] hasHeader if true, the first non-empty line gives the column
+     *            names, else the number of fields in it gives the number of
+     *            columns
+     * @param[in] nRowsPerBatch rows returned by each call to read except the last
+     * @param[in] readAhead read the next chunk in a background thread
+     */
+    inline explicit CsvReader
+    (
+        std::string const & filePath,
+        char        const   rDelimiter     = ',',
+        bool        const   hasHeader      = true,
+        size_t      const   rnRowsPerBatch = 64 * 1024,
+        size_t      const   rnChunkBytes   = 1024 * 1024,
+        bool        const   rReadAhead     = true
+    )
+     : delimiter( rDelimiter ), nRowsPerBatch( rnRowsPerBatch ), nChunkBytes( rnChunkBytes ),
+       readAhead( rReadAhead ), nColumns( 0 ), nRowsRead( 0 ), iBuffer( 0 ),
+       iBegin( rnChunkBytes ), iEnd( rnChunkBytes ), endOfFile( false ),
+       separators( nScanBytes ), iSeparator( 0 ), nSeparators( 0 ), iScanned( rnChunkBytes )
+    {
+        if ( nRowsPerBatch == 0 )
+            throw std::invalid_argument( "[CsvReader] Rows per batch must be positive!" );
+        /* positions in the buffers are stored as 32-bit integers */
+        if ( nChunkBytes == 0 || nChunkBytes > ( size_t( 1 ) << 31 ) )
+            throw std::invalid_argument( "[CsvReader] Chunk size must be in (0, 2 GiB]!" );
+        if ( delimiter == '\n' || delimiter == '\r' )
+            throw std::invalid_argument( "[CsvReader] Delimiter must not be a line break!" );
+
+        file.open( filePath, std::ios::in | std::ios::binary );
+        if ( file.fail() )
+            throw std::invalid_argument( "Couldn't open file!" );
+        buffers[0].reset( new char[ 2 * nChunkBytes ] );
+        buffers[1].reset( new char[ 2 * nChunkBytes ] );
+        startRead();
+
+        if ( hasHeader )
+        {
+            /* f is called again for the fields of an incomplete line after refilling */
+            forEachFieldOfNextLine( [this] ( size_t const i, char const * const first, char const * const last ) {
+                names.resize( i + 1 );
+                names[i].assign( first, last );
+            } );
+            nColumns = names.size();
+        }
+        else
+            forEachFieldOfNextLine( [this] ( size_t const i, char const *, char const * ) { nColumns = i + 1; }, false );
+        iDateColumns.assign( nColumns, -1 );
+    }
+
+    CsvReader( CsvReader const & ) = delete;
+    CsvReader & operator=( CsvReader const & ) = delete;
+
+    /** @return the names from the header which are empty without header */
+    inline std::vector< std::string > const & columnNames( void ) const { return names; }
+    inline size_t size( void ) const { return nColumns; }
+
+    /** @return index of the first column with that name or size() if there is none */
+    inline size_t find( std::string const & name ) const
+    {
+        size_t i = 0;
+        while ( i < names.size() && names[i] != name )
+            ++i;
+        return i < names.size() ? i : nColumns;
+    }
+
+    /**
+     * Parses the column as dates, e.g. with "%Y-%m-%d %H:%M:%S", into unix
+     * time stamps. @see parseTimes
+     */
+    inline void setDateFormat( size_t const iColumn, std::string const & dateFormatter, double const timeZone = 0 )
+    {
+        if ( iColumn >= nColumns )
+            throw std::invalid_argument( "[CsvReader::setDateFormat] Column index out of range!" );
+        dateColumns.push_back( DateColumn{ CompiledDateFormat( dateFormatter ), timeZone } );
+        iDateColumns[ iColumn ] = int( dateColumns.size() - 1 );
+    }
+
+    inline void setDateFormat( std::string const & name, std::string const & dateFormatter, double const timeZone = 0 )
+    {
+        auto const iColumn = find( name );
+        if ( iColumn >= nColumns )
+            throw std::invalid_argument( "[CsvReader::setDateFormat] No column named '" + name + "'!" );
+        setDateFormat( iColumn, dateFormatter, timeZone );
+    }
+
+    /**
+     * Reads the next nRowsPerBatch rows or less at the end of the file.
+     * batch can be reused for the next call, so that reading doesn't allocate.
+     * @return false if there were no more rows, i.e. batch.nRows is 0
+     */
+    inline bool read( CsvBatch & batch )
+    {
+        batch.iFirstRow = nRowsRead;
+        batch.columns.resize( nColumns );
+        for ( auto & column : batch.columns )
+            column.resize( nRowsPerBatch );
+
+        size_t nRows = 0;
+        auto const nan = std::numeric_limits< double >::quiet_NaN();
+        auto const parseValue = [&] ( size_t const iColumn, char const * const first, char const * const last ) {
+            if ( iColumn < nColumns )
+                batch.columns[ iColumn ][ nRows ] = parseField( iColumn, first, last );
+        };
+
+        for ( ; nRows < nRowsPerBatch; ++nRows )
+        {
+            /* missing fields of short lines */
+            for ( auto & column : batch.columns )
+                column[ nRows ] = nan;
+            if ( ! forEachFieldOfNextLine( parseValue ) )
+                break;
+        }
+
+        for ( auto & column : batch.columns )
+            column.resize( nRows );
+        batch.nRows = nRows;
+        nRowsRead += nRows;
+        return nRows > 0;
+    }
+};
+
+
+} // namespace Fundamental
+
+
+#ifdef MAIN_TEST_CSVREADER
+
+
+#include <cmath>                        // isnan
+#include <cstdio>                       // remove, snprintf
+#include <cstdlib>                      // rand
+#include <iostream>
+
+
+namespace {
+
+
+/* straightforward reimplementation of the format described at CsvReader */
+std::vector< std::vector< double > > parseCsvReference
+(
+    std::string const & text,
+    char const delimiter,
+    size_t const nColumns,
+    Fundamental::CompiledDateFormat const & format
+)
+{
+    std::vector< std::vector< double > > rows;
+    size_t iLine = 0;
+    bool isHeader = true;
+    while ( iLine < text.size() )
+    {
+        auto iLineEnd = text.find( '\n', iLine );
+        if ( iLineEnd == std::string::npos )
+            iLineEnd = text.size();
+        auto line = text.substr( iLine, iLineEnd - iLine );
+        iLine = iLineEnd + 1;
+        if ( ! line.empty() && line.back() == '\r' )
+            line.pop_back();
+        if ( line.empty() )
+            continue;
+        if ( isHeader )
+        {
+            isHeader = false;
+            continue;
+        }
+
+        std::vector< double > row( nColumns, std::nan( "" ) );
+        size_t iField = 0;
+        for ( size_t iColumn = 0; iColumn < nColumns && iField <= line.size(); ++iColumn )
+        {
+            auto iFieldEnd = line.find( delimiter, iField );
+            if ( iFieldEnd == std::string::npos )
+                iFieldEnd = line.size();
+            auto const first = line.data() + iField;
+            auto const last  = line.data() + iFieldEnd;
+            if ( iColumn == 0 )
+            {
+                std::tm date = {};
+                if ( format.parse( first, last, date ) )
+                    row[ iColumn ] = Fundamental::timegm( date ) - 3600;
+            }
+            else
+                row[ iColumn ] = ::detail::parseNumberField( first, last );
+            iField = iFieldEnd + 1;
+        }
+        rows.push_back( row );
+    }
+    return rows;
+}
+
+bool equal( double const a, double const b )
+{
+    return a == b || ( std::isnan( a ) && std::isnan( b ) );
+}
+
+bool testFindSeparators( void )
+{
+    bool success = true;
+    std::string text( 1000, ' ' );
+    for ( auto & c : text )
+        c = ";\n,a1."[ std::rand() % 6 ];
+    std::vector< uint32_t > expected( text.size() ), result( text.size() );
+
+    for ( auto const instructionSet : { Simd::InstructionSet::Scalar, Simd::InstructionSet::Sse2,
+                                        Simd::InstructionSet::Avx2, Simd::InstructionSet::Avx512 } )
+    {
+        if ( instructionSet > Simd::instructionSet() )
+            continue;
+        for ( size_t iBegin : { 0, 1, 63, 64, 65 } )
+        for ( size_t iEnd : { size_t( 0 ), size_t( 65 ), size_t( 127 ), size_t( 128 ), text.size() } )
+        {
+            if ( iEnd < iBegin )
+                continue;
+            auto const nExpected = Fundamental::detail::findSeparatorsScalar( text.data(), iBegin, iEnd, ';', expected.data() );
+            auto const n = Fundamental::detail::findSeparators( text.data(), iBegin, iEnd, ';', result.data(), instructionSet );
+            success &= n == nExpected && std::equal( expected.begin(), expected.begin() + n, result.begin() );
+        }
+    }
+    std::cout << "findSeparators " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+bool testCsvReader( void )
+{
+    using namespace Fundamental;
+
+    /* dates, prices, volumes and some malformed data */
+    std::string text = "time;price;volume\r\n";
+    char line[256];
+    for ( int i = 0; i < 3000; ++i )
+    {
+        std::snprintf( line, sizeof( line ), "2017-%02d-%02d %02d:%02d:%02d;%.*f;%d",
+                       1 + std::rand() % 12, 1 + std::rand() % 28, std::rand() % 24, std::rand() % 60, std::rand() % 60,
+                       std::rand() % 6, ( std::rand() - RAND_MAX / 2 ) / 1e4, std::rand() % 1000 );
+        text += line;
+        switch ( std::rand() % 20 )
+        {
+            case 0: text += ";"; break;                 // empty field
+            case 1: text += ";7;8"; break;              // more fields than columns
+            case 2: text += "x"; break;                 // invalid number
+            case 3: text += "\n"; break;                // empty line
+            case 4: text += "\r"; break;                // Windows line ending
+            case 5: text.resize( text.size() - 4 ); break; // missing fields
+            case 6: text += " "; break;                 // trailing blank
+            default: break;
+        }
+        text += "\n";
+    }
+    text += "2017-01-01 00:00:00;1.5;2";     // no newline at the end
+
+    std::string const filePath = "/tmp/csvReader-test.csv";
+    {
+        std::ofstream file( filePath, std::ios::binary );
+        file << text;
+    }
+
+    CompiledDateFormat const format( "%Y-%m-%d %H:%M:%S" );
+    auto const expected = parseCsvReference( text, ';', 3, format );
+
+    bool success = true;
+    for ( size_t nChunkBytes : { size_t( 64 ), size_t( 100 ), size_t( 4096 ), size_t( 1 ) << 20, text.size() } )
+    for ( size_t nRowsPerBatch : { size_t( 1 ), size_t( 777 ), size_t( 20000 ) } )
+    for ( bool readAhead : { false, true } )
+    {
+        CsvReader reader( filePath, ';', true, nRowsPerBatch, nChunkBytes, readAhead );
+        success &= reader.columnNames() == std::vector< std::string >{ "time", "price", "volume" };
+        reader.setDateFormat( "time", "%Y-%m-%d %H:%M:%S", 3600 );
+
+        CsvBatch batch;
+        size_t nRows = 0;
+        while ( reader.read( batch ) )
+        {
+            success &= batch.iFirstRow == nRows && batch.nRows <= nRowsPerBatch && batch.columns.size() == 3;
+            for ( size_t i = 0; i < batch.nRows; ++i )
+                for ( size_t iColumn = 0; iColumn < 3; ++iColumn )
+                    success &= nRows + i < expected.size() && equal( batch.columns[ iColumn ][i], expected[ nRows + i ][ iColumn ] );
+            nRows += batch.nRows;
+        }
+        success &= nRows == expected.size() && ! reader.read( batch ) && batch.nRows == 0;
+        if ( ! success )
+        {
+            std::cout << "CsvReader with chunks of " << nChunkBytes << " bytes and batches of " << nRowsPerBatch
+                      << " rows read " << nRows << " instead of " << expected.size() << " rows!\n";
+            break;
+        }
+    }
+
+    /* without header the first line is data */
+    {
+        std::ofstream file( filePath, std::ios::binary );
+        file << "\n1,2,3\n4,,6\n7";
+    }
+    for ( size_t nChunkBytes : { size_t( 6 ), size_t( 7 ), size_t( 1024 ) } )
+    {
+        CsvReader reader( filePath, ',', false, 10, nChunkBytes );
+        CsvBatch batch;
+        if ( ! ( reader.size() == 3 && reader.columnNames().empty() && reader.read( batch ) && batch.nRows == 3 ) )
+        {
+            std::cout << "CsvReader without header and chunks of " << nChunkBytes << " bytes read " << reader.size()
+                      << " columns and " << batch.nRows << " rows instead of 3 and 3!\n";
+            success = false;
+            continue;
+        }
+        success &= batch.columns[0] == std::vector< double >{ 1, 4, 7 } && batch.columns[2][1] == 6 &&
+                   std::isnan( batch.columns[1][1] ) && std::isnan( batch.columns[1][2] );
+    }
+
+    /* lines longer than the chunk size */
+    {
+        std::ofstream file( filePath, std::ios::binary );
+        file << "a,b\n1,2\n" << std::string( 100, '1' ) << "\n";
+    }
+    try
+    {
+        CsvReader reader( filePath, ',', true, 10, 16 );
+        CsvBatch batch;
+        reader.read( batch );
+        success = false;
+    }
+    catch ( std::invalid_argument const & ) {}
+
+    std::remove( filePath.c_str() );
+    std::cout << "CsvReader " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+
+} // namespace
+
+
+int main()
+{
+    testFindSeparators();
+    testCsvReader();
+}
+
+
+#endif
@@ -1,3 +1,6 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 Fundamental.hpp -DMAIN_TEST_FUNDAMENTAL -pthread && ./a.out
+*/
 #pragma once
 
 
@@ -41,9 +44,13 @@ inline long double factorial( int n )
 #include <cmath>
 #include <vector>
 
+/**
+ * @see computeStatistics in Statistics.hpp for a vectorized version which
+ *      ignores NaN and also returns the variance, minimum and maximum
+ */
 template< typename T_Prec >
 inline
-T_Prec mean( std::vector<T_Prec> const vec )
+T_Prec mean( std::vector<T_Prec> const & vec )
 {
     auto sum = T_Prec(0);
     for ( auto const & elem : vec )
@@ -61,6 +68,184 @@ inline double relErr( T const & x, T const & y )
 
 #include <limits>
 
+#include "SimdDispatch.hpp"
+
+namespace detail {
+
+
+/** @return true if the NaN combination is penalized with an infinite error */
+template< int nanStrategy >
+inline bool isPenalizedNan( bool const xIsNan, bool const yIsNan )
+{
+    return ( ( nanStrategy & ( 1 << 0 ) ) && (   xIsNan &&   yIsNan ) ) ||
+           ( ( nanStrategy & ( 1 << 1 ) ) && (   xIsNan && ! yIsNan ) ) ||
+           ( ( nanStrategy & ( 1 << 2 ) ) && ( ! xIsNan &&   yIsNan ) );
+}
+
+template< int nanStrategy, typename T >
+inline double maxRelErrScalar( T const * const x, T const * const y, size_t const n )
+{
+    double max = 0;
+    for ( size_t i = 0u; i < n; ++i )
+    {
+        bool const xIsNan = std::isnan( x[i] );
+        bool const yIsNan = std::isnan( y[i] );
+        if ( xIsNan || yIsNan )
+        {
+            if ( isPenalizedNan< nanStrategy >( xIsNan, yIsNan ) )
+                return std::numeric_limits< double >::infinity();
+            continue;
+        }
+        max = std::max( max, std::abs( relErr( x[i], y[i] ) ) );
+    }
+    return max;
+}
+
+#if defined( __GNUC__ )
+
+/**
+ * Same as maxRelErrScalar, but NaN are not skipped, instead their relative
+ * error is NaN, which the maximum ignores just like std::max( max, NaN ).
+ * Penalized NaN are only checked for after each chunk, because relative
+ * errors of non-NaN values are at most 2, i.e. every infinity is a penalty.
+ */
+template< int nanStrategy, std::size_t nBytes >
+SIMD_ALWAYS_INLINE double maxRelErrKernel( double const * const x, double const * const y, size_t const n )
+{
+    using V = typename Simd::Vector< double, nBytes >::type;
+    auto constexpr nLanes = Simd::Vector< double, nBytes >::nLanes;
+    size_t constexpr nChunk = 1024;
+
+    using Mask = decltype( V{} != V{} );
+
+    V max0{}, max1{};
+    size_t i = 0u;
+    while ( i + 2 * nLanes <= n )
+    {
+        Mask penalized{};
+        auto const iChunkEnd = std::min( n, i + nChunk );
+        for ( ; i + 2 * nLanes <= iChunkEnd; i += 2 * nLanes )
+        {
+            for ( size_t k = 0u; k < 2; ++k )
+            {
+                auto & max = k == 0 ? max0 : max1;
+                V xi, yi;
+                Simd::load( xi, x + i + k * nLanes );
+                Simd::load( yi, y + i + k * nLanes );
+                auto const xIsNan = xi != xi;
+                auto const yIsNan = yi != yi;
+                if ( nanStrategy & ( 1 << 0 ) ) penalized |=  xIsNan &  yIsNan;
+                if ( nanStrategy & ( 1 << 1 ) ) penalized |=  xIsNan & ~yIsNan;
+                if ( nanStrategy & ( 1 << 2 ) ) penalized |= ~xIsNan &  yIsNan;
+
+                V const xAbs = xi < 0 ? -xi : xi;
+                V const yAbs = yi < 0 ? -yi : yi;
+                V const difference = xi - yi;
+                V const error = ( difference < 0 ? -difference : difference ) / ( xAbs > yAbs ? xAbs : yAbs );
+                /* 0/0 for x == y == 0 is NaN and thereby ignored like in relErr */
+                max = error > max ? error : max;
+            }
+        }
+
+        if ( nanStrategy != 0 )
+        {
+            for ( size_t k = 0u; k < nLanes; ++k )
+                if ( penalized[k] )
+                    return std::numeric_limits< double >::infinity();
+        }
+    }
+
+    double result = maxRelErrScalar< nanStrategy >( x + i, y + i, n - i );
+    for ( size_t k = 0u; k < nLanes; ++k )
+        result = std::max( result, std::max( max0[k], max1[k] ) );
+    return result;
+}
+
+#endif  // __GNUC__
+
+#if SIMD_VECTOR128
+template< int nanStrategy >
+inline double maxRelErr128( double const * const x, double const * const y, size_t const n )
+{ return maxRelErrKernel< nanStrategy, 16 >( x, y, n ); }
+#endif
+
+#if SIMD_X86
+template< int nanStrategy >
+SIMD_TARGET_AVX2 inline double maxRelErrAvx2( double const * const x, double const * const y, size_t const n )
+{ return maxRelErrKernel< nanStrategy, 32 >( x, y, n ); }
+
+template< int nanStrategy >
+SIMD_TARGET_AVX512 inline double maxRelErrAvx512( double const * const x, double const * const y, size_t const n )
+{ return maxRelErrKernel< nanStrategy, 64 >( x, y, n ); }
+#endif
+
+template< int nanStrategy >
+inline double maxRelErr
+(
+    double const * const x,
+    double const * const y,
+    size_t         const n,
+    Simd::InstructionSet const instructionSet
+)
+{
+    switch ( instructionSet )
+    {
+    #if SIMD_X86
+        case Simd::InstructionSet::Avx512:
+            if ( n >= 128 )
+                return maxRelErrAvx512< nanStrategy >( x, y, n );
+            /* fall through */
+        case Simd::InstructionSet::Avx2:
+            return maxRelErrAvx2< nanStrategy >( x, y, n );
+    #endif
+    #if SIMD_VECTOR128
+        case Simd::InstructionSet::Sse2:
+        case Simd::InstructionSet::Neon:
+            return maxRelErr128< nanStrategy >( x, y, n );
+    #endif
+        default:
+            return maxRelErrScalar< nanStrategy >( x, y, n );
+    }
+}
+
+/* other types than double are not vectorized */
+template< int nanStrategy, typename T >
+inline double maxRelErr( T const * const x, T const * const y, size_t const n, Simd::InstructionSet )
+{
+    return maxRelErrScalar< nanStrategy >( x, y, n );
+}
+
+
+} // namespace detail
+
+/**
+ * Maximum relative error with the NaN strategy known at compile time, which
+ * is vectorized for double and returns as soon as a penalized NaN is found.
+ * @see maxRelErr( x, y, nanStrategy ) for the meaning of nanStrategy
+ * @param[in] instructionSet can be used to force a kernel, e.g. for tests.
+ *            Must be supported by the CPU!
+ */
+template< int nanStrategy, typename T >
+inline double maxRelErr
+(
+    T                    const * const x,
+    T                    const * const y,
+    size_t               const         n,
+    Simd::InstructionSet const         instructionSet = Simd::instructionSet()
+)
+{
+    static_assert( 0 <= nanStrategy && nanStrategy <= 7, "nanStrategy is a combination of 3 bits!" );
+    return detail::maxRelErr< nanStrategy >( x, y, n, instructionSet );
+}
+
+template< int nanStrategy, typename T >
+inline double maxRelErr( std::vector<T> const & x, std::vector<T> const & y )
+{
+    if ( x.size() != y.size() )
+        return std::numeric_limits< double >::infinity();
+    return maxRelErr< nanStrategy >( x.data(), y.data(), x.size() );
+}
+
 /**
  * @param[in] nanStrategy basically it boils down to a truth table:
  *            @verbatim
@@ -88,62 +273,34 @@ inline double maxRelErr
     int            const nanStrategy = 3
 )
 {
-    if ( x.size() != y.size() )
-        return std::numeric_limits< double >::infinity();
-
-    double max = 0;
-    for ( size_t i = 0u; i < x.size(); ++i )
+    switch ( nanStrategy & 7 )
     {
-        if ( std::isnan( x[i] ) && std::isnan( y[i] ) )
-        {
-            if ( nanStrategy & ( 1 << 0 ) )
-            {
-                max = std::numeric_limits< double >::infinity();
-                break;
-            }
-            else
-                continue;
-        }
-        if ( std::isnan( x[i] ) and not std::isnan( y[i] ) )
-        {
-            if ( nanStrategy & ( 1 << 1 ) )
-            {
-                max = std::numeric_limits< double >::infinity();
-                break;
-            }
-            else
-                continue;
-        }
-        if ( not std::isnan( x[i] ) and std::isnan( y[i] ) )
-        {
-            if ( nanStrategy & ( 1 << 2 ) )
-            {
-                max = std::numeric_limits< double >::infinity();
-                break;
-            }
-            else
-                continue;
-        }
-        max = std::max( max, std::abs( relErr( x[i], y[i] ) ) );
+        case 0: return maxRelErr< 0 >( x, y );
+        case 1: return maxRelErr< 1 >( x, y );
+        case 2: return maxRelErr< 2 >( x, y );
+        case 3: return maxRelErr< 3 >( x, y );
+        case 4: return maxRelErr< 4 >( x, y );
+        case 5: return maxRelErr< 5 >( x, y );
+        case 6: return maxRelErr< 6 >( x, y );
+        default: return maxRelErr< 7 >( x, y );
     }
-
-    return max;
 }
 
 
 /**
- * < (x - <x>)^2 > = < x^2 + <x>^2 - 2x<x> > = <x^2> - <x>^2
+ * sqrt( sum (x - <x>)^2 / (N-1) ) in two passes, because the shorter
+ * <x^2> - <x>^2 loses all digits to cancellation for data far from 0,
+ * e.g. timestamps, and may even become negative.
  **/
 template< typename T_Prec >
 inline
-T_Prec stddev( std::vector<T_Prec> const vec )
+T_Prec stddev( std::vector<T_Prec> const & vec )
 {
+    auto const avg = mean( vec );
     auto sum2 = T_Prec(0);
     for ( auto const elem : vec )
-        sum2 += elem*elem;
-    auto avg = mean( vec );
-    auto const N = T_Prec( vec.size() );
-    return std::sqrt( ( sum2/N - avg*avg )*N/(N-1) );
+        sum2 += ( elem - avg )*( elem - avg );
+    return std::sqrt( sum2 / ( T_Prec( vec.size() ) - 1 ) );
 }
 
 
@@ -163,10 +320,324 @@ inline constexpr T pow( const T base, unsigned const exponent )
 #define CONTAINS(list,value) (std::find(list.begin(), list.end(), value) != list.end() )
 
 
-#include <vector>
-#include <string>                       // getline
+#include <algorithm>                    // min
+#include <cctype>                       // isspace
+#include <cstdint>                      // uint64_t
+#include <cstring>                      // memchr, memcmp, strlen
+#include <iterator>                     // forward_iterator_tag
+#include <locale>                       // classic
 #include <sstream>
+#include <string>
+#include <vector>
+#if __cplusplus >= 201703L
+#   include <charconv>                  // from_chars
+#   include <string_view>
+#endif
+
+/**
+ * Non-owning reference to characters with the interface subset of
+ * std::string_view needed to work with fields without copying them, because
+ * std::string_view is only available since C++17.
+ */
+class StringView
+{
+private:
+    char const * pData;
+    size_t       nChars;
+
+public:
+    inline StringView( void ) : pData( nullptr ), nChars( 0 ) {}
+    inline StringView( char const * const rpData, size_t const rnChars ) : pData( rpData ), nChars( rnChars ) {}
+    inline StringView( char const * const rpString ) : pData( rpString ), nChars( std::strlen( rpString ) ) {}
+    inline StringView( std::string const & rString ) : pData( rString.data() ), nChars( rString.size() ) {}
+#if __cplusplus >= 201703L
+    inline StringView( std::string_view const rString ) : pData( rString.data() ), nChars( rString.size() ) {}
+    inline operator std::string_view() const { return std::string_view( pData, nChars ); }
+#endif
+
+    inline char const * data ( void ) const { return pData;          }
+    inline size_t       size ( void ) const { return nChars;         }
+    inline bool         empty( void ) const { return nChars == 0;    }
+    inline char const * begin( void ) const { return pData;          }
+    inline char const * end  ( void ) const { return pData + nChars; }
+    inline char const & operator[]( size_t const i ) const { return pData[i]; }
+
+    inline std::string str( void ) const { return std::string( pData, nChars ); }
+
+    inline bool operator==( StringView const & other ) const
+    {
+        return nChars == other.nChars && ( nChars == 0 || std::memcmp( pData, other.pData, nChars ) == 0 );
+    }
+    inline bool operator!=( StringView const & other ) const { return not ( *this == other ); }
+};
+
+
+/**
+ * Lazy range over the fields of a string separated by a delimiter, with the
+ * same fields as split, i.e. also empty fields, but no empty field after a
+ * trailing delimiter and none for an empty string.
+ */
+class SplitRange
+{
+public:
+    class Iterator
+    {
+    private:
+        char const * pField;     /**< nullptr for the end iterator */
+        char const * pFieldEnd;
+        char const * pEnd;
+        char         delimiter;
+
+        inline void findFieldEnd( void )
+        {
+            auto const pDelimiter = static_cast< char const * >( std::memchr( pField, delimiter, pEnd - pField ) );
+            pFieldEnd = pDelimiter == nullptr ? pEnd : pDelimiter;
+        }
 
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = StringView;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = StringView const *;
+        using reference         = StringView;
+
+        inline Iterator( void ) : pField( nullptr ), pFieldEnd( nullptr ), pEnd( nullptr ), delimiter( 0 ) {}
+
+        inline Iterator( StringView const & src, char const rDelimiter )
+        : pField( src.empty() ? nullptr : src.data() ), pFieldEnd( nullptr ), pEnd( src.end() ), delimiter( rDelimiter )
+        {
+            if ( pField != nullptr )
+                findFieldEnd();
+        }
+
+        inline StringView operator*( void ) const { return StringView( pField, pFieldEnd - pField ); }
+
+        inline Iterator & operator++( void )
+        {
+            /* like getline, a delimiter at the very end doesn't start another field */
+            if ( pFieldEnd == pEnd || pFieldEnd + 1 == pEnd )
+                pField = nullptr;
+            else
+            {
+                pField = pFieldEnd + 1;
+                findFieldEnd();
+            }
+            return *this;
+        }
+
+        inline Iterator operator++( int )
+        {
+            auto const old = *this;
+            ++( *this );
+            return old;
+        }
+
+        inline bool operator==( Iterator const & other ) const { return pField == other.pField; }
+        inline bool operator!=( Iterator const & other ) const { return pField != other.pField; }
+    };
+
+private:
+    StringView src;
+    char       delimiter;
+
+public:
+    inline SplitRange( StringView const & rSrc, char const rDelimiter ) : src( rSrc ), delimiter( rDelimiter ) {}
+
+    inline Iterator begin( void ) const { return Iterator( src, delimiter ); }
+    inline Iterator end  ( void ) const { return Iterator(); }
+};
+
+/**
+ * @verbatim
+ * for ( auto const field : splitView( line, ',' ) )
+ *     ...
+ * @endverbatim
+ * Note that src must outlive the range, e.g. it must not be a temporary string.
+ */
+inline SplitRange splitView( StringView const & src, char const delimiter )
+{
+    return SplitRange( src, delimiter );
+}
+
+
+namespace detail {
+
+
+/**
+ * Locale-independent parsing like std::from_chars for C++ standards or
+ * standard libraries without it. Decimals with up to 19 significant digits
+ * and decimal exponents in [-22,22] are converted exactly with one
+ * multiplication or division, because the mantissa and the power of ten are
+ * exactly representable then, i.e. the result is correctly rounded.
+ * @see W. D. Clinger, "How to Read Floating Point Numbers Accurately", 1990
+ * Other numbers are parsed by a stream with the classic locale.
+ */
+inline char const * parseDoubleFallback( char const * const first, char const * const last, double & value )
+{
+    static double constexpr powersOfTen[] = {
+        1e0 , 1e1 , 1e2 , 1e3 , 1e4 , 1e5 , 1e6 , 1e7 , 1e8 , 1e9 , 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    auto p = first;
+    bool const negative = p < last && *p == '-';
+    if ( negative )
+        ++p;
+
+    /* special values like std::from_chars, case-insensitively */
+    auto const startsWith = [&p,last] ( char const * word )
+    {
+        auto q = p;
+        for ( ; *word != '\0'; ++word, ++q )
+            if ( q >= last || ( *q | 0x20 ) != *word )
+                return false;
+        return true;
+    };
+    if ( startsWith( "inf" ) )
+    {
+        value = negative ? -std::numeric_limits< double >::infinity() : std::numeric_limits< double >::infinity();
+        return p + ( startsWith( "infinity" ) ? 8 : 3 );
+    }
+    if ( startsWith( "nan" ) )
+    {
+        value = negative ? -std::numeric_limits< double >::quiet_NaN() : std::numeric_limits< double >::quiet_NaN();
+        return p + 3;
+    }
+
+    uint64_t mantissa = 0;
+    int nDigits  = 0;   /**< significant digits in mantissa */
+    int exponent = 0;
+    bool exact   = true;
+    bool anyDigit = false;
+    for ( ; p < last && '0' <= *p && *p <= '9'; ++p )
+    {
+        anyDigit = true;
+        if ( nDigits < 19 )
+        {
+            mantissa = 10 * mantissa + ( *p - '0' );
+            nDigits += mantissa > 0;
+        }
+        else
+        {
+            ++exponent;
+            exact &= *p == '0';
+        }
+    }
+    if ( p < last && *p == '.' )
+    {
+        for ( ++p; p < last && '0' <= *p && *p <= '9'; ++p )
+        {
+            anyDigit = true;
+            if ( nDigits < 19 )
+            {
+                mantissa = 10 * mantissa + ( *p - '0' );
+                nDigits += mantissa > 0;
+                --exponent;
+            }
+            else
+                exact &= *p == '0';
+        }
+    }
+    if ( not anyDigit )
+        return first;
+
+    /* the exponent is only part of the number if it has digits */
+    if ( p < last && ( *p == 'e' || *p == 'E' ) )
+    {
+        auto q = p + 1;
+        bool const negativeExponent = q < last && *q == '-';
+        if ( q < last && ( *q == '-' || *q == '+' ) )
+            ++q;
+        if ( q < last && '0' <= *q && *q <= '9' )
+        {
+            int explicitExponent = 0;
+            for ( ; q < last && '0' <= *q && *q <= '9'; ++q )
+                explicitExponent = std::min( 10 * explicitExponent + ( *q - '0' ), 100000 );
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            p = q;
+        }
+    }
+
+    if ( exact && mantissa <= ( uint64_t( 1 ) << 53 ) && -22 <= exponent && exponent <= 22 )
+    {
+        auto result = double( mantissa );
+        result = exponent < 0 ? result / powersOfTen[ -exponent ] : result * powersOfTen[ exponent ];
+        value = negative ? -result : result;
+        return p;
+    }
+
+    std::istringstream stream( std::string( first, p ) );
+    stream.imbue( std::locale::classic() );
+    stream >> value;
+    /* streams return the largest double on overflow, but strtod infinity */
+    if ( stream.fail() && std::abs( value ) == std::numeric_limits< double >::max() )
+        value = negative ? -std::numeric_limits< double >::infinity() : std::numeric_limits< double >::infinity();
+    return p;
+}
+
+
+} // namespace detail
+
+
+/**
+ * Locale-independent parsing of a double in the format of std::from_chars,
+ * i.e. without leading whitespace or '+', which is used if available.
+ *
+ * @return pointer after the parsed characters or first if there was no
+ *         number, in which case value is unchanged
+ */
+inline char const * parseDouble( char const * const first, char const * const last, double & value )
+{
+#if defined( __cpp_lib_to_chars ) && __cpp_lib_to_chars >= 201611L
+    auto const result = std::from_chars( first, last, value );
+    if ( result.ec == std::errc::result_out_of_range )
+        return detail::parseDoubleFallback( first, last, value );
+    return result.ec == std::errc() ? result.ptr : first;
+#else
+    return detail::parseDoubleFallback( first, last, value );
+#endif
+}
+
+namespace detail {
+
+/** @return NaN if the field without surrounding blanks is no number */
+inline double parseNumberField( char const * first, char const * last )
+{
+    while ( first < last && ( *first == ' ' || *first == '\t' ) )
+        ++first;
+    while ( last > first && ( last[-1] == ' ' || last[-1] == '\t' ) )
+        --last;
+    double value = 0;
+    return first < last && parseDouble( first, last, value ) == last ? value : std::numeric_limits< double >::quiet_NaN();
+}
+
+} // namespace detail
+
+/**
+ * Parses each field, e.g. of a line of a CSV file, into result, which is
+ * cleared, i.e. its memory is reused for subsequent lines.
+ * Spaces and tabs around the numbers are ignored like in CsvReader, e.g. for
+ * "1.5, 2.5", but fields which are empty or no number as a whole, e.g.
+ * "1.5abc", become NaN.
+ */
+inline void parseDoubles
+(
+    StringView    const & src,
+    char          const   delimiter,
+    std::vector< double > & result
+)
+{
+    result.clear();
+    for ( auto const field : splitView( src, delimiter ) )
+        result.push_back( detail::parseNumberField( field.begin(), field.end() ) );
+}
+
+
+/**
+ * Skips leading whitespace and '+' like operator>> and returns 0 for
+ * strings which are no number. Unlike operator>>, "inf" and "nan" are
+ * parsed and overflows become infinity instead of the largest double.
+ */
 inline std::vector< double > toDouble
 (
     std::vector< std::string >::const_iterator first,
@@ -174,11 +645,17 @@ inline std::vector< double > toDouble
 )
 {
     std::vector< double > res;
+    res.reserve( end - first );
     for ( auto it = first; it != end; ++it )
     {
-        std::stringstream ss( *it );
-        double x;
-        ss >> x;
+        auto begin = it->data();
+        auto const last = begin + it->size();
+        while ( begin < last && std::isspace( static_cast< unsigned char >( *begin ) ) )
+            ++begin;
+        if ( begin < last && *begin == '+' && ( begin + 1 == last || begin[1] != '-' ) )
+            ++begin;
+        double x = 0;
+        parseDouble( begin, last, x );
         res.push_back( x );
     }
     return res;
@@ -191,11 +668,9 @@ inline std::vector<std::string> split
     char const delim
 )
 {
-    std::stringstream ss( src );
-    std::string item;
     std::vector< std::string > result;
-    while ( std::getline( ss, item, delim ) )
-        result.push_back( item );
+    for ( auto const field : splitView( src, delim ) )
+        result.emplace_back( field.data(), field.size() );
     return result;
 }
 
@@ -221,62 +696,542 @@ inline std::string replace
 }
 
 
-#include <iomanip>              // setprecision, scientific, setw
+#include <algorithm>            // max, min
+#include <cstdio>               // snprintf
+#include <cstdlib>              // strtod
+#include <cstring>              // memcpy, memmove, memset
 #include <fstream>
+#include <iomanip>              // setprecision, scientific
 #include <limits>               // max_digits10
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <type_traits>          // enable_if, integral_constant, make_unsigned
 #include <vector>
 #include <utility>              // pair
+#if __cplusplus >= 201703L
+#   include <charconv>          // to_chars
+#endif
+
+
+namespace detail {
+
 
 /**
- * Inspired by numpy.genfromtxt and writetotxt
- *
- * Can't use std::map as input, because it would lose the order -.-
+ * Types which are formatted without iostreams. Characters and bool are
+ * excluded, because operator<< prints them as characters or as 0/1.
  */
-template< typename T_Prec >
-inline void dumpData
-(
-    std::string const & filePath,
-    std::vector< std::pair< std::string, std::vector< T_Prec > > > const & data
-)
-{
-    std::ofstream file;
-    file.open( filePath );
-    if ( file.fail() )
-        throw std::invalid_argument( "Couldn't open file!" );
+template< typename T >
+struct IsFastFormattable : std::integral_constant< bool,
+    std::is_floating_point< T >::value ||
+    ( std::is_integral< T >::value && ! std::is_same< T, bool >::value && sizeof( T ) > 1 )
+> {};
 
-    /* write out description / comment line : # t x v ... */
-    /* precision 2 means 3.1, 1 means 3, 3 means 3.14, 0 means 3, -1 means 3.14159 (for some weird reason) */
-    auto const prec  = std::numeric_limits< T_Prec >::max_digits10;
-    auto const width = prec + 8;   // "+p.pppe+999 "
+/** enough for sign, 4-digit exponent and the longest shortest round-trip representation */
+constexpr size_t nMaxFormattedChars = 48;
 
-    file << "#";
-    for ( auto const & kv : data )
-        file << std::setw( width ) << kv.first;
-    file << "\n";
+template< typename T >
+inline char * formatInteger( char * p, T const x )
+{
+    using Unsigned = typename std::make_unsigned< T >::type;
+    auto u = static_cast< Unsigned >( x );
+    if ( x < T(0) )
+    {
+        *p++ = '-';
+        u = Unsigned(0) - u;
+    }
 
-    size_t iRow = 0u;
-    bool nonEmptyColumnFound = false;
+    char digits[ std::numeric_limits< Unsigned >::digits10 + 1 ];
+    int nDigits = 0;
     do
     {
-        nonEmptyColumnFound = false;
-        /* print each column */
-        for ( auto const & kv : data )
-        {
-            if ( iRow < kv.second.size() )
-            {
-                file << std::setw( width ) << std::scientific << std::setprecision( prec ) << kv.second[iRow];
-                nonEmptyColumnFound = true;
-            }
-            //else if ( std::numeric_limits< T_Prec > has_quiet_NaN )
-            //    file << std::setw( width ) << std::numeric_limits< T_Prec > quiet_NaN();
+        digits[ nDigits++ ] = char( '0' + u % 10u );
+        u /= 10u;
+    } while ( u != 0 );
+
+    while ( nDigits > 0 )
+        *p++ = digits[ --nDigits ];
+    return p;
+}
+
+/**
+ * Formats like operator<< with std::scientific and std::setprecision, i.e.,
+ * like printf "%.*e" for floating point types and as plain decimal for
+ * integers. The caller needs to provide precision + nMaxFormattedChars
+ * characters.
+ *
+ * @return pointer past the last written character
+ */
+inline char * formatScientific( char * const p, long double const x, int const precision )
+{
+    return p + std::snprintf( p, size_t( std::max( precision, 0 ) ) + nMaxFormattedChars, "%.*Le", precision, x );
+}
+
+template< typename T >
+inline typename std::enable_if< std::is_floating_point< T >::value, char * >::type
+formatScientific( char * const p, T const x, int const precision )
+{
+    auto const nMaxChars = size_t( std::max( precision, 0 ) ) + nMaxFormattedChars;
+#if defined( __cpp_lib_to_chars ) && __cpp_lib_to_chars >= 201611L
+    /* floats are promoted to double by operator<<, but the correctly rounded digits are the same */
+    return std::to_chars( p, p + nMaxChars, x, std::chars_format::scientific, precision ).ptr;
+#else
+    return p + std::snprintf( p, nMaxChars, "%.*e", precision, double( x ) );
+#endif
+}
+
+template< typename T >
+inline typename std::enable_if< std::is_integral< T >::value, char * >::type
+formatScientific( char * const p, T const x, int )
+{
+    return formatInteger( p, x );
+}
+
+/**
+ * Formats like operator<< without manipulators, i.e., like printf "%.*g"
+ * with the stream precision, which defaults to 6, e.g., 0.1, 1e+20, 3.14159.
+ * The caller needs to provide precision + nMaxFormattedChars characters.
+ */
+inline char * formatGeneral( char * const p, long double const x, int const precision )
+{
+    return p + std::snprintf( p, size_t( std::max( precision, 0 ) ) + nMaxFormattedChars, "%.*Lg", precision, x );
+}
+
+template< typename T >
+inline typename std::enable_if< std::is_floating_point< T >::value, char * >::type
+formatGeneral( char * const p, T const x, int const precision )
+{
+    auto const nMaxChars = size_t( std::max( precision, 0 ) ) + nMaxFormattedChars;
+#if defined( __cpp_lib_to_chars ) && __cpp_lib_to_chars >= 201611L
+    return std::to_chars( p, p + nMaxChars, x, std::chars_format::general, precision ).ptr;
+#else
+    return p + std::snprintf( p, nMaxChars, "%.*g", precision, double( x ) );
+#endif
+}
+
+template< typename T >
+inline typename std::enable_if< std::is_integral< T >::value, char * >::type
+formatGeneral( char * const p, T const x, int )
+{
+    return formatInteger( p, x );
+}
+
+/**
+ * Formats with the fewest significant digits which still parse back to the
+ * same value, like printf "%g" with that precision, e.g., 0.1, 1e+20, 123.
+ * The caller needs to provide nMaxFormattedChars characters.
+ */
+inline char * formatShortest( char * const p, long double const x )
+{
+    char * end = p;
+    for ( int precision = 1; precision <= std::numeric_limits< long double >::max_digits10; ++precision )
+    {
+        end = p + std::snprintf( p, nMaxFormattedChars, "%.*Lg", precision, x );
+        if ( ! ( x == x ) || std::strtold( p, nullptr ) == x )
+            break;
+    }
+    return end;
+}
+
+template< typename T >
+inline typename std::enable_if< std::is_floating_point< T >::value, char * >::type
+formatShortest( char * const p, T const x )
+{
+#if defined( __cpp_lib_to_chars ) && __cpp_lib_to_chars >= 201611L
+    /* the shortest scientific representation tells the number of digits,
+     * because chars_format::general without precision doesn't behave like %g */
+    auto const end = std::to_chars( p, p + nMaxFormattedChars, x, std::chars_format::scientific ).ptr;
+    if ( ! ( x == x ) || x == std::numeric_limits< T >::infinity() || x == -std::numeric_limits< T >::infinity() )
+        return end;
+    int nDigits = 0;
+    for ( auto q = p; q < end && *q != 'e'; ++q )
+        nDigits += *q >= '0' && *q <= '9';
+    return std::to_chars( p, p + nMaxFormattedChars, x, std::chars_format::general, nDigits ).ptr;
+#else
+    /* try increasing precisions, which needs at most 3 tries for most values */
+    char * end = p;
+    for ( int precision = 1; precision <= std::numeric_limits< T >::max_digits10; ++precision )
+    {
+        end = p + std::snprintf( p, nMaxFormattedChars, "%.*g", precision, double( x ) );
+        if ( ! ( x == x ) || T( std::strtod( p, nullptr ) ) == x )
+            break;
+    }
+    return end;
+#endif
+}
+
+template< typename T >
+inline typename std::enable_if< std::is_integral< T >::value, char * >::type
+formatShortest( char * const p, T const x )
+{
+    return formatInteger( p, x );
+}
+
+
+} // namespace detail
+
+
+/**
+ * Growing character buffer with functions for formatting numbers into it,
+ * which unlike std::ostream don't need to set manipulators, don't construct
+ * sentries and don't depend on the locale. All widths right-align like
+ * std::setw, i.e., longer output is not truncated.
+ */
+class TextBuffer
+{
+private:
+    std::vector< char > chars;
+    size_t              nChars;
+
+    /* right-aligns the characters written after reserve to width and commits them */
+    inline void alignRight( char * const pBegin, char * const pEnd, int const width )
+    {
+        auto const nWritten = size_t( pEnd - pBegin );
+        if ( width > 0 && nWritten < size_t( width ) )
+        {
+            auto const nPadding = size_t( width ) - nWritten;
+            std::memmove( pBegin + nPadding, pBegin, nWritten );
+            std::memset( pBegin, ' ', nPadding );
+            commit( pEnd + nPadding );
+        }
+        else
+            commit( pEnd );
+    }
+
+    template< typename T >
+    inline void writeScientific( T const & x, int const precision, int const width, std::true_type )
+    {
+        auto const p = reserve( size_t( std::max( width, 0 ) + std::max( precision, 0 ) ) + detail::nMaxFormattedChars );
+        alignRight( p, detail::formatScientific( p, x, precision ), width );
+    }
+
+    template< typename T >
+    inline void writeScientific( T const & x, int const precision, int const width, std::false_type )
+    {
+        std::ostringstream stream;
+        stream << std::scientific << std::setprecision( precision ) << x;
+        writeAligned( stream.str(), width );
+    }
+
+    template< typename T >
+    inline void writeGeneral( T const & x, int const precision, int const width, std::true_type )
+    {
+        auto const p = reserve( size_t( std::max( width, 0 ) + std::max( precision, 0 ) ) + detail::nMaxFormattedChars );
+        alignRight( p, detail::formatGeneral( p, x, precision ), width );
+    }
+
+    template< typename T >
+    inline void writeGeneral( T const & x, int const precision, int const width, std::false_type )
+    {
+        std::ostringstream stream;
+        stream << std::setprecision( precision ) << x;
+        writeAligned( stream.str(), width );
+    }
+
+public:
+    inline explicit TextBuffer( size_t const nCapacity = 0 ) : chars( nCapacity ), nChars( 0 ) {}
+
+    inline char const * data ( void ) const { return chars.data(); }
+    inline size_t       size ( void ) const { return nChars; }
+    inline bool         empty( void ) const { return nChars == 0; }
+    inline void         clear( void ) { nChars = 0; }
+
+    /**
+     * @return pointer to at least n writable characters, which become part of
+     *         the buffer with commit
+     */
+    inline char * reserve( size_t const n )
+    {
+        if ( nChars + n > chars.size() )
+            chars.resize( std::max( 2 * chars.size(), nChars + n ) );
+        return chars.data() + nChars;
+    }
+
+    /** @param[in] end pointer past the last character written after reserve */
+    inline void commit( char const * const end ) { nChars = size_t( end - chars.data() ); }
+
+    inline void write( char const * const p, size_t const n )
+    {
+        std::memcpy( reserve( n ), p, n );
+        nChars += n;
+    }
+
+    inline void write( std::string const & string ) { write( string.data(), string.size() ); }
+    inline void write( char const c ) { *reserve( 1 ) = c; ++nChars; }
+
+    inline void writeSpaces( size_t const n )
+    {
+        std::memset( reserve( n ), ' ', n );
+        nChars += n;
+    }
+
+    /** like std::setw( width ) << string */
+    inline void writeAligned( std::string const & string, int const width )
+    {
+        if ( width > 0 && string.size() < size_t( width ) )
+            writeSpaces( size_t( width ) - string.size() );
+        write( string );
+    }
+
+    /**
+     * Like std::setw( width ) << std::scientific << std::setprecision( precision ) << x,
+     * which it falls back to for types other than non-character arithmetic.
+     */
+    template< typename T >
+    inline void writeScientific( T const & x, int const precision, int const width = 0 )
+    {
+        writeScientific( x, precision, width, detail::IsFastFormattable< T >() );
+    }
+
+    /**
+     * Like std::setw( width ) << std::setprecision( precision ) << x, i.e.,
+     * with the defaults like operator<< of a new stream.
+     */
+    template< typename T >
+    inline void writeGeneral( T const & x, int const precision = 6, int const width = 0 )
+    {
+        writeGeneral( x, precision, width, detail::IsFastFormattable< T >() );
+    }
+
+    /**
+     * Writes the shortest representation which parses back to exactly x.
+     * @see detail::formatShortest
+     */
+    template< typename T >
+    inline void writeShortest( T const x, int const width = 0 )
+    {
+        static_assert( detail::IsFastFormattable< T >::value, "Only implemented for non-character arithmetic types!" );
+        auto const p = reserve( size_t( std::max( width, 0 ) ) + detail::nMaxFormattedChars );
+        alignRight( p, detail::formatShortest( p, x ), width );
+    }
+};
+
+
+/**
+ * Buffered file output which formats with TextBuffer and writes out blocks
+ * of nBufferBytes, i.e., one system call per block instead of iostream
+ * overhead per value.
+ */
+class TextWriter
+{
+private:
+    std::ofstream file;
+    TextBuffer    text;
+    size_t        nBufferBytes;
+
+    inline void flushIfFull( void )
+    {
+        if ( text.size() >= nBufferBytes )
+            flush();
+    }
+
+public:
+    inline explicit TextWriter( std::string const & filePath, size_t const rnBufferBytes = 1u << 20 )
+     : text( rnBufferBytes + detail::nMaxFormattedChars ), nBufferBytes( rnBufferBytes )
+    {
+        file.open( filePath );
+        if ( file.fail() )
+            throw std::invalid_argument( "Couldn't open file!" );
+    }
+
+    /** errors can't be thrown here, call close to check for them */
+    inline ~TextWriter()
+    {
+        if ( file.is_open() && ! text.empty() )
+            file.write( text.data(), text.size() );
+    }
+
+    inline void write( char const * const p, size_t const n )
+    {
+        if ( n >= nBufferBytes )
+        {
+            flush();
+            file.write( p, n );
+            if ( file.fail() )
+                throw std::invalid_argument( "Couldn't write to file!" );
+            return;
+        }
+        text.write( p, n );
+        flushIfFull();
+    }
+
+    inline void write( std::string const & string ) { write( string.data(), string.size() ); }
+    inline void write( TextBuffer const & buffer ) { write( buffer.data(), buffer.size() ); }
+    inline void write( char const c ) { text.write( c ); flushIfFull(); }
+    inline void writeSpaces( size_t const n ) { text.writeSpaces( n ); flushIfFull(); }
+    inline void writeAligned( std::string const & string, int const width ) { text.writeAligned( string, width ); flushIfFull(); }
+
+    /** @see TextBuffer::writeScientific */
+    template< typename T >
+    inline void writeScientific( T const & x, int const precision, int const width = 0 )
+    {
+        text.writeScientific( x, precision, width );
+        flushIfFull();
+    }
+
+    /** @see TextBuffer::writeShortest */
+    template< typename T >
+    inline void writeShortest( T const x, int const width = 0 )
+    {
+        text.writeShortest( x, width );
+        flushIfFull();
+    }
+
+    inline void flush( void )
+    {
+        if ( ! text.empty() )
+        {
+            file.write( text.data(), text.size() );
+            text.clear();
+        }
+        file.flush();
+        if ( file.fail() )
+            throw std::invalid_argument( "Couldn't write to file!" );
+    }
+
+    inline void close( void )
+    {
+        flush();
+        file.close();
+        if ( file.fail() )
+            throw std::invalid_argument( "Couldn't write to file!" );
+    }
+};
+
+
+namespace detail {
+
+
+template< typename T_Sink, typename T_Prec >
+inline void writeDumpHeader
+(
+    T_Sink & sink,
+    std::vector< std::pair< std::string, std::vector< T_Prec > > > const & data,
+    int const width
+)
+{
+    sink.write( '#' );
+    for ( auto const & kv : data )
+        sink.writeAligned( kv.first, width );
+    sink.write( '\n' );
+}
+
+/** writes rows [iBegin, iEnd) in the layout described at dumpData */
+template< typename T_Sink, typename T_Prec >
+inline void writeDumpRows
+(
+    T_Sink & sink,
+    std::vector< std::pair< std::string, std::vector< T_Prec > > > const & data,
+    size_t const iBegin,
+    size_t const iEnd,
+    int    const precision,
+    int    const width
+)
+{
+    auto const nSpaces = size_t( std::max( width, 1 ) );
+    for ( auto iRow = iBegin; iRow < iEnd; ++iRow )
+    {
+        for ( auto const & kv : data )
+        {
+            if ( iRow < kv.second.size() )
+                sink.writeScientific( kv.second[iRow], precision, width );
             else
-                file << std::setw( width ) << " ";  // not really the best way, but I don't wanna add wrong data ...
+                sink.writeSpaces( nSpaces );  // not really the best way, but I don't wanna add wrong data ...
         }
-        file << "\n";
-        ++iRow;
-    } while ( nonEmptyColumnFound );
+        sink.write( '\n' );
+    }
+}
+
+/** including the trailing row of only spaces after the longest column */
+template< typename T_Prec >
+inline size_t countDumpRows( std::vector< std::pair< std::string, std::vector< T_Prec > > > const & data )
+{
+    size_t nRows = 0;
+    for ( auto const & kv : data )
+        nRows = std::max( nRows, kv.second.size() );
+    return nRows + 1;
+}
+
+
+} // namespace detail
+
+
+/**
+ * Inspired by numpy.genfromtxt and writetotxt
+ *
+ * Can't use std::map as input, because it would lose the order -.-
+ *
+ * Writes a comment line "#" with the right-aligned column names followed by
+ * one line per row, in which each value is right-aligned in scientific
+ * format with max_digits10 digits, so that it can be read back exactly.
+ * Columns shorter than the longest one are padded with spaces and the last
+ * line consists only of spaces.
+ *
+ * @see dumpBinaryData in ColumnarFile.hpp for a format which can be reloaded
+ *      without parsing
+ */
+template< typename T_Prec >
+inline void dumpData
+(
+    std::string const & filePath,
+    std::vector< std::pair< std::string, std::vector< T_Prec > > > const & data
+)
+{
+    TextWriter file( filePath );
+
+    /* "+p.pppe+999 " */
+    auto const precision = std::numeric_limits< T_Prec >::max_digits10;
+    auto const width     = precision + 8;
+
+    detail::writeDumpHeader( file, data, width );
+    detail::writeDumpRows( file, data, 0, detail::countDumpRows( data ), precision, width );
+    file.close();
+}
+
+/**
+ * Writes the same file as dumpData, but formats chunks of about 1 MiB of
+ * rows in parallel and writes them out in order, i.e., it needs about
+ * 2 * pool.size() MiB of memory.
+ *
+ * @param[in] pool anything with size() and parallelFor( nTasks,
+ *            functor( size_t iTask, unsigned int iWorker ) ) like ThreadPool,
+ *            which isn't included here, so that this header doesn't depend
+ *            on threads.
+ */
+template< typename T_Prec, typename T_Pool >
+inline void dumpData
+(
+    std::string const & filePath,
+    std::vector< std::pair< std::string, std::vector< T_Prec > > > const & data,
+    T_Pool & pool
+)
+{
+    TextWriter file( filePath );
+
+    auto const precision = std::numeric_limits< T_Prec >::max_digits10;
+    auto const width     = precision + 8;
+
+    detail::writeDumpHeader( file, data, width );
+
+    auto const nRows         = detail::countDumpRows( data );
+    auto const nBytesPerRow  = data.size() * size_t( width ) + 1u;
+    auto const nRowsPerChunk = std::max( size_t( 1 ), ( size_t( 1 ) << 20 ) / nBytesPerRow );
+    auto const nChunks       = ( nRows + nRowsPerChunk - 1 ) / nRowsPerChunk;
+
+    std::vector< TextBuffer > chunks( 2 * size_t( pool.size() ) );
+    for ( size_t iFirstChunk = 0; iFirstChunk < nChunks; iFirstChunk += chunks.size() )
+    {
+        auto const nChunksInWave = std::min( chunks.size(), nChunks - iFirstChunk );
+        pool.parallelFor( nChunksInWave, [&] ( size_t const k, unsigned int )
+        {
+            auto const iBegin = ( iFirstChunk + k ) * nRowsPerChunk;
+            chunks[k].clear();
+            detail::writeDumpRows( chunks[k], data, iBegin, std::min( nRows, iBegin + nRowsPerChunk ), precision, width );
+        } );
+
+        for ( size_t k = 0; k < nChunksInWave; ++k )
+            file.write( chunks[k] );
+    }
 
     file.close();
 }
@@ -300,33 +1255,647 @@ inline double diffNow
 }
 
 
+#include <atomic>
+#include <cstdint>                      // uint64_t
+
+/**
+ * xoshiro256** pseudo random number generator, which passes all known
+ * statistical tests, needs 4 instructions per 64 bits and, unlike std::rand,
+ * has no hidden global state, i.e., every thread can have its own instance.
+ * Models UniformRandomBitGenerator, so it works with the std distributions.
+ * @see D. Blackman, S. Vigna, "Scrambled Linear Pseudorandom Number
+ *      Generators", 2018, https://prng.di.unimi.it/
+ */
+class Xoshiro256StarStar
+{
+private:
+    uint64_t s[4];
+
+    inline static uint64_t rotl( uint64_t const x, int const k ) { return ( x << k ) | ( x >> ( 64 - k ) ); }
+
+    /* xors the states after 2^k steps for each bit k set in the polynomial into the state */
+    inline void jump( uint64_t const ( &polynomial )[4] )
+    {
+        uint64_t t[4] = { 0, 0, 0, 0 };
+        for ( auto const word : polynomial )
+        {
+            for ( int b = 0; b < 64; ++b )
+            {
+                if ( word & ( uint64_t( 1 ) << b ) )
+                {
+                    for ( int i = 0; i < 4; ++i )
+                        t[i] ^= s[i];
+                }
+                (*this)();
+            }
+        }
+        for ( int i = 0; i < 4; ++i )
+            s[i] = t[i];
+    }
+
+public:
+    using result_type = uint64_t;
+
+    static constexpr uint64_t defaultSeed = 0x853c49e6748fea9bULL;
+
+    /**
+     * The state is initialized with splitmix64 as recommended by the
+     * authors, so that similar seeds, e.g. 0, 1, 2, give unrelated streams.
+     */
+    inline explicit Xoshiro256StarStar( uint64_t seed = defaultSeed ) { this->seed( seed ); }
+
+    inline void seed( uint64_t seed )
+    {
+        for ( auto & word : s )
+        {
+            seed += 0x9e3779b97f4a7c15ULL;
+            auto z = seed;
+            z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+            z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+            word = z ^ ( z >> 31 );
+        }
+    }
+
+    static constexpr uint64_t min( void ) { return 0; }
+    static constexpr uint64_t max( void ) { return ~uint64_t( 0 ); }
+
+    inline uint64_t operator()( void )
+    {
+        auto const result = rotl( s[1] * 5, 7 ) * 9;
+        auto const t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl( s[3], 45 );
+        return result;
+    }
+
+    /**
+     * Advances the state by 2^128 steps, i.e., gives 2^128 non-overlapping
+     * streams of length 2^128, e.g. one for each thread of a simulation.
+     */
+    inline void jump( void )
+    {
+        static uint64_t const polynomial[4] = {
+            0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+        jump( polynomial );
+    }
+
+    /** advances the state by 2^192 steps, e.g. one for each process or node */
+    inline void longJump( void )
+    {
+        static uint64_t const polynomial[4] = {
+            0x76e15d3efefdcbbfULL, 0xc5004e441c522fb3ULL, 0x77710069854ee241ULL, 0x39109bb02acbe635ULL };
+        jump( polynomial );
+    }
+
+    inline void fillBits( uint64_t * const bits, size_t const n )
+    {
+        for ( size_t i = 0u; i < n; ++i )
+            bits[i] = (*this)();
+    }
 
+    /** uniformly distributed in [0,1) with all 53 bits of the mantissa random */
+    inline double uniform( void )
+    {
+        return ( (*this)() >> 11 ) * ( 1. / ( uint64_t( 1 ) << 53 ) );
+    }
+
+    inline void fillUniform( double * const x, size_t const n )
+    {
+        for ( size_t i = 0u; i < n; ++i )
+            x[i] = uniform();
+    }
+};
+
+/**
+ * Generator of the calling thread. The k-th thread calling this gets the
+ * default stream jumped k times, i.e., the streams of all threads are
+ * independent without any synchronization after the first call.
+ */
+inline Xoshiro256StarStar & threadLocalRandomGenerator( void )
+{
+    static std::atomic< unsigned int > nThreads( 0 );
+    thread_local Xoshiro256StarStar generator = [] () {
+        Xoshiro256StarStar result;
+        for ( auto k = nThreads++; k > 0; --k )
+            result.jump();
+        return result;
+    }();
+    return generator;
+}
+
+
+/**
+ * returns random bits one at a time, using all 64 bits of each generated number.
+ * Unlike the former std::rand version, std::srand has no effect on it.
+ */
 class RandomBitGenerator
 {
 private:
-    uint64_t           lastRandomNumber;
-    unsigned int       nBitsUsed       ;
-    unsigned int const nBitsUsable     ;
+    Xoshiro256StarStar generator;
+    uint64_t           bits;
+    unsigned int       nBitsLeft;
 
 public:
-    inline RandomBitGenerator()
-    : lastRandomNumber( std::rand() ),
-      nBitsUsed( 0 ),
-      nBitsUsable( std::floor( std::log2( (uint64_t) RAND_MAX ) + 1 ) )  // max 3 (has 2 bits). meh hard to do correct, because I can't add +1 to the max range of the same value... would get overflow, mah in almost any cases RAND_MAX will be at som 2^n-1, so it should be correct -.- Can't cover every edge case
+    /** seeded from threadLocalRandomGenerator(), i.e. each object gives different bits */
+    inline RandomBitGenerator( void )
+    : generator( threadLocalRandomGenerator()() ), bits( 0 ), nBitsLeft( 0 )
+    {}
+
+    /** reproducible stream for a fixed seed */
+    inline explicit RandomBitGenerator( uint64_t const seed )
+    : generator( seed ), bits( 0 ), nBitsLeft( 0 )
+    {}
+
+    /** e.g. a jumped copy of threadLocalRandomGenerator() */
+    inline explicit RandomBitGenerator( Xoshiro256StarStar const & rGenerator )
+    : generator( rGenerator ), bits( 0 ), nBitsLeft( 0 )
     {}
 
     inline bool decide()
     {
-        if ( nBitsUsed >= nBitsUsable )
+        if ( nBitsLeft == 0 )
         {
-            lastRandomNumber = std::rand();
-            nBitsUsed        = 0;
+            bits      = generator();
+            nBitsLeft = 64;
         }
 
-        ++nBitsUsed;
-        bool const bit = lastRandomNumber & uint64_t(1);
-        lastRandomNumber = lastRandomNumber >> 1;
+        --nBitsLeft;
+        bool const bit = bits & uint64_t(1);
+        bits >>= 1;
 
         return bit;
     }
 };
+
+#ifdef MAIN_TEST_FUNDAMENTAL
+
+
+#include <cstdio>                       // remove, snprintf
+#include <cstdlib>                      // rand, strtod
+#include <iomanip>                      // setw
+#include <iostream>
+#include <thread>
+
+
+/* the implementation of split before StringView */
+inline std::vector< std::string > splitWithStream( std::string const & src, char const delim )
+{
+    std::stringstream ss( src );
+    std::string item;
+    std::vector< std::string > result;
+    while ( std::getline( ss, item, delim ) )
+        result.push_back( item );
+    return result;
+}
+
+inline bool testSplit( void )
+{
+    bool success = true;
+    /* all strings up to length 6 of these characters */
+    char const alphabet[] = { 'a', ',', ' ' };
+    for ( int length = 0; length <= 6; ++length )
+    {
+        int nStrings = 1;
+        for ( int i = 0; i < length; ++i )
+            nStrings *= 3;
+        for ( int iString = 0; iString < nStrings; ++iString )
+        {
+            std::string src;
+            for ( int i = 0, j = iString; i < length; ++i, j /= 3 )
+                src += alphabet[ j % 3 ];
+            auto const expected = splitWithStream( src, ',' );
+            success &= split( src, ',' ) == expected;
+
+            size_t i = 0;
+            for ( auto const field : splitView( src, ',' ) )
+                success &= i < expected.size() && field == StringView( expected[ i++ ] );
+            success &= i == expected.size();
+        }
+    }
+    std::cout << "split " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+inline bool testParseDouble( void )
+{
+    std::vector< std::string > inputs = {
+        "0", "-0", "1", "-1", "1.5", ".5", "5.", "-.5", "0.1", "3.14159", "1e10", "1E-10", "1e+5", "2.5e-3",
+        "1e", "1e+", "1e-x", "1.5abc", "12,5", "-", ".", "-.e", "", "abc", " 1",
+        "inf", "-Infinity", "INFINITY", "infinit", "nan", "-NaN",
+        "1e308", "1.7976931348623157e308", "1e309", "-1e400", "1e-400", "4.9406564584124654e-324", "2.2250738585072014e-308",
+        "9007199254740993", "9007199254740992", "0.1000000000000000000000000001", "123456789012345678901234",
+        "00000000000000000000000000001.5", "0.000000000000000000000000000123", "1e22", "1e23", "123456789e-22"
+    };
+    char buffer[64];
+    for ( int i = 0; i < 20000; ++i )
+    {
+        auto const x = ( std::rand() - RAND_MAX / 2 ) * std::pow( 10., std::rand() % 40 - 20 ) / RAND_MAX;
+        char const * const formats[] = { "%.17g", "%.6f", "%g", "%.3e", "%.15g" };
+        std::snprintf( buffer, sizeof( buffer ), formats[ i % 5 ], x );
+        inputs.push_back( buffer );
+    }
+
+    bool success = true;
+    for ( auto const & input : inputs )
+    {
+        /* strtod skips whitespace and would parse more, e.g. hex */
+        char * pEnd = nullptr;
+        auto const expected = input.empty() || input[0] == ' ' ? 0 : std::strtod( input.c_str(), &pEnd );
+        auto const nExpected = pEnd == nullptr ? 0 : pEnd - input.c_str();
+
+        double value = 123;
+        auto const p = parseDouble( input.data(), input.data() + input.size(), value );
+        bool const ok = ( p - input.data() == nExpected ) &&
+                        ( nExpected == 0 ? value == 123 : ( std::isnan( expected ) ? std::isnan( value ) : value == expected ) );
+        if ( not ok )
+            std::cout << "parseDouble( \"" << input << "\" ) = " << value << " with " << ( p - input.data() )
+                      << " characters, but expected " << expected << " with " << nExpected << "\n";
+        success &= ok;
+    }
+    double value = 0;
+    success &= detail::parseDoubleFallback( inputs.back().data(), inputs.back().data() + inputs.back().size(), value ) ==
+               inputs.back().data() + inputs.back().size() && value == std::strtod( inputs.back().c_str(), nullptr );
+
+    std::vector< double > values;
+    parseDoubles( "1.5,,-2e3,x,7", ',', values );
+    success &= values.size() == 5 && values[0] == 1.5 && std::isnan( values[1] ) && values[2] == -2000 &&
+               std::isnan( values[3] ) && values[4] == 7;
+    parseDoubles( "1.5, 2.5\t,1.5abc, ", ',', values );
+    success &= values.size() == 4 && values[0] == 1.5 && values[1] == 2.5 && std::isnan( values[2] ) &&
+               std::isnan( values[3] );
+
+    std::vector< std::string > const strings = { " 1.5", "+2", "x", "-3e2", "+-1" };
+    success &= toDouble( strings.begin(), strings.end() ) == std::vector< double >{ 1.5, 2, 0, -300, 0 };
+
+    std::cout << "parseDouble " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+/* the implementation of dumpData before TextWriter */
+template< typename T_Prec >
+inline void dumpDataWithStream
+(
+    std::string const & filePath,
+    std::vector< std::pair< std::string, std::vector< T_Prec > > > const & data
+)
+{
+    std::ofstream file( filePath );
+    auto const prec  = std::numeric_limits< T_Prec >::max_digits10;
+    auto const width = prec + 8;
+
+    file << "#";
+    for ( auto const & kv : data )
+        file << std::setw( width ) << kv.first;
+    file << "\n";
+
+    size_t iRow = 0u;
+    bool nonEmptyColumnFound = false;
+    do
+    {
+        nonEmptyColumnFound = false;
+        for ( auto const & kv : data )
+        {
+            if ( iRow < kv.second.size() )
+            {
+                file << std::setw( width ) << std::scientific << std::setprecision( prec ) << kv.second[iRow];
+                nonEmptyColumnFound = true;
+            }
+            else
+                file << std::setw( width ) << " ";
+        }
+        file << "\n";
+        ++iRow;
+    } while ( nonEmptyColumnFound );
+}
+
+inline std::string readFile( std::string const & filePath )
+{
+    std::ifstream file( filePath );
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+/* runs the tasks serially, but in an order different from a loop */
+struct ReversingPool
+{
+    inline unsigned int size( void ) const { return 3; }
+
+    template< typename T_Functor >
+    inline void parallelFor( size_t const nTasks, T_Functor && functor )
+    {
+        for ( size_t i = nTasks; i > 0; --i )
+            functor( i - 1, 0 );
+    }
+};
+
+template< typename T >
+inline bool testDumpData( std::vector< std::pair< std::string, std::vector< T > > > const & data, char const * const name )
+{
+    std::string const expectedPath = "/tmp/dumpData-expected.dat";
+    std::string const resultPath   = "/tmp/dumpData-result.dat";
+    ReversingPool pool;
+
+    dumpDataWithStream( expectedPath, data );
+    auto const expected = readFile( expectedPath );
+    dumpData( resultPath, data );
+    bool success = readFile( resultPath ) == expected;
+    dumpData( resultPath, data, pool );
+    success &= readFile( resultPath ) == expected;
+
+    std::remove( expectedPath.c_str() );
+    std::remove( resultPath.c_str() );
+    if ( ! success )
+        std::cout << "dumpData of " << name << " differs from the iostream version!\n";
+    return success;
+}
+
+template< typename T >
+inline std::vector< std::pair< std::string, std::vector< T > > > makeDumpData( size_t const nRows )
+{
+    std::vector< std::pair< std::string, std::vector< T > > > data = {
+        { "t", {} }, { "a very long column name which exceeds the width", {} }, { "", {} }, { "short", {} }
+    };
+    for ( size_t iColumn = 0; iColumn < data.size(); ++iColumn )
+    {
+        auto & values = data[ iColumn ].second;
+        /* uneven lengths including an empty column */
+        values.resize( iColumn == 2 ? 0 : nRows / ( iColumn + 1 ) );
+        for ( auto & value : values )
+            value = T( ( std::rand() - RAND_MAX / 2 ) * std::pow( 10., std::rand() % 80 - 40 ) );
+    }
+    return data;
+}
+
+inline bool testDumpData( void )
+{
+    bool success = true;
+    for ( size_t nRows : { size_t( 0 ), size_t( 1 ), size_t( 17 ), size_t( 60000 ) } )
+    {
+        auto doubles = makeDumpData< double >( nRows );
+        if ( nRows > 0 )
+        {
+            auto & values = doubles.front().second;
+            double const specials[] = { 0., -0., INF, -INF, std::nan( "" ), -std::nan( "" ), 1e-310,
+                                        std::numeric_limits< double >::max(), std::numeric_limits< double >::lowest(),
+                                        std::numeric_limits< double >::denorm_min() };
+            for ( size_t i = 0; i < values.size() && i < sizeof( specials ) / sizeof( specials[0] ); ++i )
+                values[i] = specials[i];
+        }
+
+        success &= testDumpData( doubles, "double" );
+        success &= testDumpData( makeDumpData< float >( nRows ), "float" );
+        success &= testDumpData( makeDumpData< long double >( nRows ), "long double" );
+        success &= testDumpData( makeDumpData< int >( nRows ), "int" );
+        success &= testDumpData( makeDumpData< long long >( nRows ), "long long" );
+        success &= testDumpData( makeDumpData< unsigned short >( nRows ), "unsigned short" );
+        /* falls back to operator<< which prints characters */
+        success &= testDumpData( makeDumpData< signed char >( nRows ), "signed char" );
+    }
+    success &= testDumpData( std::vector< std::pair< std::string, std::vector< double > > >{}, "no columns" );
+    success &= testDumpData( std::vector< std::pair< std::string, std::vector< int > > >{
+        { "min", { std::numeric_limits< int >::min(), 0 } }, { "max", { std::numeric_limits< int >::max() } } }, "int limits" );
+
+    /* shortest representations have to parse back exactly and be no longer than %g with that precision */
+    for ( int i = 0; i < 100000; ++i )
+    {
+        double x = 0;
+        if ( i % 2 == 0 )
+            x = ( std::rand() - RAND_MAX / 2 ) * std::pow( 10., std::rand() % 80 - 40 ) / RAND_MAX;
+        else
+        {
+            /* arbitrary bit patterns */
+            uint64_t bits = ( uint64_t( std::rand() ) << 42 ) ^ ( uint64_t( std::rand() ) << 21 ) ^ uint64_t( std::rand() );
+            std::memcpy( &x, &bits, sizeof( x ) );
+        }
+
+        TextBuffer text;
+        text.writeShortest( x, 30 );
+        std::string const string( text.data(), text.size() );
+
+        int nDigits = 1;
+        char expected[64];
+        for ( ; nDigits <= 17; ++nDigits )
+        {
+            std::snprintf( expected, sizeof( expected ), "%.*g", nDigits, x );
+            if ( ! ( x == x ) || std::strtod( expected, nullptr ) == x )
+                break;
+        }
+        auto const trimmed = string.substr( string.find_first_not_of( ' ' ) );
+        bool const ok = string.size() == 30 && trimmed == expected;
+        if ( ! ok )
+            std::cout << "writeShortest( " << expected << " ) wrote \"" << string << "\"\n";
+        success &= ok;
+    }
+
+    TextBuffer text;
+    text.writeShortest( 0.1f );
+    text.write( ' ' );
+    text.writeShortest( -123456789012345LL );
+    text.write( ' ' );
+    text.writeScientific( 3.25, 2, 10 );
+    success &= std::string( text.data(), text.size() ) == "0.1 -123456789012345   3.25e+00";
+
+    std::cout << "dumpData " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+/* the implementation of maxRelErr before the compile-time nanStrategy */
+template< typename T >
+inline double maxRelErrBranching( std::vector<T> const & x, std::vector<T> const & y, int const nanStrategy )
+{
+    if ( x.size() != y.size() )
+        return std::numeric_limits< double >::infinity();
+
+    double max = 0;
+    for ( size_t i = 0u; i < x.size(); ++i )
+    {
+        if ( std::isnan( x[i] ) && std::isnan( y[i] ) )
+        {
+            if ( nanStrategy & ( 1 << 0 ) )
+                return std::numeric_limits< double >::infinity();
+            continue;
+        }
+        if ( std::isnan( x[i] ) && ! std::isnan( y[i] ) )
+        {
+            if ( nanStrategy & ( 1 << 1 ) )
+                return std::numeric_limits< double >::infinity();
+            continue;
+        }
+        if ( ! std::isnan( x[i] ) && std::isnan( y[i] ) )
+        {
+            if ( nanStrategy & ( 1 << 2 ) )
+                return std::numeric_limits< double >::infinity();
+            continue;
+        }
+        max = std::max( max, std::abs( relErr( x[i], y[i] ) ) );
+    }
+    return max;
+}
+
+template< int nanStrategy >
+inline bool testMaxRelErr( std::vector< double > const & x, std::vector< double > const & y,
+                           std::vector< Simd::InstructionSet > const & instructionSets )
+{
+    bool success = true;
+    auto const expected = maxRelErrBranching( x, y, nanStrategy );
+    for ( auto const instructionSet : instructionSets )
+    {
+        auto const result = maxRelErr< nanStrategy >( x.data(), y.data(), x.size(), instructionSet );
+        if ( std::memcmp( &result, &expected, sizeof( result ) ) != 0 )
+        {
+            std::cout << "maxRelErr< " << nanStrategy << " > with " << Simd::toString( instructionSet )
+                      << " for n = " << x.size() << " returned " << result << " instead of " << expected << "\n";
+            success = false;
+        }
+    }
+    success &= maxRelErr( x, y, nanStrategy ) == expected;
+    return success;
+}
+
+inline bool testMaxRelErr( void )
+{
+    bool success = true;
+
+    std::vector< Simd::InstructionSet > instructionSets = { Simd::InstructionSet::Scalar };
+    #if SIMD_VECTOR128
+        instructionSets.push_back( Simd::detectInstructionSet() == Simd::InstructionSet::Neon
+                                   ? Simd::InstructionSet::Neon : Simd::InstructionSet::Sse2 );
+    #endif
+    #if SIMD_X86
+        if ( Simd::instructionSet() == Simd::InstructionSet::Avx2 ||
+             Simd::instructionSet() == Simd::InstructionSet::Avx512 )
+            instructionSets.push_back( Simd::InstructionSet::Avx2 );
+        if ( Simd::instructionSet() == Simd::InstructionSet::Avx512 )
+            instructionSets.push_back( Simd::InstructionSet::Avx512 );
+    #endif
+
+    auto const nan = std::numeric_limits< double >::quiet_NaN();
+    auto const inf = std::numeric_limits< double >::infinity();
+    for ( size_t n : { 0, 1, 3, 16, 31, 127, 128, 129, 1000, 1024, 1025, 5000 } )
+    for ( int iCase = 0; iCase < 6; ++iCase )
+    {
+        std::vector< double > x( n ), y( n );
+        for ( size_t i = 0; i < n; ++i )
+        {
+            x[i] = ( std::rand() - RAND_MAX / 2 ) * std::pow( 10., std::rand() % 20 - 10 );
+            y[i] = std::rand() % 4 == 0 ? x[i] : x[i] * ( 1 + ( std::rand() - RAND_MAX / 2 ) * 1e-3 / RAND_MAX );
+        }
+        /* a single special value anywhere, e.g. in the scalar tail or only the second chunk */
+        if ( n > 0 && iCase > 0 )
+        {
+            auto const i = std::rand() % n;
+            switch ( iCase )
+            {
+                case 1: x[i] = nan; y[i] = nan; break;
+                case 2: x[i] = nan; break;
+                case 3: y[i] = nan; break;
+                case 4: x[i] = 0; y[i] = -0.; break;
+                case 5: x[i] = inf; y[i] = std::rand() % 2 == 0 ? inf : 1; break;
+            }
+        }
+        success &= testMaxRelErr< 0 >( x, y, instructionSets );
+        success &= testMaxRelErr< 1 >( x, y, instructionSets );
+        success &= testMaxRelErr< 2 >( x, y, instructionSets );
+        success &= testMaxRelErr< 3 >( x, y, instructionSets );
+        success &= testMaxRelErr< 4 >( x, y, instructionSets );
+        success &= testMaxRelErr< 5 >( x, y, instructionSets );
+        success &= testMaxRelErr< 6 >( x, y, instructionSets );
+        success &= testMaxRelErr< 7 >( x, y, instructionSets );
+    }
+
+    /* not vectorized types */
+    std::vector< float > const xFloat = { 1, 2, nan, 4 }, yFloat = { 1, 2.5, nan, 3 };
+    success &= maxRelErr( xFloat, yFloat, 0 ) == 0.25 && maxRelErr( xFloat, yFloat ) == inf;
+    std::vector< int > const xInt = { 1, 2, 3 }, yInt = { 1, 2, 3 };
+    success &= maxRelErr( xInt, yInt ) == 0;
+    success &= maxRelErr( xInt, std::vector< int >( 2 ) ) == inf;
+
+    std::cout << "maxRelErr " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+
+inline bool testRandomGenerators( void )
+{
+    bool success = true;
+
+    /* reference values from an independent implementation, which jumps by computing M^(2^128) of the transition matrix */
+    Xoshiro256StarStar generator;
+    success &= generator() == 0x7d392394307d1852ULL && generator() == 0xd36a63a899a184a5ULL && generator() == 0x6d8cab58145b27a9ULL;
+    generator.seed( 0 );
+    success &= generator() == 0x99ec5f36cb75f2b4ULL && generator() == 0xbf6e1f784956452aULL;
+
+    generator.seed( Xoshiro256StarStar::defaultSeed );
+    generator.jump();
+    success &= generator() == 0x459d2cdba533e83bULL && generator() == 0x7b98dac10fc41166ULL;
+
+    generator.seed( Xoshiro256StarStar::defaultSeed );
+    generator.longJump();
+    success &= generator() == 0xa17eccaa2532d55cULL && generator() == 0x6b42e35603d647f2ULL;
+
+    /* the second thread gets the stream jumped once */
+    std::vector< uint64_t > firstValues( 2 );
+    firstValues[0] = threadLocalRandomGenerator()();
+    std::thread( [&] () { firstValues[1] = threadLocalRandomGenerator()(); } ).join();
+    success &= firstValues[0] == 0x7d392394307d1852ULL && firstValues[1] == 0x459d2cdba533e83bULL;
+
+    /* bulk functions are the same stream as single calls */
+    Xoshiro256StarStar a( 123 ), b( 123 );
+    std::vector< uint64_t > bits( 1000 );
+    a.fillBits( bits.data(), bits.size() );
+    for ( auto const value : bits )
+        success &= value == b();
+
+    std::vector< double > uniform( 100000 );
+    a.fillUniform( uniform.data(), uniform.size() );
+    double sum = 0;
+    for ( auto const x : uniform )
+    {
+        success &= 0 <= x && x < 1 && x == b.uniform();
+        sum += x;
+    }
+    success &= std::abs( sum / uniform.size() - 0.5 ) < 0.01;
+
+    /* all 64 bits are used and balanced */
+    RandomBitGenerator bitGenerator( 7 ), bitGeneratorFromGenerator( Xoshiro256StarStar( 7 ) );
+    Xoshiro256StarStar referenceGenerator( 7 );
+    size_t nOnes = 0;
+    for ( int i = 0; i < 64 * 100; ++i )
+    {
+        auto const bit = bitGenerator.decide();
+        success &= bit == bitGeneratorFromGenerator.decide();
+        nOnes += bit;
+        if ( i % 64 == 0 )
+            bits[0] = referenceGenerator();
+        success &= bit == bool( ( bits[0] >> ( i % 64 ) ) & 1 );
+    }
+    success &= 3000 < nOnes && nOnes < 3400;
+
+    /* default constructed generators must not all give the same bits */
+    RandomBitGenerator first, second;
+    bool allEqual = true;
+    for ( int i = 0; i < 256; ++i )
+        allEqual &= first.decide() == second.decide();
+    success &= not allEqual;
+
+    std::cout << "Random generators " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+
+int main()
+{
+    testSplit();
+    testParseDouble();
+    testDumpData();
+    testMaxRelErr();
+    testRandomGenerators();
+}
+
+
+#endif
@@ -0,0 +1,532 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 Instrumentation.hpp -DMAIN_TEST_INSTRUMENTATION -DINSTRUMENTATION_ENABLED=1 -pthread && ./a.out
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 Instrumentation.hpp -DMAIN_TEST_INSTRUMENTATION -pthread && ./a.out
+*/
+#pragma once
+
+/**
+ * Named scoped timers and counters which can stay in production code, e.g.
+ *
+ *   void parse( ... )
+ *   {
+ *       INSTRUMENT_SCOPE( "parse" );
+ *       ...
+ *       INSTRUMENT_COUNT( "parse/rows", nRows );
+ *   }
+ *
+ * The macros compile to nothing unless INSTRUMENTATION_ENABLED is defined
+ * to 1. When enabled, each probe costs two reads of the time stamp counter
+ * and a few stores into statistics owned by the calling thread, i.e., there
+ * are no locks, atomic read-modify-writes or shared cache lines on the hot
+ * path. Only the first call of each probe and the first probe of each
+ * thread lock a mutex for registering them, and each thread locks it once
+ * more at exit for merging its statistics.
+ * The statistics of all threads are merged on demand with summarize or
+ * printSummary, or at exit after calling printSummaryAtExit.
+ */
+
+#include <algorithm>                    // max, min
+#include <atomic>
+#include <chrono>
+#include <cstddef>                      // size_t
+#include <cstdint>                      // uint64_t
+#include <cstdlib>                      // atexit
+#include <deque>
+#include <iomanip>                      // setw, setprecision
+#include <iostream>
+#include <memory>                       // unique_ptr
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#   include <x86intrin.h>               // __rdtsc
+#   define INSTRUMENTATION_TSC 1
+#else
+#   define INSTRUMENTATION_TSC 0
+#endif
+
+#ifndef INSTRUMENTATION_ENABLED
+#   define INSTRUMENTATION_ENABLED 0
+#endif
+
+
+namespace Instrumentation {
+
+
+/**
+ * Time stamp counter on x86, which is constant-rate and synchronized across
+ * cores on all CPUs since about 2008, else steady_clock in nanoseconds.
+ */
+inline uint64_t ticks( void )
+{
+#if INSTRUMENTATION_TSC
+    return __rdtsc();
+#else
+    return uint64_t( std::chrono::duration_cast< std::chrono::nanoseconds >(
+        std::chrono::steady_clock::now().time_since_epoch() ).count() );
+#endif
+}
+
+enum class Kind { Timer, Counter };
+
+/** bin k counts values in [2^(k-1), 2^k), bin 0 counts zeros */
+size_t constexpr nHistogramBins = 48;
+
+/** maximum number of distinct probe names */
+size_t constexpr nMaxProbes = 256;
+
+struct Probe
+{
+    std::string name;
+    Kind        kind;
+    size_t      id;
+};
+
+struct Summary
+{
+    std::string name;
+    Kind        kind;
+    uint64_t    count;
+    /** in seconds for timers, else the sum of the counted values */
+    double total, min, max;
+    /** same unit as total, i.e., upper bin limits are 2^k / ticksPerSecond for timers */
+    std::vector< uint64_t > histogram;
+
+    inline double mean( void ) const { return count == 0 ? 0 : total / count; }
+};
+
+
+namespace detail {
+
+
+/** number of bits needed for value, i.e. 0 for 0 and 64 - clz otherwise */
+inline unsigned int bitWidth( uint64_t value )
+{
+#if defined( __GNUC__ )
+    return value == 0 ? 0 : 64 - __builtin_clzll( value );
+#else
+    unsigned int n = 0;
+    for ( ; value != 0; value >>= 1 )
+        ++n;
+    return n;
+#endif
+}
+
+
+/**
+ * Written only by the owning thread with relaxed loads and stores, which
+ * compile to plain moves, but still allow reading from other threads.
+ */
+struct ProbeStatistics
+{
+    std::atomic< uint64_t > count, total, min, max;
+    std::atomic< uint64_t > histogram[ nHistogramBins ];
+
+    inline void add( uint64_t const value )
+    {
+        auto const increment = [] ( std::atomic< uint64_t > & x, uint64_t const n ) {
+            x.store( x.load( std::memory_order_relaxed ) + n, std::memory_order_relaxed );
+        };
+        increment( count, 1 );
+        increment( total, value );
+        if ( value < min.load( std::memory_order_relaxed ) )
+            min.store( value, std::memory_order_relaxed );
+        if ( value > max.load( std::memory_order_relaxed ) )
+            max.store( value, std::memory_order_relaxed );
+        auto const iBin = std::min< size_t >( bitWidth( value ), nHistogramBins - 1 );
+        increment( histogram[ iBin ], 1 );
+    }
+
+    inline void reset( void )
+    {
+        count = 0;
+        total = 0;
+        min   = ~uint64_t( 0 );
+        max   = 0;
+        for ( auto & n : histogram )
+            n = 0;
+    }
+
+    /** only while neither is written to, e.g. under the registry mutex after its thread exited */
+    inline void mergeInto( ProbeStatistics & target ) const
+    {
+        auto const load = [] ( std::atomic< uint64_t > const & x ) { return x.load( std::memory_order_relaxed ); };
+        target.count = load( target.count ) + load( count );
+        target.total = load( target.total ) + load( total );
+        target.min   = std::min( load( target.min ), load( min ) );
+        target.max   = std::max( load( target.max ), load( max ) );
+        for ( size_t i = 0u; i < nHistogramBins; ++i )
+            target.histogram[i] = load( target.histogram[i] ) + load( histogram[i] );
+    }
+};
+
+struct ThreadStatistics
+{
+    ProbeStatistics probes[ nMaxProbes ];
+
+    inline ThreadStatistics() { reset(); }
+
+    inline void reset( void )
+    {
+        for ( auto & probe : probes )
+            probe.reset();
+    }
+};
+
+struct Registry
+{
+    std::mutex                                       mutex;
+    std::deque< Probe >                              probes;   /**< deque for stable references */
+    /** all blocks ever allocated, i.e. at most as many as threads were alive at once */
+    std::vector< std::unique_ptr< ThreadStatistics > > threads;
+    std::vector< ThreadStatistics * >                freeThreads;  /**< reset blocks of exited threads */
+    ThreadStatistics                                 retired;      /**< merged counts of exited threads */
+
+    /* for calibrating the time stamp counter against steady_clock */
+    uint64_t                                         ticks0;
+    std::chrono::steady_clock::time_point            time0;
+
+    inline Registry() : ticks0( ticks() ), time0( std::chrono::steady_clock::now() ) {}
+};
+
+/* never destructed, so that threads still running at exit and the at-exit summary can use it */
+inline Registry & registry( void )
+{
+    static auto const instance = new Registry();
+    return *instance;
+}
+
+/**
+ * Takes a free block or allocates one for the thread. At thread exit, its
+ * counts are merged into Registry::retired and the block is reset and
+ * returned, so that programs starting threads per job don't grow.
+ */
+class ThreadStatisticsOwner
+{
+private:
+    ThreadStatistics * statistics;
+
+public:
+    inline ThreadStatisticsOwner( void )
+    {
+        auto & r = registry();
+        std::lock_guard< std::mutex > lock( r.mutex );
+        if ( r.freeThreads.empty() )
+        {
+            r.threads.emplace_back( new ThreadStatistics() );
+            statistics = r.threads.back().get();
+        }
+        else
+        {
+            statistics = r.freeThreads.back();
+            r.freeThreads.pop_back();
+        }
+    }
+
+    inline ~ThreadStatisticsOwner()
+    {
+        auto & r = registry();
+        std::lock_guard< std::mutex > lock( r.mutex );
+        for ( size_t i = 0u; i < nMaxProbes; ++i )
+            statistics->probes[i].mergeInto( r.retired.probes[i] );
+        statistics->reset();
+        r.freeThreads.push_back( statistics );
+    }
+
+    ThreadStatisticsOwner( ThreadStatisticsOwner const & ) = delete;
+    ThreadStatisticsOwner & operator=( ThreadStatisticsOwner const & ) = delete;
+
+    inline ThreadStatistics & get( void ) { return *statistics; }
+};
+
+inline ThreadStatistics & threadStatistics( void )
+{
+    thread_local ThreadStatisticsOwner owner;
+    return owner.get();
+}
+
+
+} // namespace detail
+
+
+/** @return probe with that name, which is registered on the first call */
+inline Probe const & registerProbe( std::string const & name, Kind const kind )
+{
+    auto & registry = detail::registry();
+    std::lock_guard< std::mutex > lock( registry.mutex );
+    for ( auto const & probe : registry.probes )
+    {
+        if ( probe.name == name )
+        {
+            if ( probe.kind != kind )
+                throw std::invalid_argument( "[registerProbe] Probe '" + name + "' is used as timer and counter!" );
+            return probe;
+        }
+    }
+    if ( registry.probes.size() >= nMaxProbes )
+        throw std::invalid_argument( "[registerProbe] Too many probes, increase nMaxProbes!" );
+    registry.probes.push_back( Probe{ name, kind, registry.probes.size() } );
+    return registry.probes.back();
+}
+
+inline void count( Probe const & probe, uint64_t const value )
+{
+    detail::threadStatistics().probes[ probe.id ].add( value );
+}
+
+/** adds the ticks from construction to destruction to the probe */
+class ScopedTimer
+{
+private:
+    Probe const & probe;
+    uint64_t const start;
+
+public:
+    inline explicit ScopedTimer( Probe const & rProbe ) : probe( rProbe ), start( ticks() ) {}
+    inline ~ScopedTimer() { count( probe, ticks() - start ); }
+
+    ScopedTimer( ScopedTimer const & ) = delete;
+    ScopedTimer & operator=( ScopedTimer const & ) = delete;
+};
+
+/**
+ * Ratio of the elapsed ticks and steady_clock time since the first probe was
+ * registered, waiting until at least 10 ms passed for a usable accuracy.
+ */
+inline double ticksPerSecond( void )
+{
+#if INSTRUMENTATION_TSC
+    auto const & registry = detail::registry();
+    auto elapsed = std::chrono::steady_clock::now() - registry.time0;
+    while ( elapsed < std::chrono::milliseconds( 10 ) )
+        elapsed = std::chrono::steady_clock::now() - registry.time0;
+    auto const nTicks = ticks() - registry.ticks0;
+    return nTicks / std::chrono::duration< double >( elapsed ).count();
+#else
+    return 1e9;
+#endif
+}
+
+/** merges the statistics of all threads in the order the probes were registered first */
+inline std::vector< Summary > summarize( void )
+{
+    auto & registry = detail::registry();
+    auto const toSeconds = 1 / ticksPerSecond();
+
+    std::lock_guard< std::mutex > lock( registry.mutex );
+    std::vector< Summary > summaries;
+    for ( auto const & probe : registry.probes )
+    {
+        uint64_t count = 0, total = 0, min = ~uint64_t( 0 ), max = 0;
+        std::vector< uint64_t > histogram( nHistogramBins );
+        /* free blocks are reset, i.e. add nothing */
+        std::vector< detail::ThreadStatistics const * > threads = { &registry.retired };
+        for ( auto const & thread : registry.threads )
+            threads.push_back( thread.get() );
+        for ( auto const thread : threads )
+        {
+            auto const & statistics = thread->probes[ probe.id ];
+            count += statistics.count.load( std::memory_order_relaxed );
+            total += statistics.total.load( std::memory_order_relaxed );
+            min = std::min( min, statistics.min.load( std::memory_order_relaxed ) );
+            max = std::max( max, statistics.max.load( std::memory_order_relaxed ) );
+            for ( size_t i = 0u; i < nHistogramBins; ++i )
+                histogram[i] += statistics.histogram[i].load( std::memory_order_relaxed );
+        }
+        if ( count == 0 )
+            min = 0;
+
+        auto const scale = probe.kind == Kind::Timer ? toSeconds : 1.;
+        summaries.push_back( Summary{ probe.name, probe.kind, count, total * scale, min * scale, max * scale,
+                                      std::move( histogram ) } );
+    }
+    return summaries;
+}
+
+/**
+ * Human-readable table with times in microseconds and the non-empty
+ * histogram bins as upper limit:count
+ */
+inline void printSummary( std::ostream & out = std::cerr )
+{
+    auto const summaries = summarize();
+    if ( summaries.empty() )
+        return;
+    auto const toSeconds = 1 / ticksPerSecond();
+
+    size_t nameWidth = 4;
+    for ( auto const & summary : summaries )
+        nameWidth = std::max( nameWidth, summary.name.size() );
+
+    out << std::left << std::setw( nameWidth ) << "name" << std::right
+        << std::setw( 12 ) << "count" << std::setw( 14 ) << "total" << std::setw( 12 ) << "mean"
+        << std::setw( 12 ) << "min" << std::setw( 12 ) << "max" << "   (times in us)\n";
+    for ( auto const & summary : summaries )
+    {
+        auto const scale = summary.kind == Kind::Timer ? 1e6 : 1.;
+        out << std::left << std::setw( nameWidth ) << summary.name << std::right
+            << std::setw( 12 ) << summary.count << std::fixed << std::setprecision( 3 )
+            << std::setw( 14 ) << summary.total * scale
+            << std::setw( 12 ) << summary.mean() * scale
+            << std::setw( 12 ) << summary.min * scale
+            << std::setw( 12 ) << summary.max * scale << "\n" << std::defaultfloat;
+
+        out << std::setw( nameWidth ) << "" << " ";
+        for ( size_t i = 0u; i < summary.histogram.size(); ++i )
+        {
+            if ( summary.histogram[i] == 0 )
+                continue;
+            auto const upperLimit = double( uint64_t( 1 ) << i ) * ( summary.kind == Kind::Timer ? toSeconds * scale : 1. );
+            out << " <" << std::setprecision( 3 ) << upperLimit << ":" << summary.histogram[i];
+        }
+        out << "\n";
+    }
+}
+
+inline void printSummaryAtExit( void )
+{
+    static std::once_flag registered;
+    std::call_once( registered, [] () { std::atexit( [] () { printSummary( std::cerr ); } ); } );
+}
+
+
+} // namespace Instrumentation
+
+
+#define INSTRUMENTATION_CONCAT_( A, B ) A##B
+#define INSTRUMENTATION_CONCAT( A, B ) INSTRUMENTATION_CONCAT_( A, B )
+
+#if INSTRUMENTATION_ENABLED
+    /** times until the end of the enclosing scope, name must be a string constant */
+#   define INSTRUMENT_SCOPE( NAME )                                                                         \
+        static ::Instrumentation::Probe const & INSTRUMENTATION_CONCAT( instrumentationProbe, __LINE__ ) =  \
+            ::Instrumentation::registerProbe( NAME, ::Instrumentation::Kind::Timer );                       \
+        ::Instrumentation::ScopedTimer const INSTRUMENTATION_CONCAT( instrumentationTimer, __LINE__ )(    \
+            INSTRUMENTATION_CONCAT( instrumentationProbe, __LINE__ ) )
+    /** adds VALUE, e.g. a number of processed bytes, and counts the calls */
+#   define INSTRUMENT_COUNT( NAME, VALUE )                                                                  \
+        do {                                                                                                \
+            static ::Instrumentation::Probe const & instrumentationProbe =                                  \
+                ::Instrumentation::registerProbe( NAME, ::Instrumentation::Kind::Counter );                 \
+            ::Instrumentation::count( instrumentationProbe, uint64_t( VALUE ) );                            \
+        } while ( false )
+#else
+#   define INSTRUMENT_SCOPE( NAME ) static_assert( true, "" )
+#   define INSTRUMENT_COUNT( NAME, VALUE ) do {} while ( false )
+#endif
+
+
+#ifdef MAIN_TEST_INSTRUMENTATION
+
+
+#include <sstream>
+#include <thread>
+
+
+namespace {
+
+
+void work( size_t const n )
+{
+    INSTRUMENT_SCOPE( "work" );
+    volatile double sink = 0;
+    for ( size_t i = 0u; i < n; ++i )
+        sink = sink + 1;
+    INSTRUMENT_COUNT( "work/n", n );
+}
+
+bool testInstrumentation( void )
+{
+    bool success = true;
+
+    /* count exactly, also across threads, and time in ascending order */
+    std::vector< std::thread > threads;
+    for ( int iThread = 0; iThread < 4; ++iThread )
+        threads.emplace_back( [] () { for ( size_t n = 0; n < 1000; ++n ) work( n ); } );
+    for ( auto & thread : threads )
+        thread.join();
+    { INSTRUMENT_SCOPE( "sleep" ); std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) ); }
+
+    auto const summaries = Instrumentation::summarize();
+#if ! INSTRUMENTATION_ENABLED
+    success &= summaries.empty();
+#else
+    success &= summaries.size() == 3;
+    if ( summaries.size() == 3 )
+    {
+        auto const & timer = summaries[0];
+        auto const & counter = summaries[1];
+        auto const & sleep = summaries[2];
+        success &= timer.name == "work" && timer.kind == Instrumentation::Kind::Timer && timer.count == 4000;
+        success &= 0 < timer.min && timer.min <= timer.mean() && timer.mean() <= timer.max && timer.max < 1;
+        success &= counter.name == "work/n" && counter.kind == Instrumentation::Kind::Counter;
+        success &= counter.count == 4000 && counter.total == 4 * 999 * 1000 / 2 && counter.min == 0 && counter.max == 999;
+        /* 1 zero, 1 one, 2 in [2,4), ..., 1000 - 512 in [512,1024) per thread */
+        success &= counter.histogram[0] == 4 && counter.histogram[1] == 4 && counter.histogram[2] == 8 &&
+                   counter.histogram[10] == 4 * 488;
+        success &= sleep.count == 1 && 0.019 < sleep.total && sleep.total < 0.5;
+
+        uint64_t nInHistogram = 0;
+        for ( auto const n : timer.histogram )
+            nInHistogram += n;
+        success &= nInHistogram == timer.count;
+    }
+
+    /* short-lived threads reuse the statistics blocks of exited ones */
+    for ( int iThread = 0; iThread < 200; ++iThread )
+    {
+        std::thread( [] () { INSTRUMENT_COUNT( "shortLived", 1 ); } ).join();
+        std::thread a( [] () { INSTRUMENT_COUNT( "shortLived", 2 ); } ), b( [] () { INSTRUMENT_COUNT( "shortLived", 3 ); } );
+        a.join();
+        b.join();
+    }
+    {
+        auto & registry = Instrumentation::detail::registry();
+        std::lock_guard< std::mutex > lock( registry.mutex );
+        /* at most the first 4 threads and the main thread at once, instead of one per thread */
+        success &= registry.threads.size() <= 5;
+    }
+    auto const afterShortLived = Instrumentation::summarize();
+    success &= afterShortLived.size() == 4 && afterShortLived[3].count == 600 && afterShortLived[3].total == 1200 &&
+               afterShortLived[3].min == 1 && afterShortLived[3].max == 3 && afterShortLived[0].count == 4000;
+
+    /* histogram bins up to the largest values */
+    for ( unsigned int k = 0u; k < 64; ++k )
+    {
+        success &= Instrumentation::detail::bitWidth( uint64_t( 1 ) << k ) == k + 1;
+        success &= Instrumentation::detail::bitWidth( ( uint64_t( 1 ) << k ) - 1 ) == k;
+    }
+    success &= Instrumentation::detail::bitWidth( ~uint64_t( 0 ) ) == 64;
+
+    /* same name aggregates, other kind is an error */
+    success &= &Instrumentation::registerProbe( "work", Instrumentation::Kind::Timer ) ==
+               &Instrumentation::registerProbe( "work", Instrumentation::Kind::Timer );
+    try
+    {
+        Instrumentation::registerProbe( "work", Instrumentation::Kind::Counter );
+        success = false;
+    }
+    catch ( std::invalid_argument const & ) {}
+
+    std::stringstream summary;
+    Instrumentation::printSummary( summary );
+    success &= summary.str().find( "work/n" ) != std::string::npos;
+#endif
+
+    std::cout << "Instrumentation " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+
+} // namespace
+
+
+int main()
+{
+    testInstrumentation();
+}
+
+
+#endif
@@ -1,14 +1,367 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 LinearRegression.hpp -DMAIN_TEST_LINEARREGRESSION -pthread && ./a.out
+*/
 #pragma once
 
+#include <algorithm>                    // min, max, fill
+#include <cassert>
 #include <cmath>
+#include <cstddef>                      // size_t
+#include <functional>                   // reference_wrapper
 #include <limits>
+#include <stdexcept>
 #include <vector>
 
+#include "Instrumentation.hpp"
+#include "RollingWindow.hpp"
+#include "SimdDispatch.hpp"
+#include "ThreadPool.hpp"
+
 
 namespace Fundamental {
 
 
 
+/**
+ * Sums over the points (x_i - x0, y_i - y0) needed for fitting lines. The
+ * points are shifted by the first one, because e.g. for timestamps as x
+ * n sxx and sx^2 would be nearly equal and their difference, which is
+ * needed for the slope, would lose all significant digits.
+ */
+struct RegressionSums
+{
+    size_t n   = 0;
+    double x0  = 0;
+    double y0  = 0;
+    double sx  = 0;
+    double sxx = 0;
+    double sy  = 0;
+    double syy = 0;
+    double sxy = 0;
+};
+
+struct LineFit
+{
+    double slope      ;
+    double offset     ;
+    double correlation;  /**< Pearson correlation coefficient */
+};
+
+enum class Summation
+{
+    Plain,
+    Compensated     /**< Kahan summation, about half as fast */
+};
+
+
+/**
+ * @see https://de.wikipedia.org/wiki/Methode_der_kleinsten_Quadrate#Lineare_Modellfunktion
+ * Ansatz: f(x) = a x + b
+ * Data: x_i, y_i for i = 1..n
+ * Idea: Minimize C(a,b) = \sum_i ( a x_i + b - y_i )^2
+ *   C_a = 2 \sum_i x_i ( a x_i + b - y_i ) = 0
+ *   C_b = 2 \sum_i     ( a x_i + b - y_i ) = 0
+ *                  <=>
+ *   a \sum_i x_i^2 + b \sum_i x_i = \sum_i x_i y_i =: sxy
+ *   a \sum_i x_i   + b n          = \sum_i y_i     =: sy
+ *           <=>
+ *   a sxx + b sx = sxy   | * n  |    | * sx  |
+ *   a sx  + b n  = sy    | * sx v-   | * sxx v-
+ *           <=>
+ *   a sx^2 - a n sxx = n sxy - sx sy
+ *   b n sxx - b sx^2 = sy sxx - sxy sx
+ *           <=>
+ *   a = ( n  sxy - sx  sy )/( sx^2  - n sxx )
+ *   b = ( sy sxx - sxy sx )/( n sxx - sx^2  )
+ *     = ( sy - a sx ) / n
+ *  => calculation for b can be seen as average of all offsets per point
+ *     pair with a given slope!
+ * C_min = \sum_i ( a^2 x_i + b^2 + y_i^2 + 2( a b x_i - a x_i y_i - b y_i ) )
+ *       = a^2 sx + n b^2 + syy + 2 a ( b sx - sxy ) - 2 b sy
+ *       = ...
+ * The sums are over shifted points, i.e. the offset has to be shifted back:
+ *   y - y0 = a ( x - x0 ) + b  <=>  y = a x + ( b + y0 - a x0 )
+ */
+inline LineFit fitLine( RegressionSums const & s )
+{
+    auto const n = double( s.n );
+    auto const denominator = n * s.sxx - s.sx * s.sx;
+    auto const numerator   = n * s.sxy - s.sx * s.sy;
+
+    LineFit result;
+    result.slope       = numerator / denominator;
+    result.offset      = ( s.sy - result.slope * s.sx ) / n + s.y0 - result.slope * s.x0;
+    /* https://en.wikipedia.org/wiki/Pearson_correlation_coefficient */
+    result.correlation = numerator / std::sqrt( denominator * ( n * s.syy - s.sy * s.sy ) );
+    return result;
+}
+
+
+namespace detail {
+
+
+/**
+ * Running sums for RegressionSums with optional Kahan compensation which
+ * works for V being double or a SIMD vector of doubles.
+ * @see https://en.wikipedia.org/wiki/Kahan_summation_algorithm
+ */
+template< typename V, bool compensated >
+struct RegressionAccumulator
+{
+    V sx, sxx, sy, syy, sxy;
+    V cx, cxx, cy, cyy, cxy;  /**< compensations, i.e. lost low order bits */
+
+    SIMD_ALWAYS_INLINE static void add( V & sum, V & compensation, V const & value )
+    {
+        if ( compensated )
+        {
+            V const corrected = value - compensation;
+            V const newSum = sum + corrected;
+            compensation = ( newSum - sum ) - corrected;
+            sum = newSum;
+        }
+        else
+            sum += value;
+    }
+
+    SIMD_ALWAYS_INLINE void add( V const & dx, V const & dy )
+    {
+        V const dxx = dx * dx;
+        V const dyy = dy * dy;
+        V const dxy = dx * dy;
+        add( sx , cx , dx  );
+        add( sxx, cxx, dxx );
+        add( sy , cy , dy  );
+        add( syy, cyy, dyy );
+        add( sxy, cxy, dxy );
+    }
+
+    /* adds the compensated sums of other */
+    SIMD_ALWAYS_INLINE void add( RegressionAccumulator const & other )
+    {
+        if ( compensated )
+        {
+            add( sx , cx , V( other.sx  - other.cx  ) );
+            add( sxx, cxx, V( other.sxx - other.cxx ) );
+            add( sy , cy , V( other.sy  - other.cy  ) );
+            add( syy, cyy, V( other.syy - other.cyy ) );
+            add( sxy, cxy, V( other.sxy - other.cxy ) );
+        }
+        else
+        {
+            sx += other.sx; sxx += other.sxx; sy += other.sy; syy += other.syy; sxy += other.sxy;
+        }
+    }
+};
+
+template< bool compensated, typename T >
+inline void regressionSumsScalar
+(
+    T const * const x,
+    T const * const y,
+    size_t    const iBegin,
+    size_t    const iEnd,
+    RegressionAccumulator< double, compensated > & accumulator,
+    double    const x0,
+    double    const y0
+)
+{
+    for ( size_t i = iBegin; i < iEnd; ++i )
+        accumulator.add( double( x[i] ) - x0, double( y[i] ) - y0 );
+}
+
+template< bool compensated >
+inline void finishRegressionSums
+(
+    RegressionAccumulator< double, compensated > const & accumulator,
+    RegressionSums & result
+)
+{
+    result.sx  = accumulator.sx  - ( compensated ? accumulator.cx  : 0 );
+    result.sxx = accumulator.sxx - ( compensated ? accumulator.cxx : 0 );
+    result.sy  = accumulator.sy  - ( compensated ? accumulator.cy  : 0 );
+    result.syy = accumulator.syy - ( compensated ? accumulator.cyy : 0 );
+    result.sxy = accumulator.sxy - ( compensated ? accumulator.cxy : 0 );
+}
+
+#if defined( __GNUC__ )
+
+/**
+ * Two independent accumulators per lane, because the sums are serial
+ * dependency chains and one addition takes 3-4 cycles, while 2 can be
+ * started per cycle.
+ */
+template< std::size_t nBytes, bool compensated >
+SIMD_ALWAYS_INLINE void regressionSumsKernel
+(
+    double const * const x,
+    double const * const y,
+    size_t         const n,
+    RegressionSums     & result
+)
+{
+    using V = typename Simd::Vector< double, nBytes >::type;
+    auto constexpr nLanes = Simd::Vector< double, nBytes >::nLanes;
+
+    V x0, y0;
+    Simd::broadcast( x0, result.x0 );
+    Simd::broadcast( y0, result.y0 );
+    RegressionAccumulator< V, compensated > accumulator0 = {};
+    RegressionAccumulator< V, compensated > accumulator1 = {};
+
+    size_t i = 0u;
+    for ( ; i + 2 * nLanes <= n; i += 2 * nLanes )
+    {
+        V xi, yi;
+        Simd::load( xi, x + i );
+        Simd::load( yi, y + i );
+        accumulator0.add( V( xi - x0 ), V( yi - y0 ) );
+        Simd::load( xi, x + i + nLanes );
+        Simd::load( yi, y + i + nLanes );
+        accumulator1.add( V( xi - x0 ), V( yi - y0 ) );
+    }
+    accumulator0.add( accumulator1 );
+
+    RegressionAccumulator< double, compensated > sums = {};
+    for ( size_t k = 0u; k < nLanes; ++k )
+    {
+        sums.add( sums.sx , sums.cx , accumulator0.sx [k] - ( compensated ? accumulator0.cx [k] : 0 ) );
+        sums.add( sums.sxx, sums.cxx, accumulator0.sxx[k] - ( compensated ? accumulator0.cxx[k] : 0 ) );
+        sums.add( sums.sy , sums.cy , accumulator0.sy [k] - ( compensated ? accumulator0.cy [k] : 0 ) );
+        sums.add( sums.syy, sums.cyy, accumulator0.syy[k] - ( compensated ? accumulator0.cyy[k] : 0 ) );
+        sums.add( sums.sxy, sums.cxy, accumulator0.sxy[k] - ( compensated ? accumulator0.cxy[k] : 0 ) );
+    }
+    regressionSumsScalar( x, y, i, n, sums, result.x0, result.y0 );
+    finishRegressionSums( sums, result );
+}
+
+#endif  // __GNUC__
+
+#if SIMD_VECTOR128
+template< bool compensated >
+void regressionSums128( double const * const x, double const * const y, size_t const n, RegressionSums & result )
+{ regressionSumsKernel< 16, compensated >( x, y, n, result ); }
+#endif
+
+#if SIMD_X86
+template< bool compensated >
+SIMD_TARGET_AVX2 void regressionSumsAvx2( double const * const x, double const * const y, size_t const n, RegressionSums & result )
+{ regressionSumsKernel< 32, compensated >( x, y, n, result ); }
+
+template< bool compensated >
+SIMD_TARGET_AVX512 void regressionSumsAvx512( double const * const x, double const * const y, size_t const n, RegressionSums & result )
+{ regressionSumsKernel< 64, compensated >( x, y, n, result ); }
+#endif
+
+template< bool compensated >
+inline void regressionSums
+(
+    double const * const x,
+    double const * const y,
+    size_t         const n,
+    RegressionSums     & result,
+    Simd::InstructionSet const instructionSet
+)
+{
+    switch ( instructionSet )
+    {
+    #if SIMD_X86
+        case Simd::InstructionSet::Avx512:
+            /* for short data the reduction of the 8 lanes costs more than the wider loop saves */
+            if ( n >= 128 )
+            {
+                regressionSumsAvx512< compensated >( x, y, n, result );
+                return;
+            }
+            /* fall through */
+        case Simd::InstructionSet::Avx2:
+            regressionSumsAvx2< compensated >( x, y, n, result );
+            return;
+    #endif
+    #if SIMD_VECTOR128
+        case Simd::InstructionSet::Sse2:
+        case Simd::InstructionSet::Neon:
+            regressionSums128< compensated >( x, y, n, result );
+            return;
+    #endif
+        default:
+        {
+            RegressionAccumulator< double, compensated > sums = {};
+            regressionSumsScalar( x, y, 0, n, sums, result.x0, result.y0 );
+            finishRegressionSums( sums, result );
+        }
+    }
+}
+
+/* other types than double are not vectorized */
+template< bool compensated, typename T >
+inline void regressionSums
+(
+    T      const * const x,
+    T      const * const y,
+    size_t         const n,
+    RegressionSums     & result,
+    Simd::InstructionSet
+)
+{
+    RegressionAccumulator< double, compensated > sums = {};
+    regressionSumsScalar( x, y, 0, n, sums, result.x0, result.y0 );
+    finishRegressionSums( sums, result );
+}
+
+
+} // namespace detail
+
+
+/**
+ * Calculates the sums for fitLine in one pass over the data using the
+ * widest SIMD instruction set supported for T = double.
+ *
+ * @param[in] instructionSet can be used to force a kernel, e.g. for tests.
+ *            Must be supported by the CPU!
+ */
+template< typename T >
+inline RegressionSums regressionSums
+(
+    T                    const * const x,
+    T                    const * const y,
+    size_t               const         n,
+    Summation            const         summation = Summation::Plain,
+    Simd::InstructionSet const         instructionSet = Simd::instructionSet()
+)
+{
+    RegressionSums result;
+    result.n = n;
+    if ( n == 0 )
+        return result;
+    result.x0 = x[0];
+    result.y0 = y[0];
+    if ( summation == Summation::Compensated )
+        detail::regressionSums< true  >( x, y, n, result, instructionSet );
+    else
+        detail::regressionSums< false >( x, y, n, result, instructionSet );
+    return result;
+}
+
+/**
+ * Least squares fit of a line y = slope x + offset without allocations
+ *
+ * @return all NaN if n < 2 or if all x are equal
+ */
+template< typename T >
+inline LineFit fitLine
+(
+    T                    const * const x,
+    T                    const * const y,
+    size_t               const         n,
+    Summation            const         summation = Summation::Plain,
+    Simd::InstructionSet const         instructionSet = Simd::instructionSet()
+)
+{
+    INSTRUMENT_SCOPE( "fitLine" );
+    return fitLine( regressionSums( x, y, n, summation, instructionSet ) );
+}
+
 /**
  * @return vector with 3 elements. In this order: slope, offset, correlation
  *         coefficient
@@ -25,173 +378,624 @@ std::vector< double > fitLine
     if ( n < 1u )
         return {};
 
-    auto const nan = std::numeric_limits< double >::quiet_NaN();
-    std::vector< double > result( 3, nan );
+    auto const result = fitLine( rX.data(), rY.data(), n );
+    return { result.slope, result.offset, result.correlation };
+}
+
+
+/**
+ * Least squares line fit over the last nWindow pushed points with O(1)
+ * updates, e.g. for a regression slope over a trailing window per bar.
+ *
+ * Keeps the means and the sums of centered products
+ *   cxx = \sum_i ( x_i - <x> )^2, cyy likewise, cxy = \sum_i ( x_i - <x> )( y_i - <y> )
+ * which are updated like in Welford's algorithm when points enter or leave
+ * the window. This avoids the cancellation of adding and removing from
+ * the raw sums sx, sxx, ... for which e.g. after a price jump the
+ * variance of the window can be many orders of magnitude smaller than the
+ * sums it is calculated from. Like RollingMoments, the state is recalculated
+ * from the stored points after every nWindow removals, so that rounding
+ * errors don't accumulate over long runs, and also when cxx or cyy dropped
+ * to below 1e-6 of their maximum since the last recalculation, because then
+ * the rounding errors of the large values already removed dominate.
+ *
+ * Points with NaN in x or y are ignored, but still take up their place in
+ * the window.
+ */
+template< typename T >
+class RollingLineFit
+{
+private:
+    struct Point { T x, y; };
+
+    size_t              nWindow ;
+    size_t              nValid  ;
+    size_t              nRemoved;
+    double              meanX, meanY;
+    double              cxx, cyy, cxy;
+    double              cxxMax, cyyMax;
+    RingBuffer< Point > points  ;
+
+    static inline bool isValid( Point const & p ){ return p.x == p.x && p.y == p.y; }
+
+    inline void add( double const x, double const y )
+    {
+        ++nValid;
+        auto const dx = x - meanX;
+        auto const dy = y - meanY;
+        meanX += dx / nValid;
+        meanY += dy / nValid;
+        cxx += dx * ( x - meanX );
+        cyy += dy * ( y - meanY );
+        cxy += dx * ( y - meanY );
+        cxxMax = std::max( cxxMax, cxx );
+        cyyMax = std::max( cyyMax, cyy );
+    }
+
+    inline void remove( double const x, double const y )
+    {
+        assert( nValid > 0 );
+        --nValid;
+        if ( nValid == 0 )
+        {
+            meanX = meanY = cxx = cyy = cxy = cxxMax = cyyMax = 0;
+            return;
+        }
+        auto const dx = x - meanX;
+        auto const dy = y - meanY;
+        meanX -= dx / nValid;
+        meanY -= dy / nValid;
+        cxx -= dx * ( x - meanX );
+        cyy -= dy * ( y - meanY );
+        cxy -= dx * ( y - meanY );
+    }
+
+    /* two-pass calculation over the window */
+    inline void recalculate( void )
+    {
+        nRemoved = 0;
+        nValid = 0;
+        meanX = meanY = cxx = cyy = cxy = cxxMax = cyyMax = 0;
+        for ( size_t i = 0u; i < points.size(); ++i )
+        {
+            if ( isValid( points[i] ) )
+            {
+                ++nValid;
+                meanX += points[i].x;
+                meanY += points[i].y;
+            }
+        }
+        if ( nValid == 0 )
+            return;
+        meanX /= nValid;
+        meanY /= nValid;
+        for ( size_t i = 0u; i < points.size(); ++i )
+        {
+            if ( isValid( points[i] ) )
+            {
+                auto const dx = points[i].x - meanX;
+                auto const dy = points[i].y - meanY;
+                cxx += dx * dx;
+                cyy += dy * dy;
+                cxy += dx * dy;
+            }
+        }
+        cxxMax = cxx;
+        cyyMax = cyy;
+    }
+
+public:
+    inline explicit RollingLineFit( size_t const rnWindow )
+    : nWindow( rnWindow ), nValid( 0 ), nRemoved( 0 ),
+      meanX( 0 ), meanY( 0 ), cxx( 0 ), cyy( 0 ), cxy( 0 ), cxxMax( 0 ), cyyMax( 0 ),
+      points( std::min( rnWindow, size_t( 1024 ) ) )
+    {
+        if ( rnWindow == 0 )
+            throw std::invalid_argument( "[RollingLineFit] window length must be > 0!" );
+    }
+
+    inline void push( T const & x, T const & y )
+    {
+        Point const point = { x, y };
+        if ( points.size() == nWindow )
+        {
+            auto const oldPoint = points.front();
+            points.popFront();
+            points.pushBack( point );
+            if ( isValid( oldPoint ) )
+            {
+                if ( ++nRemoved >= nWindow )
+                {
+                    recalculate();
+                    return;
+                }
+                remove( oldPoint.x, oldPoint.y );
+                if ( cxx < 1e-6 * cxxMax || cyy < 1e-6 * cyyMax )
+                {
+                    recalculate();
+                    return;
+                }
+            }
+        }
+        else
+            points.pushBack( point );
+
+        if ( isValid( point ) )
+            add( point.x, point.y );
+    }
+
+    /** number of points in the window without NaN */
+    inline size_t count( void ) const { return nValid; }
 
     /**
-     * @see https://de.wikipedia.org/wiki/Methode_der_kleinsten_Quadrate#Lineare_Modellfunktion
-     * Ansatz: f(x) = a x + b
-     * Data: x_i, y_i for i = 1..n
-     * Idea: Minimize C(a,b) = \sum_i ( a x_i + b - y_i )^2
-     *   C_a = 2 \sum_i x_i ( a x_i + b - y_i ) = 0
-     *   C_b = 2 \sum_i     ( a x_i + b - y_i ) = 0
-     *                  <=>
-     *   a \sum_i x_i^2 + b \sum_i x_i = \sum_i x_i y_i =: sxy
-     *   a \sum_i x_i   + b n          = \sum_i y_i     =: sy
-     *           <=>
-     *   a sxx + b sx = sxy   | * n  |    | * sx  |
-     *   a sx  + b n  = sy    | * sx v-   | * sxx v-
-     *           <=>
-     *   a sx^2 - a n sxx = n sxy - sx sy
-     *   b n sxx - b sx^2 = sy sxx - sxy sx
-     *           <=>
-     *   a = ( n  sxy - sx  sy )/( sx^2  - n sxx )
-     *   b = ( sy sxx - sxy sx )/( n sxx - sx^2  )
-     *     = ( sy - a sx ) / n
-     *  => calculation for b can be seen as average of all offsets per point
-     *     pair with a given slope!
-     * C_min = \sum_i ( a^2 x_i + b^2 + y_i^2 + 2( a b x_i - a x_i y_i - b y_i ) )
-     *       = a^2 sx + n b^2 + syy + 2 a ( b sx - sxy ) - 2 b sy
-     *       = ...
+     * @return sums over the window to be used with fitLine. They are
+     *         centered, i.e. x0 and y0 are the means and sx = sy = 0.
      */
-    double sx, sxx, sxy, sy, syy;    // sums
-    sx = sxx = sxy = sy = syy = 0;
+    inline RegressionSums sums( void ) const
+    {
+        RegressionSums result;
+        result.n   = nValid;
+        result.x0  = meanX;
+        result.y0  = meanY;
+        result.sxx = std::max( 0., cxx );
+        result.syy = std::max( 0., cyy );
+        result.sxy = cxy;
+        return result;
+    }
+
+    /** @return all NaN if there are less than 2 points */
+    inline LineFit fit( void ) const { return fitLine( sums() ); }
+
+    inline void clear( void )
+    {
+        nValid = nRemoved = 0;
+        meanX = meanY = cxx = cyy = cxy = cxxMax = cyyMax = 0;
+        points.clear();
+    }
+};
 
+/**
+ * Fits a line to each trailing window [ i - nWindow + 1, i ] of the points
+ * given by x and y, i.e. the window includes point i and is shorter for the
+ * first nWindow - 1 points.
+ *
+ * @param[out] slopes, offsets, correlations preallocated arrays of length n,
+ *             which may be nullptr if that result isn't needed.
+ */
+template< typename T >
+inline void rollingFitLine
+(
+    T      const * const x,
+    T      const * const y,
+    size_t         const n,
+    size_t         const nWindow,
+    double       * const slopes,
+    double       * const offsets      = nullptr,
+    double       * const correlations = nullptr
+)
+{
+    INSTRUMENT_SCOPE( "rollingFitLine" );
+    INSTRUMENT_COUNT( "rollingFitLine/values", n );
+    RollingLineFit< T > window( nWindow );
     for ( size_t i = 0u; i < n; ++i )
     {
-        auto const & x = rX.at(i);
-        auto const & y = rY.at(i);
-        sx  += x;
-        sxx += x * x;
-        sy  += y;
-        syy += y * y;
-        sxy += x * y;
+        window.push( x[i], y[i] );
+        auto const result = window.fit();
+        if ( slopes       != nullptr ) slopes      [i] = result.slope;
+        if ( offsets      != nullptr ) offsets     [i] = result.offset;
+        if ( correlations != nullptr ) correlations[i] = result.correlation;
     }
+}
 
-    result[0] = (n * sxy - sx * sy) / (n * sxx - sx * sx);   // slope
-    result[1] = (sy * sxx - sx * sxy)/ (n * sxx - sx * sx);  // offset
-    /* https://en.wikipedia.org/wiki/Pearson_correlation_coefficient */
-    result[2] = (n * sxy - sx * sy)/ std::sqrt((n * sxx - sx * sx)*(n * syy - sy * sy)); // correlation
 
-    return result;
+namespace detail {
+
+
+/**
+ * Sums of weighted points shifted like for RegressionSums, i.e.
+ * sw = \sum_i w_i, sx = \sum_i w_i ( x_i - x0 ), sxx = \sum_i w_i ( x_i - x0 )^2, ...
+ */
+template< typename V >
+struct WeightedRegressionAccumulator
+{
+    V sw, sx, sxx, sy, syy, sxy;
+
+    SIMD_ALWAYS_INLINE void add( V const & dx, V const & dy, V const & w )
+    {
+        V const wdx = w * dx;
+        V const wdy = w * dy;
+        sw  += w;
+        sx  += wdx;
+        sxx += wdx * dx;
+        sy  += wdy;
+        syy += wdy * dy;
+        sxy += wdx * dy;
+    }
+
+    SIMD_ALWAYS_INLINE void add( WeightedRegressionAccumulator const & other )
+    {
+        sw += other.sw; sx += other.sx; sxx += other.sxx; sy += other.sy; syy += other.syy; sxy += other.sxy;
+    }
+};
+
+template< typename T >
+inline void weightedRegressionSumsScalar
+(
+    T      const * const x,
+    T      const * const y,
+    T      const * const w,
+    size_t         const iBegin,
+    size_t         const iEnd,
+    double         const x0,
+    double         const y0,
+    double         const lineWeight,
+    WeightedRegressionAccumulator< double > & sums
+)
+{
+    for ( size_t i = iBegin; i < iEnd; ++i )
+        sums.add( double( x[i] ) - x0, double( y[i] ) - y0, lineWeight * w[i] );
+}
+
+#if defined( __GNUC__ )
+
+/* two accumulators for the same reason as in regressionSumsKernel */
+template< std::size_t nBytes >
+SIMD_ALWAYS_INLINE void weightedRegressionSumsKernel
+(
+    double const * const x,
+    double const * const y,
+    double const * const w,
+    size_t         const n,
+    double         const x0,
+    double         const y0,
+    double         const lineWeight,
+    WeightedRegressionAccumulator< double > & result
+)
+{
+    using V = typename Simd::Vector< double, nBytes >::type;
+    auto constexpr nLanes = Simd::Vector< double, nBytes >::nLanes;
+
+    V vx0, vy0, vLineWeight;
+    Simd::broadcast( vx0, x0 );
+    Simd::broadcast( vy0, y0 );
+    Simd::broadcast( vLineWeight, lineWeight );
+    WeightedRegressionAccumulator< V > accumulator0 = {};
+    WeightedRegressionAccumulator< V > accumulator1 = {};
+
+    size_t i = 0u;
+    for ( ; i + 2 * nLanes <= n; i += 2 * nLanes )
+    {
+        V xi, yi, wi;
+        Simd::load( xi, x + i );
+        Simd::load( yi, y + i );
+        Simd::load( wi, w + i );
+        accumulator0.add( V( xi - vx0 ), V( yi - vy0 ), V( vLineWeight * wi ) );
+        Simd::load( xi, x + i + nLanes );
+        Simd::load( yi, y + i + nLanes );
+        Simd::load( wi, w + i + nLanes );
+        accumulator1.add( V( xi - vx0 ), V( yi - vy0 ), V( vLineWeight * wi ) );
+    }
+    accumulator0.add( accumulator1 );
+
+    for ( size_t k = 0u; k < nLanes; ++k )
+    {
+        result.sw  += accumulator0.sw [k];
+        result.sx  += accumulator0.sx [k];
+        result.sxx += accumulator0.sxx[k];
+        result.sy  += accumulator0.sy [k];
+        result.syy += accumulator0.syy[k];
+        result.sxy += accumulator0.sxy[k];
+    }
+    weightedRegressionSumsScalar( x, y, w, i, n, x0, y0, lineWeight, result );
+}
+
+#endif  // __GNUC__
+
+#if SIMD_VECTOR128
+inline void weightedRegressionSums128
+( double const * x, double const * y, double const * w, size_t n, double x0, double y0, double lineWeight, WeightedRegressionAccumulator< double > & result )
+{ weightedRegressionSumsKernel< 16 >( x, y, w, n, x0, y0, lineWeight, result ); }
+#endif
+
+#if SIMD_X86
+SIMD_TARGET_AVX2 inline void weightedRegressionSumsAvx2
+( double const * x, double const * y, double const * w, size_t n, double x0, double y0, double lineWeight, WeightedRegressionAccumulator< double > & result )
+{ weightedRegressionSumsKernel< 32 >( x, y, w, n, x0, y0, lineWeight, result ); }
+
+SIMD_TARGET_AVX512 inline void weightedRegressionSumsAvx512
+( double const * x, double const * y, double const * w, size_t n, double x0, double y0, double lineWeight, WeightedRegressionAccumulator< double > & result )
+{ weightedRegressionSumsKernel< 64 >( x, y, w, n, x0, y0, lineWeight, result ); }
+#endif
+
+/** adds the sums over the n points to result */
+inline void weightedRegressionSums
+(
+    double const * const x,
+    double const * const y,
+    double const * const w,
+    size_t         const n,
+    double         const x0,
+    double         const y0,
+    double         const lineWeight,
+    WeightedRegressionAccumulator< double > & result,
+    Simd::InstructionSet const instructionSet
+)
+{
+    switch ( instructionSet )
+    {
+    #if SIMD_X86
+        case Simd::InstructionSet::Avx512:
+            if ( n >= 128 )
+            {
+                weightedRegressionSumsAvx512( x, y, w, n, x0, y0, lineWeight, result );
+                return;
+            }
+            /* fall through */
+        case Simd::InstructionSet::Avx2:
+            weightedRegressionSumsAvx2( x, y, w, n, x0, y0, lineWeight, result );
+            return;
+    #endif
+    #if SIMD_VECTOR128
+        case Simd::InstructionSet::Sse2:
+        case Simd::InstructionSet::Neon:
+            weightedRegressionSums128( x, y, w, n, x0, y0, lineWeight, result );
+            return;
+    #endif
+        default:
+            weightedRegressionSumsScalar( x, y, w, 0, n, x0, y0, lineWeight, result );
+    }
+}
+
+template< typename T >
+inline void weightedRegressionSums
+(
+    T      const * const x,
+    T      const * const y,
+    T      const * const w,
+    size_t         const n,
+    double         const x0,
+    double         const y0,
+    double         const lineWeight,
+    WeightedRegressionAccumulator< double > & result,
+    Simd::InstructionSet
+)
+{
+    weightedRegressionSumsScalar( x, y, w, 0, n, x0, y0, lineWeight, result );
 }
 
 
 /**
- * Will fit parallel lines. I.e. fitting multiple lines with the constraint
- * that the slope of all lines is to be equal
- *
- * If x and y data length for one line do not match, then the shortest length
- * will be chosen. One or more line data sets being effectively zero length
- * is allowed. Only if there is no effective data for any line will there be
- * no fitting done.
- *
- * @todo allow weights for each data per line and for each line as a whole, i.e.
- *       in respect to the other lines. Maybe do that in another function as it
- *       affects performance quite a bit
- *
- * @param[in] rX a "list" of x data sets for each line. The argument uses
- *            a vector of const references to vectors, so specifying the
- *            same x data set for each line isn't a performance problem, it
- *            won't be copied n times
- * @param[in] rY a vector of y data set vectors. One vector for each line
- * @return vector containing in this order: slope offset1 offset2 offset3 ...
- *         offset_n correlation
+ * Sums for fitParallelLines in structure-of-arrays layout with one element
+ * per chunk of a line, so that chunks can be summed up in parallel without
+ * false sharing of a shared accumulator and the reduction per line is a
+ * pass over contiguous arrays.
+ */
+struct ParallelLineSums
+{
+    std::vector< size_t > iLine;
+    std::vector< double > sw, sx, sxx, sy, syy, sxy;
+
+    inline void resize( size_t const n )
+    {
+        iLine.resize( n );
+        for ( auto sums : { &sw, &sx, &sxx, &sy, &syy, &sxy } )
+            sums->assign( n, 0 );
+    }
+};
+
+/**
+ * @param[in] w weights per point for each line or empty for all weights 1
+ * @param[in] weightsPerLine empty or one weight per line
+ * @see the wrappers Fundamental::fitParallelLines for the result
  */
 template< typename T >
-inline
-std::vector< double > fitParallelLines
+inline std::vector< double > fitParallelLines
 (
-    std::vector< std::vector< T > * > const & rX,
-    std::vector< std::vector< T > * > const & rY
+    std::vector< T const * > const & x,
+    std::vector< T const * > const & y,
+    std::vector< T const * > const & w,
+    std::vector< size_t    > const & n,
+    std::vector< T         > const & weightsPerLine,
+    ThreadPool                     & pool
 )
 {
     /**
      * Ansatz: f_j(x) = a x + b_j for j = 1..m the index for each separate
      *                                         but parallel line
-     * Data: x_j_i, y_j_i for i = 1..n_j and j = 1..m
-     * Idea: Minimize C(a,b_0,..,b_m) = \sum_j \sum_i ( a x_j_i + b_j - y_j_i )^2
+     * Data: x_j_i, y_j_i with weights w_j_i for i = 1..n_j and j = 1..m,
+     *       which already include the weight per line
+     * Idea: Minimize C(a,b_0,..,b_m) = \sum_j \sum_i w_j_i ( a x_j_i + b_j - y_j_i )^2
      * This gives an m-d linear equation system:
-     *   C_a   = 2 \sum_j \sum_i ( a x_j_i + b_j - y_j_i ) x_j_i = 0
-     *   C_b_j = 2        \sum_i ( a x_j_i + b_j - y_j_i )       = 0
+     *   C_a   = 2 \sum_j \sum_i w_j_i ( a x_j_i + b_j - y_j_i ) x_j_i = 0
+     *   C_b_j = 2        \sum_i w_j_i ( a x_j_i + b_j - y_j_i )       = 0
      *     -> all sums with wrong b_k (with k!=j) derivate to 0!
+     * Some shorthands: \sum_i w_j_i =: swj, \sum_i w_j_i x_j_i =: sxj,
+     * similar for syj, sxxj, sxyj and ssxx := \sum_j sxxj, ssxy likewise
      *                  <=>
-     *   a ssxx         + \sum_j b_j \sum_i x_j_i = ssxy            (1)
-     *   a \sum_i x_j_i + n_j b_j                 = \sum_i y_j_i    (2_j)
-     * Some shorthands: \sum_i x_j_i =: sxj, similar for syj
+     *   a ssxx + \sum_j b_j sxj = ssxy            (1)
+     *   a sxj  + swj b_j        = syj             (2_j)
      * Eliminate b_j by:
-     *   (1) - \sum_j (2_j) / n_j \sum_i x_j_i  == (1) - \sum_j (2_j) / n_j sxj
+     *   (1) - \sum_j (2_j) / swj sxj
      *                  <=>
-     *   a ( ssxx - \sum_j sxj^2 / n_j ) = ssxy - \sum_j syj sxj / n_j
-     * => a = ( ssxy - \sum_j syj sxj / n_j )/( ssxx - \sum_j sxj^2 / n_j )
-     * Now that we have the slope the offset should only depend on the data
-     * per line without interdependency. And exactly that can be observed in
-     * (2_j), i.e. knowing a we can simply solve for b_j:
-     *    b_j = ( syj - a sxj ) / n_j
-     *
-     * C_min = \sum_j \sum_i ( a^2 x_j_i^2 + b_j^2 + y_j_i^2  +
-     *                         2 a x_j_i b_j - 2 a x_j_i y_j_i - 2 b_j y_j_i )
-     * C_min = a^2 ssx + n_j sbb + ssyy + 2a ( \sum_j b_j sxj - ssxy )
-     *       - 2 \sum_j b_j syj
+     *   a ( ssxx - \sum_j sxj^2 / swj ) = ssxy - \sum_j syj sxj / swj
+     * => a = ( ssxy - \sum_j syj sxj / swj )/( ssxx - \sum_j sxj^2 / swj )
+     *      = \sum_j cxyj / \sum_j cxxj
+     * with cxyj := sxyj - sxj syj / swj, i.e. the sum of products of the
+     * deviations from the weighted means per line, which is calculated
+     * from sums shifted by the first point of each line for the same
+     * reason as in fitLine. Now that we have the slope the offset should
+     * only depend on the data per line without interdependency. And exactly
+     * that can be observed in (2_j), i.e. knowing a we can simply solve for b_j:
+     *    b_j = ( syj - a sxj ) / swj
+     * The correlation is the one of the deviations of all points from the
+     * means of their line: \sum_j cxyj / sqrt( \sum_j cxxj \sum_j cyyj )
      */
-
-    size_t const nLines = std::min( rX.size(), rY.size() );
+    auto const nLines = n.size();
     if ( nLines < 1u )
         return {};
+    if ( not weightsPerLine.empty() && weightsPerLine.size() != nLines )
+        throw std::invalid_argument( "[fitParallelLines] there must be no or one weight per line!" );
+    INSTRUMENT_SCOPE( "fitParallelLines" );
 
-    auto const nan = std::numeric_limits< double >::quiet_NaN();
-    std::vector< double > result( 1 + nLines + 1, nan );
-
-    std::vector< double > sx ( nLines, 0 );
-    std::vector< double > sy ( nLines, 0 );
-    std::vector< double > sxy( nLines, 0 );
-    std::vector< double > sxx( nLines, 0 );
-    std::vector< double > syy( nLines, 0 );
-    double ssxx = 0, ssxy = 0;
-    //double ssx = 0, ssy = 0, ssyy = 0;
-    double sumSxjSquared = 0;
-    double sumSxjSyj     = 0;
+    /* split long lines into chunks, so that also few long lines are summed up in parallel */
+    size_t constexpr nValuesPerChunk = 16384;
+    std::vector< size_t > iChunkBegin( nLines + 1, 0 );
+    size_t nValues = 0;
+    for ( size_t j = 0u; j < nLines; ++j )
+    {
+        iChunkBegin[j+1] = iChunkBegin[j] + ( n[j] + nValuesPerChunk - 1 ) / nValuesPerChunk;
+        nValues += n[j];
+    }
+    auto const nChunks = iChunkBegin[ nLines ];
 
+    ParallelLineSums chunkSums;
+    chunkSums.resize( nChunks );
     for ( size_t j = 0u; j < nLines; ++j )
+        std::fill( chunkSums.iLine.begin() + iChunkBegin[j], chunkSums.iLine.begin() + iChunkBegin[j+1], j );
+
+    auto const instructionSet = Simd::instructionSet();
+    auto const sumChunk = [&] ( size_t const iChunk, unsigned int )
     {
-        auto const nValuesPerLine = std::min( rX.at(j)->size(), rY.at(j)->size() );
-        for ( size_t i = 0u; i < nValuesPerLine; ++i )
+        auto const j = chunkSums.iLine[ iChunk ];
+        auto const iBegin = ( iChunk - iChunkBegin[j] ) * nValuesPerChunk;
+        auto const nValuesInChunk = std::min( nValuesPerChunk, n[j] - iBegin );
+        double const x0 = x[j][0];
+        double const y0 = y[j][0];
+        double const lineWeight = weightsPerLine.empty() ? 1 : weightsPerLine[j];
+
+        WeightedRegressionAccumulator< double > sums = {};
+        if ( w.empty() )
         {
-            auto const & x = rX.at(j)->at(i);
-            auto const & y = rY.at(j)->at(i);
-            sx .at(j) += x;
-            sy .at(j) += y;
-            sxy.at(j) += x*y;
-            sxx.at(j) += x*x;
-            syy.at(j) += y*y;
+            RegressionSums unweighted;
+            unweighted.x0 = x0;
+            unweighted.y0 = y0;
+            regressionSums< false >( x[j] + iBegin, y[j] + iBegin, nValuesInChunk, unweighted, instructionSet );
+            sums.sw  = lineWeight * nValuesInChunk;
+            sums.sx  = lineWeight * unweighted.sx ;
+            sums.sxx = lineWeight * unweighted.sxx;
+            sums.sy  = lineWeight * unweighted.sy ;
+            sums.syy = lineWeight * unweighted.syy;
+            sums.sxy = lineWeight * unweighted.sxy;
         }
-        //ssx  += sx .at(j);
-        //ssy  += sy .at(j);
-        ssxy += sxy.at(j);
-        ssxx += sxx.at(j);
-        //ssyy += syy.at(j);
-        sumSxjSquared += sx[j] * sx[j] / nValuesPerLine;
-        sumSxjSyj     += sx[j] * sy[j] / nValuesPerLine;
-    }
-    // ( ssxy - \sum_j syj sxj / n_j )/( ssxx - \sum_j sxj^2 / n_j )
-    result[0] = ( ssxy - sumSxjSyj )/( ssxx - sumSxjSquared );
-
-    /* Calculate offsets: b_j = ( syj - a sxj ) / n_j */
+        else
+            weightedRegressionSums( x[j] + iBegin, y[j] + iBegin, w[j] + iBegin, nValuesInChunk,
+                                    x0, y0, lineWeight, sums, instructionSet );
+
+        chunkSums.sw [ iChunk ] = sums.sw ;
+        chunkSums.sx [ iChunk ] = sums.sx ;
+        chunkSums.sxx[ iChunk ] = sums.sxx;
+        chunkSums.sy [ iChunk ] = sums.sy ;
+        chunkSums.syy[ iChunk ] = sums.syy;
+        chunkSums.sxy[ iChunk ] = sums.sxy;
+    };
+    /* waking up the pool takes a few microseconds */
+    if ( nValues < 4 * nValuesPerChunk )
+    {
+        for ( size_t iChunk = 0u; iChunk < nChunks; ++iChunk )
+            sumChunk( iChunk, 0 );
+    }
+    else
+        pool.parallelFor( nChunks, sumChunk );
+
+    /* reduce in a fixed order, so that the result doesn't depend on the number of threads */
+    ParallelLineSums lineSums;
+    lineSums.resize( nLines );
+    for ( size_t iChunk = 0u; iChunk < nChunks; ++iChunk )
+    {
+        auto const j = chunkSums.iLine[ iChunk ];
+        lineSums.sw [j] += chunkSums.sw [ iChunk ];
+        lineSums.sx [j] += chunkSums.sx [ iChunk ];
+        lineSums.sxx[j] += chunkSums.sxx[ iChunk ];
+        lineSums.sy [j] += chunkSums.sy [ iChunk ];
+        lineSums.syy[j] += chunkSums.syy[ iChunk ];
+        lineSums.sxy[j] += chunkSums.sxy[ iChunk ];
+    }
+
+    double cxx = 0, cyy = 0, cxy = 0;
     for ( size_t j = 0u; j < nLines; ++j )
     {
-        auto const nValuesPerLine = std::min( rX.at(j)->size(), rY.at(j)->size() );
-        result.at(1+j) = ( sy[j] - result[0] * sx[j] ) / nValuesPerLine;
+        /* lines without data or with zero weight don't contribute */
+        if ( not ( lineSums.sw[j] > 0 ) )
+            continue;
+        cxx += lineSums.sxx[j] - lineSums.sx[j] * lineSums.sx[j] / lineSums.sw[j];
+        cyy += lineSums.syy[j] - lineSums.sy[j] * lineSums.sy[j] / lineSums.sw[j];
+        cxy += lineSums.sxy[j] - lineSums.sx[j] * lineSums.sy[j] / lineSums.sw[j];
     }
 
+    auto const nan = std::numeric_limits< double >::quiet_NaN();
+    std::vector< double > result( 1 + nLines + 1, nan );
+    auto const slope = cxy / cxx;
+    result[0] = slope;
+    /* Calculate offsets: b_j = ( syj - a sxj ) / swj, shifted back like in fitLine */
+    for ( size_t j = 0u; j < nLines; ++j )
+    {
+        if ( lineSums.sw[j] > 0 )
+            result[ 1 + j ] = ( lineSums.sy[j] - slope * lineSums.sx[j] ) / lineSums.sw[j] + y[j][0] - slope * x[j][0];
+    }
+    result[ 1 + nLines ] = cxy / std::sqrt( cxx * cyy );
+
     return result;
 }
 
 
+} // namespace detail
+
+
+/**
+ * Will fit parallel lines. I.e. fitting multiple lines with the constraint
+ * that the slope of all lines is to be equal
+ *
+ * If x and y data length for one line do not match, then the shortest length
+ * will be chosen. One or more line data sets being effectively zero length
+ * is allowed, their offsets will be NaN. Only if there is no effective data
+ * for any line will there be no fitting done.
+ *
+ * The sums per line are calculated in parallel on pool, also for chunks of
+ * long lines, if there are enough points for that to pay off. Called from a
+ * task of pool, they are calculated on the calling thread, see
+ * ThreadPool::parallelFor.
+ *
+ * @param[in] rX a "list" of x data sets for each line. The argument uses
+ *            a vector of const references to vectors, so specifying the
+ *            same x data set for each line isn't a performance problem, it
+ *            won't be copied n times
+ * @param[in] rY a vector of y data set vectors. One vector for each line
+ * @return vector containing in this order: slope offset1 offset2 offset3 ...
+ *         offset_n correlation
+ */
+template< typename T >
+inline
+std::vector< double > fitParallelLines
+(
+    std::vector< std::vector< T > * > const & rX,
+    std::vector< std::vector< T > * > const & rY,
+    ThreadPool                              & pool = defaultThreadPool()
+)
+{
+    size_t const nLines = std::min( rX.size(), rY.size() );
+    std::vector< T const * > x( nLines ), y( nLines );
+    std::vector< size_t > n( nLines );
+    for ( size_t j = 0u; j < nLines; ++j )
+    {
+        x[j] = rX[j]->data();
+        y[j] = rY[j]->data();
+        n[j] = std::min( rX[j]->size(), rY[j]->size() );
+    }
+    return detail::fitParallelLines< T >( x, y, {}, n, {}, pool );
+}
+
+
 /**
+ * Same as fitParallelLines without weights, but minimizes the sum of the
+ * squared residuals times rWeightsPerLine[j] * rW[j][i].
+ *
  * missing weights are handled like missing x or y data. I.e. the minimum
  * length vector of x,y and w will be used
  * Note that weight per line is just a user-feature and basically redundant,
  * as it can just be applied to each data weights.
+ *
+ * @param[in] rWeightsPerLine empty for all lines having the same weight
+ *            or one weight per line
  */
 template< typename T >
 inline
@@ -200,12 +1004,308 @@ std::vector< double > fitParallelLines
     std::vector< std::reference_wrapper< std::vector< T > > > const & rX,
     std::vector< std::reference_wrapper< std::vector< T > > > const & rY,
     std::vector< std::reference_wrapper< std::vector< T > > > const & rW,
-    std::vector< T > const & rWeightsPerLine = {}
+    std::vector< T > const & rWeightsPerLine = {},
+    ThreadPool             & pool = defaultThreadPool()
 )
 {
-    return {};
+    size_t const nLines = std::min( rX.size(), std::min( rY.size(), rW.size() ) );
+    std::vector< T const * > x( nLines ), y( nLines ), w( nLines );
+    std::vector< size_t > n( nLines );
+    for ( size_t j = 0u; j < nLines; ++j )
+    {
+        x[j] = rX[j].get().data();
+        y[j] = rY[j].get().data();
+        w[j] = rW[j].get().data();
+        n[j] = std::min( rX[j].get().size(), std::min( rY[j].get().size(), rW[j].get().size() ) );
+    }
+    return detail::fitParallelLines< T >( x, y, w, n, rWeightsPerLine, pool );
 }
 
 
-
 } // namespace Fundamental
+
+
+#ifdef MAIN_TEST_LINEARREGRESSION
+
+
+#include <cstdlib>                      // rand
+#include <iostream>
+
+
+/* fitLine with long double two-pass sums */
+inline Fundamental::LineFit fitLineReference( std::vector< double > const & x, std::vector< double > const & y )
+{
+    long double mx = 0, my = 0;
+    for ( size_t i = 0u; i < x.size(); ++i )
+    {
+        mx += x[i];
+        my += y[i];
+    }
+    mx /= x.size();
+    my /= y.size();
+
+    long double sxx = 0, syy = 0, sxy = 0;
+    for ( size_t i = 0u; i < x.size(); ++i )
+    {
+        sxx += ( x[i] - mx ) * ( x[i] - mx );
+        syy += ( y[i] - my ) * ( y[i] - my );
+        sxy += ( x[i] - mx ) * ( y[i] - my );
+    }
+    Fundamental::LineFit result;
+    result.slope       = sxy / sxx;
+    result.offset      = my - sxy / sxx * mx;
+    result.correlation = sxy / std::sqrt( sxx * syy );
+    return result;
+}
+
+bool testFitLine
+(
+    char const * const name,
+    std::vector< double > const & x,
+    std::vector< double > const & y,
+    double const tolerance,
+    Fundamental::Summation const summation,
+    Simd::InstructionSet const instructionSet
+)
+{
+    auto const expected = fitLineReference( x, y );
+    auto const result = Fundamental::fitLine( x.data(), y.data(), x.size(), summation, instructionSet );
+    auto const relErr = [] ( double const a, double const b ) { return std::abs( a - b ) / std::max( std::abs( a ), std::abs( b ) ); };
+    bool const success = relErr( result.slope      , expected.slope       ) < tolerance &&
+                         relErr( result.offset     , expected.offset      ) < tolerance &&
+                         relErr( result.correlation, expected.correlation ) < tolerance;
+    std::cout << "fitLine for " << name << " with " << Simd::toString( instructionSet )
+              << ( summation == Fundamental::Summation::Compensated ? " compensated" : "" )
+              << ( success ? " OK" : " FAILED" ) << "\n";
+    return success;
+}
+
+int main()
+{
+    using Fundamental::Summation;
+
+    std::vector< Simd::InstructionSet > instructionSets = { Simd::InstructionSet::Scalar };
+    #if SIMD_VECTOR128
+        instructionSets.push_back( Simd::detectInstructionSet() == Simd::InstructionSet::Neon
+                                   ? Simd::InstructionSet::Neon : Simd::InstructionSet::Sse2 );
+    #endif
+    #if SIMD_X86
+        if ( Simd::instructionSet() == Simd::InstructionSet::Avx2 ||
+             Simd::instructionSet() == Simd::InstructionSet::Avx512 )
+            instructionSets.push_back( Simd::InstructionSet::Avx2 );
+        if ( Simd::instructionSet() == Simd::InstructionSet::Avx512 )
+            instructionSets.push_back( Simd::InstructionSet::Avx512 );
+    #endif
+
+    /* odd length to also test the remainder loops */
+    std::vector< double > x( 100003 ), y( x.size() ), xTime( x.size() ), yPrice( x.size() );
+    for ( size_t i = 0u; i < x.size(); ++i )
+    {
+        x[i] = std::rand() / double( RAND_MAX );
+        y[i] = 3 * x[i] - 2 + std::rand() / double( RAND_MAX );
+        /* unix timestamps of minute bars and prices, for which the
+         * unshifted sums of the old fitLine lost ~8 significant digits */
+        xTime [i] = 1.5e9 + 60. * i;
+        yPrice[i] = 1e4 + 1e-6 * xTime[i] + std::rand() / double( RAND_MAX );
+    }
+
+    for ( auto const instructionSet : instructionSets )
+    {
+        for ( auto const summation : { Summation::Plain, Summation::Compensated } )
+        {
+            testFitLine( "random points", x, y, 1e-10, summation, instructionSet );
+            testFitLine( "prices over time", xTime, yPrice, 1e-8, summation, instructionSet );
+        }
+    }
+
+    /* other types and the old interface */
+    std::vector< float > xf( x.begin(), x.begin() + 1000 ), yf( y.begin(), y.begin() + 1000 );
+    auto const resultFloat = Fundamental::fitLine( xf, yf );
+    std::cout << "fitLine for floats " << ( resultFloat.size() == 3 && std::abs( resultFloat[0] - 3 ) < 0.1 ? "OK" : "FAILED" ) << "\n";
+
+    /* rolling fits against fitLine on each window */
+    for ( auto const & data : { std::make_pair( &x, &y ), std::make_pair( &xTime, &yPrice ) } )
+    {
+        auto xs = std::vector< double >( data.first->begin(), data.first->begin() + 3000 );
+        auto ys = std::vector< double >( data.second->begin(), data.second->begin() + 3000 );
+        for ( size_t i = 0u; i < ys.size(); i += 1 + std::rand() % 50 )
+            ys[i] = std::nan( "" );
+        /* a jump to test that the small variance after it is kept accurate */
+        for ( size_t i = 2000u; i < ys.size(); ++i )
+            ys[i] += 1e6;
+
+        bool success = true;
+        for ( size_t nWindow : { size_t( 2 ), size_t( 10 ), size_t( 500 ), size_t( 5000 ) } )
+        {
+            std::vector< double > slopes( xs.size() ), offsets( xs.size() ), correlations( xs.size() );
+            Fundamental::rollingFitLine( xs.data(), ys.data(), xs.size(), nWindow,
+                                         slopes.data(), offsets.data(), correlations.data() );
+            for ( size_t i = 0u; i < xs.size(); ++i )
+            {
+                std::vector< double > xWindow, yWindow;
+                for ( size_t j = i + 1 - std::min( i + 1, nWindow ); j <= i; ++j )
+                {
+                    if ( not std::isnan( ys[j] ) )
+                    {
+                        xWindow.push_back( xs[j] );
+                        yWindow.push_back( ys[j] );
+                    }
+                }
+                if ( xWindow.size() < 3 )
+                {
+                    success &= xWindow.size() == 2 || std::isnan( slopes[i] );
+                    continue;
+                }
+                /* for windows with almost no correlation the slope is ill-conditioned,
+                 * so measure the errors in units of the spread of the points */
+                auto const expected = fitLineReference( xWindow, yWindow );
+                auto const mean = [] ( std::vector< double > const & v ) { double sum = 0; for ( auto const e : v ) sum += e; return sum / v.size(); };
+                auto const spread = [&mean] ( std::vector< double > const & v ) { double sum = 0; auto const m = mean( v ); for ( auto const e : v ) sum += ( e - m ) * ( e - m ); return std::sqrt( sum / v.size() ); };
+                auto const slopeScale = spread( yWindow ) / spread( xWindow );
+                auto const offsetScale = slopeScale * ( std::abs( mean( xWindow ) ) + spread( xWindow ) );
+                success &= std::abs( slopes      [i] - expected.slope       ) < 1e-7 * slopeScale;
+                success &= std::abs( offsets     [i] - expected.offset      ) < 1e-7 * offsetScale;
+                success &= std::abs( correlations[i] - expected.correlation ) < 1e-7;
+            }
+        }
+        std::cout << "rollingFitLine " << ( success ? "OK" : "FAILED" ) << "\n";
+    }
+
+    /* parallel lines, e.g. one per session, over shared timestamps and of
+     * different lengths, so that some are split into several chunks */
+    {
+        std::vector< std::vector< double > > xs, ys, ws;
+        size_t const nLines = 300;
+        for ( size_t j = 0u; j < nLines; ++j )
+        {
+            size_t const n = j == 7 ? 0 : j % 50 == 0 ? 40000 + std::rand() % 1000 : std::rand() % 500;
+            auto const offset = 100. * std::rand() / RAND_MAX;
+            xs.emplace_back( n );
+            ys.emplace_back( n );
+            ws.emplace_back( n );
+            for ( size_t i = 0u; i < n; ++i )
+            {
+                xs[j][i] = xTime[i];
+                ys[j][i] = 1e-3 * xs[j][i] + offset + std::rand() / double( RAND_MAX );
+                ws[j][i] = 1 + std::rand() % 3;
+            }
+        }
+        std::vector< double > weightsPerLine( nLines );
+        for ( auto & weight : weightsPerLine )
+            weight = 1 + std::rand() % 4;
+        weightsPerLine[3] = 0;
+
+        /* long double two-pass reference */
+        auto const reference = [&] ( bool const weighted )
+        {
+            long double cxx = 0, cyy = 0, cxy = 0;
+            std::vector< long double > mx( nLines, 0 ), my( nLines, 0 );
+            for ( size_t j = 0u; j < nLines; ++j )
+            {
+                long double sw = 0;
+                for ( size_t i = 0u; i < xs[j].size(); ++i )
+                {
+                    auto const w = weighted ? weightsPerLine[j] * ws[j][i] : 1;
+                    sw += w;
+                    mx[j] += w * xs[j][i];
+                    my[j] += w * ys[j][i];
+                }
+                mx[j] /= sw;
+                my[j] /= sw;
+                if ( not ( sw > 0 ) )
+                    continue;
+                for ( size_t i = 0u; i < xs[j].size(); ++i )
+                {
+                    auto const w = weighted ? weightsPerLine[j] * ws[j][i] : 1;
+                    cxx += w * ( xs[j][i] - mx[j] ) * ( xs[j][i] - mx[j] );
+                    cyy += w * ( ys[j][i] - my[j] ) * ( ys[j][i] - my[j] );
+                    cxy += w * ( xs[j][i] - mx[j] ) * ( ys[j][i] - my[j] );
+                }
+            }
+            std::vector< double > result( 1 + nLines + 1 );
+            result[0] = cxy / cxx;
+            for ( size_t j = 0u; j < nLines; ++j )
+                result[ 1 + j ] = my[j] - cxy / cxx * mx[j];
+            result[ 1 + nLines ] = cxy / std::sqrt( cxx * cyy );
+            return result;
+        };
+
+        /* the offsets are extrapolated from x ~ 1.5e9 to 0, so compare them in units of slope * x */
+        auto const matches = [&] ( std::vector< double > const & result, std::vector< double > const & expected )
+        {
+            bool success = result.size() == expected.size();
+            for ( size_t k = 0u; success && k < result.size(); ++k )
+            {
+                auto const isOffset = k > 0 && k + 1 < result.size();
+                auto const scale = isOffset ? std::abs( expected[0] * xTime[0] ) : std::abs( expected[k] );
+                success &= std::isnan( expected[k] ) ? std::isnan( result[k] ) :
+                           std::abs( result[k] - expected[k] ) <= 1e-12 * scale;
+            }
+            return success;
+        };
+
+        std::vector< std::vector< double > * > pX, pY;
+        std::vector< std::reference_wrapper< std::vector< double > > > rX, rY, rW;
+        for ( size_t j = 0u; j < nLines; ++j )
+        {
+            pX.push_back( &xs[j] );
+            pY.push_back( &ys[j] );
+            rX.push_back( xs[j] );
+            rY.push_back( ys[j] );
+            rW.push_back( ws[j] );
+        }
+
+        auto const expectedWeighted = reference( true );
+        for ( unsigned int nThreads : { 1u, 4u } )
+        {
+            Fundamental::ThreadPool pool( nThreads );
+            auto const unweighted = Fundamental::fitParallelLines( pX, pY, pool );
+            auto const weighted = Fundamental::fitParallelLines( rX, rY, rW, weightsPerLine, pool );
+            std::cout << "fitParallelLines with " << nThreads << " threads "
+                      << ( matches( unweighted, reference( false ) ) ? "OK" : "FAILED" ) << "\n";
+            std::cout << "weighted fitParallelLines with " << nThreads << " threads "
+                      << ( matches( weighted, expectedWeighted ) ? "OK" : "FAILED" ) << "\n";
+        }
+
+        /* a pool, e.g. the default one, used from one of its own tasks must not deadlock */
+        Fundamental::ThreadPool pool( 4 );
+        std::vector< std::vector< double > > nested( 4 );
+        pool.parallelFor( nested.size(), [&] ( size_t const k, unsigned int )
+        {
+            nested[k] = Fundamental::fitParallelLines( pX, pY, pool );
+        } );
+        bool nestedMatches = true;
+        for ( auto const & result : nested )
+            nestedMatches &= matches( result, reference( false ) );
+        std::cout << "fitParallelLines called from a pool task " << ( nestedMatches ? "OK" : "FAILED" ) << "\n";
+
+        /* integer weights are the same as repeated points */
+        std::vector< std::vector< double > > xsRepeated( nLines ), ysRepeated( nLines );
+        std::vector< std::reference_wrapper< std::vector< double > > > rXRepeated, rYRepeated, rWOnes;
+        std::vector< std::vector< double > > ones( nLines );
+        for ( size_t j = 0u; j < nLines; ++j )
+        {
+            for ( size_t i = 0u; i < xs[j].size(); ++i )
+            {
+                for ( int k = 0; k < ws[j][i]; ++k )
+                {
+                    xsRepeated[j].push_back( xs[j][i] );
+                    ysRepeated[j].push_back( ys[j][i] );
+                }
+            }
+            ones[j].assign( xsRepeated[j].size(), 1 );
+            rXRepeated.push_back( xsRepeated[j] );
+            rYRepeated.push_back( ysRepeated[j] );
+            rWOnes.push_back( ones[j] );
+        }
+        std::cout << "weighted fitParallelLines with repeated points "
+                  << ( matches( Fundamental::fitParallelLines( rX, rY, rW ),
+                                Fundamental::fitParallelLines( rXRepeated, rYRepeated, rWOnes ) ) ? "OK" : "FAILED" ) << "\n";
+    }
+
+    std::cout << "fitLine for 1 point " << ( std::isnan( Fundamental::fitLine( x.data(), y.data(), 1 ).slope ) ? "OK" : "FAILED" ) << "\n";
+}
+
+
+#endif
+
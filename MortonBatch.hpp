@@ -0,0 +1,382 @@
+/*
+g++ -x c++ -Wall -Wextra -O3 -std=c++11 MortonBatch.hpp -DMAIN_TEST_MORTONBATCH && ./a.out
+*/
+#pragma once
+
+#include <array>
+#include <cstddef>                      // size_t
+
+#include "BitsCompileTime.hpp"
+#include "SimdDispatch.hpp"
+
+
+namespace BitFunctions {
+
+
+/**
+ * The same shift and mask cascades as DiluteBitsCrumble and
+ * CompactBitsCrumble, but working in-place on all lanes of a vector type V
+ * with lanes of type T. Masks are truncated to T, because RectangularWave
+ * may be longer than T, which for scalars is done implicitly.
+ */
+template< typename T, unsigned char nSpacing, unsigned char nStepsNeeded, unsigned char iStep >
+struct DiluteBitsCrumbleLanes { template< typename V > SIMD_ALWAYS_INLINE static void apply( V & x )
+{
+    DiluteBitsCrumbleLanes<T,nSpacing,nStepsNeeded,iStep-1>::apply( x );
+    auto constexpr iStep2Pow = 1llu << ( (nStepsNeeded-1) - iStep );
+    x = ( x | ( x << ( iStep2Pow * nSpacing ) ) )
+        & T( BitPatterns::RectangularWave< T, iStep2Pow, iStep2Pow * nSpacing >::value );
+} };
+
+template< typename T, unsigned char nSpacing, unsigned char nStepsNeeded >
+struct DiluteBitsCrumbleLanes<T,nSpacing,nStepsNeeded,0> { template< typename V > SIMD_ALWAYS_INLINE static void apply( V & x )
+{
+    auto constexpr nBitsAllowed = 1 + ( sizeof(T) * CHAR_BIT - 1 ) / ( nSpacing + 1 );
+    x &= BitPatterns::Ones< T, nBitsAllowed >::value;
+} };
+
+template< typename T, unsigned char nSpacing, unsigned char iStep >
+struct CompactBitsCrumbleLanes { template< typename V > SIMD_ALWAYS_INLINE static void apply( V & x )
+{
+    CompactBitsCrumbleLanes<T,nSpacing,iStep-1>::apply( x );
+    auto constexpr iStep2Pow = 1llu << ( iStep - 1 );
+    x = ( x | ( x >> ( iStep2Pow * nSpacing ) ) )
+        & T( BitPatterns::RectangularWave< T, 2 * iStep2Pow, 2 * iStep2Pow * nSpacing >::value );
+} };
+
+template< typename T, unsigned char nSpacing >
+struct CompactBitsCrumbleLanes<T,nSpacing,0> { template< typename V > SIMD_ALWAYS_INLINE static void apply( V & x )
+{
+    x &= T( BitPatterns::RectangularWave< T, 1, nSpacing >::value );
+} };
+
+/* The number of steps is calculated like in diluteBitsCascade */
+template< typename T, unsigned char nSpacing >
+struct DilutionLanes
+{
+    static auto constexpr nBitsAllowed = CompileTimeFunctions::ceilDiv( sizeof(T) * CHAR_BIT, nSpacing + 1 );
+    static auto constexpr nShifts      = CompileTimeFunctions::CeilLog< 2, nBitsAllowed >::value;
+
+    template< typename V > SIMD_ALWAYS_INLINE static void dilute( V & x )
+    {
+        DiluteBitsCrumbleLanes< T, nSpacing, nShifts + 1, nShifts >::apply( x );
+    }
+
+    template< typename V > SIMD_ALWAYS_INLINE static void compact( V & x )
+    {
+        CompactBitsCrumbleLanes< T, nSpacing, nShifts >::apply( x );
+    }
+};
+
+template< typename T >
+struct DilutionLanes<T,0>
+{
+    template< typename V > SIMD_ALWAYS_INLINE static void dilute ( V & ){}
+    template< typename V > SIMD_ALWAYS_INLINE static void compact( V & ){}
+};
+
+
+namespace detail {
+
+
+template< typename T, std::size_t D >
+inline void mortonEncodeBatchScalar
+(
+    std::array< T const *, D > const & coordinates,
+    T                        * const   keys,
+    std::size_t                const   iBegin,
+    std::size_t                const   iEnd
+)
+{
+    for ( std::size_t i = iBegin; i < iEnd; ++i )
+    {
+        std::array< T, D > x;
+        for ( std::size_t k = 0u; k < D; ++k )
+            x[k] = coordinates[k][i] & MortonBits< T, D >::coordinateMask;
+        keys[i] = mortonEncode< T >( x );
+    }
+}
+
+template< typename T, std::size_t D >
+inline void mortonDecodeBatchScalar
+(
+    T                  const * const   keys,
+    std::array< T *, D >       const & coordinates,
+    std::size_t                const   iBegin,
+    std::size_t                const   iEnd
+)
+{
+    for ( std::size_t i = iBegin; i < iEnd; ++i )
+    {
+        auto const x = mortonDecode< T, D >( keys[i] );
+        for ( std::size_t k = 0u; k < D; ++k )
+            coordinates[k][i] = x[k];
+    }
+}
+
+
+#if defined( __GNUC__ )
+
+template< typename T, std::size_t D, std::size_t nBytes >
+SIMD_ALWAYS_INLINE void mortonEncodeBatchKernel
+(
+    std::array< T const *, D > const & coordinates,
+    T                        * const   keys,
+    std::size_t                const   n
+)
+{
+    using V = typename Simd::Vector< T, nBytes >::type;
+    auto constexpr nLanes = Simd::Vector< T, nBytes >::nLanes;
+    auto constexpr mask = MortonBits< T, D >::coordinateMask;
+
+    std::size_t i = 0u;
+    for ( ; i + nLanes <= n; i += nLanes )
+    {
+        V key = {};
+        for ( std::size_t k = 0u; k < D; ++k )
+        {
+            V x;
+            Simd::load( x, coordinates[k] + i );
+            x &= mask;
+            DilutionLanes< T, D-1 >::dilute( x );
+            key |= x << k;
+        }
+        Simd::store( keys + i, key );
+    }
+    mortonEncodeBatchScalar< T, D >( coordinates, keys, i, n );
+}
+
+template< typename T, std::size_t D, std::size_t nBytes >
+SIMD_ALWAYS_INLINE void mortonDecodeBatchKernel
+(
+    T                  const * const   keys,
+    std::array< T *, D >       const & coordinates,
+    std::size_t                const   n
+)
+{
+    using V = typename Simd::Vector< T, nBytes >::type;
+    auto constexpr nLanes = Simd::Vector< T, nBytes >::nLanes;
+    auto constexpr mask = MortonBits< T, D >::coordinateMask;
+
+    std::size_t i = 0u;
+    for ( ; i + nLanes <= n; i += nLanes )
+    {
+        V key;
+        Simd::load( key, keys + i );
+        for ( std::size_t k = 0u; k < D; ++k )
+        {
+            V x = key >> k;
+            DilutionLanes< T, D-1 >::compact( x );
+            x &= mask;
+            Simd::store( coordinates[k] + i, x );
+        }
+    }
+    mortonDecodeBatchScalar< T, D >( keys, coordinates, i, n );
+}
+
+#endif  // __GNUC__
+
+
+#if SIMD_VECTOR128
+template< typename T, std::size_t D >
+void mortonEncodeBatch128( std::array< T const *, D > const & coordinates, T * const keys, std::size_t const n )
+{ mortonEncodeBatchKernel< T, D, 16 >( coordinates, keys, n ); }
+
+template< typename T, std::size_t D >
+void mortonDecodeBatch128( T const * const keys, std::array< T *, D > const & coordinates, std::size_t const n )
+{ mortonDecodeBatchKernel< T, D, 16 >( keys, coordinates, n ); }
+#endif
+
+#if SIMD_X86
+template< typename T, std::size_t D >
+SIMD_TARGET_AVX2 void mortonEncodeBatchAvx2( std::array< T const *, D > const & coordinates, T * const keys, std::size_t const n )
+{ mortonEncodeBatchKernel< T, D, 32 >( coordinates, keys, n ); }
+
+template< typename T, std::size_t D >
+SIMD_TARGET_AVX2 void mortonDecodeBatchAvx2( T const * const keys, std::array< T *, D > const & coordinates, std::size_t const n )
+{ mortonDecodeBatchKernel< T, D, 32 >( keys, coordinates, n ); }
+
+template< typename T, std::size_t D >
+SIMD_TARGET_AVX512 void mortonEncodeBatchAvx512( std::array< T const *, D > const & coordinates, T * const keys, std::size_t const n )
+{ mortonEncodeBatchKernel< T, D, 64 >( coordinates, keys, n ); }
+
+template< typename T, std::size_t D >
+SIMD_TARGET_AVX512 void mortonDecodeBatchAvx512( T const * const keys, std::array< T *, D > const & coordinates, std::size_t const n )
+{ mortonDecodeBatchKernel< T, D, 64 >( keys, coordinates, n ); }
+#endif
+
+
+} // namespace detail
+
+
+/**
+ * Calculates keys[i] = mortonEncode< T >( { coordinates[0][i], ...,
+ * coordinates[D-1][i] } ) for all i < n using the widest SIMD instruction set
+ * supported by the CPU.
+ *
+ * Note that unlike mortonEncode, coordinates which are too large are
+ * silently truncated to MortonBits< T, D >::nBitsPerCoordinate, the same
+ * for all instruction sets including the scalar remainder.
+ *
+ * @param[in] coordinates D arrays of length n
+ * @param[out] keys preallocated array of length n
+ * @param[in] instructionSet can be used to force a kernel, e.g. for tests.
+ *            Must be supported by the CPU!
+ */
+template< typename T, std::size_t D >
+inline void mortonEncodeBatch
+(
+    std::array< T const *, D > const & coordinates,
+    T                        * const   keys,
+    std::size_t                const   n,
+    Simd::InstructionSet       const   instructionSet = Simd::instructionSet()
+)
+{
+    switch ( instructionSet )
+    {
+    #if SIMD_X86
+        case Simd::InstructionSet::Avx512:
+            detail::mortonEncodeBatchAvx512< T, D >( coordinates, keys, n );
+            return;
+        case Simd::InstructionSet::Avx2:
+            detail::mortonEncodeBatchAvx2< T, D >( coordinates, keys, n );
+            return;
+    #endif
+    #if SIMD_VECTOR128
+        case Simd::InstructionSet::Sse2:
+        case Simd::InstructionSet::Neon:
+            detail::mortonEncodeBatch128< T, D >( coordinates, keys, n );
+            return;
+    #endif
+        default:
+            detail::mortonEncodeBatchScalar< T, D >( coordinates, keys, 0, n );
+    }
+}
+
+/**
+ * Inverse of mortonEncodeBatch
+ *
+ * @param[out] coordinates D preallocated arrays of length n
+ */
+template< typename T, std::size_t D >
+inline void mortonDecodeBatch
+(
+    T                  const * const   keys,
+    std::array< T *, D >       const & coordinates,
+    std::size_t                const   n,
+    Simd::InstructionSet       const   instructionSet = Simd::instructionSet()
+)
+{
+    switch ( instructionSet )
+    {
+    #if SIMD_X86
+        case Simd::InstructionSet::Avx512:
+            detail::mortonDecodeBatchAvx512< T, D >( keys, coordinates, n );
+            return;
+        case Simd::InstructionSet::Avx2:
+            detail::mortonDecodeBatchAvx2< T, D >( keys, coordinates, n );
+            return;
+    #endif
+    #if SIMD_VECTOR128
+        case Simd::InstructionSet::Sse2:
+        case Simd::InstructionSet::Neon:
+            detail::mortonDecodeBatch128< T, D >( keys, coordinates, n );
+            return;
+    #endif
+        default:
+            detail::mortonDecodeBatchScalar< T, D >( keys, coordinates, 0, n );
+    }
+}
+
+
+} // namespace BitFunctions
+
+
+
+#ifdef MAIN_TEST_MORTONBATCH
+
+
+#include <cstdint>
+#include <cstdlib>                      // rand
+#include <iostream>
+#include <vector>
+
+
+template< typename T, std::size_t D >
+bool testMortonBatch( Simd::InstructionSet const instructionSet )
+{
+    /* odd length to also test the scalar remainder */
+    std::size_t const n = 1001;
+    std::vector< std::vector< T > > x( D, std::vector< T >( n ) );
+    std::vector< std::vector< T > > y( D, std::vector< T >( n ) );
+    std::array< T const *, D > px;
+    std::array< T       *, D > py;
+    for ( std::size_t k = 0u; k < D; ++k )
+    {
+        for ( auto & coordinate : x[k] )
+            coordinate = T( T( std::rand() ) * T( 2654435761u ) ) & BitFunctions::MortonBits< T, D >::coordinateMask;
+        px[k] = x[k].data();
+        py[k] = y[k].data();
+    }
+
+    std::vector< T > keys( n );
+    BitFunctions::mortonEncodeBatch< T, D >( px, keys.data(), n, instructionSet );
+    BitFunctions::mortonDecodeBatch< T, D >( keys.data(), py, n, instructionSet );
+
+    bool success = x == y;
+    for ( std::size_t i = 0u; i < n; ++i )
+    {
+        std::array< T, D > coordinates;
+        for ( std::size_t k = 0u; k < D; ++k )
+            coordinates[k] = x[k][i];
+        success &= keys[i] == BitFunctions::mortonEncode< T >( coordinates );
+    }
+
+    /* bits above the mask must be ignored, also by the scalar remainder */
+    for ( std::size_t k = 0u; k < D; ++k )
+        for ( auto & coordinate : x[k] )
+            coordinate |= T( ~BitFunctions::MortonBits< T, D >::coordinateMask );
+    std::vector< T > keysTruncated( n );
+    BitFunctions::mortonEncodeBatch< T, D >( px, keysTruncated.data(), n, instructionSet );
+    success &= keysTruncated == keys;
+
+    std::cout << D << "D batch Morton keys with " << sizeof(T) * CHAR_BIT << " bits using "
+              << Simd::toString( instructionSet ) << ( success ? " OK" : " FAILED" ) << "\n";
+    return success;
+}
+
+template< typename T >
+void testMortonBatches( Simd::InstructionSet const instructionSet )
+{
+    testMortonBatch< T, 1 >( instructionSet );
+    testMortonBatch< T, 2 >( instructionSet );
+    testMortonBatch< T, 3 >( instructionSet );
+    testMortonBatch< T, 4 >( instructionSet );
+}
+
+int main()
+{
+    std::cout << "Detected instruction set: " << Simd::toString( Simd::instructionSet() ) << "\n";
+
+    std::vector< Simd::InstructionSet > instructionSets = { Simd::InstructionSet::Scalar };
+    #if SIMD_VECTOR128
+        instructionSets.push_back( Simd::detectInstructionSet() == Simd::InstructionSet::Neon
+                                   ? Simd::InstructionSet::Neon : Simd::InstructionSet::Sse2 );
+    #endif
+    #if SIMD_X86
+        if ( Simd::instructionSet() == Simd::InstructionSet::Avx2 ||
+             Simd::instructionSet() == Simd::InstructionSet::Avx512 )
+            instructionSets.push_back( Simd::InstructionSet::Avx2 );
+        if ( Simd::instructionSet() == Simd::InstructionSet::Avx512 )
+            instructionSets.push_back( Simd::InstructionSet::Avx512 );
+    #endif
+
+    for ( auto const instructionSet : instructionSets )
+    {
+        testMortonBatches< uint32_t >( instructionSet );
+        testMortonBatches< uint64_t >( instructionSet );
+    }
+}
+
+
+#endif
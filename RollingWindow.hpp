@@ -0,0 +1,607 @@
+#pragma once
+
+/**
+ * Building blocks for statistics over sliding windows of a time series which
+ * cost O(1) per value instead of O(window length). The exception are the
+ * RollingQuantiles, which need a partially sorted window.
+ */
+
+#include <algorithm>                    // min, max, lower_bound, upper_bound, move_backward
+#include <cassert>
+#include <cmath>                        // sqrt
+#include <cstddef>                      // size_t
+#include <functional>                   // less, greater
+#include <limits>
+#include <stdexcept>
+#include <type_traits>                  // common_type
+#include <utility>                      // move
+#include <vector>
+
+
+namespace Fundamental {
+
+
+/**
+ * Minimum and maximum which ignore NaN in the second argument like the
+ * !( x >= y ) comparisons in normalizeTimeSeries. Written as ternaries so that
+ * for floating point types they map to single minsd/maxsd instructions.
+ */
+template< typename T > inline T minIgnoringNaN( T const & a, T const & b ) { return b < a ? b : a; }
+template< typename T > inline T maxIgnoringNaN( T const & a, T const & b ) { return b > a ? b : a; }
+
+/**
+ * Neutral elements of minIgnoringNaN and maxIgnoringNaN, i.e. the minimum
+ * and maximum of an empty set or a set of only NaNs. For types without
+ * infinity these are the largest and lowest representable values.
+ */
+template< typename T > inline T emptyMin( void )
+{
+    return std::numeric_limits< T >::has_infinity ? std::numeric_limits< T >::infinity()
+                                                  : std::numeric_limits< T >::max();
+}
+template< typename T > inline T emptyMax( void )
+{
+    return std::numeric_limits< T >::has_infinity ? -std::numeric_limits< T >::infinity()
+                                                  : std::numeric_limits< T >::lowest();
+}
+
+
+/**
+ * Calls functor( iBegin, min, max ) with the NaN-ignoring minimum and
+ * maximum of each window x[iBegin, iBegin + nWindow) which lies completely
+ * inside x, in order of increasing iBegin.
+ *
+ * Uses the van Herk/Gil-Werman algorithm: x is split into blocks of length
+ * nWindow. Each window spans at most two blocks, i.e. it is a suffix of one
+ * block and a prefix of the next, so the extrema are combinations of block
+ * suffix and block prefix extrema. This needs 3 comparisons per value, no
+ * matter how long the window is and, unlike a monotonic deque, no data
+ * dependent branches.
+ * @see M. van Herk, "A fast algorithm for local minimum and maximum filters
+ *      on rectangular and octagonal kernels", 1992
+ * @see J. Gil, M. Werman, "Computing 2-D min, median, and max filters", 1993
+ */
+template< typename T, typename T_Functor >
+inline void forEachWindowMinMax
+(
+    T         const *  const x,
+    size_t             const n,
+    size_t             const nWindow,
+    T_Functor      &&        functor,
+    std::vector< T >  &      suffixMin,  /**< scratch memory, only grows */
+    std::vector< T >  &      suffixMax   /**< scratch memory, only grows */
+)
+{
+    if ( nWindow == 0 )
+        throw std::invalid_argument( "[forEachWindowMinMax] window length must be > 0!" );
+    if ( n < nWindow )
+        return;
+
+    /* suffix extrema of each block */
+    if ( suffixMin.size() < n )
+    {
+        suffixMin.resize( n );
+        suffixMax.resize( n );
+    }
+    for ( size_t iBlock = 0u; iBlock < n; iBlock += nWindow )
+    {
+        auto curMin = emptyMin< T >();
+        auto curMax = emptyMax< T >();
+        for ( size_t i = std::min( n, iBlock + nWindow ); i > iBlock; --i )
+        {
+            curMin = minIgnoringNaN( curMin, x[ i - 1 ] );
+            curMax = maxIgnoringNaN( curMax, x[ i - 1 ] );
+            suffixMin[ i - 1 ] = curMin;
+            suffixMax[ i - 1 ] = curMax;
+        }
+    }
+
+    /* the prefix extrema up to the last element of each window are computed on the fly */
+    auto prefixMin = emptyMin< T >();
+    auto prefixMax = emptyMax< T >();
+    size_t nLeftInBlock = 0;      /* instead of a slow iLast % nWindow */
+    for ( size_t iLast = 0u; iLast < n; ++iLast )
+    {
+        if ( nLeftInBlock == 0 )
+        {
+            prefixMin = emptyMin< T >();
+            prefixMax = emptyMax< T >();
+            nLeftInBlock = nWindow;
+        }
+        --nLeftInBlock;
+        prefixMin = minIgnoringNaN( prefixMin, x[ iLast ] );
+        prefixMax = maxIgnoringNaN( prefixMax, x[ iLast ] );
+
+        if ( iLast + 1 < nWindow )
+            continue;
+        auto const iBegin = iLast + 1 - nWindow;
+        functor( iBegin, minIgnoringNaN( suffixMin[ iBegin ], prefixMin ),
+                         maxIgnoringNaN( suffixMax[ iBegin ], prefixMax ) );
+    }
+}
+
+template< typename T, typename T_Functor >
+inline void forEachWindowMinMax
+(
+    T         const * const x,
+    size_t            const n,
+    size_t            const nWindow,
+    T_Functor      &&       functor
+)
+{
+    std::vector< T > suffixMin, suffixMax;
+    forEachWindowMinMax( x, n, nWindow, functor, suffixMin, suffixMax );
+}
+
+
+/**
+ * FIFO queue which also allows removing from the back, i.e. a deque, stored
+ * in one contiguous ring buffer. The capacity is always a power of two, so
+ * that wrapping around is a bit mask, and is doubled when it runs full, so
+ * e.g. windows of std::numeric_limits< size_t >::max() only allocate as
+ * much as actually is pushed.
+ */
+template< typename T >
+class RingBuffer
+{
+private:
+    std::vector< T > data  ;
+    size_t           iFront;
+    size_t           n     ;
+
+public:
+    inline explicit RingBuffer( size_t const nMinCapacity = 16 )
+    : iFront( 0 ), n( 0 )
+    {
+        size_t capacity = 1;
+        while ( capacity < nMinCapacity )
+            capacity *= 2;
+        data.resize( capacity );
+    }
+
+    inline size_t size    ( void ) const { return n; }
+    inline bool   empty   ( void ) const { return n == 0; }
+    inline size_t capacity( void ) const { return data.size(); }
+
+    /** @param[in] i 0 is the front, i.e. oldest element */
+    inline T       & operator[]( size_t const i )       { assert( i < n ); return data[ ( iFront + i ) & ( data.size() - 1 ) ]; }
+    inline T const & operator[]( size_t const i ) const { assert( i < n ); return data[ ( iFront + i ) & ( data.size() - 1 ) ]; }
+
+    inline T       & front( void )       { return (*this)[0]; }
+    inline T const & front( void ) const { return (*this)[0]; }
+    inline T       & back ( void )       { return (*this)[ n - 1 ]; }
+    inline T const & back ( void ) const { return (*this)[ n - 1 ]; }
+
+    inline void pushBack( T value )
+    {
+        if ( n == data.size() )
+            grow();
+        data[ ( iFront + n ) & ( data.size() - 1 ) ] = std::move( value );
+        ++n;
+    }
+
+    inline void popFront( void )
+    {
+        assert( n > 0 );
+        iFront = ( iFront + 1 ) & ( data.size() - 1 );
+        --n;
+    }
+
+    inline void popBack( void )
+    {
+        assert( n > 0 );
+        --n;
+    }
+
+    inline void clear( void )
+    {
+        iFront = 0;
+        n      = 0;
+    }
+
+private:
+    inline void grow( void )
+    {
+        std::vector< T > newData( 2 * data.size() );
+        for ( size_t i = 0u; i < n; ++i )
+            newData[i] = std::move( (*this)[i] );
+        data.swap( newData );
+        iFront = 0;
+    }
+};
+
+
+/**
+ * Keeps those of the pushed values which still can become the extremum of
+ * a window sliding to the right, together with their indexes.
+ *
+ * Before pushing a new value all values at the back which are not better
+ * than it are removed, because they will leave the window before the new
+ * value does. The values are therefore strictly ordered and the front is the
+ * extremum. Each value is pushed and popped at most once, which makes this
+ * amortized O(1) per value.
+ * @see D. Lemire, "Streaming Maximum-Minimum Filter Using No More than Three
+ *      Comparisons per Element", 2006, https://arxiv.org/abs/cs/0610046
+ *
+ * @tparam T_Better std::greater for maxima, std::less for minima. Values
+ *         for which it returns false in both directions, e.g. NaN, must
+ *         not be pushed.
+ */
+template< typename T, typename T_Better >
+class MonotonicDeque
+{
+private:
+    struct Element
+    {
+        size_t index;
+        T      value;
+    };
+
+    RingBuffer< Element > elements;
+    T_Better              better  ;
+
+public:
+    inline explicit MonotonicDeque( size_t const nMinCapacity = 16 )
+    : elements( nMinCapacity )
+    {}
+
+    inline void push( size_t const index, T const & value )
+    {
+        while ( not elements.empty() && not better( elements.back().value, value ) )
+            elements.popBack();
+        elements.pushBack( Element{ index, value } );
+    }
+
+    /** removes all values with index < iFirst */
+    inline void expire( size_t const iFirst )
+    {
+        while ( not elements.empty() && elements.front().index < iFirst )
+            elements.popFront();
+    }
+
+    inline bool     empty     ( void ) const { return elements.empty(); }
+    inline size_t   size      ( void ) const { return elements.size(); }
+    inline T const& front     ( void ) const { return elements.front().value; }
+    inline size_t   frontIndex( void ) const { return elements.front().index; }
+    inline void     clear     ( void )       { elements.clear(); }
+};
+
+
+/**
+ * Minimum and maximum over the last nWindow pushed values for data arriving
+ * one value at a time. For data which is available completely,
+ * forEachWindowMinMax is faster, because the loops popping from the deques
+ * are badly predictable branches.
+ *
+ * NaN values are ignored like in minIgnoringNaN, but still take up their
+ * place in the window. If there are no other values in the window, min()
+ * and max() return emptyMin() and emptyMax().
+ */
+template< typename T >
+class RollingMinMax
+{
+private:
+    size_t                                      nWindow;
+    size_t                                      nPushed;
+    MonotonicDeque< T, std::less   < T > >      minima ;
+    MonotonicDeque< T, std::greater< T > >      maxima ;
+
+public:
+    inline explicit RollingMinMax( size_t const rnWindow )
+    : nWindow( rnWindow ),
+      nPushed( 0 ),
+      minima( std::min( rnWindow, size_t( 1024 ) ) ),
+      maxima( std::min( rnWindow, size_t( 1024 ) ) )
+    {
+        if ( rnWindow == 0 )
+            throw std::invalid_argument( "[RollingMinMax] window length must be > 0!" );
+    }
+
+    inline void push( T const & value )
+    {
+        auto const i = nPushed++;
+        if ( i >= nWindow )
+        {
+            minima.expire( i - nWindow + 1 );
+            maxima.expire( i - nWindow + 1 );
+        }
+        if ( not ( value == value ) )   /* NaN */
+            return;
+        minima.push( i, value );
+        maxima.push( i, value );
+    }
+
+    inline T min( void ) const
+    {
+        return minima.empty() ? emptyMin< T >() : minima.front();
+    }
+
+    inline T max( void ) const
+    {
+        return maxima.empty() ? emptyMax< T >() : maxima.front();
+    }
+
+    /** number of values currently in the window including NaNs */
+    inline size_t size  ( void ) const { return std::min( nPushed, nWindow ); }
+    inline size_t window( void ) const { return nWindow; }
+
+    inline void clear( void )
+    {
+        nPushed = 0;
+        minima.clear();
+        maxima.clear();
+    }
+};
+
+
+/**
+ * Mean and variance of the last nWindow pushed values with O(1) updates.
+ *
+ * Uses Welford's algorithm extended by removal of the value leaving the
+ * window, i.e. it updates the mean and the sum of squared deviations from
+ * the mean directly. The textbook ( sum x^2 - ( sum x )^2 / n ) / ( n - 1 )
+ * subtracts two large and nearly equal numbers, which for e.g. prices
+ * around 1e4 with changes of 1e-2 loses almost all significant digits.
+ * @see B. P. Welford, "Note on a method for calculating corrected sums of
+ *      squares and products", Technometrics 4(3), 1962
+ * @see T. Finch, "Incremental calculation of weighted mean and variance", 2009
+ *
+ * Removals let rounding errors accumulate without bound, so the moments are
+ * recalculated from the stored window after every nWindow removals, which
+ * still is amortized O(1).
+ *
+ * NaN values are ignored, but still take up their place in the window, like
+ * in RollingMinMax, i.e. count() may be less than the window length.
+ */
+template< typename T >
+class RollingMoments
+{
+public:
+    using Float = typename std::common_type< T, double >::type;
+
+private:
+    size_t          nWindow      ;
+    size_t          nValid       ;  /**< number of non-NaN values in window */
+    size_t          nRemoved     ;  /**< since the last recalculation */
+    Float           curMean      ;
+    Float           curSumSquares;  /**< sum of squared deviations from mean */
+    RingBuffer< T > values       ;  /**< needed to know what to remove */
+
+    inline void add( Float const x )
+    {
+        ++nValid;
+        auto const delta = x - curMean;
+        curMean       += delta / nValid;
+        curSumSquares += delta * ( x - curMean );
+    }
+
+    inline void remove( Float const x )
+    {
+        assert( nValid > 0 );
+        --nValid;
+        if ( nValid == 0 )
+        {
+            curMean       = 0;
+            curSumSquares = 0;
+            return;
+        }
+        auto const delta = x - curMean;
+        curMean       -= delta / nValid;
+        curSumSquares -= delta * ( x - curMean );
+    }
+
+    /* two-pass calculation over the window */
+    inline void recalculate( void )
+    {
+        nRemoved      = 0;
+        nValid        = 0;
+        curMean       = 0;
+        curSumSquares = 0;
+        for ( size_t i = 0u; i < values.size(); ++i )
+        {
+            if ( values[i] == values[i] )
+            {
+                curMean += values[i];
+                ++nValid;
+            }
+        }
+        if ( nValid == 0 )
+            return;
+        curMean /= nValid;
+        for ( size_t i = 0u; i < values.size(); ++i )
+        {
+            if ( values[i] == values[i] )
+                curSumSquares += ( values[i] - curMean ) * ( values[i] - curMean );
+        }
+    }
+
+    /* with a full window, removing and adding in one step saves a division */
+    inline void replace( Float const xOld, Float const xNew )
+    {
+        auto const delta   = xNew - xOld;
+        auto const oldMean = curMean;
+        curMean       += delta / nValid;
+        curSumSquares += delta * ( ( xNew - curMean ) + ( xOld - oldMean ) );
+    }
+
+public:
+    inline explicit RollingMoments( size_t const rnWindow )
+    : nWindow( rnWindow ),
+      nValid( 0 ),
+      nRemoved( 0 ),
+      curMean( 0 ),
+      curSumSquares( 0 ),
+      values( std::min( rnWindow, size_t( 1024 ) ) )
+    {
+        if ( rnWindow == 0 )
+            throw std::invalid_argument( "[RollingMoments] window length must be > 0!" );
+    }
+
+    inline void push( T const & value )
+    {
+        bool const isValid = value == value;
+        if ( values.size() == nWindow )
+        {
+            auto const oldValue = values.front();
+            values.popFront();
+            if ( oldValue == oldValue )
+            {
+                values.pushBack( value );
+                if ( ++nRemoved >= nWindow )
+                    recalculate();
+                else if ( isValid )
+                    replace( oldValue, value );
+                else
+                    remove( oldValue );
+                return;
+            }
+        }
+        values.pushBack( value );
+        if ( isValid )
+            add( value );
+    }
+
+    /** number of non-NaN values in the window */
+    inline size_t count( void ) const { return nValid; }
+    /** number of values in the window including NaNs */
+    inline size_t size ( void ) const { return values.size(); }
+
+    /** @return NaN if there are no values */
+    inline Float mean( void ) const
+    {
+        return nValid == 0 ? std::numeric_limits< Float >::quiet_NaN() : curMean;
+    }
+
+    /**
+     * Unbiased sample variance, i.e. divided by count() - 1
+     * @return NaN if there are less than 2 values
+     */
+    inline Float variance( void ) const
+    {
+        if ( nValid < 2 )
+            return std::numeric_limits< Float >::quiet_NaN();
+        /* rounding errors may lead to slightly negative values for constant data */
+        return std::max( Float( 0 ), curSumSquares / ( nValid - 1 ) );
+    }
+
+    inline Float stddev( void ) const { return std::sqrt( variance() ); }
+
+    inline void clear( void )
+    {
+        nValid        = 0;
+        nRemoved      = 0;
+        curMean       = 0;
+        curSumSquares = 0;
+        values.clear();
+    }
+};
+
+
+/**
+ * Quantiles of the last nWindow pushed values, e.g. the median and the
+ * quartiles for a robust normalization.
+ *
+ * Keeps the non-NaN values of the window in a sorted vector. When a value
+ * leaves the window, only the values between it and the new value in the
+ * sorted order are shifted, so a push costs O(log nWindow) for the search
+ * plus a memmove of the distance between both. For time series this
+ * distance usually is small, but it still is O(nWindow) in the worst case,
+ * so this is meant for windows of up to a few thousand values rather than
+ * for an unbounded history.
+ *
+ * NaN values are ignored, but still take up their place in the window, like
+ * in RollingMinMax.
+ */
+template< typename T >
+class RollingQuantiles
+{
+private:
+    size_t           nWindow;
+    RingBuffer< T >  values ;  /**< needed to know what to remove */
+    std::vector< T > sorted ;  /**< non-NaN values of the window */
+
+    /* replaces sorted[iOld] by value and shifts the values in between */
+    inline void replace( size_t const iOld, T const & value )
+    {
+        auto const old = sorted.begin() + iOld;
+        if ( value < *old )
+        {
+            auto const target = std::upper_bound( sorted.begin(), old, value );
+            std::move_backward( target, old, old + 1 );
+            *target = value;
+        }
+        else
+        {
+            auto const target = std::lower_bound( old + 1, sorted.end(), value );
+            std::move( old + 1, target, old );
+            *( target - 1 ) = value;
+        }
+    }
+
+public:
+    inline explicit RollingQuantiles( size_t const rnWindow )
+    : nWindow( rnWindow ),
+      values( std::min( rnWindow, size_t( 1024 ) ) )
+    {
+        if ( rnWindow == 0 )
+            throw std::invalid_argument( "[RollingQuantiles] window length must be > 0!" );
+        sorted.reserve( std::min( rnWindow, size_t( 1024 ) ) );
+    }
+
+    inline void push( T const & value )
+    {
+        bool const isValid = value == value;
+        if ( values.size() == nWindow )
+        {
+            auto const oldValue = values.front();
+            values.popFront();
+            if ( oldValue == oldValue )
+            {
+                auto const iOld = std::lower_bound( sorted.begin(), sorted.end(), oldValue ) - sorted.begin();
+                if ( isValid )
+                {
+                    values.pushBack( value );
+                    replace( iOld, value );
+                    return;
+                }
+                sorted.erase( sorted.begin() + iOld );
+            }
+        }
+        values.pushBack( value );
+        if ( isValid )
+            sorted.insert( std::upper_bound( sorted.begin(), sorted.end(), value ), value );
+    }
+
+    /** number of non-NaN values in the window */
+    inline size_t count( void ) const { return sorted.size(); }
+    /** number of values in the window including NaNs */
+    inline size_t size ( void ) const { return values.size(); }
+
+    /**
+     * Linearly interpolates between the closest ranks, i.e. the default of
+     * numpy.quantile and R type 7.
+     * @param[in] p in [0,1], 0.5 is the median
+     * @return NaN if there are no values
+     */
+    inline T quantile( double const p ) const
+    {
+        if ( sorted.empty() )
+            return std::numeric_limits< T >::quiet_NaN();
+        auto const rank = p * ( sorted.size() - 1 );
+        auto const i    = std::min( static_cast< size_t >( rank ), sorted.size() - 1 );
+        if ( i + 1 >= sorted.size() )
+            return sorted[i];
+        return sorted[i] + ( rank - i ) * ( sorted[ i + 1 ] - sorted[i] );
+    }
+
+    inline T median( void ) const { return quantile( 0.5 ); }
+
+    inline void clear( void )
+    {
+        values.clear();
+        sorted.clear();
+    }
+};
+
+
+} // namespace Fundamental
@@ -0,0 +1,135 @@
+#pragma once
+
+/**
+ * Helpers for writing SIMD kernels once and selecting the best one at runtime.
+ *
+ * Kernels are written as always-inline templates using GCC vector extensions
+ * (see Simd::Vector) with the vector width as template parameter. They are
+ * then instantiated inside functions with different target attributes, e.g.
+ *
+ *   template< std::size_t nBytes >
+ *   SIMD_ALWAYS_INLINE void kernel( double const * x, size_t n ) { ... }
+ *   SIMD_TARGET_AVX2 void kernelAvx2( double const * x, size_t n ) { kernel< 32 >( x, n ); }
+ *
+ * so that the compiler generates AVX2 code only for that function, while the
+ * rest of the program still runs on CPUs without AVX2.
+ * Vectors should not be passed or returned by value between functions with
+ * different targets, else GCC warns about ABI changes (-Wpsabi), that's why
+ * all helpers take references.
+ */
+
+#include <cstddef>                      // size_t
+#include <cstring>                      // memcpy
+
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#   define SIMD_X86 1
+#   define SIMD_TARGET_AVX2   __attribute__(( target( "avx2" ) ))
+#   define SIMD_TARGET_AVX512 __attribute__(( target( "avx512f" ) ))
+#else
+#   define SIMD_X86 0
+#endif
+
+#if defined( __GNUC__ ) && ( defined( __SSE2__ ) || defined( __ARM_NEON ) )
+    /* 16 Byte vectors are part of the base instruction set */
+#   define SIMD_VECTOR128 1
+#else
+#   define SIMD_VECTOR128 0
+#endif
+
+#if defined( __GNUC__ )
+#   define SIMD_ALWAYS_INLINE inline __attribute__(( always_inline ))
+#else
+#   define SIMD_ALWAYS_INLINE inline
+#endif
+
+
+namespace Simd {
+
+
+enum class InstructionSet { Scalar, Sse2, Neon, Avx2, Avx512 };
+
+/**
+ * Returns the widest supported instruction set for which kernels are
+ * written, i.e. it doesn't test for everything like SSE4 or AVX.
+ */
+inline InstructionSet detectInstructionSet( void )
+{
+#if SIMD_X86
+    __builtin_cpu_init();
+    if ( __builtin_cpu_supports( "avx512f" ) )
+        return InstructionSet::Avx512;
+    if ( __builtin_cpu_supports( "avx2" ) )
+        return InstructionSet::Avx2;
+#endif
+#if SIMD_VECTOR128 && defined( __ARM_NEON )
+    return InstructionSet::Neon;
+#elif SIMD_VECTOR128
+    return InstructionSet::Sse2;
+#else
+    return InstructionSet::Scalar;
+#endif
+}
+
+/**
+ * Cached version of detectInstructionSet to be used for dispatching
+ */
+inline InstructionSet instructionSet( void )
+{
+    static auto const result = detectInstructionSet();
+    return result;
+}
+
+inline char const * toString( InstructionSet const instructionSet )
+{
+    switch ( instructionSet )
+    {
+        case InstructionSet::Scalar: return "Scalar";
+        case InstructionSet::Sse2  : return "SSE2"  ;
+        case InstructionSet::Neon  : return "NEON"  ;
+        case InstructionSet::Avx2  : return "AVX2"  ;
+        case InstructionSet::Avx512: return "AVX512";
+    }
+    return "Unknown";
+}
+
+
+#if defined( __GNUC__ )
+
+/**
+ * GCC vector extension type with nBytes / sizeof(T) lanes of type T.
+ * Supports elementwise arithmetic, bit operations, shifts by scalars,
+ * comparisons (returning lane masks) and ?: for blending.
+ */
+template< typename T, std::size_t nBytes >
+struct Vector
+{
+    typedef T type __attribute__(( vector_size( nBytes ) ));
+    static std::size_t constexpr nLanes = nBytes / sizeof( T );
+};
+
+/** unaligned load */
+template< typename V, typename T >
+SIMD_ALWAYS_INLINE void load( V & v, T const * const p )
+{
+    std::memcpy( &v, p, sizeof( V ) );
+}
+
+/** unaligned store */
+template< typename V, typename T >
+SIMD_ALWAYS_INLINE void store( T * const p, V const & v )
+{
+    std::memcpy( p, &v, sizeof( V ) );
+}
+
+/** sets all lanes to x */
+template< typename V, typename T >
+SIMD_ALWAYS_INLINE void broadcast( V & v, T const x )
+{
+    v = V{} + x;
+}
+
+#endif  // __GNUC__
+
+
+} // namespace Simd
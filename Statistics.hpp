@@ -0,0 +1,532 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 Statistics.hpp -DMAIN_TEST_STATISTICS -pthread && ./a.out
+*/
+#pragma once
+
+/**
+ * Count, mean, variance, minimum and maximum of an array in one pass over
+ * the data without copying it, ignoring NaN like RollingMoments.
+ *
+ * The array is split into chunks, for which the sums of the values and of
+ * their squares shifted by the first value of the chunk are computed with
+ * SIMD instructions and Kahan summation, i.e. the variance doesn't suffer
+ * from the cancellation of <x^2> - <x>^2 for data far from 0, e.g. prices or
+ * timestamps. The chunks are then merged pairwise like in Welford's
+ * algorithm, in a fixed order, so that the result doesn't depend on whether
+ * and with how many threads the chunks were processed.
+ * @see T. F. Chan, G. H. Golub, R. J. LeVeque, "Updating Formulae and a
+ *      Pairwise Algorithm for Computing Sample Variances", 1979
+ */
+
+#include <algorithm>                    // min, max
+#include <cmath>                        // sqrt
+#include <cstddef>                      // size_t
+#include <limits>
+#include <type_traits>                  // conditional, is_floating_point
+#include <vector>
+
+#include "SimdDispatch.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace Fundamental {
+
+
+template< typename Float >
+struct Statistics
+{
+    size_t count;       /**< number of non-NaN values */
+    Float  mean;        /**< NaN if count is 0 */
+    Float  sumSquares;  /**< of the deviations from the mean */
+    Float  min;         /**< infinity if count is 0 */
+    Float  max;         /**< -infinity if count is 0 */
+
+    inline static Statistics empty( void )
+    {
+        return Statistics{ 0, std::numeric_limits< Float >::quiet_NaN(), 0,
+                           std::numeric_limits< Float >::infinity(), -std::numeric_limits< Float >::infinity() };
+    }
+
+    /**
+     * Unbiased sample variance, i.e. divided by count - 1 like stddev
+     * @return NaN if there are less than 2 values
+     */
+    inline Float variance( void ) const
+    {
+        return count < 2 ? std::numeric_limits< Float >::quiet_NaN() : sumSquares / Float( count - 1 );
+    }
+
+    inline Float stddev( void ) const { return std::sqrt( variance() ); }
+
+    /** combines the statistics of two disjoint data sets, e.g. batches of a stream */
+    inline void merge( Statistics const & other )
+    {
+        if ( other.count == 0 )
+            return;
+        if ( count == 0 )
+        {
+            *this = other;
+            return;
+        }
+        auto const n     = Float( count + other.count );
+        auto const delta = other.mean - mean;
+        mean       += delta * ( Float( other.count ) / n );
+        sumSquares += other.sumSquares + delta * delta * ( Float( count ) * Float( other.count ) / n );
+        count      += other.count;
+        min = std::min( min, other.min );
+        max = std::max( max, other.max );
+    }
+};
+
+/** integers are summed up as doubles */
+template< typename T >
+using StatisticsFloat = typename std::conditional< std::is_floating_point< T >::value, T, double >::type;
+
+
+namespace detail {
+
+
+/**
+ * Sums of the valid values shifted by a common value with Kahan
+ * compensation, which works for V being a float type or a SIMD vector of it.
+ * @see RegressionAccumulator
+ */
+template< typename V >
+struct MomentsAccumulator
+{
+    V count, sum, sumSquares, min, max;
+    V cSum, cSumSquares;  /**< compensations, i.e. lost low order bits */
+
+    SIMD_ALWAYS_INLINE void init( V const & infinity )
+    {
+        count = sum = sumSquares = cSum = cSumSquares = V{};
+        min = infinity;
+        max = -infinity;
+    }
+
+    SIMD_ALWAYS_INLINE static void add( V & sum, V & compensation, V const & value )
+    {
+        V const corrected = value - compensation;
+        V const newSum = sum + corrected;
+        compensation = ( newSum - sum ) - corrected;
+        sum = newSum;
+    }
+
+    SIMD_ALWAYS_INLINE void add( V const & x, V const & shift )
+    {
+        /* NaN compares false, i.e. is neither counted nor changes min or max */
+        V const dx = x == x ? V( x - shift ) : V{};
+        count += x == x ? V( V{} + 1 ) : V{};
+        add( sum, cSum, dx );
+        add( sumSquares, cSumSquares, V( dx * dx ) );
+        min = x < min ? x : min;
+        max = x > max ? x : max;
+    }
+
+    SIMD_ALWAYS_INLINE void add( MomentsAccumulator const & other )
+    {
+        count += other.count;
+        add( sum, cSum, V( other.sum - other.cSum ) );
+        add( sumSquares, cSumSquares, V( other.sumSquares - other.cSumSquares ) );
+        min = other.min < min ? other.min : min;
+        max = other.max > max ? other.max : max;
+    }
+};
+
+template< typename T, typename Float >
+inline void momentsScalar
+(
+    T      const * const x,
+    size_t         const iBegin,
+    size_t         const iEnd,
+    Float          const shift,
+    MomentsAccumulator< Float > & sums
+)
+{
+    for ( size_t i = iBegin; i < iEnd; ++i )
+        sums.add( Float( x[i] ), shift );
+}
+
+#if defined( __GNUC__ )
+
+template< std::size_t nBytes >
+SIMD_ALWAYS_INLINE void momentsKernel
+(
+    double const * const x,
+    size_t         const n,
+    double         const shift,
+    MomentsAccumulator< double > & result
+)
+{
+    using V = typename Simd::Vector< double, nBytes >::type;
+    auto constexpr nLanes = Simd::Vector< double, nBytes >::nLanes;
+
+    V vShift, infinity;
+    Simd::broadcast( vShift, shift );
+    Simd::broadcast( infinity, std::numeric_limits< double >::infinity() );
+    MomentsAccumulator< V > accumulator0, accumulator1;
+    accumulator0.init( infinity );
+    accumulator1.init( infinity );
+
+    size_t i = 0u;
+    for ( ; i + 2 * nLanes <= n; i += 2 * nLanes )
+    {
+        V xi;
+        Simd::load( xi, x + i );
+        accumulator0.add( xi, vShift );
+        Simd::load( xi, x + i + nLanes );
+        accumulator1.add( xi, vShift );
+    }
+    accumulator0.add( accumulator1 );
+
+    for ( size_t k = 0u; k < nLanes; ++k )
+    {
+        result.count += accumulator0.count[k];
+        result.add( result.sum, result.cSum, accumulator0.sum[k] - accumulator0.cSum[k] );
+        result.add( result.sumSquares, result.cSumSquares, accumulator0.sumSquares[k] - accumulator0.cSumSquares[k] );
+        result.min = std::min( result.min, accumulator0.min[k] );
+        result.max = std::max( result.max, accumulator0.max[k] );
+    }
+    momentsScalar( x, i, n, shift, result );
+}
+
+#endif  // __GNUC__
+
+#if SIMD_VECTOR128
+inline void moments128( double const * const x, size_t const n, double const shift, MomentsAccumulator< double > & result )
+{ momentsKernel< 16 >( x, n, shift, result ); }
+#endif
+
+#if SIMD_X86
+SIMD_TARGET_AVX2 inline void momentsAvx2( double const * const x, size_t const n, double const shift, MomentsAccumulator< double > & result )
+{ momentsKernel< 32 >( x, n, shift, result ); }
+
+SIMD_TARGET_AVX512 inline void momentsAvx512( double const * const x, size_t const n, double const shift, MomentsAccumulator< double > & result )
+{ momentsKernel< 64 >( x, n, shift, result ); }
+#endif
+
+inline void moments
+(
+    double const * const x,
+    size_t         const n,
+    double         const shift,
+    MomentsAccumulator< double > & result,
+    Simd::InstructionSet const instructionSet
+)
+{
+    switch ( instructionSet )
+    {
+    #if SIMD_X86
+        case Simd::InstructionSet::Avx512:
+            /* for short data the reduction of the 8 lanes costs more than the wider loop saves */
+            if ( n >= 128 )
+            {
+                momentsAvx512( x, n, shift, result );
+                return;
+            }
+            /* fall through */
+        case Simd::InstructionSet::Avx2:
+            momentsAvx2( x, n, shift, result );
+            return;
+    #endif
+    #if SIMD_VECTOR128
+        case Simd::InstructionSet::Sse2:
+        case Simd::InstructionSet::Neon:
+            moments128( x, n, shift, result );
+            return;
+    #endif
+        default:
+            momentsScalar( x, 0, n, shift, result );
+    }
+}
+
+/* other types than double are not vectorized */
+template< typename T, typename Float >
+inline void moments
+(
+    T      const * const x,
+    size_t         const n,
+    Float          const shift,
+    MomentsAccumulator< Float > & result,
+    Simd::InstructionSet
+)
+{
+    momentsScalar( x, 0, n, shift, result );
+}
+
+/** values per chunk, which are processed serially */
+size_t constexpr nStatisticsChunk = 16384;
+
+template< typename T >
+inline Statistics< StatisticsFloat< T > > chunkStatistics
+(
+    T                    const * const x,
+    size_t               const         n,
+    Simd::InstructionSet const         instructionSet
+)
+{
+    using Float = StatisticsFloat< T >;
+
+    /* shift by the first valid value, which is close to the mean for most data */
+    size_t iFirst = 0;
+    while ( iFirst < n && ! ( x[ iFirst ] == x[ iFirst ] ) )
+        ++iFirst;
+    if ( iFirst == n )
+        return Statistics< Float >::empty();
+    auto const shift = Float( x[ iFirst ] );
+
+    MomentsAccumulator< Float > sums;
+    sums.init( std::numeric_limits< Float >::infinity() );
+    moments( x + iFirst, n - iFirst, shift, sums, instructionSet );
+
+    Statistics< Float > result;
+    result.count      = size_t( sums.count );
+    auto const sum    = sums.sum - sums.cSum;
+    auto const mean   = sum / sums.count;
+    result.mean       = shift + mean;
+    /* rounding errors may lead to slightly negative values for constant data */
+    result.sumSquares = std::max( Float( 0 ), ( sums.sumSquares - sums.cSumSquares ) - sum * mean );
+    result.min        = sums.min;
+    result.max        = sums.max;
+    return result;
+}
+
+
+} // namespace detail
+
+
+/**
+ * @param[in] instructionSet can be used to force a kernel, e.g. for tests.
+ *            Must be supported by the CPU!
+ */
+template< typename T >
+inline Statistics< StatisticsFloat< T > > computeStatistics
+(
+    T                    const * const x,
+    size_t               const         n,
+    Simd::InstructionSet const         instructionSet = Simd::instructionSet()
+)
+{
+    auto result = Statistics< StatisticsFloat< T > >::empty();
+    for ( size_t i = 0u; i < n; i += detail::nStatisticsChunk )
+        result.merge( detail::chunkStatistics( x + i, std::min( detail::nStatisticsChunk, n - i ), instructionSet ) );
+    return result;
+}
+
+template< typename T >
+inline Statistics< StatisticsFloat< T > > computeStatistics( std::vector< T > const & x )
+{
+    return computeStatistics( x.data(), x.size() );
+}
+
+/**
+ * Same as computeStatistics with the chunks distributed to the pool, i.e.
+ * with bitwise identical results. Called from a task of the pool, the
+ * chunks are processed on the calling thread, see ThreadPool::parallelFor.
+ */
+template< typename T >
+inline Statistics< StatisticsFloat< T > > computeStatisticsParallel
+(
+    T                    const * const x,
+    size_t               const         n,
+    ThreadPool                       & pool = defaultThreadPool(),
+    Simd::InstructionSet const         instructionSet = Simd::instructionSet()
+)
+{
+    auto const nChunks = ( n + detail::nStatisticsChunk - 1 ) / detail::nStatisticsChunk;
+    /* waking up the pool takes a few microseconds */
+    if ( nChunks < 4 || pool.size() == 1 )
+        return computeStatistics( x, n, instructionSet );
+
+    std::vector< Statistics< StatisticsFloat< T > > > chunks( nChunks );
+    pool.parallelFor( nChunks, [&] ( size_t const iChunk, unsigned int )
+    {
+        auto const i = iChunk * detail::nStatisticsChunk;
+        chunks[ iChunk ] = detail::chunkStatistics( x + i, std::min( detail::nStatisticsChunk, n - i ), instructionSet );
+    } );
+
+    auto result = Statistics< StatisticsFloat< T > >::empty();
+    for ( auto const & chunk : chunks )
+        result.merge( chunk );
+    return result;
+}
+
+template< typename T >
+inline Statistics< StatisticsFloat< T > > computeStatisticsParallel
+(
+    std::vector< T > const & x,
+    ThreadPool             & pool = defaultThreadPool()
+)
+{
+    return computeStatisticsParallel( x.data(), x.size(), pool );
+}
+
+
+} // namespace Fundamental
+
+
+#ifdef MAIN_TEST_STATISTICS
+
+
+#include <cstdint>                      // int64_t
+#include <cstdlib>                      // rand
+#include <cstring>                      // memcmp
+#include <iostream>
+
+
+namespace {
+
+
+using namespace Fundamental;
+
+/* two-pass reference in long double */
+template< typename T >
+Statistics< long double > referenceStatistics( std::vector< T > const & x )
+{
+    auto result = Statistics< long double >::empty();
+    long double sum = 0;
+    for ( auto const value : x )
+    {
+        if ( ! ( value == value ) )
+            continue;
+        ++result.count;
+        sum += value;
+        result.min = std::min< long double >( result.min, value );
+        result.max = std::max< long double >( result.max, value );
+    }
+    if ( result.count == 0 )
+        return result;
+    result.mean = sum / result.count;
+    result.sumSquares = 0;
+    for ( auto const value : x )
+        if ( value == value )
+            result.sumSquares += ( value - result.mean ) * ( value - result.mean );
+    return result;
+}
+
+template< typename Float >
+bool isClose( Statistics< Float > const & result, Statistics< long double > const & expected, double const tolerance )
+{
+    if ( result.count != expected.count || result.min != Float( expected.min ) || result.max != Float( expected.max ) )
+        return false;
+    if ( expected.count == 0 )
+        return std::isnan( result.mean ) && std::isnan( result.variance() );
+
+    /* relative to the spread of the data instead of the, e.g. large, mean */
+    auto const scale = std::max( 1e-300L, expected.max - expected.min );
+    auto const meanOk = std::abs( result.mean - expected.mean ) <= tolerance * scale;
+    auto const sumSquaresOk = std::abs( result.sumSquares - expected.sumSquares ) <=
+                              tolerance * ( expected.sumSquares + scale * scale );
+    return meanOk && sumSquaresOk;
+}
+
+bool bitwiseEqual( Statistics< double > const & a, Statistics< double > const & b )
+{
+    return a.count == b.count && a.min == b.min && a.max == b.max &&
+           std::memcmp( &a.mean, &b.mean, sizeof( a.mean ) ) == 0 &&
+           std::memcmp( &a.sumSquares, &b.sumSquares, sizeof( a.sumSquares ) ) == 0;
+}
+
+bool testStatistics( void )
+{
+    bool success = true;
+
+    std::vector< Simd::InstructionSet > instructionSets = { Simd::InstructionSet::Scalar };
+    #if SIMD_VECTOR128
+        instructionSets.push_back( Simd::detectInstructionSet() == Simd::InstructionSet::Neon
+                                   ? Simd::InstructionSet::Neon : Simd::InstructionSet::Sse2 );
+    #endif
+    #if SIMD_X86
+        if ( Simd::instructionSet() == Simd::InstructionSet::Avx2 ||
+             Simd::instructionSet() == Simd::InstructionSet::Avx512 )
+            instructionSets.push_back( Simd::InstructionSet::Avx2 );
+        if ( Simd::instructionSet() == Simd::InstructionSet::Avx512 )
+            instructionSets.push_back( Simd::InstructionSet::Avx512 );
+    #endif
+
+    for ( size_t n : { 0, 1, 2, 3, 17, 127, 128, 1000, 16383, 16384, 16385, 100000 } )
+    for ( double offset : { 0., 1e9 } )
+    for ( int nanEvery : { 0, 1, 7 } )
+    {
+        std::vector< double > x( n );
+        for ( size_t i = 0; i < n; ++i )
+            x[i] = offset + std::rand() / double( RAND_MAX ) - 0.5;
+        if ( nanEvery > 0 )
+            for ( size_t i = 0; i < n; i += nanEvery )
+                x[i] = std::nan( "" );
+
+        auto const expected = referenceStatistics( x );
+        /* the spread of 1 is 1e-9 relative to the offset, i.e. 7 of 16 digits are lost anyway */
+        auto const tolerance = offset == 0 ? 1e-14 : 1e-6;
+        for ( auto const instructionSet : instructionSets )
+        {
+            auto const result = computeStatistics( x.data(), x.size(), instructionSet );
+            if ( ! isClose( result, expected, tolerance ) )
+            {
+                std::cout << "computeStatistics with " << Simd::toString( instructionSet ) << " for n = " << n
+                          << ", offset = " << offset << ", NaN every " << nanEvery << " differs: mean "
+                          << result.mean << " instead of " << double( expected.mean ) << ", variance "
+                          << result.variance() << " instead of "
+                          << double( expected.count < 2 ? 0 : expected.sumSquares / ( expected.count - 1 ) ) << "\n";
+                success = false;
+            }
+        }
+
+        for ( unsigned int nThreads : { 1u, 3u } )
+        {
+            ThreadPool pool( nThreads );
+            success &= bitwiseEqual( computeStatisticsParallel( x, pool ), computeStatistics( x ) );
+        }
+    }
+
+    /* from tasks of the same pool, e.g. the default one, which is used implicitly */
+    {
+        ThreadPool pool( 3 );
+        std::vector< double > x( 100000 );
+        for ( auto & value : x )
+            value = std::rand() / double( RAND_MAX );
+        auto const expected = computeStatistics( x );
+        std::vector< Statistics< double > > nested( 8, Statistics< double >::empty() );
+        pool.parallelFor( nested.size(), [&] ( size_t const i, unsigned int )
+        {
+            nested[i] = computeStatisticsParallel( x, pool );
+        } );
+        for ( auto const & result : nested )
+            success &= bitwiseEqual( result, expected );
+    }
+
+    /* other types */
+    std::vector< float > floats( 1000 );
+    std::vector< int64_t > integers( 1000 );
+    for ( size_t i = 0; i < floats.size(); ++i )
+    {
+        floats[i]   = float( std::rand() % 1000 ) / 8;
+        integers[i] = std::rand() % 1000 - 500;
+    }
+    success &= isClose( computeStatistics( floats ), referenceStatistics( floats ), 1e-6 );
+    success &= isClose( computeStatistics( integers ), referenceStatistics( integers ), 1e-14 );
+
+    /* streaming by merging batches */
+    std::vector< double > x( 5000 );
+    for ( auto & value : x )
+        value = 100 + std::rand() / double( RAND_MAX );
+    auto merged = Statistics< double >::empty();
+    for ( size_t i = 0; i < x.size(); i += 333 )
+        merged.merge( computeStatistics( x.data() + i, std::min< size_t >( 333, x.size() - i ) ) );
+    success &= isClose( merged, referenceStatistics( x ), 1e-13 );
+
+    std::cout << "Statistics " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+
+} // namespace
+
+
+int main()
+{
+    testStatistics();
+}
+
+
+#endif
@@ -0,0 +1,400 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 ThreadPool.hpp -DMAIN_TEST_THREADPOOL -pthread && ./a.out
+*/
+#pragma once
+
+/**
+ * Persistent worker threads executing parallel loops over independent tasks
+ * with very different run times, e.g. time series of very different lengths.
+ *
+ * Each participating thread owns a range of task indexes which it processes
+ * from the front. Threads which run out of work steal the back half of the
+ * remaining range of another thread, so that no thread idles while another
+ * still has a backlog, without the cost of a central queue per task.
+ * @see R. D. Blumofe, C. E. Leiserson, "Scheduling multithreaded computations
+ *      by work stealing", 1999
+ */
+
+#include <algorithm>                    // min, max
+#include <condition_variable>
+#include <cstddef>                      // size_t
+#include <exception>                    // exception_ptr
+#include <functional>
+#include <memory>                       // unique_ptr
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace Fundamental {
+
+
+class ThreadPool
+{
+private:
+    /* padded so that the ranges of different threads are on different cache lines */
+    struct Range
+    {
+        std::mutex mutex;
+        size_t     begin = 0;
+        size_t     end   = 0;
+        char       padding[64];
+    };
+
+    std::vector< std::thread >                 threads     ;
+    std::unique_ptr< Range[] >                 ranges      ;  /**< [0] belongs to the calling thread */
+    std::function< void( size_t, unsigned ) >  task        ;
+
+    std::mutex                                 mutex       ;  /**< for all members below */
+    std::condition_variable                    wakeUp      ;
+    std::condition_variable                    finished    ;
+    size_t                                     iGeneration ;  /**< incremented for each parallel loop */
+    unsigned int                               nBusy       ;
+    bool                                       stopping    ;
+    std::exception_ptr                         exception   ;
+
+    std::mutex                                 callerMutex ;  /**< serializes parallelFor calls */
+
+    /**
+     * The pools whose tasks the current thread is running, innermost first,
+     * so that nested parallelFor calls can be detected
+     */
+    struct ActiveScope
+    {
+        ThreadPool  const * pool   ;
+        unsigned int        iWorker;
+        ActiveScope const * outer  ;
+    };
+
+    static inline ActiveScope const * & activeScope( void )
+    {
+        static thread_local ActiveScope const * scope = nullptr;
+        return scope;
+    }
+
+    class ScopeGuard
+    {
+    private:
+        ActiveScope scope;
+
+    public:
+        inline ScopeGuard( ThreadPool const * const pool, unsigned int const iWorker )
+        : scope{ pool, iWorker, activeScope() }
+        {
+            activeScope() = &scope;
+        }
+
+        inline ~ScopeGuard() { activeScope() = scope.outer; }
+
+        ScopeGuard( ScopeGuard const & ) = delete;
+        ScopeGuard & operator=( ScopeGuard const & ) = delete;
+    };
+
+    /** @return true if the current thread is running a task of this pool */
+    inline bool findActiveWorker( unsigned int & iWorker ) const
+    {
+        for ( auto scope = activeScope(); scope != nullptr; scope = scope->outer )
+        {
+            if ( scope->pool == this )
+            {
+                iWorker = scope->iWorker;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template< typename T_Functor >
+    inline void runInline( size_t const nTasks, T_Functor && functor, unsigned int const iWorker )
+    {
+        ScopeGuard const scope( this, iWorker );
+        for ( size_t iTask = 0u; iTask < nTasks; ++iTask )
+            functor( iTask, iWorker );
+    }
+
+    inline bool popTask( unsigned int const iWorker, size_t & iTask )
+    {
+        auto & range = ranges[ iWorker ];
+        std::lock_guard< std::mutex > lock( range.mutex );
+        if ( range.begin >= range.end )
+            return false;
+        iTask = range.begin++;
+        return true;
+    }
+
+    inline bool stealTask( unsigned int const iWorker, size_t & iTask )
+    {
+        auto const nWorkers = size();
+        for ( unsigned int i = 1u; i < nWorkers; ++i )
+        {
+            auto & victim = ranges[ ( iWorker + i ) % nWorkers ];
+            size_t begin, end;
+            {
+                std::lock_guard< std::mutex > lock( victim.mutex );
+                if ( victim.begin >= victim.end )
+                    continue;
+                end   = victim.end;
+                begin = victim.end - ( victim.end - victim.begin + 1 ) / 2;
+                victim.end = begin;
+            }
+
+            iTask = begin;
+            auto & range = ranges[ iWorker ];
+            std::lock_guard< std::mutex > lock( range.mutex );
+            range.begin = begin + 1;
+            range.end   = end;
+            return true;
+        }
+        return false;
+    }
+
+    inline void work( unsigned int const iWorker )
+    {
+        size_t iTask;
+        while ( popTask( iWorker, iTask ) || stealTask( iWorker, iTask ) )
+        {
+            try
+            {
+                task( iTask, iWorker );
+            }
+            catch ( ... )
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                if ( not exception )
+                    exception = std::current_exception();
+            }
+        }
+    }
+
+    inline void workerLoop( unsigned int const iWorker )
+    {
+        size_t iLastGeneration = 0;
+        while ( true )
+        {
+            {
+                std::unique_lock< std::mutex > lock( mutex );
+                wakeUp.wait( lock, [&] () { return stopping || iGeneration != iLastGeneration; } );
+                if ( stopping )
+                    return;
+                iLastGeneration = iGeneration;
+            }
+
+            {
+                ScopeGuard const scope( this, iWorker );
+                work( iWorker );
+            }
+
+            std::lock_guard< std::mutex > lock( mutex );
+            if ( --nBusy == 0 )
+                finished.notify_all();
+        }
+    }
+
+public:
+    /**
+     * @param[in] nThreads number of threads working on a loop including the
+     *            calling thread. 0 means one per hardware thread.
+     */
+    inline explicit ThreadPool( unsigned int nThreads = 0 )
+    : iGeneration( 0 ),
+      nBusy( 0 ),
+      stopping( false )
+    {
+        if ( nThreads == 0 )
+            nThreads = std::max( 1u, std::thread::hardware_concurrency() );
+        ranges.reset( new Range[ nThreads ] );
+        threads.reserve( nThreads - 1 );
+        for ( unsigned int iWorker = 1u; iWorker < nThreads; ++iWorker )
+            threads.emplace_back( &ThreadPool::workerLoop, this, iWorker );
+    }
+
+    inline ~ThreadPool()
+    {
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for ( auto & thread : threads )
+            thread.join();
+    }
+
+    ThreadPool( ThreadPool const & ) = delete;
+    ThreadPool & operator=( ThreadPool const & ) = delete;
+
+    /** number of threads working on a loop including the calling thread */
+    inline unsigned int size( void ) const { return threads.size() + 1; }
+
+    /**
+     * Calls functor( iTask, iWorker ) for all iTask in [0,nTasks) and returns
+     * after all calls have finished. iWorker is in [0,size()) and can be used
+     * to index per-thread scratch memory, because calls with the same iWorker
+     * never run concurrently. The first exception thrown by a task is
+     * rethrown after all other tasks have finished.
+     *
+     * Concurrent calls from different threads are serialized. A call from
+     * within a task of the same pool, e.g. a library function using
+     * defaultThreadPool() called by a task of it, instead runs all its tasks
+     * inline on the calling thread with the iWorker of the enclosing task,
+     * because the other threads may all be waiting for it. Cycles between
+     * different pools, i.e. a task of pool A waiting for pool B whose task
+     * waits for pool A, still deadlock.
+     */
+    template< typename T_Functor >
+    inline void parallelFor( size_t const nTasks, T_Functor && functor )
+    {
+        if ( nTasks == 0 )
+            return;
+
+        unsigned int iActiveWorker;
+        if ( findActiveWorker( iActiveWorker ) )
+        {
+            runInline( nTasks, functor, iActiveWorker );
+            return;
+        }
+
+        std::lock_guard< std::mutex > callerLock( callerMutex );
+        if ( size() == 1 || nTasks == 1 )
+        {
+            runInline( nTasks, functor, 0u );
+            return;
+        }
+
+        task = std::ref( functor );
+        auto const nWorkers = size();
+        for ( unsigned int iWorker = 0u; iWorker < nWorkers; ++iWorker )
+        {
+            std::lock_guard< std::mutex > lock( ranges[ iWorker ].mutex );
+            ranges[ iWorker ].begin = nTasks *   iWorker       / nWorkers;
+            ranges[ iWorker ].end   = nTasks * ( iWorker + 1 ) / nWorkers;
+        }
+
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            exception = nullptr;
+            nBusy = nWorkers - 1;
+            ++iGeneration;
+        }
+        wakeUp.notify_all();
+
+        {
+            ScopeGuard const scope( this, 0u );
+            work( 0 );
+        }
+
+        std::unique_lock< std::mutex > lock( mutex );
+        finished.wait( lock, [&] () { return nBusy == 0; } );
+        task = nullptr;
+        if ( exception )
+            std::rethrow_exception( exception );
+    }
+};
+
+
+/**
+ * Pool with one thread per hardware thread, started on first use
+ */
+inline ThreadPool & defaultThreadPool( void )
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+
+} // namespace Fundamental
+
+
+#ifdef MAIN_TEST_THREADPOOL
+
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+
+int main()
+{
+    using namespace Fundamental;
+
+    for ( unsigned int nThreads : { 1u, 2u, 3u, 8u } )
+    {
+        ThreadPool pool( nThreads );
+        bool success = pool.size() == nThreads;
+
+        /* each task must run exactly once, also for unbalanced loads */
+        for ( size_t nTasks : { size_t( 0 ), size_t( 1 ), size_t( 7 ), size_t( 1000 ) } )
+        {
+            std::vector< std::atomic< int > > nCalls( nTasks );
+            for ( auto & n : nCalls )
+                n = 0;
+            std::vector< int > nCallsPerWorker( pool.size(), 0 );
+            pool.parallelFor( nTasks, [&] ( size_t const iTask, unsigned int const iWorker )
+            {
+                if ( iTask % 97 == 0 )
+                    std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+                ++nCalls[ iTask ];
+                ++nCallsPerWorker[ iWorker ];  /* no data race because of the iWorker guarantee */
+            } );
+            for ( auto const & n : nCalls )
+                success &= n == 1;
+            int nCallsTotal = 0;
+            for ( auto const n : nCallsPerWorker )
+                nCallsTotal += n;
+            success &= nCallsTotal == int( nTasks );
+        }
+
+        /* exceptions are propagated to the caller and the pool stays usable */
+        bool caught = false;
+        try
+        {
+            pool.parallelFor( 100, [] ( size_t const iTask, unsigned int )
+            {
+                if ( iTask == 42 )
+                    throw std::runtime_error( "test" );
+            } );
+        }
+        catch ( std::runtime_error const & )
+        {
+            caught = true;
+        }
+        success &= caught;
+
+        std::atomic< size_t > sum( 0 );
+        pool.parallelFor( 100, [&] ( size_t const iTask, unsigned int ) { sum += iTask; } );
+        success &= sum == 4950;
+
+        /* nested calls run inline instead of deadlocking and keep the iWorker guarantee */
+        std::vector< std::vector< int > > nNestedCalls( pool.size(), std::vector< int >( 10, 0 ) );
+        std::atomic< size_t > nNestedTotal( 0 );
+        pool.parallelFor( 50, [&] ( size_t, unsigned int const iWorker )
+        {
+            pool.parallelFor( 10, [&] ( size_t const iTask, unsigned int const iNestedWorker )
+            {
+                ++nNestedCalls[ iNestedWorker ][ iTask ];  /* races if iNestedWorker != iWorker */
+                nNestedTotal += iNestedWorker == iWorker;
+            } );
+        } );
+        success &= nNestedTotal == 500;
+
+        /* concurrent calls of the single task fast path must be serialized, too */
+        std::vector< int > nSingleCalls( pool.size(), 0 );
+        std::vector< std::thread > callers;
+        for ( int i = 0; i < 4; ++i )
+        {
+            callers.emplace_back( [&] () {
+                for ( int j = 0; j < 1000; ++j )
+                    pool.parallelFor( 1, [&] ( size_t, unsigned int const iWorker ) { ++nSingleCalls[ iWorker ]; } );
+            } );
+        }
+        for ( auto & caller : callers )
+            caller.join();
+        success &= nSingleCalls[0] == 4000;
+
+        std::cout << "ThreadPool with " << nThreads << " threads" << ( success ? " OK" : " FAILED" ) << "\n";
+    }
+}
+
+
+#endif
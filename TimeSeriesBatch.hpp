@@ -0,0 +1,319 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 TimeSeriesBatch.hpp -DMAIN_TEST_TIMESERIESBATCH -pthread && ./a.out
+*/
+#pragma once
+
+/**
+ * Versions of normalizeTimeSeries and findLocalExtrema for many independent
+ * series, e.g. one per instrument, which are processed in parallel on a
+ * work-stealing ThreadPool and write into caller-provided output, so that
+ * repeated runs don't allocate.
+ *
+ * Series given as one contiguous buffer are laid out like for parseTimes:
+ * series k is x[ offsets[k], offsets[k+1] ), i.e. offsets has nSeries + 1
+ * elements and the outputs have offsets[ nSeries ] elements.
+ *
+ * The functions may be called from tasks of the pool they use, e.g. a job
+ * per exchange on defaultThreadPool(), then they run on the calling thread,
+ * see ThreadPool::parallelFor.
+ */
+
+#include <algorithm>                    // fill
+#include <cstddef>                      // size_t
+#include <limits>
+#include <utility>                      // pair
+#include <vector>
+
+#include "findLocalExtrema.hpp"
+#include "normalizeTimeSeries.hpp"
+#include "RollingWindow.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace Fundamental {
+
+
+/** bit flags for each value in the output of findLocalExtremaBatch */
+enum LocalExtremumFlag : unsigned char
+{
+    LocalMinimum = 1,
+    LocalMaximum = 2
+};
+
+
+/**
+ * @param[out] result offsets[ nSeries ] normalized values, may be x itself
+ */
+template< typename T >
+inline void normalizeTimeSeriesBatch
+(
+    T            const * const x,
+    size_t       const * const offsets,
+    size_t               const nSeries,
+    T                  * const result,
+    size_t               const nBarsMax = std::numeric_limits< size_t >::max(),
+    int                  const iNormalizationStrategy = 0,
+    ThreadPool               & pool = defaultThreadPool()
+)
+{
+    detail::checkNormalizationArguments( "normalizeTimeSeriesBatch", nBarsMax, iNormalizationStrategy );
+
+    /* one normalizer per thread which is reset for each series */
+    std::vector< TimeSeriesNormalizer< T > > normalizers(
+        pool.size(), TimeSeriesNormalizer< T >( nBarsMax, iNormalizationStrategy ) );
+
+    pool.parallelFor( nSeries, [&] ( size_t const k, unsigned int const iWorker )
+    {
+        auto const iBegin = offsets[k];
+        auto const iEnd   = offsets[k+1];
+        /* keep the special case of normalizeTimeSeries */
+        if ( iEnd - iBegin <= 1 )
+        {
+            if ( iEnd > iBegin )
+                result[ iBegin ] = x[ iBegin ];
+            return;
+        }
+
+        auto & normalizer = normalizers[ iWorker ];
+        normalizer.clear();
+        for ( size_t i = iBegin; i < iEnd; ++i )
+            result[i] = normalizer.push( x[i] );
+    } );
+}
+
+/**
+ * @param[out] results resized to series.size() and each element to the
+ *             length of the series, i.e. reusing it doesn't allocate
+ */
+template< typename T >
+inline void normalizeTimeSeriesBatch
+(
+    std::vector< std::vector< T > > const & series,
+    std::vector< std::vector< T > >       & results,
+    size_t                          const   nBarsMax = std::numeric_limits< size_t >::max(),
+    int                             const   iNormalizationStrategy = 0,
+    ThreadPool                            & pool = defaultThreadPool()
+)
+{
+    detail::checkNormalizationArguments( "normalizeTimeSeriesBatch", nBarsMax, iNormalizationStrategy );
+
+    results.resize( series.size() );
+    std::vector< TimeSeriesNormalizer< T > > normalizers(
+        pool.size(), TimeSeriesNormalizer< T >( nBarsMax, iNormalizationStrategy ) );
+
+    pool.parallelFor( series.size(), [&] ( size_t const k, unsigned int const iWorker )
+    {
+        auto const & x = series[k];
+        auto & result = results[k];
+        result.resize( x.size() );
+        if ( x.size() <= 1 )
+        {
+            result = x;
+            return;
+        }
+
+        auto & normalizer = normalizers[ iWorker ];
+        normalizer.clear();
+        for ( size_t i = 0u; i < x.size(); ++i )
+            result[i] = normalizer.push( x[i] );
+    } );
+}
+
+
+/**
+ * @param[out] flags offsets[ nSeries ] values which are set to a combination
+ *             of LocalExtremumFlag, i.e. 0 for values which are no extrema.
+ */
+template< typename T >
+inline void findLocalExtremaBatch
+(
+    T             const * const x,
+    size_t        const * const offsets,
+    size_t                const nSeries,
+    unsigned int          const nBarsLeftRight,
+    unsigned char       * const flags,
+    ThreadPool                & pool = defaultThreadPool()
+)
+{
+    struct Scratch { std::vector< T > suffixMin, suffixMax; };
+    std::vector< Scratch > scratches( pool.size() );
+
+    pool.parallelFor( nSeries, [&] ( size_t const k, unsigned int const iWorker )
+    {
+        auto const iBegin = offsets[k];
+        auto const n      = offsets[k+1] - iBegin;
+        std::fill( flags + iBegin, flags + iBegin + n, (unsigned char) 0 );
+
+        auto const px = x + iBegin;
+        auto & scratch = scratches[ iWorker ];
+        forEachWindowMinMax( px, n, 2 * size_t( nBarsLeftRight ) + 1,
+            [&] ( size_t const iWindow, T const & min, T const & max )
+            {
+                auto const i = iWindow + nBarsLeftRight;
+                flags[ iBegin + i ] = ( min == px[i] ? LocalMinimum : 0 ) |
+                                      ( max == px[i] ? LocalMaximum : 0 );
+            },
+            scratch.suffixMin, scratch.suffixMax
+        );
+    } );
+}
+
+/**
+ * @param[out] results resized to series.size(), each element is set to the
+ *             result of findLocalExtrema for that series. The vectors are
+ *             cleared instead of reallocated, so reusing results across
+ *             calls doesn't allocate.
+ */
+template< typename T >
+inline void findLocalExtremaBatch
+(
+    std::vector< std::vector< T > > const & series,
+    unsigned int                    const   nBarsLeftRight,
+    std::vector< LocalExtrema< T > >      & results,
+    ThreadPool                            & pool = defaultThreadPool()
+)
+{
+    struct Scratch { std::vector< T > suffixMin, suffixMax; };
+    std::vector< Scratch > scratches( pool.size() );
+
+    results.resize( series.size() );
+    pool.parallelFor( series.size(), [&] ( size_t const k, unsigned int const iWorker )
+    {
+        auto const & x = series[k];
+        auto & minima = results[k].first;
+        auto & maxima = results[k].second;
+        minima.first.clear(); minima.second.clear();
+        maxima.first.clear(); maxima.second.clear();
+
+        auto & scratch = scratches[ iWorker ];
+        forEachWindowMinMax( x.data(), x.size(), 2 * size_t( nBarsLeftRight ) + 1,
+            [&] ( size_t const iWindow, T const & min, T const & max )
+            {
+                auto const i = iWindow + nBarsLeftRight;
+                if ( min == x[i] )
+                {
+                    minima.first.push_back( i );
+                    minima.second.push_back( x[i] );
+                }
+                if ( max == x[i] )
+                {
+                    maxima.first.push_back( i );
+                    maxima.second.push_back( x[i] );
+                }
+            },
+            scratch.suffixMin, scratch.suffixMax
+        );
+    } );
+}
+
+
+} // namespace Fundamental
+
+
+#ifdef MAIN_TEST_TIMESERIESBATCH
+
+
+#include <cmath>
+#include <cstdlib>                      // rand
+#include <iostream>
+
+
+int main()
+{
+    using namespace Fundamental;
+
+    /* lengths varying by 100x like for instruments with different histories */
+    std::vector< std::vector< double > > series( 300 );
+    std::vector< double > buffer;
+    std::vector< size_t > offsets = { 0 };
+    for ( auto & x : series )
+    {
+        x.resize( 20 + std::rand() % 2000 );
+        double value = 100;
+        for ( auto & element : x )
+        {
+            element = value += std::rand() / double( RAND_MAX ) - 0.5;
+            if ( std::rand() % 50 == 0 )
+                element = std::nan( "" );
+        }
+        buffer.insert( buffer.end(), x.begin(), x.end() );
+        offsets.push_back( buffer.size() );
+    }
+    series.push_back( {} );
+    series.push_back( { 1.0 } );
+    offsets.push_back( buffer.size() );
+    buffer.push_back( 1.0 );
+    offsets.push_back( buffer.size() );
+
+    auto const equal = [] ( double const a, double const b ) { return a == b || ( std::isnan( a ) && std::isnan( b ) ); };
+
+    for ( unsigned int nThreads : { 1u, 4u } )
+    {
+        ThreadPool pool( nThreads );
+        bool success = true;
+
+        for ( int iStrategy : { 0, 1, 2 } )
+        {
+            std::vector< std::vector< double > > results;
+            normalizeTimeSeriesBatch( series, results, 100, iStrategy, pool );
+            std::vector< double > resultBuffer( buffer.size() );
+            normalizeTimeSeriesBatch( buffer.data(), offsets.data(), series.size(),
+                                      resultBuffer.data(), 100, iStrategy, pool );
+
+            for ( size_t k = 0u; k < series.size(); ++k )
+            {
+                auto const expected = normalizeTimeSeries( series[k], 100, iStrategy );
+                success &= expected.size() == results[k].size();
+                for ( size_t i = 0u; i < expected.size(); ++i )
+                {
+                    success &= equal( expected[i], results[k][i] );
+                    success &= equal( expected[i], resultBuffer[ offsets[k] + i ] );
+                }
+            }
+        }
+
+        std::vector< LocalExtrema< double > > extrema;
+        findLocalExtremaBatch( series, 10, extrema, pool );
+        std::vector< unsigned char > flags( buffer.size() );
+        findLocalExtremaBatch( buffer.data(), offsets.data(), series.size(), 10, flags.data(), pool );
+        for ( size_t k = 0u; k < series.size(); ++k )
+        {
+            auto const expected = findLocalExtrema( series[k], 10 );
+            success &= extrema[k] == expected;
+
+            std::vector< size_t > iMinima, iMaxima;
+            for ( size_t i = offsets[k]; i < offsets[k+1]; ++i )
+            {
+                if ( flags[i] & LocalMinimum ) iMinima.push_back( i - offsets[k] );
+                if ( flags[i] & LocalMaximum ) iMaxima.push_back( i - offsets[k] );
+            }
+            success &= iMinima == expected.first.first && iMaxima == expected.second.first;
+        }
+
+        std::cout << "Batch time series functions with " << nThreads << " threads"
+                  << ( success ? " OK" : " FAILED" ) << "\n";
+    }
+
+    /* calls from tasks of the same pool, e.g. the default one, must not deadlock */
+    ThreadPool pool( 4 );
+    std::vector< std::vector< std::vector< double > > > nestedResults( 4 );
+    pool.parallelFor( nestedResults.size(), [&] ( size_t const k, unsigned int )
+    {
+        normalizeTimeSeriesBatch( series, nestedResults[k], 100, 1, pool );
+    } );
+    std::vector< std::vector< double > > expected;
+    normalizeTimeSeriesBatch( series, expected, 100, 1 );
+    bool success = true;
+    for ( auto const & results : nestedResults )
+    {
+        for ( size_t k = 0u; k < series.size(); ++k )
+        {
+            for ( size_t i = 0u; i < series[k].size(); ++i )
+                success &= equal( expected[k][i], results[k][i] );
+        }
+    }
+    std::cout << "Batch time series functions called from a pool task" << ( success ? " OK" : " FAILED" ) << "\n";
+}
+
+
+#endif
@@ -0,0 +1,693 @@
+/*
+g++ -Wall -Wextra -O3 -march=native -std=c++11 benchmarks.cpp timeExtensions.cpp -pthread -o benchmarks && ./benchmarks
+
+Usage: benchmarks [--json] [filter]
+  --json  print one JSON object per benchmark and line instead of a table
+  filter  only run benchmarks whose name contains this string
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>                       // remove
+#include <cstdlib>                      // rand
+#include <cstring>                      // strcmp
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Benchmark.hpp"
+#include "BitsCompileTime.hpp"
+#include "ColumnarFile.hpp"
+#include "CsvReader.hpp"
+#include "Fundamental.hpp"
+#include "findLocalExtrema.hpp"
+#include "Instrumentation.hpp"
+#include "LinearRegression.hpp"
+#include "MortonBatch.hpp"
+#include "normalizeTimeSeries.hpp"
+#include "Statistics.hpp"
+#include "timeExtensions.hpp"
+#include "toString.hpp"
+#include "vectorIndex.hpp"
+
+
+namespace {
+
+
+/** runs only benchmarks whose name contains the filter and collects their results */
+struct Benchmarks
+{
+    std::string filter;
+    std::vector< Benchmark::Result > results;
+
+    template< typename T_Functor >
+    void run( std::string const & name, T_Functor && functor, size_t const nItemsPerIteration = 1 )
+    {
+        if ( name.find( filter ) != std::string::npos )
+            results.push_back( Benchmark::run( name, functor, nItemsPerIteration ) );
+    }
+};
+
+/* all kernels which can run on this CPU */
+std::vector< Simd::InstructionSet > instructionSets( void )
+{
+    std::vector< Simd::InstructionSet > result = { Simd::InstructionSet::Scalar };
+    #if SIMD_VECTOR128
+        result.push_back( Simd::detectInstructionSet() == Simd::InstructionSet::Neon
+                          ? Simd::InstructionSet::Neon : Simd::InstructionSet::Sse2 );
+    #endif
+    #if SIMD_X86
+        if ( Simd::instructionSet() == Simd::InstructionSet::Avx2 ||
+             Simd::instructionSet() == Simd::InstructionSet::Avx512 )
+            result.push_back( Simd::InstructionSet::Avx2 );
+        if ( Simd::instructionSet() == Simd::InstructionSet::Avx512 )
+            result.push_back( Simd::InstructionSet::Avx512 );
+    #endif
+    return result;
+}
+
+
+/* reference implementations from http://graphics.stanford.edu/~seander/bithacks.html */
+
+uint32_t part1by1( uint32_t n )
+{
+    n &= 0x0000ffff;
+    n = (n | (n << 8)) & 0x00FF00FF;
+    n = (n | (n << 4)) & 0x0F0F0F0F;
+    n = (n | (n << 2)) & 0x33333333;
+    n = (n | (n << 1)) & 0x55555555;
+    return n;
+}
+
+uint32_t part1by2( uint32_t n )
+{
+    n&= 0x000003ff;
+    n = (n ^ (n << 16)) & 0xFF0000FF;
+    n = (n ^ (n <<  8)) & 0x0300F00F;
+    n = (n ^ (n <<  4)) & 0x030C30C3;
+    n = (n ^ (n <<  2)) & 0x09249249;
+    return n;
+}
+
+
+/**
+ * Benchmark the latency of chained calls, because the throughput of
+ * independent calls would mostly measure the loop.
+ *
+ * The old hand-written loops in BitsCompileTime.hpp found:
+ *  - at -O0 the template cascade is ~1.5x slower than part1by1 because
+ *    nothing gets inlined, with -O1 and above both are equally fast
+ *  - g++-6 -O2 made part1by2 ~9% slower, presumably because of
+ *    -finline-small-functions, see
+ *    https://gcc.gnu.org/bugzilla/show_bug.cgi?id=84327
+ *    https://gcc.gnu.org/bugzilla/show_bug.cgi?id=84328
+ */
+void benchmarkBitFunctions( Benchmarks & benchmarks )
+{
+    using namespace BitFunctions;
+    uint32_t x32 = std::rand();
+    uint64_t x64 = std::rand();
+
+    benchmarks.run( "bits/part1by1", [&] () {
+        x32 ^= part1by1( x32 ) | 0x12345;
+        Benchmark::doNotOptimize( x32 );
+    } );
+    benchmarks.run( "bits/diluteBitsCascade<uint32_t,1>", [&] () {
+        x32 ^= diluteBitsCascade< uint32_t, 1 >( x32 ) | 0x12345;
+        Benchmark::doNotOptimize( x32 );
+    } );
+    benchmarks.run( "bits/diluteBitsRecursive<uint32_t,1>", [&] () {
+        x32 ^= diluteBitsRecursive< uint32_t, 1 >( x32 ) | 0x12345;
+        Benchmark::doNotOptimize( x32 );
+    } );
+    benchmarks.run( "bits/part1by2", [&] () {
+        x32 ^= part1by2( x32 ) | 0x12345;
+        Benchmark::doNotOptimize( x32 );
+    } );
+    benchmarks.run( "bits/diluteBitsCascade<uint32_t,2>", [&] () {
+        x32 ^= diluteBitsCascade< uint32_t, 2 >( x32 ) | 0x12345;
+        Benchmark::doNotOptimize( x32 );
+    } );
+    benchmarks.run( "bits/diluteBitsRecursive<uint32_t,2>", [&] () {
+        x32 ^= diluteBitsRecursive< uint32_t, 2 >( x32 ) | 0x12345;
+        Benchmark::doNotOptimize( x32 );
+    } );
+    benchmarks.run( "bits/compactBitsCascade<uint64_t,2>", [&] () {
+        x64 ^= compactBitsCascade< uint64_t, 2 >( x64 ) | 0x12345;
+        Benchmark::doNotOptimize( x64 );
+    } );
+    benchmarks.run( "bits/compactBitsRecursive<uint64_t,2>", [&] () {
+        x64 ^= compactBitsRecursive< uint64_t, 2 >( x64 ) | 0x12345;
+        Benchmark::doNotOptimize( x64 );
+    } );
+
+    size_t const n = 1 << 16;
+    std::vector< uint64_t > coordinates( 3 * n ), keys( n );
+    for ( auto & x : coordinates )
+        x = uint64_t( std::rand() ) & MortonBits< uint64_t, 3 >::coordinateMask;
+    std::array< uint64_t const *, 3 > const pCoordinates = {{
+        coordinates.data(), coordinates.data() + n, coordinates.data() + 2 * n }};
+
+    benchmarks.run( "bits/mortonEncode<uint64_t,3>", [&] () {
+        for ( size_t i = 0u; i < n; ++i )
+        {
+            keys[i] = mortonEncode< uint64_t >( std::array< uint64_t, 3 >{{
+                pCoordinates[0][i], pCoordinates[1][i], pCoordinates[2][i] }} );
+        }
+        Benchmark::clobberMemory();
+    }, n );
+
+    for ( auto const instructionSet : instructionSets() )
+    {
+        benchmarks.run( std::string( "bits/mortonEncodeBatch<uint64_t,3>/" )
+                        + Simd::toString( instructionSet ), [&] () {
+            mortonEncodeBatch< uint64_t, 3 >( pCoordinates, keys.data(), n, instructionSet );
+            Benchmark::clobberMemory();
+        }, n );
+    }
+}
+
+
+void benchmarkParseTime( Benchmarks & benchmarks )
+{
+    size_t const n = 10000;
+    std::vector< std::string > dates;
+    std::vector< char > buffer;
+    std::vector< size_t > offsets = { 0 };
+    for ( size_t i = 0u; i < n; ++i )
+    {
+        auto const date = std::to_string( 2000 + i % 30 ) + "-" + std::to_string( 1 + i % 12 ) + "-"
+                        + std::to_string( 1 + i % 28 ) + " " + std::to_string( i % 24 ) + ":"
+                        + std::to_string( i % 60 ) + ":" + std::to_string( ( 7 * i ) % 60 );
+        dates.push_back( date );
+        buffer.insert( buffer.end(), date.begin(), date.end() );
+        offsets.push_back( buffer.size() );
+    }
+    std::string const formatter = "%Y-%m-%d %H:%M:%S";
+    Fundamental::CompiledDateFormat const format( formatter );
+    std::vector< double > result( n );
+
+    size_t i = 0;
+    benchmarks.run( "time/parseTime", [&] () {
+        Benchmark::doNotOptimize( Fundamental::parseTime( dates[i], formatter ) );
+        i = ( i + 1 ) % n;
+    } );
+    benchmarks.run( "time/CompiledDateFormat::parse", [&] () {
+        std::tm date = {};
+        Benchmark::doNotOptimize( format.parse( dates[i].data(), dates[i].data() + dates[i].size(), date ) );
+        Benchmark::doNotOptimize( date );
+        i = ( i + 1 ) % n;
+    } );
+    benchmarks.run( "time/parseTimes", [&] () {
+        Fundamental::parseTimes( buffer.data(), offsets.data(), n, format, result.data() );
+        Benchmark::clobberMemory();
+    }, n );
+    benchmarks.run( "time/timegm", [&] () {
+        std::tm date = {};
+        date.tm_year = 100 + int( i % 30 );
+        date.tm_mon  = int( i % 12 );
+        date.tm_mday = 1 + int( i % 28 );
+        Benchmark::doNotOptimize( Fundamental::timegm( date ) );
+        i = ( i + 1 ) % n;
+    } );
+}
+
+
+std::vector< double > randomWalk( size_t const n )
+{
+    std::vector< double > x( n );
+    double value = 100;
+    for ( auto & element : x )
+    {
+        value += ( std::rand() / double( RAND_MAX ) - 0.5 );
+        element = value;
+    }
+    return x;
+}
+
+
+void benchmarkTimeSeries( Benchmarks & benchmarks )
+{
+    size_t const n = 100000;
+    auto const x = randomWalk( n );
+
+    for ( auto const nBarsLeftRight : { 10u, 100u } )
+    {
+        benchmarks.run( "findLocalExtrema/" + std::to_string( nBarsLeftRight ), [&] () {
+            Benchmark::doNotOptimize( Fundamental::findLocalExtrema( x, nBarsLeftRight ) );
+        }, n );
+        benchmarks.run( "LocalExtremaDetector/" + std::to_string( nBarsLeftRight ), [&] () {
+            Fundamental::LocalExtremaDetector< double > detector( nBarsLeftRight );
+            for ( auto const value : x )
+                Benchmark::doNotOptimize( detector.push( value ) );
+        }, n );
+    }
+
+    for ( auto const iStrategy : { 0, 1, 2 } )
+    {
+        for ( auto const nBarsMax : { size_t( 100 ), size_t( 1000 ) } )
+        {
+            benchmarks.run( "normalizeTimeSeries/" + std::to_string( iStrategy ) + "/"
+                            + std::to_string( nBarsMax ), [&] () {
+                Benchmark::doNotOptimize( Fundamental::normalizeTimeSeries( x, nBarsMax, iStrategy ) );
+            }, n );
+            /* the streaming version for comparison */
+            benchmarks.run( "TimeSeriesNormalizer/" + std::to_string( iStrategy ) + "/"
+                            + std::to_string( nBarsMax ), [&] () {
+                Fundamental::TimeSeriesNormalizer< double > normalizer( nBarsMax, iStrategy );
+                for ( auto const value : x )
+                    Benchmark::doNotOptimize( normalizer.push( value ) );
+            }, n );
+        }
+    }
+}
+
+
+void benchmarkLinearRegression( Benchmarks & benchmarks )
+{
+    for ( auto const n : { size_t( 16 ), size_t( 10000 ) } )
+    {
+        std::vector< double > x( n ), y( n );
+        for ( size_t i = 0u; i < n; ++i )
+        {
+            x[i] = i;
+            y[i] = 3 * i + std::rand() / double( RAND_MAX );
+        }
+        benchmarks.run( "fitLine/" + std::to_string( n ), [&] () {
+            Benchmark::doNotOptimize( Fundamental::fitLine( x, y ) );
+        }, n );
+        for ( auto const instructionSet : instructionSets() )
+        {
+            for ( auto const summation : { Fundamental::Summation::Plain, Fundamental::Summation::Compensated } )
+            {
+                benchmarks.run( "fitLine(LineFit)/" + std::to_string( n ) + "/" + Simd::toString( instructionSet )
+                                + ( summation == Fundamental::Summation::Compensated ? "/compensated" : "" ), [&] () {
+                    Benchmark::doNotOptimize( Fundamental::fitLine( x.data(), y.data(), n, summation, instructionSet ) );
+                }, n );
+            }
+        }
+    }
+
+    /* trailing window fits per bar, compared to refitting each window */
+    size_t const n = 10000;
+    std::vector< double > x( n ), y( n ), slopes( n ), offsets( n ), correlations( n );
+    for ( size_t i = 0u; i < n; ++i )
+    {
+        x[i] = i;
+        y[i] = 3 * i + std::rand() / double( RAND_MAX );
+    }
+    for ( auto const nWindow : { size_t( 20 ), size_t( 500 ) } )
+    {
+        benchmarks.run( "rollingFitLine/" + std::to_string( nWindow ), [&] () {
+            Fundamental::rollingFitLine( x.data(), y.data(), n, nWindow, slopes.data(), offsets.data(), correlations.data() );
+            Benchmark::clobberMemory();
+        }, n );
+        benchmarks.run( "fitLine(LineFit) per window/" + std::to_string( nWindow ), [&] () {
+            for ( size_t i = nWindow; i <= n; ++i )
+                slopes[ i - 1 ] = Fundamental::fitLine( x.data() + i - nWindow, y.data() + i - nWindow, nWindow ).slope;
+            Benchmark::clobberMemory();
+        }, n );
+    }
+
+    /* one parallel line per intraday session of minute bars sharing the x data */
+    for ( auto const nPerLine : { size_t( 390 ), size_t( 20000 ) } )
+    {
+        size_t const nLines = 390 * 300 / nPerLine;
+        std::vector< double > xLine( nPerLine );
+        for ( size_t i = 0u; i < nPerLine; ++i )
+            xLine[i] = 1.5e9 + 60. * i;
+        std::vector< std::vector< double > > yLines( nLines, std::vector< double >( nPerLine ) );
+        std::vector< std::vector< double > > wLines( nLines, std::vector< double >( nPerLine, 1 ) );
+        std::vector< std::vector< double > * > pX, pY;
+        std::vector< std::reference_wrapper< std::vector< double > > > rX, rY, rW;
+        for ( size_t j = 0u; j < nLines; ++j )
+        {
+            for ( size_t i = 0u; i < nPerLine; ++i )
+                yLines[j][i] = 1e-3 * xLine[i] + j + std::rand() / double( RAND_MAX );
+            pX.push_back( &xLine );
+            pY.push_back( &yLines[j] );
+            rX.push_back( xLine );
+            rY.push_back( yLines[j] );
+            rW.push_back( wLines[j] );
+        }
+        auto const suffix = "/" + std::to_string( nLines ) + "x" + std::to_string( nPerLine );
+        Fundamental::ThreadPool serial( 1 );
+        benchmarks.run( "fitParallelLines" + suffix + "/1 thread", [&] () {
+            Benchmark::doNotOptimize( Fundamental::fitParallelLines( pX, pY, serial ) );
+        }, nLines * nPerLine );
+        benchmarks.run( "fitParallelLines" + suffix, [&] () {
+            Benchmark::doNotOptimize( Fundamental::fitParallelLines( pX, pY ) );
+        }, nLines * nPerLine );
+        benchmarks.run( "fitParallelLines weighted" + suffix, [&] () {
+            Benchmark::doNotOptimize( Fundamental::fitParallelLines( rX, rY, rW ) );
+        }, nLines * nPerLine );
+    }
+}
+
+
+void benchmarkRandom( Benchmarks & benchmarks )
+{
+    size_t const n = 100000;
+    std::vector< double > x( n );
+
+    benchmarks.run( "random/std::rand", [&] () {
+        for ( auto & value : x )
+            value = std::rand();
+        Benchmark::clobberMemory();
+    }, n );
+    benchmarks.run( "random/fillUniform", [&] () {
+        threadLocalRandomGenerator().fillUniform( x.data(), n );
+        Benchmark::clobberMemory();
+    }, n );
+
+    RandomBitGenerator bits;
+    benchmarks.run( "random/RandomBitGenerator::decide", [&] () {
+        for ( size_t i = 0u; i < n; ++i )
+            Benchmark::doNotOptimize( bits.decide() );
+    }, n );
+}
+
+/** cost of a probe when INSTRUMENTATION_ENABLED is 1, the macros are empty otherwise */
+void benchmarkInstrumentation( Benchmarks & benchmarks )
+{
+    auto const & timer = Instrumentation::registerProbe( "benchmark/timer", Instrumentation::Kind::Timer );
+    auto const & counter = Instrumentation::registerProbe( "benchmark/counter", Instrumentation::Kind::Counter );
+    benchmarks.run( "instrumentation/ScopedTimer", [&] () {
+        Instrumentation::ScopedTimer const scopedTimer( timer );
+        Benchmark::clobberMemory();
+    } );
+    benchmarks.run( "instrumentation/count", [&] () {
+        Instrumentation::count( counter, 1 );
+    } );
+    benchmarks.run( "instrumentation/steady_clock::now", [&] () {
+        Benchmark::doNotOptimize( std::chrono::steady_clock::now() );
+    } );
+}
+
+void benchmarkStatistics( Benchmarks & benchmarks )
+{
+    for ( auto const n : { size_t( 1000 ), size_t( 1000000 ) } )
+    {
+        auto const x = randomWalk( n );
+        benchmarks.run( "mean+stddev/" + std::to_string( n ), [&] () {
+            Benchmark::doNotOptimize( mean( x ) );
+            Benchmark::doNotOptimize( stddev( x ) );
+        }, n );
+        for ( auto const instructionSet : instructionSets() )
+        {
+            benchmarks.run( "computeStatistics/" + std::to_string( n ) + "/" + Simd::toString( instructionSet ), [&] () {
+                Benchmark::doNotOptimize( Fundamental::computeStatistics( x.data(), n, instructionSet ) );
+            }, n );
+        }
+        benchmarks.run( "computeStatisticsParallel/" + std::to_string( n ), [&] () {
+            Benchmark::doNotOptimize( Fundamental::computeStatisticsParallel( x ) );
+        }, n );
+    }
+}
+
+
+
+void benchmarkMaxRelErr( Benchmarks & benchmarks )
+{
+    size_t const n = 1000000;
+    auto const x = randomWalk( n );
+    auto y = x;
+    for ( size_t i = 0u; i < n; i += 3 )
+        y[i] *= 1 + 1e-12;
+
+    benchmarks.run( "maxRelErr/runtime nanStrategy", [&] () {
+        Benchmark::doNotOptimize( maxRelErr( x, y, 3 ) );
+    }, n );
+    for ( auto const instructionSet : instructionSets() )
+    {
+        benchmarks.run( std::string( "maxRelErr<3>/" ) + Simd::toString( instructionSet ), [&] () {
+            Benchmark::doNotOptimize( maxRelErr< 3 >( x.data(), y.data(), n, instructionSet ) );
+        }, n );
+    }
+}
+
+/**
+ * 7-point stencil on a 3D grid which doesn't fit into the caches, with
+ * the loops always in the same order, i.e. only the memory layout changes
+ */
+template< typename T_Layout >
+void benchmarkStencil( Benchmarks & benchmarks, std::string const & name )
+{
+    unsigned int const n = 128;
+    T_Layout const layout( { n, n, n } );
+    std::vector< double > inData( layout.requiredSize(), 1 ), outData( layout.requiredSize() );
+    NdArrayView< double, 3, T_Layout > const in( inData.data(), layout ), out( outData.data(), layout );
+    auto const stencil = [&] ( unsigned int const i, unsigned int const j, unsigned int const k )
+    {
+        out( i, j, k ) = in( i, j, k ) - ( in( i - 1, j, k ) + in( i + 1, j, k ) + in( i, j - 1, k ) +
+                                           in( i, j + 1, k ) + in( i, j, k - 1 ) + in( i, j, k + 1 ) ) / 6;
+    };
+    benchmarks.run( "vectorIndex/stencil 128^3/" + name, [&] () {
+        for ( unsigned int i = 1u; i + 1 < n; ++i )
+        for ( unsigned int j = 1u; j + 1 < n; ++j )
+        for ( unsigned int k = 1u; k + 1 < n; ++k )
+            stencil( i, j, k );
+        Benchmark::clobberMemory();
+    }, size_t( n - 2 ) * ( n - 2 ) * ( n - 2 ) );
+    /* in blocks of 8^3 like for temporal blocking or sparse updates */
+    unsigned int const b = 8;
+    benchmarks.run( "vectorIndex/stencil 128^3 blocked/" + name, [&] () {
+        for ( unsigned int i0 = 0u; i0 < n; i0 += b )
+        for ( unsigned int j0 = 0u; j0 < n; j0 += b )
+        for ( unsigned int k0 = 0u; k0 < n; k0 += b )
+        for ( unsigned int i = std::max( i0, 1u ); i < std::min( i0 + b, n - 1 ); ++i )
+        for ( unsigned int j = std::max( j0, 1u ); j < std::min( j0 + b, n - 1 ); ++j )
+        for ( unsigned int k = std::max( k0, 1u ); k < std::min( k0 + b, n - 1 ); ++k )
+            stencil( i, j, k );
+        Benchmark::clobberMemory();
+    }, size_t( n - 2 ) * ( n - 2 ) * ( n - 2 ) );
+}
+
+void benchmarkTextParsing( Benchmarks & benchmarks )
+{
+    /* lines of a CSV file with prices and volumes */
+    std::string line;
+    size_t const nFields = 16;
+    for ( size_t i = 0u; i < nFields; ++i )
+        line += ( i > 0 ? "," : "" ) + std::to_string( 1000 + std::rand() % 100000 / 100. );
+
+    benchmarks.run( "text/split", [&] () {
+        Benchmark::doNotOptimize( split( line, ',' ) );
+    }, nFields );
+    benchmarks.run( "text/splitView", [&] () {
+        for ( auto const field : splitView( line, ',' ) )
+            Benchmark::doNotOptimize( field );
+    }, nFields );
+    auto const fields = split( line, ',' );
+    benchmarks.run( "text/toDouble", [&] () {
+        Benchmark::doNotOptimize( toDouble( fields.begin(), fields.end() ) );
+    }, nFields );
+    std::vector< double > values;
+    benchmarks.run( "text/parseDoubles", [&] () {
+        parseDoubles( line, ',', values );
+        Benchmark::doNotOptimize( values.data() );
+    }, nFields );
+
+    std::vector< std::pair< std::string, std::vector< double > > > table( 10 );
+    for ( size_t i = 0u; i < table.size(); ++i )
+    {
+        table[i].first = "column" + std::to_string( i );
+        for ( size_t j = 0u; j < 20000 - 1000 * i; ++j )
+            table[i].second.push_back( ( std::rand() - RAND_MAX / 2 ) / 1e3 );
+    }
+    auto const nCells = table.size() * table[0].second.size();
+    benchmarks.run( "text/dumpData", [&] () {
+        dumpData( "/tmp/benchmark-dumpData.dat", table );
+    }, nCells );
+    benchmarks.run( "text/dumpData/parallel", [&] () {
+        dumpData( "/tmp/benchmark-dumpData.dat", table, Fundamental::defaultThreadPool() );
+    }, nCells );
+    benchmarks.run( "text/dumpData/reload", [&] () {
+        std::ifstream file( "/tmp/benchmark-dumpData.dat" );
+        std::string row;
+        double sum = 0;
+        while ( std::getline( file, row ) )
+        {
+            if ( row.empty() || row[0] == '#' )
+                continue;
+            for ( auto const field : splitView( row, ' ' ) )
+            {
+                double value = 0;
+                if ( parseDouble( field.data(), field.data() + field.size(), value ) != field.data() )
+                    sum += value;
+            }
+        }
+        Benchmark::doNotOptimize( sum );
+    }, nCells );
+    std::remove( "/tmp/benchmark-dumpData.dat" );
+
+    benchmarks.run( "binary/dumpBinaryData", [&] () {
+        Fundamental::dumpBinaryData( "/tmp/benchmark-dumpData.bin", table );
+    }, nCells );
+    benchmarks.run( "binary/dumpBinaryData/reload", [&] () {
+        Fundamental::MappedColumnarFile const file( "/tmp/benchmark-dumpData.bin" );
+        double sum = 0;
+        for ( size_t i = 0u; i < file.size(); ++i )
+            for ( auto const value : file.column< double >( i ) )
+                sum += value;
+        Benchmark::doNotOptimize( sum );
+    }, nCells );
+    std::remove( "/tmp/benchmark-dumpData.bin" );
+
+    /* a day of ticks with one time stamp column */
+    size_t const nRows = 200000;
+    {
+        std::ofstream file( "/tmp/benchmark-ticks.csv" );
+        file << "time,bid,ask,last,volume\n";
+        for ( size_t i = 0u; i < nRows; ++i )
+            file << "2017-06-01 " << 10 + i / 3600 % 10 << ":" << i / 60 % 50 + 10 << ":" << i % 50 + 10 << ","
+                 << 1000 + std::rand() % 100000 / 100. << "," << 1000 + std::rand() % 100000 / 100. << ","
+                 << 1000 + std::rand() % 100000 / 100. << "," << std::rand() % 1000 << "\n";
+    }
+    benchmarks.run( "text/csv/getline+parseDoubles+parseTime", [&] () {
+        std::ifstream file( "/tmp/benchmark-ticks.csv" );
+        Fundamental::CompiledDateFormat const format( "%Y-%m-%d %H:%M:%S" );
+        std::string row;
+        std::vector< double > values;
+        double sum = 0;
+        std::getline( file, row );
+        while ( std::getline( file, row ) )
+        {
+            auto const iDelimiter = row.find( ',' );
+            parseDoubles( row.substr( iDelimiter + 1 ), ',', values );
+            sum += format.parseTime( row.data(), row.data() + iDelimiter ) + values[0];
+        }
+        Benchmark::doNotOptimize( sum );
+    }, nRows );
+    benchmarks.run( "text/csv/CsvReader", [&] () {
+        Fundamental::CsvReader reader( "/tmp/benchmark-ticks.csv" );
+        reader.setDateFormat( "time", "%Y-%m-%d %H:%M:%S" );
+        Fundamental::CsvBatch batch;
+        double sum = 0;
+        while ( reader.read( batch ) )
+            for ( size_t i = 0u; i < batch.nRows; ++i )
+                sum += batch.columns[0][i] + batch.columns[1][i];
+        Benchmark::doNotOptimize( sum );
+    }, nRows );
+    std::remove( "/tmp/benchmark-ticks.csv" );
+}
+
+void benchmarkToString( Benchmarks & benchmarks )
+{
+    size_t const n = 10000;
+    std::vector< std::pair< int, double > > pairs( n );
+    for ( size_t i = 0u; i < n; ++i )
+        pairs[i] = { std::rand(), std::rand() / double( RAND_MAX ) };
+
+    benchmarks.run( "toString/vector<pair<int,double>>", [&] () {
+        Benchmark::doNotOptimize( toString( pairs ) );
+    }, n );
+    TextBuffer text;
+    benchmarks.run( "toString/appendString into one buffer", [&] () {
+        text.clear();
+        appendString( text, pairs );
+        Benchmark::doNotOptimize( text.data() );
+    }, n );
+}
+
+void benchmarkVectorIndex( Benchmarks & benchmarks )
+{
+    std::vector< unsigned int > const size = { 37, 101, 53 };
+    size_t const n = size[0] * size[1] * size[2];
+    std::vector< std::vector< unsigned int > > indexes;
+    for ( size_t i = 0u; i < n; i += 97 )
+        indexes.push_back( convertLinearToVectorIndex( i, size ) );
+
+    size_t i = 0;
+    benchmarks.run( "vectorIndex/convertVectorToLinearIndex/3D", [&] () {
+        Benchmark::doNotOptimize( convertVectorToLinearIndex( indexes[i], size ) );
+        if ( ++i == indexes.size() ) i = 0;
+    } );
+    size_t iLinear = 0;
+    benchmarks.run( "vectorIndex/convertLinearToVectorIndex/3D", [&] () {
+        Benchmark::doNotOptimize( convertLinearToVectorIndex( iLinear, size ) );
+        if ( ( iLinear += 97 ) >= n ) iLinear -= n;
+    } );
+
+    VectorIndexer< 3, unsigned int > const indexer( { 37, 101, 53 } );
+    using StaticIndexer = StaticVectorIndexer< unsigned int, 37, 101, 53 >;
+    std::vector< StaticIndexer::Index > arrayIndexes;
+    for ( auto const & index : indexes )
+        arrayIndexes.push_back( {{ index[0], index[1], index[2] }} );
+    benchmarks.run( "vectorIndex/VectorIndexer::toLinearIndex/3D", [&] () {
+        Benchmark::doNotOptimize( indexer.toLinearIndex( arrayIndexes[i] ) );
+        if ( ++i == arrayIndexes.size() ) i = 0;
+    } );
+    benchmarks.run( "vectorIndex/VectorIndexer::toVectorIndex/3D", [&] () {
+        Benchmark::doNotOptimize( indexer.toVectorIndex( iLinear ) );
+        if ( ( iLinear += 97 ) >= n ) iLinear -= n;
+    } );
+    benchmarks.run( "vectorIndex/StaticVectorIndexer::toLinearIndex/3D", [&] () {
+        Benchmark::doNotOptimize( StaticIndexer::toLinearIndex( arrayIndexes[i] ) );
+        if ( ++i == arrayIndexes.size() ) i = 0;
+    } );
+    benchmarks.run( "vectorIndex/StaticVectorIndexer::toVectorIndex/3D", [&] () {
+        Benchmark::doNotOptimize( StaticIndexer::toVectorIndex( iLinear ) );
+        if ( ( iLinear += 97 ) >= n ) iLinear -= n;
+    } );
+
+    /* traversals of the whole grid */
+    benchmarks.run( "vectorIndex/traversal/convertLinearToVectorIndex", [&] () {
+        for ( size_t iElement = 0u; iElement < n; ++iElement )
+            Benchmark::doNotOptimize( convertLinearToVectorIndex( iElement, size )[2] );
+    }, n );
+    benchmarks.run( "vectorIndex/traversal/VectorIndexer::toVectorIndex", [&] () {
+        for ( unsigned int iElement = 0u; iElement < n; ++iElement )
+            Benchmark::doNotOptimize( indexer.toVectorIndex( iElement )[2] );
+    }, n );
+    VectorIndexRange< 3, unsigned int > const range( { 37, 101, 53 } );
+    benchmarks.run( "vectorIndex/traversal/VectorIndexRange", [&] () {
+        for ( auto const & element : range )
+            Benchmark::doNotOptimize( element.vecIndex[2] );
+    }, n );
+
+    benchmarkStencil< RowMajorLayout   < 3, unsigned int > >( benchmarks, "row-major"    );
+    benchmarkStencil< ColumnMajorLayout< 3, unsigned int > >( benchmarks, "column-major" );
+    benchmarkStencil< TiledLayout   < 3, 3, unsigned int > >( benchmarks, "tiled 8^3"    );
+    benchmarkStencil< MortonLayout     < 3, unsigned int > >( benchmarks, "Morton"       );
+}
+
+
+} // anonymous namespace
+
+
+int main( int argc, char ** argv )
+{
+    bool json = false;
+    Benchmarks benchmarks;
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( std::strcmp( argv[i], "--json" ) == 0 )
+            json = true;
+        else
+            benchmarks.filter = argv[i];
+    }
+
+    benchmarkBitFunctions     ( benchmarks );
+    benchmarkParseTime        ( benchmarks );
+    benchmarkTimeSeries       ( benchmarks );
+    benchmarkLinearRegression ( benchmarks );
+    benchmarkRandom           ( benchmarks );
+    benchmarkInstrumentation  ( benchmarks );
+    benchmarkStatistics       ( benchmarks );
+    benchmarkMaxRelErr        ( benchmarks );
+    benchmarkVectorIndex      ( benchmarks );
+    benchmarkTextParsing      ( benchmarks );
+    benchmarkToString         ( benchmarks );
+
+    if ( json )
+        Benchmark::printJson( std::cout, benchmarks.results );
+    else
+    {
+        std::cout << "Instruction set: " << Simd::toString( Simd::instructionSet() ) << "\n";
+        Benchmark::printTable( std::cout, benchmarks.results );
+    }
+
+    return 0;
+}
@@ -1,8 +1,28 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 -rdynamic exceptionBacktrace.hpp -DMAIN_TEST_EXCEPTIONBACKTRACE -DEXCEPTIONBACKTRACE_THROW_SITES -pthread -ldl && ./a.out
+*/
+#pragma once
 
 /**
  * Show backtrace for exceptions otherwise not easily locatable -.-
  * Frigging exceptions.
  * https://stackoverflow.com/questions/2443135/how-do-i-find-where-an-exception-was-thrown-in-c
+ *
+ * Including this header installs my_terminate for uncaught exceptions and
+ * crit_err_hdlr for SIGSEGV, SIGBUS, SIGFPE, SIGILL and SIGABRT, unless
+ * other handlers were already installed, e.g. by sanitizers.
+ * The signal handler is async-signal-safe, i.e., it only uses write(2),
+ * backtrace_symbols_fd and static buffers, so that it can't deadlock on
+ * locks held by the crashed thread, e.g. inside malloc. It runs on an
+ * alternate signal stack, so that also stack overflows are reported.
+ * Other threads which should report stack overflows need to call
+ * Backtrace::installAlternateSignalStack themselves.
+ *
+ * Define EXCEPTIONBACKTRACE_THROW_SITES to also record the backtrace of
+ * each throw by wrapping __cxa_throw, which needs dynamic linking against
+ * libstdc++ and -ldl for glibc older than 2.34. Recording costs a few
+ * microseconds per throw, the addresses are only symbolized when printed.
+ * Link with -rdynamic to get function names instead of only offsets.
  */
 
 #ifndef _GNU_SOURCE
@@ -15,91 +35,565 @@
 #include <execinfo.h>
 #include <signal.h>
 #include <string.h>
+#include <ucontext.h>
+#include <unistd.h>                     // write, _exit, pause
 
-#include <iostream>
+#include <atomic>
 #include <cstdlib>
+#include <exception>                    // current_exception, set_terminate
+#include <memory>                       // unique_ptr
 #include <stdexcept>
 
-void my_terminate(void);
+#ifdef EXCEPTIONBACKTRACE_THROW_SITES
+#   include <dlfcn.h>                   // dlsym
+#   include <mutex>
+#   include <string>
+#   include <unordered_map>
+#   include <vector>
+#endif
+
+
+inline void my_terminate(void);
+inline void crit_err_hdlr(int sig_num, siginfo_t * info, void * ucontext);
+
+
+namespace Backtrace {
+
+
+size_t constexpr nMaxFrames = 64;
+
+/** much more than MINSIGSTKSZ, because backtrace_symbols_fd needs some stack */
+size_t constexpr nAlternateStackBytes = 64 * 1024;
+
+
+namespace detail {
+
+
+/* async-signal-safe output, i.e., without locks and allocations */
+
+inline void writeString( char const * string, size_t n )
+{
+    while ( n > 0 )
+    {
+        auto const nWritten = write( STDERR_FILENO, string, n );
+        if ( nWritten <= 0 )
+            return;
+        string += nWritten;
+        n -= size_t( nWritten );
+    }
+}
+
+inline void writeString( char const * const string ) { writeString( string, strlen( string ) ); }
+
+inline void writeNumber( unsigned long long x, unsigned int const base = 10 )
+{
+    char digits[32];
+    auto p = digits + sizeof( digits );
+    *--p = '\0';
+    do
+    {
+        *--p = "0123456789abcdef"[ x % base ];
+        x /= base;
+    } while ( x != 0 );
+    if ( base == 16 )
+    {
+        *--p = 'x';
+        *--p = '0';
+    }
+    writeString( p );
+}
+
+inline void writeAddress( void const * const address )
+{
+    writeNumber( reinterpret_cast< unsigned long long >( address ), 16 );
+}
+
+/* strsignal isn't async-signal-safe, because it may format into a buffer for unknown signals */
+inline char const * signalName( int const signal )
+{
+    switch ( signal )
+    {
+        case SIGSEGV: return "SIGSEGV";
+        case SIGBUS : return "SIGBUS";
+        case SIGFPE : return "SIGFPE";
+        case SIGILL : return "SIGILL";
+        case SIGABRT: return "SIGABRT";
+        default     : return "unknown signal";
+    }
+}
+
+/* instruction pointer at the time the signal was raised */
+inline void * callerAddress( void * const ucontext )
+{
+    auto const context = static_cast< ucontext_t * >( ucontext );
+#if defined( __x86_64__ )
+    return reinterpret_cast< void * >( context->uc_mcontext.gregs[ REG_RIP ] );
+#elif defined( __i386__ )
+    return reinterpret_cast< void * >( context->uc_mcontext.gregs[ REG_EIP ] );
+#elif defined( __aarch64__ )
+    return reinterpret_cast< void * >( context->uc_mcontext.pc );
+#else
+    (void) context;
+    return nullptr;
+#endif
+}
+
+/** set by the first crashing thread, so that further ones don't mix their output in */
+inline std::atomic_flag & crashing( void )
+{
+    static std::atomic_flag flag = ATOMIC_FLAG_INIT;
+    return flag;
+}
+
+/* written to by the signal handler, i.e., must not be on the possibly overflown stack */
+inline void ** crashFrames( void )
+{
+    static void * frames[ nMaxFrames ];
+    return frames;
+}
+
+/**
+ * Owns the alternate signal stack of a thread and unregisters it before
+ * freeing it at thread exit, so that a crash during the remaining TLS or
+ * static destruction runs the handler on the normal stack instead of on
+ * freed memory.
+ */
+class AlternateStack
+{
+private:
+    std::unique_ptr< char[] > memory;
+
+public:
+    inline void install( void )
+    {
+        memory.reset( new char[ nAlternateStackBytes ] );
+        stack_t stack;
+        stack.ss_sp    = memory.get();
+        stack.ss_size  = nAlternateStackBytes;
+        stack.ss_flags = 0;
+        sigaltstack( &stack, nullptr );
+    }
+
+    inline ~AlternateStack()
+    {
+        stack_t current;
+        if ( not memory || sigaltstack( nullptr, &current ) != 0 || current.ss_sp != memory.get() )
+            return;
+        stack_t disabled;
+        memset( &disabled, 0, sizeof( disabled ) );
+        disabled.ss_flags = SS_DISABLE;
+        sigaltstack( &disabled, nullptr );
+    }
+};
+
+
+} // namespace detail
+
+
+#ifdef EXCEPTIONBACKTRACE_THROW_SITES
+
+struct ThrowSite
+{
+    void * frames[ nMaxFrames ];
+    int    nFrames;
+};
+
+/** backtrace of the last exception thrown by the calling thread */
+inline ThrowSite & lastThrowSite( void )
+{
+    /* plain old data, i.e., no initialization guard on each access */
+    thread_local ThrowSite site{};
+    return site;
+}
+
+/**
+ * Symbolizes like backtrace_symbols, but caches the result per address,
+ * because backtrace_symbols parses the symbol tables on each call. Not
+ * async-signal-safe!
+ */
+inline std::vector< std::string > symbolize( void * const * const frames, int const nFrames )
+{
+    static std::mutex mutex;
+    static std::unordered_map< void *, std::string > cache;
+
+    std::vector< std::string > result;
+    std::lock_guard< std::mutex > lock( mutex );
+    for ( int i = 0; i < nFrames; ++i )
+    {
+        auto it = cache.find( frames[i] );
+        if ( it == cache.end() )
+        {
+            auto const symbols = backtrace_symbols( frames + i, 1 );
+            it = cache.emplace( frames[i], symbols == nullptr ? "?" : symbols[0] ).first;
+            free( symbols );
+        }
+        result.push_back( it->second );
+    }
+    return result;
+}
+
+/** e.g. for logging where a caught exception came from */
+inline std::vector< std::string > lastThrowBacktrace( void )
+{
+    auto const & site = lastThrowSite();
+    return symbolize( site.frames, site.nFrames );
+}
+
+#endif  // EXCEPTIONBACKTRACE_THROW_SITES
+
+
+/**
+ * Needs to be called by every thread which should report stack overflows,
+ * because the alternate stack is per thread. Does nothing if the thread
+ * already has one.
+ */
+inline void installAlternateSignalStack( void )
+{
+    stack_t current;
+    if ( sigaltstack( nullptr, &current ) != 0 || ( current.ss_flags & SS_DISABLE ) == 0 )
+        return;
+
+    thread_local detail::AlternateStack stack;
+    stack.install();
+}
+
+/**
+ * Installs crit_err_hdlr for each crash signal which still has its default
+ * action. Called when including this header.
+ * @return true if crit_err_hdlr handles at least one signal
+ */
+inline bool installSignalHandlers( void )
+{
+    /* backtrace loads libgcc_s on the first call, which allocates, so do it now instead of in the handler */
+    void * frame;
+    backtrace( &frame, 1 );
+    installAlternateSignalStack();
+
+    struct sigaction action;
+    memset( &action, 0, sizeof( action ) );
+    action.sa_sigaction = crit_err_hdlr;
+    sigemptyset( &action.sa_mask );
+    action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+
+    bool installed = false;
+    for ( auto const signalNumber : { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT } )
+    {
+        struct sigaction previous;
+        if ( sigaction( signalNumber, nullptr, &previous ) != 0 )
+            continue;
+        if ( ( previous.sa_flags & SA_SIGINFO ) != 0 && previous.sa_sigaction == crit_err_hdlr )
+            installed = true;
+        else if ( ( previous.sa_flags & SA_SIGINFO ) == 0 && previous.sa_handler == SIG_DFL )
+            installed |= sigaction( signalNumber, &action, nullptr ) == 0;
+    }
+    return installed;
+}
+
+
+} // namespace Backtrace
+
 
 namespace
 {
     // invoke set_terminate as part of global constant initialization
     static const bool SET_TERMINATE = std::set_terminate(my_terminate);
+    static const bool SET_SIGNAL_HANDLERS = Backtrace::installSignalHandlers();
 }
 
-// This structure mirrors the one found in /usr/include/asm/ucontext.h
-typedef struct _sig_ucontext {
-   unsigned long     uc_flags;
-   struct ucontext   *uc_link;
-   stack_t           uc_stack;
-   struct sigcontext uc_mcontext;
-   sigset_t          uc_sigmask;
-} sig_ucontext_t;
-
-void crit_err_hdlr(int sig_num, siginfo_t * info, void * ucontext)
+/**
+ * Prints the signal, the faulting address and the backtrace, then re-raises
+ * the signal with the default action, i.e., the process terminates with
+ * the same status and core dump as without this handler.
+ */
+inline void crit_err_hdlr(int sig_num, siginfo_t * info, void * ucontext)
 {
-    sig_ucontext_t * uc = (sig_ucontext_t *)ucontext;
+    using namespace Backtrace::detail;
 
-    // Get the address at the time the signal was raised from the EIP (x86)
-    void * caller_address = (void *) uc->uc_mcontext.eip;
+    /* another thread is already reporting and will terminate the process */
+    if ( crashing().test_and_set() )
+    {
+        while ( true )
+            pause();
+    }
 
-    std::cerr << "signal " << sig_num
-              << " (" << strsignal(sig_num) << "), address is "
-              << info->si_addr << " from "
-              << caller_address << std::endl;
+    void * const caller_address = callerAddress( ucontext );
 
-    void * array[50];
-    int size = backtrace(array, 50);
+    writeString( "signal " );
+    writeNumber( unsigned( sig_num ) );
+    writeString( " (" );
+    writeString( signalName( sig_num ) );
+    writeString( "), address is " );
+    writeAddress( info->si_addr );
+    writeString( " from " );
+    writeAddress( caller_address );
+    writeString( "\n" );
 
-    std::cerr << __FUNCTION__ << " backtrace returned "
-              << size << " frames\n\n";
+    auto const array = crashFrames();
+    int const size = backtrace( array, int( Backtrace::nMaxFrames ) );
 
-    // overwrite sigaction with caller's address
-    array[1] = caller_address;
+    writeString( "crit_err_hdlr backtrace returned " );
+    writeNumber( unsigned( size ) );
+    writeString( " frames\n\n" );
 
-    char ** messages = backtrace_symbols(array, size);
+    // overwrite sigaction with caller's address
+    if ( size > 1 && caller_address != nullptr )
+        array[1] = caller_address;
 
     // skip first stack frame (points here)
-    for (int i = 1; i < size && messages != NULL; ++i) {
-        std::cerr << "[bt]: (" << i << ") " << messages[i] << std::endl;
+    if ( size > 1 )
+        backtrace_symbols_fd( array + 1, size - 1, STDERR_FILENO );
+    writeString( "\n" );
+
+    /* the signal is blocked while its handler runs */
+    signal( sig_num, SIG_DFL );
+    sigset_t signals;
+    sigemptyset( &signals );
+    sigaddset( &signals, sig_num );
+    pthread_sigmask( SIG_UNBLOCK, &signals, nullptr );
+    raise( sig_num );
+    _exit( EXIT_FAILURE );
+}
+
+/**
+ * Prints the uncaught exception and the backtrace and, if recorded, where
+ * it was thrown from. Only uses write(2), because terminate may also be
+ * called after heap corruption or from within noexcept destructors.
+ */
+inline void my_terminate()
+{
+    using namespace Backtrace::detail;
+
+    auto const exception = std::current_exception();
+    if ( exception ) {
+        try {
+            std::rethrow_exception( exception );
+        }
+        catch ( std::exception const & e ) {
+            writeString( __FUNCTION__ );
+            writeString( " caught unhandled exception. what(): " );
+            writeString( e.what() );
+            writeString( "\n" );
+        }
+        catch ( ... ) {
+            writeString( __FUNCTION__ );
+            writeString( " caught unknown/unhandled exception.\n" );
+        }
     }
-    std::cerr << std::endl;
 
-    free(messages);
+#ifdef EXCEPTIONBACKTRACE_THROW_SITES
+    auto const & site = Backtrace::lastThrowSite();
+    if ( exception && site.nFrames > 0 ) {
+        writeString( __FUNCTION__ );
+        writeString( " last throw site backtrace:\n" );
+        backtrace_symbols_fd( site.frames, site.nFrames, STDERR_FILENO );
+        writeString( "\n" );
+    }
+#endif
+
+    void * array[ Backtrace::nMaxFrames ];
+    int const size = backtrace( array, int( Backtrace::nMaxFrames ) );
 
-    exit(EXIT_FAILURE);
+    writeString( __FUNCTION__ );
+    writeString( " backtrace returned " );
+    writeNumber( unsigned( size ) );
+    writeString( " frames\n\n" );
+    backtrace_symbols_fd( array, size, STDERR_FILENO );
+    writeString( "\n" );
+
+    /* the backtrace was just printed, don't print another one from crit_err_hdlr */
+    signal( SIGABRT, SIG_DFL );
+    abort();
 }
 
-void my_terminate()
+
+#ifdef EXCEPTIONBACKTRACE_THROW_SITES
+
+/**
+ * Records the backtrace and forwards to the __cxa_throw of libstdc++. Weak,
+ * so that including this header in several translation units links. Aborts
+ * if libstdc++ is linked statically, because there is nothing to forward
+ * to. The type_info is void *, because GCC implicitly declares it like that
+ * for throw expressions.
+ */
+extern "C" __attribute__(( weak, noreturn ))
+void __cxa_throw( void * exception, void * type, void ( * destructor )( void * ) )
 {
-    static bool tried_throw = false;
-    try {
-        // try once to re-throw currently active exception -> why?
-        if (!tried_throw++) throw;
+    auto & site = Backtrace::lastThrowSite();
+    site.nFrames = backtrace( site.frames, int( Backtrace::nMaxFrames ) );
+
+    using Throw = void (*)( void *, void *, void (*)( void * ) );
+    static auto const original = reinterpret_cast< Throw >( dlsym( RTLD_NEXT, "__cxa_throw" ) );
+    /* e.g. with a statically linked libstdc++, whose __cxa_throw this replaced */
+    if ( original == nullptr )
+    {
+        Backtrace::detail::writeString( "__cxa_throw of the C++ runtime not found, "
+                                        "EXCEPTIONBACKTRACE_THROW_SITES needs a shared libstdc++\n" );
+        abort();
     }
-    catch ( std::exception const & e ) {
-        std::cerr << __FUNCTION__ << " caught unhandled exception. what(): "
-                  << e.what() << std::endl;
+    original( exception, type, destructor );
+    __builtin_unreachable();
+}
+
+#endif  // EXCEPTIONBACKTRACE_THROW_SITES
+
+
+#ifdef MAIN_TEST_EXCEPTIONBACKTRACE
+
+
+#include <sys/wait.h>                   // waitpid
+
+#include <iostream>
+#include <thread>
+
+
+/* not static or in an anonymous namespace, so that -rdynamic exports their names,
+ * cold so that GCC doesn't move the throw into a local .cold clone */
+__attribute__(( noinline, cold )) void exceptionBacktraceTestThrow( int const i )
+{
+    if ( i >= 0 )
+        throw std::runtime_error( "boom" );
+}
+
+int volatile exceptionBacktraceTestMaxDepth = 1 << 30;
+
+__attribute__(( noinline )) int exceptionBacktraceTestOverflowStack( int const depth )
+{
+    volatile char buffer[1024];
+    buffer[0] = char( depth );
+    return depth >= exceptionBacktraceTestMaxDepth ? 0 : exceptionBacktraceTestOverflowStack( depth + 1 ) + buffer[0];
+}
+
+
+namespace {
+
+
+/** @return the stderr output of crash run in a child process and its wait status */
+template< typename T_Functor >
+std::string runInChild( T_Functor && crash, int & status )
+{
+    int pipeEnds[2];
+    if ( pipe( pipeEnds ) != 0 )
+        return "";
+    auto const pid = fork();
+    if ( pid == 0 )
+    {
+        dup2( pipeEnds[1], STDERR_FILENO );
+        close( pipeEnds[0] );
+        crash();
+        _exit( 0 );
     }
-    catch ( ... ) {
-        std::cerr << __FUNCTION__ << " caught unknown/unhandled exception.\n";
+    close( pipeEnds[1] );
+
+    std::string output;
+    char buffer[4096];
+    ssize_t nRead;
+    while ( ( nRead = read( pipeEnds[0], buffer, sizeof( buffer ) ) ) > 0 )
+        output.append( buffer, size_t( nRead ) );
+    close( pipeEnds[0] );
+    waitpid( pid, &status, 0 );
+    return output;
+}
+
+/* destroyed after the alternate stack of its thread if constructed before it */
+struct AlternateStackCheck
+{
+    bool * disabledAtExit = nullptr;
+
+    ~AlternateStackCheck()
+    {
+        stack_t current;
+        if ( disabledAtExit != nullptr )
+            *disabledAtExit = sigaltstack( nullptr, &current ) == 0 && ( current.ss_flags & SS_DISABLE ) != 0;
+    }
+};
+
+size_t countOccurrences( std::string const & haystack, std::string const & needle )
+{
+    size_t n = 0;
+    for ( auto i = haystack.find( needle ); i != std::string::npos; i = haystack.find( needle, i + 1 ) )
+        ++n;
+    return n;
+}
+
+bool testExceptionBacktrace( void )
+{
+    bool success = true;
+    int status = 0;
+
+    if ( ! SET_SIGNAL_HANDLERS )
+    {
+        std::cout << "Signal handlers weren't installed, e.g. because of sanitizers\n";
+        return false;
     }
 
-    void * array[50];
-    int size = backtrace(array, 50);
+    auto output = runInChild( [] () { *static_cast< int volatile * >( nullptr ) = 1; }, status );
+    success &= output.find( "signal 11 (SIGSEGV), address is 0x0 from 0x" ) == 0;
+    success &= countOccurrences( output, "backtrace returned" ) == 1;
+    success &= WIFSIGNALED( status ) && WTERMSIG( status ) == SIGSEGV;
 
-    std::cerr << __FUNCTION__ << " backtrace returned "
-              << size << " frames\n\n";
+    /* needs the alternate stack */
+    output = runInChild( [] () { exceptionBacktraceTestOverflowStack( 0 ); }, status );
+    success &= output.find( "(SIGSEGV)" ) != std::string::npos &&
+               output.find( "exceptionBacktraceTestOverflowStack" ) != std::string::npos;
+    success &= WIFSIGNALED( status ) && WTERMSIG( status ) == SIGSEGV;
 
-    char ** messages = backtrace_symbols(array, size);
+    /* the alternate stack is unregistered before it is freed at thread exit */
+    bool disabledAtExit = false;
+    std::thread( [&] () {
+        thread_local AlternateStackCheck check;
+        check.disabledAtExit = &disabledAtExit;
+        Backtrace::installAlternateSignalStack();
+    } ).join();
+    success &= disabledAtExit;
 
-    for (int i = 0; i < size && messages != NULL; ++i) {
-        std::cerr << "[bt]: (" << i << ") " << messages[i] << std::endl;
+    output = runInChild( [] () { abort(); }, status );
+    success &= output.find( "(SIGABRT)" ) != std::string::npos;
+    success &= WIFSIGNALED( status ) && WTERMSIG( status ) == SIGABRT;
+
+    /* only one thread reports */
+    output = runInChild( [] () {
+        std::thread other( [] () { *static_cast< int volatile * >( nullptr ) = 2; } );
+        *static_cast< int volatile * >( nullptr ) = 1;
+        other.join();
+    }, status );
+    success &= countOccurrences( output, "backtrace returned" ) == 1;
+    success &= WIFSIGNALED( status ) && WTERMSIG( status ) == SIGSEGV;
+
+    /* uncaught exceptions print only the terminate backtrace */
+    output = runInChild( [] () { exceptionBacktraceTestThrow( 1 ); }, status );
+    success &= output.find( "my_terminate caught unhandled exception. what(): boom\n" ) == 0;
+    success &= countOccurrences( output, "backtrace returned" ) == 1;
+    success &= WIFSIGNALED( status ) && WTERMSIG( status ) == SIGABRT;
+#ifdef EXCEPTIONBACKTRACE_THROW_SITES
+    success &= output.find( "last throw site backtrace:\n" ) != std::string::npos;
+
+    /* throw sites of caught exceptions */
+    try
+    {
+        exceptionBacktraceTestThrow( 2 );
     }
-    std::cerr << std::endl;
+    catch ( std::runtime_error const & )
+    {
+        auto const frames = Backtrace::lastThrowBacktrace();
+        bool found = false;
+        for ( auto const & frame : frames )
+            found |= frame.find( "exceptionBacktraceTestThrow" ) != std::string::npos;
+        success &= found && frames == Backtrace::lastThrowBacktrace();
+    }
+#endif
 
-    free(messages);
+    std::cout << "exceptionBacktrace " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
 
-    abort();
+
+} // namespace
+
+
+int main()
+{
+    testExceptionBacktrace();
 }
+
+
+#endif
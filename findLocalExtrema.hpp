@@ -1,14 +1,27 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 findLocalExtrema.hpp -DMAIN_TEST_FINDLOCALEXTREMA && ./a.out
+*/
 #pragma once
 
-#include <cmath>
+#include <cstddef>                      // size_t
 #include <utility>
 #include <vector>
 
+#include "RollingWindow.hpp"
+
 
 namespace Fundamental {
 
 
 
+/** min/max pair of index/value pairs */
+template< typename T >
+using LocalExtrema = std::pair<
+    std::pair< std::vector< size_t >, std::vector< T > >, /* Minimums */
+    std::pair< std::vector< size_t >, std::vector< T > >  /* Maximums */
+>;
+
+
 /**
  * Returns index and values of all value in original data set which are
  * extremal in index +- nBarsLeftRight
@@ -18,50 +31,210 @@ namespace Fundamental {
  *            out of fractal data we want to zoom.
  *            The larger the value the more values at the start and end of
  *            the input data set will have to be ignored!
- * @return min/max pair of index/value pairs
+ * @return min/max pair of index/value pairs. If multiple values in a
+ *         window are equally extremal, all of them are returned.
+ *         NaN values are ignored. Runs in O(x.size()) independent of
+ *         nBarsLeftRight.
  */
 template< typename T >
+inline LocalExtrema< T > findLocalExtrema
+(
+    std::vector< T > const & x,
+    unsigned int     const   nBarsLeftRight
+)
+{
+    std::vector< size_t > viMin, viMax;
+    std::vector< T >       vMin,  vMax;
+
+    /* The old implementation rescanned the whole window for each value,
+     * which is O(n nBarsLeftRight). NaN never compares equal, so it won't be
+     * returned, but ignored when finding the extrema around it. */
+    forEachWindowMinMax( x.data(), x.size(), 2 * size_t( nBarsLeftRight ) + 1,
+        [&] ( size_t const iBegin, T const & min, T const & max )
+        {
+            auto const i = iBegin + nBarsLeftRight;
+            if ( min == x[i] )
+            {
+                viMin.push_back( i );
+                 vMin.push_back( x[i] );
+            }
+            if ( max == x[i] )
+            {
+                viMax.push_back( i );
+                 vMax.push_back( x[i] );
+            }
+        }
+    );
+
+    return { { viMin, vMin }, { viMax, vMax } };
+}
+
+/**
+ * Incremental version of findLocalExtrema for data arriving one bar at a
+ * time, e.g. live feeds. Each push costs amortized O(1) and the state is
+ * O(nBarsLeftRight), independent of the number of bars pushed so far.
+ *
+ * A bar can only be confirmed as extremum when nBarsLeftRight bars after it
+ * have arrived, so push returns the verdict for the bar pushed
+ * nBarsLeftRight calls earlier. Collecting all confirmed extrema yields the
+ * same results as findLocalExtrema on the whole history.
+ */
+template< typename T >
+class LocalExtremaDetector
+{
+public:
+    struct Verdict
+    {
+        bool   isMinimum;
+        bool   isMaximum;
+        size_t index    ;  /**< of the judged bar, counting pushes from 0 */
+        T      value    ;  /**< of the judged bar */
+    };
+
+private:
+    unsigned int     const nBarsLeftRight;
+    size_t                 nPushed       ;
+    RollingMinMax< T >     window        ;
+    RingBuffer< T >        lastValues    ;  /**< the last nBarsLeftRight + 1 bars */
+
+public:
+    inline explicit LocalExtremaDetector( unsigned int const rnBarsLeftRight )
+    : nBarsLeftRight( rnBarsLeftRight ),
+      nPushed( 0 ),
+      window( 2 * size_t( rnBarsLeftRight ) + 1 ),
+      lastValues( size_t( rnBarsLeftRight ) + 1 )
+    {}
+
+    /**
+     * @return isMinimum and isMaximum are false as long as less than
+     *         2 * nBarsLeftRight + 1 bars were pushed, i.e. for bars without
+     *         enough neighbors to the left.
+     */
+    inline Verdict push( T const & value )
+    {
+        window.push( value );
+        if ( lastValues.size() > nBarsLeftRight )
+            lastValues.popFront();
+        lastValues.pushBack( value );
+        ++nPushed;
+
+        Verdict verdict = { false, false, 0, lastValues.front() };
+        if ( nPushed < window.window() )
+            return verdict;
+
+        verdict.index     = nPushed - 1 - nBarsLeftRight;
+        verdict.isMinimum = window.min() == verdict.value;
+        verdict.isMaximum = window.max() == verdict.value;
+        return verdict;
+    }
+
+    inline size_t size( void ) const { return nPushed; }
+
+    inline void clear( void )
+    {
+        nPushed = 0;
+        window.clear();
+        lastValues.clear();
+    }
+};
+
+
+
+} // namespace Fundamental
+
+
+#ifdef MAIN_TEST_FINDLOCALEXTREMA
+
+
+#include <cstdlib>                      // rand
+#include <iostream>
+#include <limits>
+
+
+/* straightforward O(n nBarsLeftRight) version of findLocalExtrema */
+template< typename T >
 std::pair<
-    std::pair< std::vector< size_t >, std::vector< T > >, /* Minimums */
-    std::pair< std::vector< size_t >, std::vector< T > >  /* Maximums */
+    std::pair< std::vector< size_t >, std::vector< T > >,
+    std::pair< std::vector< size_t >, std::vector< T > >
 >
-inline findLocalExtrema
+findLocalExtremaReference
 (
     std::vector< T > const & x,
     unsigned int     const   nBarsLeftRight
 )
 {
     std::vector< size_t > viMin, viMax;
-    std::vector< double >  vMin,  vMax;
+    std::vector< T >       vMin,  vMax;
 
-    for ( size_t i = 0u; i < x.size(); ++i )
+    for ( size_t i = nBarsLeftRight; i + nBarsLeftRight < x.size(); ++i )
     {
-        if ( not ( i >= nBarsLeftRight ) or not ( i + nBarsLeftRight < x.size() ) )
-            continue;
-
-        double tmpMax = 0;
-        double tmpMin = std::numeric_limits< double >::infinity();
+        auto tmpMax = std::numeric_limits< T >::lowest();
+        auto tmpMin = std::numeric_limits< T >::max();
         for ( size_t j = i - nBarsLeftRight; j <= i + nBarsLeftRight; ++j )
         {
-            tmpMax = std::max( tmpMax, x.at(j) );
-            tmpMin = std::min( tmpMin, x.at(j) );
+            tmpMax = std::max( tmpMax, x[j] );
+            tmpMin = std::min( tmpMin, x[j] );
         }
+        if ( tmpMin == x[i] ) { viMin.push_back( i ); vMin.push_back( x[i] ); }
+        if ( tmpMax == x[i] ) { viMax.push_back( i ); vMax.push_back( x[i] ); }
+    }
 
-        if ( tmpMin == x.at(i) )
-        {
-            viMin.push_back( i );
-             vMin.push_back( tmpMin );
-        }
-        if ( tmpMax == x.at(i) )
+    return { { viMin, vMin }, { viMax, vMax } };
+}
+
+template< typename T >
+bool testFindLocalExtrema( char const * const name, std::vector< T > const & x )
+{
+    bool success = true;
+    for ( unsigned int nBarsLeftRight : { 0u, 1u, 2u, 5u, 17u, 100u, 1000u } )
+        success &= Fundamental::findLocalExtrema( x, nBarsLeftRight ) == findLocalExtremaReference( x, nBarsLeftRight );
+    for ( unsigned int nBarsLeftRight : { 0u, 1u, 5u, 100u } )
+    {
+        std::vector< size_t > viMin, viMax;
+        std::vector< T >       vMin,  vMax;
+        Fundamental::LocalExtremaDetector< T > detector( nBarsLeftRight );
+        for ( auto const & value : x )
         {
-            viMax.push_back( i );
-             vMax.push_back( tmpMax );
+            auto const verdict = detector.push( value );
+            if ( verdict.isMinimum ) { viMin.push_back( verdict.index ); vMin.push_back( verdict.value ); }
+            if ( verdict.isMaximum ) { viMax.push_back( verdict.index ); vMax.push_back( verdict.value ); }
         }
+        success &= Fundamental::findLocalExtrema( x, nBarsLeftRight ) ==
+                   std::make_pair( std::make_pair( viMin, vMin ), std::make_pair( viMax, vMax ) );
     }
-
-    return { { viMin, vMin }, { viMax, vMax } };
+    std::cout << "findLocalExtrema for " << name << ( success ? " OK" : " FAILED" ) << "\n";
+    return success;
 }
 
+int main()
+{
+    auto const nan = std::numeric_limits< double >::quiet_NaN();
 
+    /* the old implementation started the maximum at 0 and returned no maxima for these */
+    std::vector< double > negative( 1234 );
+    for ( auto & x : negative )
+        x = -1 - std::rand() / double( RAND_MAX );
+    testFindLocalExtrema( "negative values", negative );
 
-} // namespace Fundamental
+    std::vector< double > withNaN = negative;
+    for ( size_t i = 0u; i < withNaN.size(); i += 1 + std::rand() % 10 )
+        withNaN[i] = nan;
+    testFindLocalExtrema( "values with NaN", withNaN );
+
+    /* many ties */
+    std::vector< int > integers( 1234 );
+    for ( auto & x : integers )
+        x = std::rand() % 7 - 3;
+    testFindLocalExtrema( "integers", integers );
+
+    std::vector< float > trend( 1234 );
+    for ( size_t i = 0u; i < trend.size(); ++i )
+        trend[i] = i + 3 * ( std::rand() / float( RAND_MAX ) );
+    testFindLocalExtrema( "trend", trend );
+
+    testFindLocalExtrema( "empty", std::vector< double >() );
+    testFindLocalExtrema( "all NaN", std::vector< double >( 10, nan ) );
+}
+
+
+#endif
@@ -1,26 +1,380 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 normalizeTimeSeries.hpp -DMAIN_TEST_NORMALIZETIMESERIES && ./a.out
+*/
 #pragma once
 
+#include <algorithm>                    // min, max
 #include <cmath>
 #include <limits>
+#include <new>                          // placement new
 #include <stdexcept>
-#include <utility>
+#include <string>
 #include <vector>
 
+#include "Instrumentation.hpp"
+#include "RollingWindow.hpp"
+
 
 namespace Fundamental {
 
 
 
+namespace detail {
+
+inline void checkNormalizationArguments
+(
+    char   const * const caller,
+    size_t         const nBarsMax,
+    int            const iNormalizationStrategy
+)
+{
+    if ( nBarsMax == 0 )
+        throw std::invalid_argument( std::string( "[" ) + caller + "] nBarsMax must be > 0!" );
+    if ( ( iNormalizationStrategy == 1 || iNormalizationStrategy == 2 ) && nBarsMax < 2 )
+        throw std::invalid_argument( std::string( "[" ) + caller + "] nBarsMax must be >= 2 for a strategy which uses the standard deviation or quartiles!" );
+    /* each bar of RollingQuantiles costs up to O(nBarsMax) */
+    if ( iNormalizationStrategy == 2 && nBarsMax == std::numeric_limits< size_t >::max() )
+        throw std::invalid_argument( std::string( "[" ) + caller + "] nBarsMax must be finite for the quartiles strategy!" );
+
+    if ( not ( 0 <= iNormalizationStrategy and iNormalizationStrategy <= 2 ) )
+        throw std::invalid_argument( std::string( "[" ) + caller + "] unsupported normalization strategy!" );
+}
+
+} // namespace detail
+
+
+/**
+ * Normalization strategies as types for BasicTimeSeriesNormalizer and
+ * normalizeTimeSeries< T_Strategy >. Own strategies can be plugged in by
+ * implementing the same interface:
+ *
+ *   template< typename T > class Strategy
+ *   {
+ *   public:
+ *       struct Parameters;   // window statistics normalize needs, default constructible
+ *       explicit Strategy( size_t nBarsMax );
+ *       Parameters parameters( void ) const;   // of the values pushed so far
+ *       void push ( T const & value );
+ *       void clear( void );
+ *       static T normalize( T const & value, Parameters const & parameters );
+ *   };
+ *
+ * Splitting the rolling statistics, which depend on all values before, from
+ * the static normalize, which does not, lets normalizeTimeSeries run the
+ * latter as a loop without dependencies between iterations, which can be
+ * vectorized. Undefined statistics should be encoded as NaN parameters, so
+ * that normalize returns NaN without a branch.
+ */
+
+/**
+ * ( x - min ) / ( max - min ), which maps the range of the window to [0,1]
+ */
+template< typename T >
+class MinMaxNormalization
+{
+private:
+    RollingMinMax< T > minMax;
+
+public:
+    struct Parameters
+    {
+        T min  ;
+        T range;  /**< NaN if all values in the window are equal */
+    };
+
+    inline explicit MinMaxNormalization( size_t const nBarsMax ) : minMax( nBarsMax ) {}
+
+    inline Parameters parameters( void ) const
+    {
+        auto const curMin = minMax.min();
+        auto const curMax = minMax.max();
+        return Parameters{ curMin, curMin != curMax ? curMax - curMin : std::numeric_limits< T >::quiet_NaN() };
+    }
+
+    inline void push ( T const & value ) { minMax.push( value ); }
+    inline void clear( void )            { minMax.clear(); }
+
+    static inline T normalize( T const & value, Parameters const & parameters )
+    {
+        return ( value - parameters.min ) / parameters.range;
+    }
+};
+
+/**
+ * 0.5 + 0.5 tanh( 0.01 ( x - mean ) / stddev ), a robust alternative to the
+ * z-score which also maps to [0,1]
+ */
+template< typename T >
+class TanhNormalization
+{
+private:
+    RollingMoments< T > moments;
+
+public:
+    using Float = typename RollingMoments< T >::Float;
+
+    struct Parameters
+    {
+        Float mean ;
+        Float scale;  /**< 100 stddev, NaN for less than 2 values */
+    };
+
+    inline explicit TanhNormalization( size_t const nBarsMax ) : moments( nBarsMax ) {}
+
+    inline Parameters parameters( void ) const
+    {
+        return Parameters{ moments.mean(), 100. * moments.stddev() };
+    }
+
+    inline void push ( T const & value ) { moments.push( value ); }
+    inline void clear( void )            { moments.clear(); }
+
+    static inline T normalize( T const & value, Parameters const & parameters )
+    {
+        return 0.5 + 0.5 * std::tanh( ( value - parameters.mean ) / parameters.scale );
+    }
+};
+
+/**
+ * ( x - median ) / ( Q3 - Q1 ), the robust scaling of scikit-learn, which is
+ * not thrown off by single outliers like min max normalization, but neither
+ * is bounded. Costs more than the others, see RollingQuantiles, which is
+ * why nBarsMax must be finite, i.e. less than the maximum size_t, instead of
+ * the default to use all bars before, which would be O(n^2).
+ */
+template< typename T >
+class RobustNormalization
+{
+private:
+    RollingQuantiles< T > quantiles;
+
+public:
+    struct Parameters
+    {
+        T median;
+        T iqr   ;  /**< interquartile range, NaN if it is 0 */
+    };
+
+    inline explicit RobustNormalization( size_t const nBarsMax )
+    : quantiles( nBarsMax == std::numeric_limits< size_t >::max()
+                 ? throw std::invalid_argument( "[RobustNormalization] nBarsMax must be finite!" )
+                 : nBarsMax )
+    {}
+
+    inline Parameters parameters( void ) const
+    {
+        auto const iqr = quantiles.quantile( 0.75 ) - quantiles.quantile( 0.25 );
+        return Parameters{ quantiles.median(), iqr != 0 ? iqr : std::numeric_limits< T >::quiet_NaN() };
+    }
+
+    inline void push ( T const & value ) { quantiles.push( value ); }
+    inline void clear( void )            { quantiles.clear(); }
+
+    static inline T normalize( T const & value, Parameters const & parameters )
+    {
+        return ( value - parameters.median ) / parameters.iqr;
+    }
+};
+
+
+/**
+ * Normalizes a time series bar by bar using only the nBarsMax bars before
+ * the current one, so that no information from the future leaks into the
+ * normalized values, with a strategy chosen at compile time, e.g.
+ * MinMaxNormalization. Normalized values are NaN if the statistics are
+ * undefined, e.g. for the first bar(s), or if all values in the window are
+ * equal. NaN values are ignored for the window statistics.
+ */
+template< typename T, template< typename > class T_Strategy >
+class BasicTimeSeriesNormalizer
+{
+private:
+    T_Strategy< T > strategy;
+
+public:
+    inline explicit BasicTimeSeriesNormalizer( size_t const nBarsMax = std::numeric_limits< size_t >::max() )
+    : strategy( nBarsMax )
+    {}
+
+    /**
+     * @return value normalized with the statistics of the bars pushed
+     *         before, after which value is added to them
+     */
+    inline T push( T const & value )
+    {
+        auto const parameters = strategy.parameters();
+        strategy.push( value );
+        return T_Strategy< T >::normalize( value, parameters );
+    }
+
+    inline void clear( void ) { strategy.clear(); }
+};
+
+
+/**
+ * Normalizer with the strategy chosen at run time. Each bar costs amortized
+ * O(1), except for strategy 2, which needs a finite nBarsMax, so the same object can be used for backtests
+ * in batch, see normalizeTimeSeries, and be fed live data one bar at a time.
+ *
+ * Strategies:
+ *   0: MinMaxNormalization
+ *   1: TanhNormalization
+ *   2: RobustNormalization
+ *
+ * About whether to use [0,1] or [-1,1]
+ * @see https://visualstudiomagazine.com/articles/2014/01/01/how-to-standardize-data-for-neural-networks.aspx
+ * When dealing with categorical x-data, it's useful to distinguish between binary x-data, such as sex, which can take one of two possible values, and regular categorical data, such as location, which can take one of three or more possible values. Experience has shown that it's better to encode binary x-data using a -1, +1 scheme rather than a 0, 1 scheme.
+ * @see https://stats.stackexchange.com/a/231330/130265
+ * @see http://scikit-learn.org/stable/modules/preprocessing.html#preprocessing-normalization
+ */
+template< typename T >
+class TimeSeriesNormalizer
+{
+private:
+    using MinMax    = BasicTimeSeriesNormalizer< T, MinMaxNormalization >;
+    using Moments   = BasicTimeSeriesNormalizer< T, TanhNormalization   >;
+    using Quantiles = BasicTimeSeriesNormalizer< T, RobustNormalization >;
+
+    /**
+     * Only the member for iNormalizationStrategy is constructed, so that
+     * e.g. copies per thread don't allocate windows for the other ones
+     */
+    union Normalizers
+    {
+        MinMax    minMax   ;  /**< strategy 0 */
+        Moments   moments  ;  /**< strategy 1 */
+        Quantiles quantiles;  /**< strategy 2 */
+
+        inline  Normalizers( void ) {}
+        inline ~Normalizers() {}
+    };
+
+    int         const iNormalizationStrategy;
+    Normalizers       normalizers;
+
+    static inline int checkedStrategy( size_t const nBarsMax, int const iNormalizationStrategy )
+    {
+        detail::checkNormalizationArguments( "TimeSeriesNormalizer", nBarsMax, iNormalizationStrategy );
+        return iNormalizationStrategy;
+    }
+
+public:
+    inline explicit TimeSeriesNormalizer
+    (
+        size_t const nBarsMax = std::numeric_limits< size_t >::max(),
+        int    const riNormalizationStrategy = 0
+    )
+    : iNormalizationStrategy( checkedStrategy( nBarsMax, riNormalizationStrategy ) )
+    {
+        switch ( iNormalizationStrategy )
+        {
+            case 0 : new ( &normalizers.minMax    ) MinMax   ( nBarsMax ); break;
+            case 1 : new ( &normalizers.moments   ) Moments  ( nBarsMax ); break;
+            default: new ( &normalizers.quantiles ) Quantiles( nBarsMax ); break;
+        }
+    }
+
+    inline TimeSeriesNormalizer( TimeSeriesNormalizer const & other )
+    : iNormalizationStrategy( other.iNormalizationStrategy )
+    {
+        switch ( iNormalizationStrategy )
+        {
+            case 0 : new ( &normalizers.minMax    ) MinMax   ( other.normalizers.minMax    ); break;
+            case 1 : new ( &normalizers.moments   ) Moments  ( other.normalizers.moments   ); break;
+            default: new ( &normalizers.quantiles ) Quantiles( other.normalizers.quantiles ); break;
+        }
+    }
+
+    TimeSeriesNormalizer & operator=( TimeSeriesNormalizer const & ) = delete;
+
+    inline ~TimeSeriesNormalizer()
+    {
+        switch ( iNormalizationStrategy )
+        {
+            case 0 : normalizers.minMax   .~MinMax   (); break;
+            case 1 : normalizers.moments  .~Moments  (); break;
+            default: normalizers.quantiles.~Quantiles(); break;
+        }
+    }
+
+    /** @see BasicTimeSeriesNormalizer::push */
+    inline T push( T const & value )
+    {
+        switch ( iNormalizationStrategy )
+        {
+            case 0 : return normalizers.minMax   .push( value );
+            case 1 : return normalizers.moments  .push( value );
+            default: return normalizers.quantiles.push( value );
+        }
+    }
+
+    inline void clear( void )
+    {
+        switch ( iNormalizationStrategy )
+        {
+            case 0 : normalizers.minMax   .clear(); break;
+            case 1 : normalizers.moments  .clear(); break;
+            default: normalizers.quantiles.clear(); break;
+        }
+    }
+};
+
+
+/**
+ * Normalizes each value using the statistics of the nBarsMax values before
+ * it, see BasicTimeSeriesNormalizer, with e.g.
+ *   normalizeTimeSeries< RobustNormalization >( x, 100 )
+ *
+ * The window statistics are collected for blocks of bars first, so that the
+ * normalization of each block is a loop without branches or dependencies.
+ *
+ * @param[in] nBarsMax length of the sliding window, default is to use all
+ *            values before
+ * @return normalized time series of the same length. Input with less than 2
+ *         values is returned as is.
+ */
+template< template< typename > class T_Strategy, typename T >
+inline std::vector<T> normalizeTimeSeries
+(
+    std::vector< T > const & x,
+    size_t           const   nBarsMax = std::numeric_limits< size_t >::max()
+)
+{
+    if ( x.size() <= 1 )
+        return x;
+    if ( nBarsMax == 0 )
+        throw std::invalid_argument( "[normalizeTimeSeries] nBarsMax must be > 0!" );
+    INSTRUMENT_SCOPE( "normalizeTimeSeries" );
+    INSTRUMENT_COUNT( "normalizeTimeSeries/values", x.size() );
+
+    using Strategy = T_Strategy< T >;
+    Strategy strategy( nBarsMax );
+    std::vector<T> result( x.size() );
+
+    /* small enough to stay in the L1 cache for the second loop */
+    constexpr size_t nBlock = 256;
+    typename Strategy::Parameters parameters[ nBlock ];
+    for ( size_t iBlock = 0u; iBlock < x.size(); iBlock += nBlock )
+    {
+        auto const n = std::min( nBlock, x.size() - iBlock );
+        auto const xBlock = x.data() + iBlock;
+        for ( size_t i = 0u; i < n; ++i )
+        {
+            parameters[i] = strategy.parameters();
+            strategy.push( xBlock[i] );
+        }
+        auto const resultBlock = result.data() + iBlock;
+        for ( size_t i = 0u; i < n; ++i )
+            resultBlock[i] = Strategy::normalize( xBlock[i], parameters[i] );
+    }
+    return result;
+}
+
 /**
- * Returns index and values of all value in original data set which are
- * extremal in index +- nBarsLeftRight
+ * Version with the strategy chosen at run time, see TimeSeriesNormalizer
  *
- * @param[in] nBarsLeftRight see header description. The larger this value the
- *            fewer values bill returned. This basically controls how far
- *            out of fractal data we want to zoom.
- *            The larger the value the more values at the start and end of
- *            the input data set will have to be ignored!
- * @return min/max pair of index/value pairs
+ * @param[in] iNormalizationStrategy 0: min max, 1: tanh, 2: robust
+ *            normalization
  */
 template< typename T >
 inline std::vector<T> normalizeTimeSeries
@@ -30,119 +384,285 @@ inline std::vector<T> normalizeTimeSeries
     int              const   iNormalizationStrategy = 0
 )
 {
-    /**
-     * About whether to use [0,1] or [-1,1]
-     * @see https://visualstudiomagazine.com/articles/2014/01/01/how-to-standardize-data-for-neural-networks.aspx
-     * When dealing with categorical x-data, it's useful to distinguish between binary x-data, such as sex, which can take one of two possible values, and regular categorical data, such as location, which can take one of three or more possible values. Experience has shown that it's better to encode binary x-data using a -1, +1 scheme rather than a 0, 1 scheme.
-     * @see https://stats.stackexchange.com/a/231330/130265
-     * @see http://scikit-learn.org/stable/modules/preprocessing.html#preprocessing-normalization
-     */
     if ( x.size() <= 1 )
         return x;
-    if ( nBarsMax == 0 )
-        throw std::invalid_argument( "[normalizeTimeSeries] nBarsMax must be > 0!" );
-    if ( iNormalizationStrategy == 1 && nBarsMax < 2 )
-        throw std::invalid_argument( "[normalizeTimeSeries] nBarsMax must be >= 2 for a strategy which uses the standard deviation!" );
+    detail::checkNormalizationArguments( "normalizeTimeSeries", nBarsMax, iNormalizationStrategy );
 
-    if ( not ( 0 <= iNormalizationStrategy and iNormalizationStrategy <= 1 ) )
-        throw std::invalid_argument( "[normalizeTimeSeries] unsupported normalization strategy!" );
+    switch ( iNormalizationStrategy )
+    {
+        case 0 : return normalizeTimeSeries< MinMaxNormalization >( x, nBarsMax );
+        case 1 : return normalizeTimeSeries< TanhNormalization   >( x, nBarsMax );
+        default: return normalizeTimeSeries< RobustNormalization >( x, nBarsMax );
+    }
+}
+
+
+
+} // namespace Fundamental
 
-    std::vector<T> result( x.size() );
 
-    auto curMax      = -std::numeric_limits<T>::infinity();
-    auto curMin      = +std::numeric_limits<T>::infinity();
-    auto curSum      = T(0);
-    auto curSum2     = T(0); // sum of squares for stddev
-    size_t iStartMax = 0u;
+#ifdef MAIN_TEST_NORMALIZETIMESERIES
 
+
+#include <algorithm>                    // sort
+#include <cstdlib>                      // rand
+#include <iostream>
+
+
+/* straightforward O(n nBarsMax) version of the min max normalization */
+template< typename T >
+std::vector< T > normalizeMinMaxReference( std::vector< T > const & x, size_t const nBarsMax )
+{
+    std::vector< T > result( x.size() );
     for ( size_t i = 0u; i < x.size(); ++i )
     {
-        /* assume here we have min and max over last nBarsMax bars */
-        if ( iNormalizationStrategy == 0 ) /* min max normalization */
+        auto curMin = Fundamental::emptyMin< T >();
+        auto curMax = Fundamental::emptyMax< T >();
+        for ( size_t j = i - std::min( i, nBarsMax ); j < i; ++j )
         {
-            if ( curMin == curMax )
-                result[i] = std::numeric_limits< T >::quiet_NaN();
-            else
-                result[i] = ( x[i] - curMin )/( curMax - curMin );
-        }
-        else if ( iNormalizationStrategy == 1 ) /* tanh normalization */
-        {
-            size_t curN = i - iStartMax;
-            if ( curN < 2 ) /* at least this many needed for stddev */
-            {
-                result[i] = std::numeric_limits< T >::quiet_NaN();
-            }
-            else
-            {
-                auto const curAverage = 1. * curSum / curN;
-                /* 1/(N-1) sum (x_i-<x>)^2 = 1/(N-1) sum [ x_i^2 - 2 x_i <x> +
-                 * <x>^2 ] = 1/(N-1) sum x_i^2 + 1/(N-1)*[ N <x>^2 - 2 N <x> <x>]
-                 * ( sx2 - N <x>^2 )/( N-1 ) */
-                auto const curStdDev  = ( curSum2 - 1. * curSum / curN * curSum ) / ( curN - 1 );
-                result[i] = 0.5 + 0.5 * std::tanh( ( x[i] - curAverage )/( 100. * curStdDev ) );
-            }
+            curMin = Fundamental::minIgnoringNaN( curMin, x[j] );
+            curMax = Fundamental::maxIgnoringNaN( curMax, x[j] );
         }
+        result[i] = curMin == curMax ? std::numeric_limits< T >::quiet_NaN()
+                                     : ( x[i] - curMin ) / ( curMax - curMin );
+    }
+    return result;
+}
 
+template< typename T >
+bool equalOrBothNaN( std::vector< T > const & a, std::vector< T > const & b )
+{
+    if ( a.size() != b.size() )
+        return false;
+    for ( size_t i = 0u; i < a.size(); ++i )
+    {
+        if ( not ( a[i] == b[i] ) && not ( std::isnan( a[i] ) && std::isnan( b[i] ) ) )
+            return false;
+    }
+    return true;
+}
+
+bool testNormalizeMinMax( char const * const name, std::vector< double > const & x )
+{
+    bool success = true;
+    for ( size_t nBarsMax : { size_t( 1 ), size_t( 2 ), size_t( 7 ), size_t( 100 ), std::numeric_limits< size_t >::max() } )
+        success &= equalOrBothNaN( Fundamental::normalizeTimeSeries( x, nBarsMax, 0 ), normalizeMinMaxReference( x, nBarsMax ) );
+    std::cout << "min max normalization for " << name << ( success ? " OK" : " FAILED" ) << "\n";
+    return success;
+}
 
-        if ( iNormalizationStrategy == 0 )
+/* two-pass mean and standard deviation over the window for each value */
+template< typename T >
+std::vector< T > normalizeTanhReference( std::vector< T > const & x, size_t const nBarsMax )
+{
+    std::vector< T > result( x.size(), std::numeric_limits< T >::quiet_NaN() );
+    for ( size_t i = 0u; i < x.size(); ++i )
+    {
+        size_t n = 0;
+        long double mean = 0;
+        for ( size_t j = i - std::min( i, nBarsMax ); j < i; ++j )
         {
-            /* update minimum and maximum */
-            assert( i >= iStartMax );
-            if ( size_t( i - iStartMax ) >= nBarsMax )
+            if ( not std::isnan( x[j] ) )
             {
-                /* if maximum already encompasses too many values, begin to
-                 * reduce it again. We only need to recalculate it, if the value
-                 * fading out of range is the maximum! */
-
-                /* @see https://stackoverflow.com/a/30915238/2191065 */
-                /* if we are more out of range than one value, then we
-                 * also won't take a shortcut and just recalculate the max */
-                if ( x[ iStartMax ] == curMax || size_t( i - iStartMax ) - nBarsMax > 1u )
-                {
-                    /* ! >= instead of < basically ignores NaN */
-                    curMax = * std::max_element( x.begin() + iStartMax + 1u,
-                        x.begin() + i, /* less functor: */
-                        []( T x, T y ){ return !( x >= y ); }
-                    );
-                }
-
-                if ( x[ iStartMax ] == curMin || size_t( i - iStartMax ) - nBarsMax > 1u )
-                {
-                    /* ! >= instead of < basically ignores NaN */
-                    curMin = * std::min_element( x.begin() + iStartMax + 1u,
-                        x.begin() + i, /* less functor: */
-                        []( T x, T y ){ return !( x >= y ); }
-                    );
-                }
-
-                iStartMax += 1;
+                mean += x[j];
+                ++n;
             }
-            curMax = std::max( curMax, x[i] );
-            curMin = std::min( curMin, x[i] );
         }
+        if ( n < 2 )
+            continue;
+        mean /= n;
 
-        if ( iNormalizationStrategy == 0 )
+        long double variance = 0;
+        for ( size_t j = i - std::min( i, nBarsMax ); j < i; ++j )
         {
-            /* update mean and stddev */
-            if ( size_t( i - iStartMax ) >= nBarsMax )
-            {
-                /* we assume that it can't be out of range more than one value! */
-                if ( nBarsMax < std::numeric_limits< size_t >::max() )
-                    assert( size_t( i - iStartMax ) <= nBarsMax + 1u );
+            if ( not std::isnan( x[j] ) )
+                variance += ( x[j] - mean ) * ( x[j] - mean );
+        }
+        variance /= n - 1;
+        result[i] = 0.5 + 0.5 * std::tanh( ( x[i] - mean ) / ( 100. * std::sqrt( variance ) ) );
+    }
+    return result;
+}
 
-                curSum  -= x[ iStartMax ];
-                curSum2 -= x[ iStartMax ] * x[ iStartMax ];
+template< typename T >
+T maxAbsErr( std::vector< T > const & a, std::vector< T > const & b )
+{
+    T result = 0;
+    for ( size_t i = 0u; i < a.size(); ++i )
+    {
+        if ( std::isnan( a[i] ) != std::isnan( b[i] ) )
+            return std::numeric_limits< T >::infinity();
+        if ( not std::isnan( a[i] ) )
+            result = std::max( result, std::abs( a[i] - b[i] ) );
+    }
+    return result;
+}
 
-                iStartMax += 1;
-            }
-            curSum  += x[i];
-            curSum2 += x[i] * x[i];
+bool testNormalizeTanh( char const * const name, std::vector< double > const & x )
+{
+    bool success = true;
+    for ( size_t nBarsMax : { size_t( 2 ), size_t( 7 ), size_t( 100 ), std::numeric_limits< size_t >::max() } )
+        success &= maxAbsErr( Fundamental::normalizeTimeSeries( x, nBarsMax, 1 ), normalizeTanhReference( x, nBarsMax ) ) < 1e-7;
+    std::cout << "tanh normalization for " << name << ( success ? " OK" : " FAILED" ) << "\n";
+    return success;
+}
+
+/* sorts the window for each value */
+template< typename T >
+std::vector< T > normalizeRobustReference( std::vector< T > const & x, size_t const nBarsMax )
+{
+    auto const quantile = [] ( std::vector< T > const & sorted, double const p )
+    {
+        auto const rank = p * ( sorted.size() - 1 );
+        auto const i    = static_cast< size_t >( rank );
+        return i + 1 >= sorted.size() ? sorted[i] : sorted[i] + ( rank - i ) * ( sorted[ i + 1 ] - sorted[i] );
+    };
+
+    std::vector< T > result( x.size(), std::numeric_limits< T >::quiet_NaN() );
+    for ( size_t i = 0u; i < x.size(); ++i )
+    {
+        std::vector< T > window;
+        for ( size_t j = i - std::min( i, nBarsMax ); j < i; ++j )
+        {
+            if ( not std::isnan( x[j] ) )
+                window.push_back( x[j] );
         }
+        if ( window.empty() )
+            continue;
+        std::sort( window.begin(), window.end() );
+        auto const iqr = quantile( window, 0.75 ) - quantile( window, 0.25 );
+        if ( iqr != 0 )
+            result[i] = ( x[i] - quantile( window, 0.5 ) ) / iqr;
     }
-
     return result;
 }
 
+bool testNormalizeRobust( char const * const name, std::vector< double > const & x )
+{
+    bool success = true;
+    for ( size_t nBarsMax : { size_t( 2 ), size_t( 7 ), size_t( 100 ), x.size() } )
+        success &= equalOrBothNaN( Fundamental::normalizeTimeSeries( x, nBarsMax, 2 ), normalizeRobustReference( x, nBarsMax ) );
+    std::cout << "robust normalization for " << name << ( success ? " OK" : " FAILED" ) << "\n";
+    return success;
+}
+
+/* the batch version collects the statistics in blocks, which must not make a difference */
+template< template< typename > class T_Strategy >
+bool testBarByBar( char const * const name, std::vector< double > const & x )
+{
+    bool success = true;
+    for ( size_t nBarsMax : { size_t( 2 ), size_t( 100 ), x.size() } )
+    {
+        Fundamental::BasicTimeSeriesNormalizer< double, T_Strategy > normalizer( nBarsMax );
+        std::vector< double > streamed;
+        for ( auto const value : x )
+            streamed.push_back( normalizer.push( value ) );
+        success &= equalOrBothNaN( streamed, Fundamental::normalizeTimeSeries< T_Strategy >( x, nBarsMax ) );
+    }
+    std::cout << "BasicTimeSeriesNormalizer bar by bar for " << name << ( success ? " OK" : " FAILED" ) << "\n";
+    return success;
+}
 
+/* example for a user defined strategy: the relative change to the last value */
+template< typename T >
+class RelativeChangeNormalization
+{
+private:
+    T last;
 
-} // namespace Fundamental
+public:
+    struct Parameters { T last; };
+
+    explicit RelativeChangeNormalization( size_t ) : last( std::numeric_limits< T >::quiet_NaN() ) {}
+    Parameters parameters( void ) const { return Parameters{ last }; }
+    void push ( T const & value ) { last = value; }
+    void clear( void ) { last = std::numeric_limits< T >::quiet_NaN(); }
+    static T normalize( T const & value, Parameters const & parameters ) { return value / parameters.last - 1; }
+};
+
+int main()
+{
+    std::vector< double > randomWalk( 2345 );
+    double value = 0;
+    for ( auto & x : randomWalk )
+        x = value += std::rand() / double( RAND_MAX ) - 0.5;
+    testNormalizeMinMax( "random walk", randomWalk );
+
+    std::vector< double > trend( 2345 );
+    for ( size_t i = 0u; i < trend.size(); ++i )
+        trend[i] = i + std::rand() / double( RAND_MAX );
+    testNormalizeMinMax( "trend", trend );
+
+    /* the old implementation returned mostly NaN after the first NaN fell out of the window */
+    auto withNaN = randomWalk;
+    for ( size_t i = 0u; i < withNaN.size(); i += 1 + std::rand() % 20 )
+        withNaN[i] = std::numeric_limits< double >::quiet_NaN();
+    testNormalizeMinMax( "random walk with NaN", withNaN );
+
+    testNormalizeTanh( "random walk", randomWalk );
+    testNormalizeTanh( "trend", trend );
+    testNormalizeTanh( "random walk with NaN", withNaN );
+
+    /* the old sum of squares variance returned NaN for this, because it
+     * became negative. Short windows are ill-conditioned for this data. */
+    std::vector< double > price( 2345 );
+    for ( auto & x : price )
+        x = 1e6 + 1e-3 * std::rand() / double( RAND_MAX );
+    bool success = true;
+    for ( size_t nBarsMax : { size_t( 100 ), size_t( 1000 ), std::numeric_limits< size_t >::max() } )
+        success &= maxAbsErr( Fundamental::normalizeTimeSeries( price, nBarsMax, 1 ), normalizeTanhReference( price, nBarsMax ) ) < 1e-7;
+    std::cout << "tanh normalization for prices with small changes" << ( success ? " OK" : " FAILED" ) << "\n";
+
+    /* feeding bar by bar must give the same as the batch version, also for
+     * copies, which continue from the state of the original */
+    success = true;
+    for ( int iStrategy : { 0, 1, 2 } )
+    {
+        Fundamental::TimeSeriesNormalizer< double > normalizer( 100, iStrategy );
+        std::vector< double > streamed;
+        for ( size_t i = 0u; i < 1000; ++i )
+            streamed.push_back( normalizer.push( withNaN[i] ) );
+        auto copy = normalizer;
+        auto streamedCopy = streamed;
+        for ( size_t i = 1000u; i < withNaN.size(); ++i )
+        {
+            streamed.push_back( normalizer.push( withNaN[i] ) );
+            streamedCopy.push_back( copy.push( withNaN[i] ) );
+        }
+        auto const expected = Fundamental::normalizeTimeSeries( withNaN, 100, iStrategy );
+        success &= equalOrBothNaN( streamed, expected ) && equalOrBothNaN( streamedCopy, expected );
+
+        normalizer.clear();
+        success &= std::isnan( normalizer.push( 1 ) );
+    }
+    std::cout << "TimeSeriesNormalizer bar by bar " << ( success ? "OK" : "FAILED" ) << "\n";
+
+    testNormalizeRobust( "random walk", randomWalk );
+    testNormalizeRobust( "random walk with NaN", withNaN );
+    /* many equal values */
+    auto rounded = randomWalk;
+    for ( auto & x : rounded )
+        x = std::round( 4 * x );
+    testNormalizeRobust( "rounded random walk", rounded );
+
+    testBarByBar< Fundamental::MinMaxNormalization >( "min max normalization", withNaN );
+    testBarByBar< Fundamental::TanhNormalization   >( "tanh normalization"   , withNaN );
+    testBarByBar< Fundamental::RobustNormalization >( "robust normalization" , withNaN );
+
+    /* the quartiles would cost O(n^2) for an unbounded window */
+    success = true;
+    auto const nBarsUnbounded = std::numeric_limits< size_t >::max();
+    try { Fundamental::normalizeTimeSeries( randomWalk, nBarsUnbounded, 2 ); success = false; } catch ( std::invalid_argument const & ) {}
+    try { Fundamental::TimeSeriesNormalizer< double > normalizer( nBarsUnbounded, 2 ); success = false; } catch ( std::invalid_argument const & ) {}
+    try { Fundamental::normalizeTimeSeries< Fundamental::RobustNormalization >( randomWalk ); success = false; } catch ( std::invalid_argument const & ) {}
+    std::cout << "unbounded window for the quartiles strategy throws" << ( success ? " OK" : " FAILED" ) << "\n";
+
+    auto const relativeChanges = Fundamental::normalizeTimeSeries< RelativeChangeNormalization >( trend );
+    success = std::isnan( relativeChanges[0] );
+    for ( size_t i = 1u; i < trend.size(); ++i )
+        success &= relativeChanges[i] == trend[i] / trend[ i - 1 ] - 1;
+    std::cout << "user defined normalization strategy" << ( success ? " OK" : " FAILED" ) << "\n";
+}
+
+
+#endif
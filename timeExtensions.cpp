@@ -1,16 +1,22 @@
-
+/*
+g++ -Wall -Wextra -O2 -std=c++11 timeExtensions.cpp -DMAIN_TEST_TIMEEXTENSIONS -pthread && ./a.out
+*/
 #include "timeExtensions.hpp"
 
+#include <algorithm>            // find
 #include <cassert>
+#include <cmath>                // floor
 #include <ctime>
-#include <iostream>
+#include <limits>               // quiet_NaN
 #include <map>
-#include <regex>
+#include <stdexcept>
 #include <string>               // getline
-#include <sstream>
+#include <utility>              // move
 #include <vector>
 
 #include "Fundamental.hpp"
+#include "Instrumentation.hpp"
+#include "ThreadPool.hpp"
 
 
 namespace Fundamental {
@@ -28,13 +34,87 @@ double getTimeZone( void )
     /* daylight saving is never included in this, because gmtime doesn't set it */
 }
 
+std::tm gmtime( double const unixTime )
+{
+    auto const t = (long long int) std::floor( unixTime );
+    auto const days = detail::floorDiv< long long int >( t, 86400 );
+    auto const secondOfDay = t - days * 86400;
+    auto const date = civilFromDays( days );
+
+    std::tm result = {};
+    result.tm_year  = int( date.year - 1900 );
+    result.tm_mon   = int( date.month ) - 1;
+    result.tm_mday  = int( date.day );
+    result.tm_hour  = int( secondOfDay / 3600 );
+    result.tm_min   = int( secondOfDay / 60 % 60 );
+    result.tm_sec   = int( secondOfDay % 60 );
+    /* 1970-01-01 was a Thursday */
+    result.tm_wday  = int( days - detail::floorDiv< long long int >( days + 4, 7 ) * 7 + 4 );
+    result.tm_yday  = int( days - daysFromCivil< long long int >( date.year, 1, 1 ) );
+    result.tm_isdst = 0;
+    return result;
+}
+
 double timegm( std::tm time )
 {
-    static double timezone = getTimeZone();
     assert( time.tm_isdst == 0 );
-    /* mktime  now tries again to subtract timezone from time, so we need to
-     * readd it to get proper UTC / GMT time */
-    return std::mktime( &time ) + timezone;
+    /* normalize month, because daysFromCivil can't handle months outside
+     * [1,12]. All other fields can simply be added up */
+    long long int const year = time.tm_year + 1900LL
+                             + detail::floorDiv< long long int >( time.tm_mon, 12 );
+    long long int const month = time.tm_mon
+                              - detail::floorDiv< long long int >( time.tm_mon, 12 ) * 12 + 1;
+    return double( unixTimeFromCivil< long long int >( year, month, 1,
+                   time.tm_hour, time.tm_min, time.tm_sec ) )
+           + double( time.tm_mday - 1 ) * 86400;
+}
+
+void unixTimeFromCivil
+(
+    int const * const years,
+    int const * const months,
+    int const * const days,
+    int const * const hours,
+    int const * const minutes,
+    int const * const seconds,
+    size_t      const n,
+    double    * const result
+)
+{
+    /* 32-bit arithmetic suffices for years up to +-5 million and vectorizes
+     * better, especially the divisions by constants */
+    for ( size_t i = 0u; i < n; ++i )
+    {
+        result[i] = double( daysFromCivil< int >( years[i], months[i], days[i] ) ) * 86400
+                  + ( hours[i] * 3600 + minutes[i] * 60 + seconds[i] );
+    }
+}
+
+void civilFromUnixTime
+(
+    double const * const unixTimes,
+    size_t         const n,
+    int          * const years,
+    int          * const months,
+    int          * const days,
+    int          * const hours,
+    int          * const minutes,
+    int          * const seconds
+)
+{
+    for ( size_t i = 0u; i < n; ++i )
+    {
+        auto const t = (long long int) std::floor( unixTimes[i] );
+        auto const nDays = detail::floorDiv< long long int >( t, 86400 );
+        auto const secondOfDay = int( t - nDays * 86400 );
+        auto const date = civilFromDays( nDays );
+        years  [i] = int( date.year );
+        months [i] = int( date.month );
+        days   [i] = int( date.day );
+        hours  [i] = secondOfDay / 3600;
+        minutes[i] = secondOfDay / 60 % 60;
+        seconds[i] = secondOfDay % 60;
+    }
 }
 
 /*
@@ -64,12 +144,14 @@ std::string dateFormatterToRegex
 )
 {
     auto const formatter = s;
-    static std::map< std::string, std::pair< std::string, std::vector< std::string > > > resultCache = {};
+    /* One cache per thread, so that no locking is necessary */
+    thread_local std::map< std::string, std::pair< std::string, std::vector< std::string > > > resultCache = {};
     {
         auto const & it = resultCache.find( s );
         if ( it != resultCache.end() )
         {
-            *pNamedCaptureGroups = it->second.second;
+            if ( pNamedCaptureGroups != NULL )
+                *pNamedCaptureGroups = it->second.second;
             return it->second.first;
         }
     }
@@ -87,20 +169,19 @@ std::string dateFormatterToRegex
     static std::vector< std::string > const specifiers = {
         "Y", "y", "m", "j", "d", "e", "w", "H", "M", "S", "p"
     };
-    if ( pNamedCaptureGroups != NULL )
+    std::vector< std::string > namedCaptureGroups;
+    for ( size_t i = 0u; i < s.size(); ++i )
     {
-        pNamedCaptureGroups->clear();
-        for ( size_t i = 0u; i < s.size(); ++i )
-        {
-            if ( ( s[i] != '%' ) or not ( i+1 < s.size() ) )
-                continue;
+        if ( ( s[i] != '%' ) or not ( i+1 < s.size() ) )
+            continue;
 
-            auto const toSearch = s.substr( i+1, 1 );
-            auto const found = std::find( specifiers.begin(), specifiers.end(), toSearch );
-            if ( found != specifiers.end() )
-                pNamedCaptureGroups->push_back( toSearch );
-        }
+        auto const toSearch = s.substr( i+1, 1 );
+        auto const found = std::find( specifiers.begin(), specifiers.end(), toSearch );
+        if ( found != specifiers.end() )
+            namedCaptureGroups.push_back( toSearch );
     }
+    if ( pNamedCaptureGroups != NULL )
+        *pNamedCaptureGroups = namedCaptureGroups;
 
     /* replace everything with regex rules and capture groups */
     /* Default regex is std::regex::ECMAScript */
@@ -125,102 +206,617 @@ std::string dateFormatterToRegex
         s = replace( s, rule.first, rule.second );
 
     /* put in cache */
-    resultCache[ formatter ] = { s, *pNamedCaptureGroups };
+    resultCache[ formatter ] = { s, std::move( namedCaptureGroups ) };
 
     return s;
 }
 
-double parseTime
+namespace {
+
+
+inline bool isWhitespace( char const c )
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/**
+ * Greedily reads up to nMaxDigits digits, but stops before a digit which
+ * would make the value exceed nMaxValue, i.e. "13" with nMaxValue = 12
+ * only reads "1". This is what the alternatives like (1[0-2]|0?[0-9]) did
+ * in the regex version. Values below nMinValue, e.g. month "00", fail.
+ */
+inline bool parseDigits
 (
-    std::string const & sDate,
-    std::string const & dateFormatter,
-    double      const   timeZone
+    char const * &       it,
+    char const * const   end,
+    unsigned int const   nMinDigits,
+    unsigned int const   nMaxDigits,
+    int          const   nMinValue,
+    int          const   nMaxValue,
+    int          &       result
 )
 {
-    std::vector< std::string > namedCaptures = {};
-    std::regex * dateRegex;
-    std::string const sDateRegex = dateFormatterToRegex( dateFormatter, &namedCaptures );
+    int value = 0;
+    unsigned int nDigits = 0u;
+    for ( ; ( nDigits < nMaxDigits ) && ( it != end ); ++nDigits, ++it )
     {
-        static std::map< std::string, std::regex > regexCache = {};
-        auto const & it = regexCache.find( sDateRegex );
-        if ( it != regexCache.end() )
-            dateRegex = &it->second; // ... ... COPY CONSTRUCTOR ALSO SLOW on gcc 4.9 on another test system! -> use pointer
-        else
+        auto const digit = *it - '0';
+        if ( ( digit < 0 ) || ( digit > 9 ) || ( value * 10 + digit > nMaxValue ) )
+            break;
+        value = value * 10 + digit;
+    }
+    if ( ( nDigits < nMinDigits ) || ( value < nMinValue ) )
+        return false;
+    result = value;
+    return true;
+}
+
+/**
+ * Calls processChunk( iBegin, iEnd ) for nThreads roughly equally sized
+ * chunks of [0,n) in parallel on defaultThreadPool() and returns the sum of
+ * the returned values. nThreads is capped to the size of the pool.
+ */
+template< typename T_Functor >
+size_t sumOverChunksParallel
+(
+    size_t       const n,
+    unsigned int       nThreads,
+    T_Functor    const & processChunk
+)
+{
+    /* below this, starting a thread costs more than it saves */
+    size_t constexpr nMinPerThread = 4096;
+
+    if ( nThreads == 1 )
+        return processChunk( size_t( 0 ), n );
+
+    auto & pool = Fundamental::defaultThreadPool();
+    if ( ( nThreads == 0 ) || ( nThreads > pool.size() ) )
+        nThreads = pool.size();
+    nThreads = std::min< size_t >( nThreads, std::max< size_t >( 1, n / nMinPerThread ) );
+    if ( nThreads <= 1 )
+        return processChunk( size_t( 0 ), n );
+
+    std::vector< size_t > results( nThreads, 0 );
+    auto const nPerThread = ceilDiv( n, nThreads );
+    pool.parallelFor( nThreads, [&] ( size_t const iThread, unsigned int ) {
+        results[iThread] = processChunk( std::min( n,   iThread       * nPerThread ),
+                                         std::min( n, ( iThread + 1 ) * nPerThread ) );
+    } );
+
+    size_t sum = 0;
+    for ( auto const result : results )
+        sum += result;
+    return sum;
+}
+
+
+} // anonymous namespace
+
+
+CompiledDateFormat::CompiledDateFormat( std::string const & dateFormatter )
+{
+    static std::map< std::string, std::string > const shorthands = {
+        { "%D", "%m / %d / %y "   },
+        { "%r", "%I : %M : %S %p" },
+        { "%R", "%H : %M"         },
+        { "%T", "%H : %M : %S"    },
+    };
+    auto s = dateFormatter;
+    for ( auto const & rule : shorthands )
+        s = replace( s, rule.first, rule.second );
+
+    static std::map< char, Field > const specifiers = {
+        { 'n', Field::Whitespace            },
+        { 't', Field::Whitespace            },
+        { 'Y', Field::Year4                 },
+        { 'y', Field::Year2                 },
+        { 'm', Field::Month                 },
+        { 'j', Field::DayOfYear             },
+        { 'd', Field::DayOfMonth            },
+        { 'e', Field::DayOfMonthSpacePadded },
+        { 'w', Field::WeekDay               },
+        { 'H', Field::Hour24                },
+        { 'I', Field::Hour12                },
+        { 'M', Field::Minute                },
+        { 'S', Field::Second                },
+        { 'p', Field::AmPm                  }
+    };
+
+    for ( size_t i = 0u; i < s.size(); ++i )
+    {
+        if ( isWhitespace( s[i] ) )
+        {
+            /* one whitespace token already matches any amount of whitespace */
+            if ( tokens.empty() || ( tokens.back().field != Field::Whitespace ) )
+                tokens.push_back( { Field::Whitespace, ' ' } );
+            continue;
+        }
+
+        if ( s[i] != '%' )
+        {
+            tokens.push_back( { Field::Literal, s[i] } );
+            continue;
+        }
+
+        if ( not ( i+1 < s.size() ) )
+            throw std::invalid_argument( "[CompiledDateFormat] Formatter must not end with a single '%'!" );
+        ++i;
+        if ( s[i] == '%' )
+        {
+            tokens.push_back( { Field::Literal, '%' } );
+            continue;
+        }
+
+        auto const it = specifiers.find( s[i] );
+        if ( it == specifiers.end() )
+            throw std::invalid_argument( std::string( "[CompiledDateFormat] Unsupported conversion specifier '%" ) + s[i] + "'!" );
+        if ( ( it->second != Field::Whitespace ) || tokens.empty() ||
+             ( tokens.back().field != Field::Whitespace ) )
         {
-            std::cout << "Create new regex object for '" << sDateRegex << "'" << std::endl;
-            regexCache[ sDateRegex ] = std::regex( sDateRegex ); // FUCKING SLOW!!!!! for a simple constructor -.-
-            dateRegex = &regexCache[ sDateRegex ];
+            tokens.push_back( { it->second, ' ' } );
         }
     }
+}
 
-    // https://stackoverflow.com/questions/20942450/why-c11-regex-libc-implementation-is-so-slow
-    //std::regex dateRegex( sDateRegex ); // FUCKING SLOW!!!!!
-    std::smatch matches;
-    auto const found = std::regex_match( sDate, matches, *dateRegex );
-    if ( not found )
-        throw std::invalid_argument( "Couldn't parse give string with given formatter." );
-    /* first in match is always the whole match, then followed by capture groups */
-    /*
-    std::cout << "[parseTime] '" << sDate << "' using '" << dateFormatter << "'" << std::endl;
-    std::cout << "  Regex        : " << sDateRegex    << std::endl;
-    std::cout << "  Capture Names: " << namedCaptures << std::endl;
-    std::cout << "  Found: " << found << std::endl;
-    std::cout << "  Matches: ";
-    for ( auto const & m : matches )
-        std::cout << m << ", ";
-    std::cout << std::endl;
-    */
+bool CompiledDateFormat::parse
+(
+    char const * const begin,
+    char const * const end,
+    std::tm    &       result
+) const
+{
+    auto it = begin;
+    int value = 0;
+    int isPm  = -1;  /* -1: no %p, 0: AM, 1: PM */
+    bool hasMonthOrDay = false;
+    bool hasDayOfYear  = false;
+
+    /* http://en.cppreference.com/w/cpp/chrono/c/tm */
+    for ( auto const & token : tokens )
+    {
+        switch ( token.field )
+        {
+            case Field::Literal:
+                if ( ( it == end ) || ( *it != token.literal ) )
+                    return false;
+                ++it;
+                break;
+
+            case Field::Whitespace:
+                while ( ( it != end ) && isWhitespace( *it ) )
+                    ++it;
+                break;
+
+            case Field::Year4:
+                if ( not parseDigits( it, end, 1, 4, 0, 9999, value ) )
+                    return false;
+                result.tm_year = value - 1900;
+                break;
+
+            case Field::Year2:
+                if ( not parseDigits( it, end, 2, 2, 0, 99, value ) )
+                    return false;
+                result.tm_year = ( value < 69 ? 2000 + value : 1900 + value ) - 1900;
+                break;
+
+            case Field::Month:
+                if ( not parseDigits( it, end, 1, 2, 1, 12, value ) )
+                    return false;
+                result.tm_mon = value - 1;   // starts at 0
+                hasMonthOrDay = true;
+                break;
+
+            case Field::DayOfYear:
+                if ( not parseDigits( it, end, 1, 3, 1, 366, value ) )
+                    return false;
+                result.tm_yday = value - 1;  // days since January 1st
+                hasDayOfYear = true;
+                break;
+
+            case Field::DayOfMonthSpacePadded:
+                if ( ( it != end ) && ( *it == ' ' ) )
+                    ++it;
+                /* fall through */
+            case Field::DayOfMonth:
+                if ( not parseDigits( it, end, 1, 2, 1, 31, value ) )
+                    return false;
+                result.tm_mday = value;
+                hasMonthOrDay = true;
+                break;
+
+            case Field::WeekDay:
+                if ( not parseDigits( it, end, 1, 1, 0, 6, value ) )
+                    return false;
+                result.tm_wday = value;
+                break;
+
+            case Field::Hour24:
+                if ( not parseDigits( it, end, 1, 2, 0, 23, value ) )
+                    return false;
+                result.tm_hour = value;
+                break;
+
+            case Field::Hour12:
+                if ( not parseDigits( it, end, 1, 2, 1, 12, value ) )
+                    return false;
+                result.tm_hour = value;
+                break;
+
+            case Field::Minute:
+                if ( not parseDigits( it, end, 1, 2, 0, 59, value ) )
+                    return false;
+                result.tm_min = value;
+                break;
+
+            case Field::Second:
+                if ( not parseDigits( it, end, 1, 2, 0, 59, value ) )
+                    return false;
+                result.tm_sec = value;
+                break;
+
+            case Field::AmPm:
+            {
+                /* [apAP]\.?[mM]\.? */
+                if ( it == end )
+                    return false;
+                if ( ( *it == 'a' ) || ( *it == 'A' ) )
+                    isPm = 0;
+                else if ( ( *it == 'p' ) || ( *it == 'P' ) )
+                    isPm = 1;
+                else
+                    return false;
+                ++it;
+                if ( ( it != end ) && ( *it == '.' ) )
+                    ++it;
+                if ( ( it == end ) || not ( ( *it == 'm' ) || ( *it == 'M' ) ) )
+                    return false;
+                ++it;
+                if ( ( it != end ) && ( *it == '.' ) )
+                    ++it;
+                break;
+            }
+        }
+    }
+
+    if ( it != end )
+        return false;
+
+    /* applied after all fields are read, so that %p may come before %I */
+    if ( ( isPm == 1 ) && ( result.tm_hour < 12 ) )
+        result.tm_hour += 12;
+    /* 12:16 AM is 00:16 in 24h -.-
+     * @see https://www.italki.com/question/277978?hl=de
+     * @see Bittrex data set */
+    if ( ( isPm == 0 ) && ( result.tm_hour >= 12 ) )
+        result.tm_hour -= 12;
 
+    /* like strptime, so that e.g. "%Y-%j" can be converted with timegm */
+    if ( hasDayOfYear && not hasMonthOrDay )
+    {
+        auto const date = civilFromDays( daysFromCivil< long long int >( result.tm_year + 1900LL, 1, 1 ) + result.tm_yday );
+        result.tm_mon  = int( date.month ) - 1;
+        result.tm_mday = int( date.day );
+    }
+
+    return true;
+}
+
+double CompiledDateFormat::parseTime
+(
+    char const * const begin,
+    char const * const end,
+    double       const timeZone
+) const
+{
     std::tm date = {};
-    // assert( matches.size() == namedCaptures.size() + 1 );
-    for ( size_t i = 0u; i < namedCaptures.size(); ++i )
-    {
-        /* http://en.cppreference.com/w/cpp/chrono/c/tm */
-        auto const & match = matches[i+1].str();
-        if ( namedCaptures[i] == std::string( "Y" ) )
-            date.tm_year = std::stoi( match ) - 1900;
-        else if ( namedCaptures[i] == std::string( "y" ) )
+    if ( not parse( begin, end, date ) )
+        throw std::invalid_argument( "Couldn't parse give string with given formatter." );
+    return timegm( date ) - timeZone;
+}
+
+
+double parseTime
+(
+    std::string const & sDate,
+    std::string const & dateFormatter,
+    double      const   timeZone
+)
+{
+    INSTRUMENT_SCOPE( "parseTime" );
+    /* One cache per thread, so that no locking is necessary. The compiled
+     * formats are small, so the duplication doesn't matter. */
+    thread_local std::map< std::string, CompiledDateFormat > formatCache = {};
+    auto it = formatCache.find( dateFormatter );
+    if ( it == formatCache.end() )
+        it = formatCache.emplace( dateFormatter, CompiledDateFormat( dateFormatter ) ).first;
+    return it->second.parseTime( sDate.data(), sDate.data() + sDate.size(), timeZone );
+}
+
+size_t parseTimes
+(
+    char               const * const buffer,
+    size_t             const * const offsets,
+    size_t             const         nDates,
+    CompiledDateFormat const &       format,
+    double                   * const result,
+    double             const         timeZone,
+    unsigned int       const         nThreads
+)
+{
+    INSTRUMENT_SCOPE( "parseTimes" );
+    INSTRUMENT_COUNT( "parseTimes/dates", nDates );
+    auto const nan = std::numeric_limits< double >::quiet_NaN();
+    auto const parseChunk = [&] ( size_t const iBegin, size_t const iEnd )
+    {
+        size_t nFailed = 0;
+        for ( size_t i = iBegin; i < iEnd; ++i )
         {
-            auto const y = std::stoi( match );
-            date.tm_year = ( y < 69 ? 2000 + y : 1900 + y ) - 1900;
+            std::tm date = {};
+            if ( format.parse( buffer + offsets[i], buffer + offsets[i+1], date ) )
+                result[i] = timegm( date ) - timeZone;
+            else
+            {
+                result[i] = nan;
+                ++nFailed;
+            }
         }
-        else if ( namedCaptures[i] == std::string( "m" ) )
-            date.tm_mon = std::stoi( match ) - 1;   // starts at 0
-        else if ( namedCaptures[i] == std::string( "j" ) )
-            date.tm_yday = std::stoi( match );
-        else if ( ( namedCaptures[i] == std::string( "d" ) ) ||
-                  ( namedCaptures[i] == std::string( "e" ) ) )
-            date.tm_mday = std::stoi( match );
-        else if ( ( namedCaptures[i] == std::string( "H" ) ) ||
-                  ( namedCaptures[i] == std::string( "I" ) ) )
-            date.tm_hour = std::stoi( match );
-        else if ( namedCaptures[i] == std::string( "M" ) )
-            date.tm_min = std::stoi( match );
-        else if ( namedCaptures[i] == std::string( "S" ) )
-            date.tm_sec = std::stoi( match );
-        else if ( namedCaptures[i] == std::string( "p" ) )
+        return nFailed;
+    };
+    return sumOverChunksParallel( nDates, nThreads, parseChunk );
+}
+
+size_t parseTimes
+(
+    std::vector< std::string > const &       dates,
+    std::string                const &       dateFormatter,
+    double                           * const result,
+    double                     const         timeZone,
+    unsigned int               const         nThreads
+)
+{
+    INSTRUMENT_SCOPE( "parseTimes" );
+    INSTRUMENT_COUNT( "parseTimes/dates", dates.size() );
+    CompiledDateFormat const format( dateFormatter );
+    auto const nan = std::numeric_limits< double >::quiet_NaN();
+    auto const parseChunk = [&] ( size_t const iBegin, size_t const iEnd )
+    {
+        size_t nFailed = 0;
+        for ( size_t i = iBegin; i < iEnd; ++i )
         {
-            if ( ( std::find( match.begin(), match.end(), 'P' ) != match.end() ) ||
-                 ( std::find( match.begin(), match.end(), 'p' ) != match.end() ) )
+            auto const & sDate = dates[i];
+            std::tm date = {};
+            if ( format.parse( sDate.data(), sDate.data() + sDate.size(), date ) )
+                result[i] = timegm( date ) - timeZone;
+            else
             {
-                if ( date.tm_hour < 12 )
-                    date.tm_hour += 12;
+                result[i] = nan;
+                ++nFailed;
             }
-            if ( ( std::find( match.begin(), match.end(), 'A' ) != match.end() ) ||
-                 ( std::find( match.begin(), match.end(), 'a' ) != match.end() ) )
+        }
+        return nFailed;
+    };
+    return sumOverChunksParallel( dates.size(), nThreads, parseChunk );
+}
+
+
+} // namespace compileTime
+
+
+#ifdef MAIN_TEST_TIMEEXTENSIONS
+
+
+/* the POSIX and glibc functions this is compared against */
+#include <time.h>                       // strptime, strftime, timegm, gmtime_r
+
+#include <cstdlib>                      // rand
+#include <cstring>                      // strlen
+#include <iostream>
+
+
+bool sameDate( std::tm const & a, std::tm const & b )
+{
+    return a.tm_year == b.tm_year && a.tm_mon == b.tm_mon && a.tm_mday == b.tm_mday &&
+           a.tm_hour == b.tm_hour && a.tm_min == b.tm_min  && a.tm_sec  == b.tm_sec;
+}
+
+bool testCalendar( void )
+{
+    using namespace Fundamental;
+    bool success = true;
+
+    /* every day from 1 BC to 4200, i.e. including 1900, 2000 and 2100 */
+    for ( long long int days = -720000; days < 800000; ++days )
+    {
+        std::time_t const t = days * 86400 + ( days & 0xFFFF );
+        std::tm expected;
+        gmtime_r( &t, &expected );
+
+        auto const date = civilFromDays( days );
+        success &= date.year == expected.tm_year + 1900LL && int( date.month ) == expected.tm_mon + 1
+                   && int( date.day ) == expected.tm_mday;
+        success &= daysFromCivil( date.year, (long long int) date.month, (long long int) date.day ) == days;
+
+        auto const result = Fundamental::gmtime( double( t ) + 0.5 );
+        success &= sameDate( result, expected ) && result.tm_wday == expected.tm_wday
+                   && result.tm_yday == expected.tm_yday && result.tm_isdst == 0;
+        success &= Fundamental::timegm( expected ) == double( ::timegm( &expected ) );
+    }
+
+    /* leap years: every 4th, but not every 100th, but every 400th */
+    for ( long long int year : { 1900LL, 1970LL, 2000LL, 2004LL, 2100LL, 1600LL, 1700LL, -4LL } )
+    {
+        bool const isLeapYear = year % 4 == 0 && ( year % 100 != 0 || year % 400 == 0 );
+        success &= daysFromCivil( year, 3LL, 1LL ) - daysFromCivil( year, 2LL, 28LL ) == ( isLeapYear ? 2 : 1 );
+        success &= daysFromCivil( year + 1, 1LL, 1LL ) - daysFromCivil( year, 1LL, 1LL ) == ( isLeapYear ? 366 : 365 );
+    }
+    static_assert( daysFromCivil( 1970, 1, 1 ) == 0, "" );
+    static_assert( unixTimeFromCivil( 2000, 3, 1, 12, 34, 56 ) == 951914096, "" );
+    static_assert( civilFromDays( -1 ).year == 1969 && civilFromDays( -1 ).day == 31, "" );
+
+    /* fields out of range are normalized like by glibc */
+    for ( int i = 0; i < 100000; ++i )
+    {
+        std::tm time = {};
+        time.tm_year = std::rand() % 400 - 200;
+        time.tm_mon  = std::rand() % 60 - 30;
+        time.tm_mday = std::rand() % 100 - 30;
+        time.tm_hour = std::rand() % 100 - 30;
+        time.tm_min  = std::rand() % 200 - 60;
+        time.tm_sec  = std::rand() % 200 - 60;
+        auto copy = time;
+        success &= Fundamental::timegm( time ) == double( ::timegm( &copy ) );
+    }
+
+    /* array versions */
+    std::vector< int > years, months, days, hours, minutes, seconds;
+    std::vector< double > expected;
+    for ( int i = 0; i < 1000; ++i )
+    {
+        std::time_t const t = ( (long long int)( std::rand() ) * std::rand() ) % ( 20000LL * 86400 ) - 10000LL * 86400;
+        std::tm time;
+        gmtime_r( &t, &time );
+        years  .push_back( time.tm_year + 1900 );
+        months .push_back( time.tm_mon + 1 );
+        days   .push_back( time.tm_mday );
+        hours  .push_back( time.tm_hour );
+        minutes.push_back( time.tm_min );
+        seconds.push_back( time.tm_sec );
+        expected.push_back( double( t ) );
+    }
+    std::vector< double > unixTimes( expected.size() );
+    unixTimeFromCivil( years.data(), months.data(), days.data(), hours.data(), minutes.data(),
+                       seconds.data(), years.size(), unixTimes.data() );
+    success &= unixTimes == expected;
+    auto fields = years;
+    civilFromUnixTime( unixTimes.data(), unixTimes.size(), fields.data(), fields.data(), fields.data(),
+                       fields.data(), fields.data(), fields.data() );
+    success &= fields == seconds;
+
+    std::cout << "Calendar arithmetic compared to glibc " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+/* @return false if strptime doesn't consume the whole string */
+bool strptimeWhole( std::string const & date, std::string const & format, std::tm & result )
+{
+    auto const end = strptime( date.c_str(), format.c_str(), &result );
+    return end != nullptr && *end == '\0';
+}
+
+bool testParsing( void )
+{
+    using namespace Fundamental;
+    bool success = true;
+
+    /* all specifiers and shorthands CompiledDateFormat accepts */
+    std::vector< std::string > const formats = {
+        "%Y-%m-%d %H:%M:%S", "%Y%m%d", "%d.%m.%Y %T", "%D", "%y-%m-%d %R", "%I:%M:%S %p",
+        "%p %I:%M", "%r", "%e/%m/%Y", "%Y-%j", "%w %H", "%Y%%%m", "%Y%n%m%t%d"
+    };
+    for ( auto const & formatter : formats )
+    {
+        CompiledDateFormat const format( formatter );
+        bool const hasDayOfYear = formatter.find( "%j" ) != std::string::npos;
+        bool const hasWeekDay   = formatter.find( "%w" ) != std::string::npos;
+        bool const hasFullDate  = formatter.find( "%Y-%m-%d" ) != std::string::npos;
+
+        std::vector< std::string > dates;
+        std::vector< double > expectedTimes;
+        for ( int i = 0; i < 20000; ++i )
+        {
+            /* 1000 to 9999, i.e. what %Y can hold, including dates before 1970 */
+            std::time_t const t = ( std::rand() % 3286000 - 354000LL ) * 86400 + std::rand() % 86400;
+            std::tm time;
+            gmtime_r( &t, &time );
+            char buffer[64];
+            auto const n = strftime( buffer, sizeof( buffer ), formatter.c_str(), &time );
+            dates.emplace_back( buffer, n );
+
+            std::tm expected = {};
+            std::tm result = {};
+            bool const parsedExpected = strptimeWhole( dates.back(), formatter, expected );
+            bool const parsed = format.parse( dates.back().data(), dates.back().data() + dates.back().size(), result );
+            bool ok = parsedExpected && parsed && sameDate( result, expected );
+            if ( hasDayOfYear ) ok &= result.tm_yday == expected.tm_yday;
+            if ( hasWeekDay   ) ok &= result.tm_wday == expected.tm_wday;
+            if ( not ok )
             {
-                /* 12:16 AM is 00:16 in 24h -.-
-                 * @see https://www.italki.com/question/277978?hl=de
-                 * @see Bittrex data set */
-                if ( date.tm_hour >= 12 )
-                    date.tm_hour -= 12;
+                std::cout << "Parsing \"" << dates.back() << "\" with \"" << formatter << "\" differs from strptime\n";
+                success = false;
             }
+            expectedTimes.push_back( double( ::timegm( &expected ) ) );
+        }
+
+        if ( hasFullDate )
+        {
+            std::vector< double > times( dates.size() );
+            success &= parseTimes( dates, formatter, times.data(), 0, 4 ) == 0;
+            success &= times == expectedTimes;
+            success &= parseTime( dates[0], formatter, 3600 ) == expectedTimes[0] - 3600;
         }
     }
 
-    //std::cout << date << std::endl;
-    return timegm( date ) - timeZone;
+    /* leading zeros are optional */
+    {
+        std::tm result = {};
+        success &= CompiledDateFormat( "%Y-%m-%d %H:%M:%S" ).parse( "2017-6-1 1:2:3", "2017-6-1 1:2:3" + 14, result );
+        std::tm expected = {};
+        success &= strptimeWhole( "2017-6-1 1:2:3", "%Y-%m-%d %H:%M:%S", expected ) && sameDate( result, expected );
+    }
+
+    /* malformed input must be rejected by both */
+    std::string const formatter = "%Y-%m-%d %H:%M:%S";
+    CompiledDateFormat const format( formatter );
+    std::vector< std::string > const malformed = {
+        "", "2017", "2017-06-01", "2017-06-01 12:34", "2017-06-01 12:34:56x", "2017/06/01 12:34:56",
+        "abcd-06-01 12:34:56", "2017-13-01 12:34:56", "2017-00-01 12:34:56", "2017-06-32 12:34:56",
+        "2017-06-00 12:34:56", "2017-06-01 24:00:00", "2017-06-01 12:60:00", "2017-06-01 12:-1:00",
+        "2017-06-01T12:34:56", "20170-06-01 12:34:56"
+    };
+    std::vector< size_t > offsets = { 0 };
+    std::string buffer;
+    for ( auto const & date : malformed )
+    {
+        std::tm result = {};
+        std::tm expected = {};
+        if ( format.parse( date.data(), date.data() + date.size(), result ) ||
+             strptimeWhole( date, formatter, expected ) )
+        {
+            std::cout << "Malformed \"" << date << "\" was not rejected by "
+                      << ( strptimeWhole( date, formatter, expected ) ? "strptime" : "CompiledDateFormat" ) << "\n";
+            success = false;
+        }
+        buffer += date;
+        offsets.push_back( buffer.size() );
+    }
+    std::vector< double > times( malformed.size() );
+    success &= parseTimes( buffer.data(), offsets.data(), malformed.size(), format, times.data() ) == malformed.size();
+    for ( auto const time : times )
+        success &= std::isnan( time );
+
+    bool threw = false;
+    try { parseTime( "2017-06-01", formatter ); } catch ( std::invalid_argument const & ) { threw = true; }
+    success &= threw;
+
+    /* unsupported specifiers */
+    for ( auto const & unsupported : { "%Y-%b", "%Y%", "%Q" } )
+    {
+        threw = false;
+        try { CompiledDateFormat format( unsupported ); } catch ( std::invalid_argument const & ) { threw = true; }
+        success &= threw;
+    }
+
+    std::cout << "Date parsing compared to strptime " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+int main()
+{
+    bool success = testCalendar();
+    success &= testParsing();
+    return success ? 0 : 1;
 }
 
 
-} // namespace compileTime
+#endif
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>                      // size_t
 #include <ctime>                        // tm
 #include <iomanip>                      // locale
 #include <string>
@@ -14,12 +15,202 @@ namespace Fundamental {
  */
 double getTimeZone( void );
 
+namespace detail {
+
+/* C++11 constexpr functions may only consist of one return statement, that's
+ * why the algorithms below are split into multiple helper functions */
+
+template< typename T_Int >
+inline constexpr T_Int floorDiv( T_Int const a, T_Int const b )
+{
+    return ( a >= 0 ? a : a - ( b - 1 ) ) / b;
+}
+
+template< typename T_Int >
+inline constexpr T_Int daysFromCivil
+(
+    T_Int const era,
+    T_Int const yearOfEra,  /**< [0,399] */
+    T_Int const dayOfYear   /**< [0,365] beginning with March 1st */
+)
+{
+    return era * 146097 + yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100
+           + dayOfYear - 719468;
+}
+
+template< typename T_Int >
+inline constexpr T_Int daysFromCivilShifted
+(
+    T_Int const year,       /**< year beginning with March */
+    T_Int const month,
+    T_Int const day
+)
+{
+    return daysFromCivil< T_Int >(
+        floorDiv< T_Int >( year, 400 ),
+        year - floorDiv< T_Int >( year, 400 ) * 400,
+        ( 153 * ( month > 2 ? month - 3 : month + 9 ) + 2 ) / 5 + day - 1
+    );
+}
+
+} // namespace detail
+
+/**
+ * Pure arithmetic conversion without any time zone database or locking.
+ * Works for the proleptic Gregorian calendar including negative years.
+ * @see http://howardhinnant.github.io/date_algorithms.html#days_from_civil
+ *
+ * @param[in] month 1 to 12
+ * @param[in] day 1 to 31
+ * @return days since 1970-01-01
+ */
+template< typename T_Int = long long int >
+inline constexpr T_Int daysFromCivil
+(
+    T_Int const year,
+    T_Int const month,
+    T_Int const day
+)
+{
+    return detail::daysFromCivilShifted< T_Int >( month <= 2 ? year - 1 : year, month, day );
+}
+
+/**
+ * @return unix time stamp for the given UTC date
+ */
+template< typename T_Int = long long int >
+inline constexpr T_Int unixTimeFromCivil
+(
+    T_Int const year,
+    T_Int const month,
+    T_Int const day,
+    T_Int const hour   = 0,
+    T_Int const minute = 0,
+    T_Int const second = 0
+)
+{
+    return daysFromCivil< T_Int >( year, month, day ) * 86400
+           + hour * 3600 + minute * 60 + second;
+}
+
+struct CivilDate
+{
+    long long int year;
+    unsigned int  month;  /**< 1 to 12 */
+    unsigned int  day;    /**< 1 to 31 */
+};
+
+namespace detail {
+
+inline constexpr CivilDate civilFromMonthIndex
+(
+    long long int const year,
+    long long int const dayOfYear,  /**< [0,365] beginning with March 1st */
+    long long int const monthIndex  /**< [0,11] beginning with March */
+)
+{
+    return CivilDate{
+        year + ( monthIndex >= 10 ? 1 : 0 ),
+        (unsigned int)( monthIndex < 10 ? monthIndex + 3 : monthIndex - 9 ),
+        (unsigned int)( dayOfYear - ( 153 * monthIndex + 2 ) / 5 + 1 )
+    };
+}
+
+inline constexpr CivilDate civilFromDayOfYear
+(
+    long long int const year,
+    long long int const dayOfYear
+)
+{
+    return civilFromMonthIndex( year, dayOfYear, ( 5 * dayOfYear + 2 ) / 153 );
+}
+
+inline constexpr CivilDate civilFromYearOfEra
+(
+    long long int const era,
+    long long int const dayOfEra,   /**< [0,146096] */
+    long long int const yearOfEra   /**< [0,399] */
+)
+{
+    return civilFromDayOfYear(
+        era * 400 + yearOfEra,
+        dayOfEra - ( 365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100 )
+    );
+}
+
+inline constexpr CivilDate civilFromDayOfEra
+(
+    long long int const era,
+    long long int const dayOfEra
+)
+{
+    return civilFromYearOfEra( era, dayOfEra,
+        ( dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096 ) / 365 );
+}
+
+inline constexpr CivilDate civilFromShiftedDays( long long int const days )
+{
+    return civilFromDayOfEra( floorDiv< long long int >( days, 146097 ),
+                              days - floorDiv< long long int >( days, 146097 ) * 146097 );
+}
+
+} // namespace detail
+
+/**
+ * Inverse of daysFromCivil
+ * @see http://howardhinnant.github.io/date_algorithms.html#civil_from_days
+ */
+inline constexpr CivilDate civilFromDays( long long int const days )
+{
+    return detail::civilFromShiftedDays( days + 719468 );
+}
+
+/**
+ * Thread-safe and lock-free replacement for std::gmtime. The fractional part
+ * of unixTime is discarded, i.e. it is rounded towards negative infinity.
+ * tm_isdst is always 0.
+ */
+std::tm gmtime( double const unixTime );
+
 /**
  * Written because timegm isn't in the STL. It's in the Linux headers, but not
- * available on Windows
+ * available on Windows. Fields out of range are normalized like with
+ * std::mktime, e.g. tm_mon = 12 means January of the next year.
+ * This does only integer arithmetic and does not use the time zone database.
  */
 double timegm( std::tm time );
 
+/**
+ * Vectorizable version of unixTimeFromCivil for arrays of fields.
+ * Fields must be given like for unixTimeFromCivil, i.e. not normalized.
+ */
+void unixTimeFromCivil
+(
+    int const * const years,
+    int const * const months,
+    int const * const days,
+    int const * const hours,
+    int const * const minutes,
+    int const * const seconds,
+    size_t      const n,
+    double    * const result
+);
+
+/**
+ * Inverse of the above. The fractional part of the time stamps is discarded.
+ */
+void civilFromUnixTime
+(
+    double const * const unixTimes,
+    size_t         const n,
+    int          * const years,
+    int          * const months,
+    int          * const days,
+    int          * const hours,
+    int          * const minutes,
+    int          * const seconds
+);
+
 /**
  * Written as a shorthand for get_time with some default values set,
  * reducing complexity of usage
@@ -42,7 +233,71 @@ double timegm( std::tm time );
 ); */
 
 /**
- * Helper function for parseTime below
+ * Date formatter which is translated only once into a list of tokens, so that
+ * many date strings can be parsed with it without having to build any regex,
+ * std::string or other temporaries per call. Digits are directly accumulated
+ * into the std::tm fields.
+ *
+ * Supported specifiers: %Y %y %m %j %d %e %w %H %I %M %S %p %% %n %t and the
+ * shorthands %D %r %R %T. Like for std::get_time, whitespace in the formatter
+ * (and %n, %t) matches zero or more whitespace characters. Numbers may be
+ * given without leading zeros. Digits are consumed greedily as long as the
+ * value stays in the valid range, so "%Y%m%d" also works for "20170601".
+ */
+class CompiledDateFormat
+{
+public:
+    /**
+     * @throw std::invalid_argument for unsupported conversion specifiers
+     */
+    explicit CompiledDateFormat( std::string const & dateFormatter );
+
+    /**
+     * @param[in] begin,end character range to parse, doesn't need to be
+     *            null-terminated
+     * @param[out] result only the fields specified in the formatter are set,
+     *             all others are left as they were. Like for strptime, %j
+     *             without %m and %d also sets tm_mon and tm_mday.
+     * @return false if the characters do not match the whole formatter
+     */
+    bool parse
+    (
+        char const * const begin,
+        char const * const end,
+        std::tm    &       result
+    ) const;
+
+    /**
+     * Same as Fundamental::parseTime, i.e. returns the unix time stamp
+     * @throw std::invalid_argument if the date couldn't be parsed
+     */
+    double parseTime
+    (
+        char const * const begin,
+        char const * const end,
+        double       const timeZone = 0
+    ) const;
+
+private:
+    enum class Field : unsigned char
+    {
+        Literal, Whitespace,
+        Year4, Year2, Month, DayOfYear, DayOfMonth, DayOfMonthSpacePadded,
+        WeekDay, Hour24, Hour12, Minute, Second, AmPm
+    };
+
+    struct Token
+    {
+        Field field;
+        char  literal;  /**< only used for Field::Literal */
+    };
+
+    std::vector< Token > tokens;
+};
+
+/**
+ * Helper function for the former regex-based parseTime.
+ * Results are cached per thread, so this may be called concurrently.
  */
 std::string dateFormatterToRegex
 (
@@ -53,6 +308,9 @@ std::string dateFormatterToRegex
 /**
  * Written because get_time can't handle dates without leading zeros -.-
  * https://gcc.gnu.org/bugzilla/show_bug.cgi?id=45896
+ * Compiles dateFormatter only once per thread and caches it, so this may be
+ * called concurrently without any locking. For parsing many dates, better
+ * use CompiledDateFormat or parseTimes directly.
  */
 double parseTime
 (
@@ -61,5 +319,40 @@ double parseTime
     double      const   timeZone = 0
 );
 
+/**
+ * Parses a whole column of dates stored contiguously, e.g. as read from a
+ * CSV file. Date i is given by [ buffer + offsets[i], buffer + offsets[i+1] ),
+ * i.e. offsets has nDates + 1 elements like for Apache Arrow string columns.
+ *
+ * @param[out] result preallocated array for nDates unix time stamps. Dates
+ *             which couldn't be parsed are set to NaN
+ * @param[in] nThreads number of threads to split the column into equally
+ *            sized chunks for, run on Fundamental::defaultThreadPool() and
+ *            capped to its size. 0 uses all threads of it
+ * @return number of dates which couldn't be parsed
+ */
+size_t parseTimes
+(
+    char               const * const buffer,
+    size_t             const * const offsets,
+    size_t             const         nDates,
+    CompiledDateFormat const &       format,
+    double                   * const result,
+    double             const         timeZone = 0,
+    unsigned int       const         nThreads = 1
+);
+
+/**
+ * Convenience overload for a column of std::string, see above
+ */
+size_t parseTimes
+(
+    std::vector< std::string > const &       dates,
+    std::string                const &       dateFormatter,
+    double                           * const result,
+    double                     const         timeZone = 0,
+    unsigned int               const         nThreads = 1
+);
+
 
 } // namespace compileTime
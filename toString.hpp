@@ -1,21 +1,63 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 toString.hpp -DMAIN_TEST_TOSTRING && ./a.out
+*/
 #pragma once
 
 
 #include <array>
 #include <cassert>
+#include <cstring>              // strlen
 #include <ctime>
 #include <iomanip>              // get_time
 #include <list>
 #include <map>
 #include <string>               // getline
 #include <sstream>
+#include <type_traits>          // true_type, false_type
 #include <utility>
 #include <vector>
 
+#include "Fundamental.hpp"      // TextBuffer
 #include "timeExtensions.hpp"
 #include "toString.hpp"
 
 
+/**
+ * All toString and operator<< overloads of this file format by appending to
+ * one TextBuffer, i.e., nested containers don't construct a stream per
+ * element and level. Numbers are formatted like operator<< of a new
+ * stream, i.e., with precision 6 for floating point types. Only types
+ * without an appendString overload fall back to their operator<<.
+ */
+template< typename T >
+inline void appendString( TextBuffer & out, T const & a );
+
+inline void appendString( TextBuffer & out, std::string const & a );
+
+inline void appendString( TextBuffer & out, char const * a );
+
+inline void appendString( TextBuffer & out, char a );
+
+inline void appendString( TextBuffer & out, bool a );
+
+template< typename T_DTYPE >
+inline void appendString( TextBuffer & out, std::list<T_DTYPE> const & ls );
+
+template< typename T_Key, typename T_Val >
+inline void appendString( TextBuffer & out, std::map<T_Key,T_Val> const & val );
+
+template< typename T_Key, typename T_Val >
+inline void appendString( TextBuffer & out, std::pair< T_Key, T_Val > const & x );
+
+template< typename T, std::size_t I >
+inline void appendString( TextBuffer & out, std::array<T,I> const & data );
+
+template< typename T >
+inline void appendString( TextBuffer & out, std::vector<T> const & data );
+
+inline void appendString( TextBuffer & out, std::tm const & data );
+
+
 template< typename T >
 inline std::string toString( T const & a );
 
@@ -57,7 +99,9 @@ inline std::ostream & operator<<                                            \
     TYPE const & data                                                       \
 )                                                                           \
 {                                                                           \
-    out << toString( data );                                                \
+    TextBuffer text;                                                        \
+    appendString( text, data );                                             \
+    out.write( text.data(), std::streamsize( text.size() ) );               \
     return out;                                                             \
 }
 
@@ -72,91 +116,297 @@ REDIRECT_TO_STRING( std::tm )
 #undef COMMA
 
 
+namespace detail {
+
+
+template< typename T >
+inline void appendString( TextBuffer & out, T const & a, std::true_type )
+{
+    out.writeGeneral( a );
+}
+
 /**
  * Watch out, for types which don't have operator<< overloaded this gets
  * called recursively!
  */
 template< typename T >
-inline std::string toString( T const & a )
+inline void appendString( TextBuffer & out, T const & a, std::false_type )
 {
-    std::stringstream tmp;
+    std::ostringstream tmp;
     tmp << a;
-    return tmp.str();
+    out.write( tmp.str() );
 }
 
+
+} // namespace detail
+
+
+template< typename T >
+inline void appendString( TextBuffer & out, T const & a )
+{
+    detail::appendString( out, a, detail::IsFastFormattable< T >() );
+}
+
+inline void appendString( TextBuffer & out, std::string const & a ) { out.write( a ); }
+inline void appendString( TextBuffer & out, char const * const a ) { out.write( a, std::strlen( a ) ); }
+inline void appendString( TextBuffer & out, char const a ) { out.write( a ); }
+inline void appendString( TextBuffer & out, bool const a ) { out.write( a ? '1' : '0' ); }
+
 template< typename T_DTYPE >
-inline std::string toString( std::list<T_DTYPE> const & ls )
+inline void appendString( TextBuffer & out, std::list<T_DTYPE> const & ls )
 {
-    std::stringstream out;
-    out << "{";
-    for ( typename std::list<T_DTYPE>::const_iterator it = ls.begin();
-    it != ls.end(); ++it )
-        out << *it << ",";
-    out << "}";
-    return out.str();
+    out.write( '{' );
+    for ( auto const & element : ls )
+    {
+        appendString( out, element );
+        out.write( ',' );
+    }
+    out.write( '}' );
 }
 
 template< typename T_Key, typename T_Val >
-inline std::string toString( std::map<T_Key,T_Val> const & val )
+inline void appendString( TextBuffer & out, std::map<T_Key,T_Val> const & val )
 {
-    std::stringstream out;
     for ( auto it = val.begin(); it != val.end(); ++it )
-        out << "map[" << it->first << "] = " << it->second << "\n";
-    return out.str();
+    {
+        out.write( "map[", 4 );
+        appendString( out, it->first );
+        out.write( "] = ", 4 );
+        appendString( out, it->second );
+        out.write( '\n' );
+    }
 }
 
 template< typename T_Key, typename T_Val >
-inline std::string toString( std::pair< T_Key, T_Val > const & x )
+inline void appendString( TextBuffer & out, std::pair< T_Key, T_Val > const & x )
 {
-    std::stringstream out;
-    out << "pair( " << x.first << ", " << x.second << " )";
-    return out.str();
+    out.write( "pair( ", 6 );
+    appendString( out, x.first );
+    out.write( ", ", 2 );
+    appendString( out, x.second );
+    out.write( " )", 2 );
+}
+
+template< typename T, std::size_t I >
+inline void appendString( TextBuffer & out, std::array<T,I> const & data )
+{
+    out.write( '(' );
+    if ( data.size() > 0 )
+        appendString( out, data[0] );
+    for ( size_t i = 1; i < data.size(); ++i )
+    {
+        out.write( ", ", 2 );
+        appendString( out, data[i] );
+    }
+    out.write( ')' );
+}
+
+template< typename T >
+inline void appendString( TextBuffer & out, std::vector<T> const & data )
+{
+    out.write( '{' );
+    if ( data.size() > 0 )
+        appendString( out, data[0] );
+    for ( size_t i = 1; i < data.size(); ++i )
+    {
+        out.write( ", ", 2 );
+        appendString( out, data[i] );
+    }
+    out.write( '}' );
+}
+
+inline void appendString( TextBuffer & out, std::tm const & data )
+{
+    std::pair< char const *, int > const fields[] = {
+        { "    tm_sec   : ", data.tm_sec   },
+        { "    tm_min   : ", data.tm_min   },
+        { "    tm_hour  : ", data.tm_hour  },
+        { "    tm_mday  : ", data.tm_mday  },
+        { "    tm_mon   : ", data.tm_mon   },
+        { "    tm_year  : ", data.tm_year  },
+        { "    tm_wday  : ", data.tm_wday  },
+        { "    tm_yday  : ", data.tm_yday  },
+        { "    tm_isdst : ", data.tm_isdst }
+    };
+    appendString( out, "tm\n{\n" );
+    for ( auto const & field : fields )
+    {
+        appendString( out, field.first );
+        appendString( out, field.second );
+        out.write( '\n' );
+    }
+    appendString( out, "}\n" );
+}
+
+
+namespace detail {
+
+
+template< typename T >
+inline std::string toStringWithBuffer( T const & a )
+{
+    TextBuffer text;
+    appendString( text, a );
+    return std::string( text.data(), text.size() );
 }
 
+
+} // namespace detail
+
+
+template< typename T >
+inline std::string toString( T const & a ) { return detail::toStringWithBuffer( a ); }
+
+template< typename T_DTYPE >
+inline std::string toString( std::list<T_DTYPE> const & ls ) { return detail::toStringWithBuffer( ls ); }
+
+template< typename T_Key, typename T_Val >
+inline std::string toString( std::map<T_Key,T_Val> const & val ) { return detail::toStringWithBuffer( val ); }
+
+template< typename T_Key, typename T_Val >
+inline std::string toString( std::pair< T_Key, T_Val > const & x ) { return detail::toStringWithBuffer( x ); }
+
 /* template deduction for this (and operator<<) fails unfortunately :(,
  * so operator<< not usable as tempalte paramaters would need to be specified! */
 template< typename T, std::size_t I >
-inline std::string toString( std::array<T,I> const & data )
+inline std::string toString( std::array<T,I> const & data ) { return detail::toStringWithBuffer( data ); }
+
+template< typename T >
+inline std::string toString( std::vector<T> const & data ) { return detail::toStringWithBuffer( data ); }
+
+inline std::string toString( std::tm const & data ) { return detail::toStringWithBuffer( data ); }
+
+
+#ifdef MAIN_TEST_TOSTRING
+
+
+#include <cmath>                        // pow
+#include <cstdlib>                      // rand
+#include <iostream>
+#include <limits>
+
+
+namespace {
+
+
+/* the formatting of all overloads before TextBuffer */
+template< typename T >
+std::string toStringWithStream( T const & a )
 {
-    std::stringstream out;
-    //out << std::setprecision(7) << std::setfill('0') << std::setw(9) << std::showpos;
-    out << "(";
-    if ( data.size() > 0 )
-        out << data[0];
-    for ( unsigned int i = 1; i < data.size(); ++i )
-        out << ", " << data[i];
-    out << ")";
-    return out.str();
+    std::stringstream tmp;
+    tmp << a;
+    return tmp.str();
 }
 
 template< typename T >
-inline std::string toString( std::vector<T> const & data )
+std::string toStringWithStream( std::vector<T> const & data )
 {
     std::stringstream out;
-    //out << std::setprecision(7) << std::setfill('0') << std::setw(9) << std::showpos;
     out << "{";
     if ( data.size() > 0 )
-        out << data[0];
+        out << toStringWithStream( data[0] );
     for ( unsigned int i = 1; i < data.size(); ++i )
-        out << ", " << data[i];
+        out << ", " << toStringWithStream( data[i] );
     out << "}";
     return out.str();
 }
 
-inline std::string toString( std::tm const & data )
+template< typename T_Key, typename T_Val >
+std::string toStringWithStream( std::pair< T_Key, T_Val > const & x )
 {
     std::stringstream out;
-    out
-    << "tm\n{\n"
-    << "    tm_sec   : " << data.tm_sec   << "\n"
-    << "    tm_min   : " << data.tm_min   << "\n"
-    << "    tm_hour  : " << data.tm_hour  << "\n"
-    << "    tm_mday  : " << data.tm_mday  << "\n"
-    << "    tm_mon   : " << data.tm_mon   << "\n"
-    << "    tm_year  : " << data.tm_year  << "\n"
-    << "    tm_wday  : " << data.tm_wday  << "\n"
-    << "    tm_yday  : " << data.tm_yday  << "\n"
-    << "    tm_isdst : " << data.tm_isdst << "\n"
-    << "}\n";
+    out << "pair( " << toStringWithStream( x.first ) << ", " << toStringWithStream( x.second ) << " )";
     return out.str();
 }
+
+template< typename T >
+bool checkToString( T const & a )
+{
+    auto const expected = toStringWithStream( a );
+    auto const result = toString( a );
+    std::stringstream stream;
+    stream << a;
+    if ( result != expected || stream.str() != expected )
+    {
+        std::cout << "toString returned \"" << result << "\" and operator<< \"" << stream.str()
+                  << "\" instead of \"" << expected << "\"\n";
+        return false;
+    }
+    return true;
+}
+
+/* not formattable by TextBuffer, i.e., uses operator<< */
+struct Point { int x, y; };
+
+std::ostream & operator<<( std::ostream & out, Point const & point )
+{
+    return out << "Point(" << point.x << "|" << point.y << ")";
+}
+
+bool testToString( void )
+{
+    bool success = true;
+
+    /* scalars exactly like a new stream, e.g., 6 significant digits */
+    std::vector< double > doubles = { 0., -0., 1., 0.1, 1. / 3., 123456., 1234567., 1e-5, 1e-4, 1e300, -2.5e-308,
+                                      5e-324, std::numeric_limits< double >::infinity(),
+                                      -std::numeric_limits< double >::infinity(), std::numeric_limits< double >::quiet_NaN() };
+    for ( int i = 0; i < 10000; ++i )
+        doubles.push_back( ( std::rand() - RAND_MAX / 2 ) * std::pow( 10., std::rand() % 40 - 20 ) / RAND_MAX );
+    for ( auto const x : doubles )
+    {
+        success &= checkToString( x );
+        success &= checkToString( float( x ) );
+        success &= checkToString( ( long double )( x ) );
+    }
+    for ( auto const x : { 0LL, 1LL, -1LL, std::numeric_limits< long long >::min(), std::numeric_limits< long long >::max() } )
+    {
+        success &= checkToString( x );
+        success &= checkToString( int( x ) );
+        success &= checkToString( ( unsigned long long )( x ) );
+        success &= checkToString( short( x ) );
+    }
+    success &= checkToString( 'a' ) && checkToString( true ) && checkToString( false );
+    success &= checkToString( std::string( "ab c" ) ) && toString( "text" ) == "text";
+    success &= checkToString( Point{ 1, -2 } );
+
+    /* containers */
+    success &= checkToString( doubles );
+    success &= checkToString( std::vector< int >{} );
+    success &= checkToString( std::vector< std::pair< std::string, double > >{ { "a", 0.5 }, { "b", 1. / 3. } } );
+    success &= checkToString( std::vector< std::vector< Point > >{ { Point{ 1, 2 } }, {}, { Point{ 3, 4 }, Point{ 5, 6 } } } );
+    success &= checkToString( std::make_pair( 'x', std::vector< bool >{ true, false } ) );
+
+    success &= toString( std::list< int >{ 1, 2, 3 } ) == "{1,2,3,}";
+    success &= toString( std::array< float, 3 >{ { 1.5f, 2.f, 1e10f } } ) == "(1.5, 2, 1e+10)";
+    success &= toString( std::map< int, std::string >{ { 1, "a" }, { 2, "b" } } ) == "map[1] = a\nmap[2] = b\n";
+
+    std::tm time{};
+    time.tm_year = 120;
+    time.tm_mday = 31;
+    success &= toString( time ) == "tm\n{\n    tm_sec   : 0\n    tm_min   : 0\n    tm_hour  : 0\n    tm_mday  : 31\n"
+                                   "    tm_mon   : 0\n    tm_year  : 120\n    tm_wday  : 0\n    tm_yday  : 0\n"
+                                   "    tm_isdst : 0\n}\n";
+
+    /* appending to a caller-provided buffer */
+    TextBuffer text;
+    appendString( text, std::vector< int >{ 1, 2 } );
+    appendString( text, ' ' );
+    appendString( text, std::make_pair( 0.25, 7 ) );
+    success &= std::string( text.data(), text.size() ) == "{1, 2} pair( 0.25, 7 )";
+
+    std::cout << "toString " << ( success ? "OK" : "FAILED" ) << "\n";
+    return success;
+}
+
+
+} // namespace
+
+
+int main()
+{
+    testToString();
+}
+
+
+#endif
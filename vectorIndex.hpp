@@ -1,8 +1,23 @@
+/*
+g++ -x c++ -Wall -Wextra -O2 -std=c++11 vectorIndex.hpp -DMAIN_TEST_VECTORINDEX && ./a.out
+*/
 #pragma once
 
+#include <array>
 #include <cassert>
+#include <cstddef>                      // size_t
+#include <cstdint>                      // uint64_t
+#include <iterator>                     // forward_iterator_tag
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <tuple>                        // tuple_size
+#include <type_traits>                  // is_unsigned
+#include <utility>                      // pair
 #include <vector>
 
+#include "BitsCompileTime.hpp"          // mortonEncode
+
 
 /**
  * converts a vector index (i,j) to a linear index i*Nx+j
@@ -101,11 +116,601 @@ inline T_Vector convertLinearToVectorIndex
 }
 
 
+/**
+ * Division by a divisor only known at run time, but used for many
+ * divisions, with one multiplication, an addition and shifts instead of a
+ * division instruction, which takes 20-90 cycles for 64 bit. This is what
+ * compilers do for divisions by compile-time constants and what libdivide
+ * does for run-time constants.
+ *
+ * For N = digits of T_Uint, l = ceil( log2( d ) ) and
+ *   m = floor( 2^N ( 2^l - d ) / d ) + 1
+ * the quotient is exact for all n in [0,2^N):
+ *   t = ( m n ) / 2^N,  n / d = ( t + ( n - t ) / 2^min(l,1) ) / 2^max(l-1,0)
+ * where "/" with powers of two are shifts.
+ * @see T. Granlund, P. Montgomery, "Division by Invariant Integers using
+ *      Multiplication", 1994, Figure 4.1
+ * @see https://libdivide.com/
+ */
+template< typename T_Uint = size_t >
+class FastDivider
+{
+private:
+    static_assert( std::is_unsigned< T_Uint >::value && sizeof( T_Uint ) <= 8,
+                   "Only unsigned integers up to 64 bit are supported!" );
+    static int constexpr nBits = std::numeric_limits< T_Uint >::digits;
+
+    T_Uint        divisor   ;
+    T_Uint        multiplier;
+    unsigned char shift1    ;
+    unsigned char shift2    ;
+
+    /** @return the upper half of the 2N bit product */
+    static inline T_Uint multiplyHigh( T_Uint const a, T_Uint const b )
+    {
+        #if defined( __SIZEOF_INT128__ )
+            /* __extension__ keeps -Wpedantic quiet about the non-standard type */
+            __extension__ typedef unsigned __int128 Uint128;
+            using Wide = typename std::conditional< ( nBits <= 32 ), uint64_t, Uint128 >::type;
+            return T_Uint( ( Wide( a ) * Wide( b ) ) >> nBits );
+        #else
+            if ( nBits <= 32 )
+                return T_Uint( ( uint64_t( a ) * uint64_t( b ) ) >> ( nBits % 64 ) );
+            /* schoolbook multiplication with 32 bit halves */
+            uint64_t const aLow = uint32_t( a ), aHigh = uint64_t( a ) >> 32;
+            uint64_t const bLow = uint32_t( b ), bHigh = uint64_t( b ) >> 32;
+            uint64_t const middle = ( ( aLow * bLow ) >> 32 ) + uint32_t( aHigh * bLow ) + uint32_t( aLow * bHigh );
+            return T_Uint( aHigh * bHigh + ( ( aHigh * bLow ) >> 32 ) + ( ( aLow * bHigh ) >> 32 ) + ( middle >> 32 ) );
+        #endif
+    }
+
+public:
+    inline explicit FastDivider( T_Uint const rDivisor = 1 )
+    : divisor( rDivisor )
+    {
+        if ( rDivisor == 0 )
+            throw std::invalid_argument( "[FastDivider] Divisor must not be 0!" );
+
+        int l = 0;
+        while ( l < nBits && ( T_Uint( 1 ) << l ) < rDivisor )
+            ++l;
+
+        /* 2^N ( 2^l - d ) / d by long division, because 2^N doesn't fit into
+         * T_Uint. Note that 2^l - d < d, so the result fits into T_Uint */
+        T_Uint remainder = T_Uint( ( l < nBits ? T_Uint( 1 ) << l : T_Uint( 0 ) ) - rDivisor );
+        T_Uint quotient  = 0;
+        for ( int i = 0; i < nBits; ++i )
+        {
+            bool const carry = remainder >> ( nBits - 1 );
+            remainder = T_Uint( remainder << 1 );
+            quotient  = T_Uint( quotient  << 1 );
+            if ( carry || remainder >= rDivisor )
+            {
+                remainder = T_Uint( remainder - rDivisor );
+                quotient |= 1;
+            }
+        }
+
+        multiplier = T_Uint( quotient + 1 );
+        shift1     = l < 1 ? l : 1;
+        shift2     = l > 1 ? l - 1 : 0;
+    }
+
+    inline T_Uint divide( T_Uint const n ) const
+    {
+        auto const t = multiplyHigh( multiplier, n );
+        return T_Uint( ( t + T_Uint( T_Uint( n - t ) >> shift1 ) ) >> shift2 );
+    }
+
+    inline T_Uint value( void ) const { return divisor; }
+};
+
+
+/**
+ * Same conversions as convertVectorToLinearIndex and
+ * convertLinearToVectorIndex for a fixed number of dimensions, but with the
+ * strides and divisions precomputed once per shape and without allocations,
+ * e.g. for the innermost loops over grids.
+ */
+template< size_t T_nDims, typename T_Uint = size_t >
+class VectorIndexer
+{
+public:
+    using Index = std::array< T_Uint, T_nDims >;
+
+private:
+    static_assert( T_nDims > 0, "At least one dimension is needed!" );
+
+    Index                                         extents  ;
+    Index                                         strides  ;
+    std::array< FastDivider< T_Uint >, T_nDims >  dividers ;
+    T_Uint                                        nElements;
+
+public:
+    /**
+     * @param[in] rnSize length of dimensions, the last one being contiguous
+     *            in memory like for convertVectorToLinearIndex
+     */
+    inline explicit VectorIndexer( Index const & rnSize )
+    : extents( rnSize )
+    {
+        T_Uint prevRange = 1;
+        for ( size_t i = T_nDims; i-- > 0; )
+        {
+            if ( rnSize[i] == 0 )
+                throw std::invalid_argument( "[VectorIndexer] Dimensions must not be empty!" );
+            strides [i] = prevRange;
+            dividers[i] = FastDivider< T_Uint >( rnSize[i] );
+            prevRange  *= rnSize[i];
+        }
+        nElements = prevRange;
+    }
+
+    inline T_Uint toLinearIndex( Index const & rIndex ) const
+    {
+        T_Uint linIndex = 0;
+        for ( size_t i = 0u; i < T_nDims; ++i )
+        {
+            assert( rIndex[i] < extents[i] );
+            linIndex += rIndex[i] * strides[i];
+        }
+        return linIndex;
+    }
+
+    inline Index toVectorIndex( T_Uint rLinIndex ) const
+    {
+        assert( rLinIndex < nElements );
+        Index vecIndex;
+        for ( size_t i = T_nDims; i-- > 0; )
+        {
+            auto const quotient = dividers[i].divide( rLinIndex );
+            vecIndex[i] = rLinIndex - quotient * extents[i];
+            rLinIndex   = quotient;
+        }
+        return vecIndex;
+    }
+
+    inline Index  const & extent ( void ) const { return extents;   }
+    inline Index  const & stride ( void ) const { return strides;   }
+    /** product of all extents */
+    inline T_Uint         size   ( void ) const { return nElements; }
+};
+
+
+/**
+ * Like VectorIndexer, but with the extents as template arguments, so that
+ * the compiler can replace the divisions with multiplications and shifts
+ * and precompute the strides, e.g. StaticVectorIndexer< unsigned, 37, 101, 53 >
+ */
+template< typename T_Uint, T_Uint... T_extents >
+class StaticVectorIndexer
+{
+public:
+    static size_t constexpr nDims = sizeof...( T_extents );
+    using Index = std::array< T_Uint, nDims >;
+
+private:
+    static_assert( nDims > 0, "At least one dimension is needed!" );
+    static T_Uint constexpr extents[ nDims ] = { T_extents... };
+
+public:
+    static constexpr T_Uint extent( size_t const i ) { return extents[i]; }
+    static constexpr T_Uint stride( size_t const i ) { return i + 1 >= nDims ? 1 : extents[ i + 1 ] * stride( i + 1 ); }
+    static constexpr T_Uint size  ( void           ) { return extents[0] * stride( 0 ); }
+
+    static inline T_Uint toLinearIndex( Index const & rIndex )
+    {
+        T_Uint linIndex = 0;
+        for ( size_t i = 0u; i < nDims; ++i )
+        {
+            assert( rIndex[i] < extents[i] );
+            linIndex += rIndex[i] * stride( i );
+        }
+        return linIndex;
+    }
+
+    static inline Index toVectorIndex( T_Uint rLinIndex )
+    {
+        assert( rLinIndex < size() );
+        Index vecIndex;
+        for ( size_t i = nDims; i-- > 0; )
+        {
+            vecIndex[i] = rLinIndex % extents[i];
+            rLinIndex  /= extents[i];
+        }
+        return vecIndex;
+    }
+};
+
+template< typename T_Uint, T_Uint... T_extents >
+T_Uint constexpr StaticVectorIndexer< T_Uint, T_extents... >::extents[];
+
+
+
+
+/**
+ * Range over all vector indexes of a shape or of a sub-box of it in memory
+ * order, i.e. the last index changing fastest, which yields the linear and
+ * vector index of each element. Incrementing works like an odometer: the
+ * last index is incremented and only on overflow reset and carried to the
+ * next one, so that a traversal costs O(1) per element instead of a
+ * division and modulo per dimension for convertLinearToVectorIndex.
+ *
+ * @verbatim
+ * for ( auto const & element : VectorIndexRange< 3 >( { 4, 5, 6 }, { 1, 0, 0 }, { 3, 5, 6 }, { 1, 2, 3 } ) )
+ *     grid[ element.linIndex ] = f( element.vecIndex[0], element.vecIndex[1], element.vecIndex[2] );
+ * @endverbatim
+ */
+template< size_t T_nDims, typename T_Uint = size_t >
+class VectorIndexRange
+{
+public:
+    using Index = std::array< T_Uint, T_nDims >;
+
+    struct Element
+    {
+        T_Uint linIndex;
+        Index  vecIndex;
+    };
+
+    class Iterator
+    {
+    private:
+        VectorIndexRange const * range   ;
+        T_Uint                   iElement;  /**< counter, so that comparisons are O(1) */
+        Element                  element ;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = Element;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = Element const *;
+        using reference         = Element const &;
+
+        inline Iterator( VectorIndexRange const * const rRange, T_Uint const riElement )
+        : range( rRange ), iElement( riElement )
+        {
+            element.linIndex = rRange->linBegin;
+            element.vecIndex = rRange->boxBegin;
+        }
+
+        inline reference operator*( void ) const { return element; }
+        inline pointer operator->( void ) const { return &element; }
+
+        inline Iterator & operator++( void )
+        {
+            ++iElement;
+            for ( size_t i = T_nDims; i-- > 0; )
+            {
+                element.vecIndex[i] += range->boxStep[i];
+                element.linIndex    += range->linStep[i];
+                if ( element.vecIndex[i] < range->boxEnd[i] )
+                    return *this;
+                /* carry: rewind this dimension and increment the next slower one */
+                element.vecIndex[i]  = range->boxBegin[i];
+                element.linIndex    -= range->linRewind[i];
+            }
+            return *this;
+        }
+
+        inline Iterator operator++( int )
+        {
+            auto const old = *this;
+            ++( *this );
+            return old;
+        }
+
+        inline bool operator==( Iterator const & other ) const { return iElement == other.iElement; }
+        inline bool operator!=( Iterator const & other ) const { return iElement != other.iElement; }
+    };
+
+private:
+    static_assert( T_nDims > 0, "At least one dimension is needed!" );
+
+    Index  boxBegin ;
+    Index  boxEnd   ;  /**< exclusive */
+    Index  boxStep  ;
+    Index  linStep  ;  /**< change of the linear index for a step in each dimension */
+    Index  linRewind;  /**< change of the linear index from the end to the begin of a dimension */
+    T_Uint linBegin ;
+    T_Uint nElements;
+
+    inline void init( Index const & rnSize )
+    {
+        T_Uint stride = 1;
+        nElements = 1;
+        linBegin  = 0;
+        for ( size_t i = T_nDims; i-- > 0; )
+        {
+            if ( boxStep[i] == 0 )
+                throw std::invalid_argument( "[VectorIndexRange] Steps must not be 0!" );
+            if ( boxEnd[i] > rnSize[i] )
+                throw std::invalid_argument( "[VectorIndexRange] Sub-box must lie inside the shape!" );
+
+            auto const nSteps = boxEnd[i] > boxBegin[i] ? ( boxEnd[i] - boxBegin[i] + boxStep[i] - 1 ) / boxStep[i] : 0;
+            nElements   *= nSteps;
+            linBegin    += boxBegin[i] * stride;
+            linStep  [i] = boxStep[i] * stride;
+            linRewind[i] = nSteps * linStep[i];
+            stride      *= rnSize[i];
+        }
+    }
+
+public:
+    /** all elements of a shape like for convertVectorToLinearIndex */
+    inline explicit VectorIndexRange( Index const & rnSize )
+    {
+        boxBegin.fill( 0 );
+        boxEnd = rnSize;
+        boxStep.fill( 1 );
+        init( rnSize );
+    }
+
+    /**
+     * @param[in] rBegin first vector index of the sub-box
+     * @param[in] rEnd exclusive end of the sub-box, i.e. the range is empty
+     *            if rEnd[i] <= rBegin[i] for any dimension
+     * @param[in] rStep increment per dimension, i.e. every rStep[i]-th element
+     *            in [ rBegin[i], rEnd[i] ) is traversed
+     */
+    inline VectorIndexRange
+    (
+        Index const & rnSize,
+        Index const & rBegin,
+        Index const & rEnd,
+        Index const & rStep
+    )
+    : boxBegin( rBegin ), boxEnd( rEnd ), boxStep( rStep )
+    {
+        init( rnSize );
+    }
+
+    inline VectorIndexRange( Index const & rnSize, Index const & rBegin, Index const & rEnd )
+    : boxBegin( rBegin ), boxEnd( rEnd )
+    {
+        boxStep.fill( 1 );
+        init( rnSize );
+    }
+
+    inline Iterator cbegin( void ) const { return Iterator( this, 0 ); }
+    inline Iterator cend  ( void ) const { return Iterator( this, nElements ); }
+    inline Iterator begin ( void ) const { return cbegin(); }
+    inline Iterator end   ( void ) const { return cend(); }
+
+    /** number of traversed elements */
+    inline T_Uint size( void ) const { return nElements; }
+};
+
+
+/**
+ * Memory layouts mapping vector indexes of a shape to offsets in storage,
+ * which all have the same interface, so that code using them, e.g. via
+ * NdArrayView, can be switched from one to the other by a template argument:
+ *   toLinearIndex( Index ) offset of the element
+ *   extent()               shape
+ *   requiredSize()         number of elements the storage must have, which
+ *                          can be larger than the shape because of padding
+ */
+
+/** last index contiguous like for convertVectorToLinearIndex or C arrays */
+template< size_t T_nDims, typename T_Uint = size_t >
+class RowMajorLayout
+{
+public:
+    using Index = std::array< T_Uint, T_nDims >;
+
+private:
+    Index extents;
+    Index strides;
+
+public:
+    inline explicit RowMajorLayout( Index const & rnSize )
+    : extents( rnSize )
+    {
+        T_Uint stride = 1;
+        for ( size_t i = T_nDims; i-- > 0; )
+        {
+            strides[i] = stride;
+            stride    *= rnSize[i];
+        }
+    }
+
+    inline T_Uint toLinearIndex( Index const & rIndex ) const
+    {
+        T_Uint linIndex = 0;
+        for ( size_t i = 0u; i < T_nDims; ++i )
+        {
+            assert( rIndex[i] < extents[i] );
+            linIndex += rIndex[i] * strides[i];
+        }
+        return linIndex;
+    }
+
+    inline Index  const & extent      ( void ) const { return extents; }
+    inline T_Uint         requiredSize( void ) const { return extents[0] * strides[0]; }
+};
+
+/** first index contiguous like for Fortran arrays */
+template< size_t T_nDims, typename T_Uint = size_t >
+class ColumnMajorLayout
+{
+public:
+    using Index = std::array< T_Uint, T_nDims >;
+
+private:
+    Index extents;
+    Index strides;
+
+public:
+    inline explicit ColumnMajorLayout( Index const & rnSize )
+    : extents( rnSize )
+    {
+        T_Uint stride = 1;
+        for ( size_t i = 0u; i < T_nDims; ++i )
+        {
+            strides[i] = stride;
+            stride    *= rnSize[i];
+        }
+    }
+
+    inline T_Uint toLinearIndex( Index const & rIndex ) const
+    {
+        T_Uint linIndex = 0;
+        for ( size_t i = 0u; i < T_nDims; ++i )
+        {
+            assert( rIndex[i] < extents[i] );
+            linIndex += rIndex[i] * strides[i];
+        }
+        return linIndex;
+    }
+
+    inline Index  const & extent      ( void ) const { return extents; }
+    inline T_Uint         requiredSize( void ) const { return extents[ T_nDims - 1 ] * strides[ T_nDims - 1 ]; }
+};
+
+/**
+ * Contiguous tiles of 2^T_nTileBits elements in each dimension which are
+ * stored in row-major order and also row-major inside each tile, e.g. for
+ * stencils, so that neighbors in all dimensions are likely in the same
+ * cache lines or pages. The shape is padded to full tiles.
+ */
+template< size_t T_nDims, unsigned char T_nTileBits = 2, typename T_Uint = size_t >
+class TiledLayout
+{
+public:
+    using Index = std::array< T_Uint, T_nDims >;
+
+private:
+    static T_Uint constexpr tileMask = ( T_Uint( 1 ) << T_nTileBits ) - 1;
+
+    Index  extents    ;
+    Index  tileStrides;  /**< offset between neighboring tiles in each dimension */
+    T_Uint nRequired  ;
+
+public:
+    inline explicit TiledLayout( Index const & rnSize )
+    : extents( rnSize )
+    {
+        T_Uint stride = T_Uint( 1 ) << ( T_nTileBits * T_nDims );
+        for ( size_t i = T_nDims; i-- > 0; )
+        {
+            tileStrides[i] = stride;
+            stride        *= ( rnSize[i] + tileMask ) >> T_nTileBits;
+        }
+        nRequired = stride;
+    }
+
+    inline T_Uint toLinearIndex( Index const & rIndex ) const
+    {
+        T_Uint tileOffset = 0;
+        T_Uint inTile     = 0;
+        for ( size_t i = 0u; i < T_nDims; ++i )
+        {
+            assert( rIndex[i] < extents[i] );
+            tileOffset += ( rIndex[i] >> T_nTileBits ) * tileStrides[i];
+            inTile      = ( inTile << T_nTileBits ) | ( rIndex[i] & tileMask );
+        }
+        return tileOffset + inTile;
+    }
+
+    inline Index  const & extent      ( void ) const { return extents;   }
+    inline T_Uint         requiredSize( void ) const { return nRequired; }
+};
+
+/**
+ * Z-order using BitFunctions::mortonEncode, i.e. with the first index
+ * in the lowest bit. Recursively, each aligned block of 2^k elements per
+ * dimension is contiguous, which makes it cache-oblivious. The
+ * storage is padded up to the key of the last element, which for very
+ * different extents per dimension wastes a lot of memory.
+ */
+template< size_t T_nDims, typename T_Uint = size_t >
+class MortonLayout
+{
+public:
+    using Index = std::array< T_Uint, T_nDims >;
+
+private:
+    Index  extents  ;
+    T_Uint nRequired;
+
+public:
+    inline explicit MortonLayout( Index const & rnSize )
+    : extents( rnSize )
+    {
+        Index last;
+        for ( size_t i = 0u; i < T_nDims; ++i )
+        {
+            if ( rnSize[i] == 0 )
+                throw std::invalid_argument( "[MortonLayout] Dimensions must not be empty!" );
+            if ( rnSize[i] - 1 > BitFunctions::MortonBits< T_Uint, T_nDims >::coordinateMask )
+                throw std::invalid_argument( "[MortonLayout] Shape too large for Morton keys of this type!" );
+            last[i] = rnSize[i] - 1;
+        }
+        /* the key is monotonic in each coordinate, so the last element has the largest */
+        nRequired = BitFunctions::mortonEncode< T_Uint >( last ) + 1;
+    }
+
+    inline T_Uint toLinearIndex( Index const & rIndex ) const
+    {
+        #ifndef NDEBUG
+            for ( size_t i = 0u; i < T_nDims; ++i )
+                assert( rIndex[i] < extents[i] );
+        #endif
+        return BitFunctions::mortonEncode< T_Uint >( rIndex );
+    }
+
+    inline Index  const & extent      ( void ) const { return extents;   }
+    inline T_Uint         requiredSize( void ) const { return nRequired; }
+};
+
+
+/**
+ * Non-owning N-D view on storage with one of the layouts above, e.g.
+ * @verbatim
+ * MortonLayout< 3 > const layout( { nx, ny, nz } );
+ * std::vector< float > data( layout.requiredSize() );
+ * NdArrayView< float, 3, MortonLayout< 3 > > grid( data.data(), layout );
+ * grid( i, j, k ) = grid( i - 1, j, k ) + grid( i + 1, j, k );
+ * @endverbatim
+ */
+template< typename T, size_t T_nDims, typename T_Layout = RowMajorLayout< T_nDims > >
+class NdArrayView
+{
+public:
+    using Layout = T_Layout;
+    using Index  = typename T_Layout::Index;
+    using Uint   = typename Index::value_type;
+
+private:
+    T      * pData       ;
+    T_Layout memoryLayout;
+
+public:
+    inline NdArrayView( T * const rpData, T_Layout const & rLayout )
+    : pData( rpData ), memoryLayout( rLayout )
+    {}
+
+    inline T & operator[]( Index const & rIndex ) const { return pData[ memoryLayout.toLinearIndex( rIndex ) ]; }
+
+    template< typename... T_Indexes >
+    inline T & operator()( T_Indexes const... indexes ) const
+    {
+        static_assert( sizeof...( T_Indexes ) == T_nDims, "Wrong number of indexes!" );
+        return pData[ memoryLayout.toLinearIndex( Index{{ Uint( indexes )... }} ) ];
+    }
+
+    inline T              * data  ( void ) const { return pData;            }
+    inline T_Layout const & layout( void ) const { return memoryLayout;          }
+    inline Index    const & extent( void ) const { return memoryLayout.extent(); }
+};
+
+
 namespace tests
 {
 
 
-    std::ostream & operator<<
+    inline std::ostream & operator<<
     (
         std::ostream & rOut,
         const std::vector<unsigned> rVectorToPrint
@@ -118,7 +723,7 @@ namespace tests
         return rOut;
     }
 
-    bool testVectorIndex( void )
+    inline bool testVectorIndex( void )
     {
         #ifndef NDEBUG
         using Vec = std::vector< unsigned int >;
@@ -198,5 +803,213 @@ namespace tests
         return true;
     }
 
+    template< typename T_Uint >
+    inline bool testFastDivider( void )
+    {
+        #ifndef NDEBUG
+        auto constexpr maxValue = std::numeric_limits< T_Uint >::max();
+        std::vector< T_Uint > values = { 0, 1, 2, 3, 7, 100, T_Uint( maxValue / 2 ), T_Uint( maxValue / 2 + 1 ), T_Uint( maxValue - 1 ), maxValue };
+        for ( int i = 0; i < std::numeric_limits< T_Uint >::digits; ++i )
+        {
+            values.push_back( T_Uint( T_Uint( 1 ) << i ) );
+            values.push_back( T_Uint( ( T_Uint( 1 ) << i ) - 1 ) );
+            values.push_back( T_Uint( ( T_Uint( 1 ) << i ) + 1 ) );
+        }
+        uint64_t random = 12345;
+        for ( int i = 0; i < 200; ++i )
+        {
+            random = random * 6364136223846793005ull + 1442695040888963407ull;
+            values.push_back( T_Uint( random >> ( i % 64 ) ) );
+        }
+
+        for ( auto const divisor : values )
+        {
+            if ( divisor == 0 )
+                continue;
+            FastDivider< T_Uint > const divider( divisor );
+            for ( auto const dividend : values )
+                assert( divider.divide( dividend ) == dividend / divisor );
+        }
+        #endif
+        return true;
+    }
+
+    inline bool testVectorIndexer( void )
+    {
+        #ifndef NDEBUG
+        VectorIndexer< 3 > const indexer( VectorIndexer< 3 >::Index{{ 2, 3, 4 }} );
+        assert( indexer.size() == 24 );
+        assert( indexer.toLinearIndex( {{ 1, 2, 1 }} ) == 21 );
+        assert( ( indexer.toVectorIndex( 21 ) == std::array< size_t, 3 >{{ 1, 2, 1 }} ) );
+
+        using Static = StaticVectorIndexer< unsigned int, 37, 101, 53 >;
+        static_assert( Static::size() == 37 * 101 * 53, "" );
+        static_assert( Static::stride( 0 ) == 101 * 53 && Static::stride( 2 ) == 1, "" );
+        VectorIndexer< 3, unsigned int > const runtime( Static::Index{{ 37, 101, 53 }} );
+        std::vector< unsigned int > const size = { 37, 101, 53 };
+        for ( unsigned int i = 0u; i < Static::size(); ++i )
+        {
+            auto const vecIndex = runtime.toVectorIndex( i );
+            assert( Static::toVectorIndex( i ) == vecIndex );
+            assert( std::vector< unsigned int >( vecIndex.begin(), vecIndex.end() ) == convertLinearToVectorIndex( i, size ) );
+            assert( runtime.toLinearIndex( vecIndex ) == i );
+            assert( Static::toLinearIndex( vecIndex ) == i );
+        }
+        #endif
+        return true;
+    }
+
+
+    inline bool testVectorIndexRange( void )
+    {
+        #ifndef NDEBUG
+        using Range = VectorIndexRange< 3, unsigned int >;
+        Range::Index const size = {{ 4, 5, 7 }};
+        std::vector< unsigned int > const sizeVector( size.begin(), size.end() );
+
+        /* full shape in memory order */
+        unsigned int linIndex = 0;
+        for ( auto const & element : Range( size ) )
+        {
+            assert( element.linIndex == linIndex );
+            assert( std::vector< unsigned int >( element.vecIndex.begin(), element.vecIndex.end() ) ==
+                    convertLinearToVectorIndex( linIndex, sizeVector ) );
+            ++linIndex;
+        }
+        assert( linIndex == 4 * 5 * 7 );
+
+        /* sub-boxes with steps against nested loops */
+        std::vector< std::pair< Range::Index, std::pair< Range::Index, Range::Index > > > const boxes =
+        {
+            /* begin, { end, step } */
+            { {{ 0, 0, 0 }}, { {{ 4, 5, 7 }}, {{ 1, 1, 1 }} } },
+            { {{ 1, 2, 3 }}, { {{ 3, 5, 7 }}, {{ 1, 1, 1 }} } },
+            { {{ 0, 1, 0 }}, { {{ 4, 5, 7 }}, {{ 3, 2, 3 }} } },
+            { {{ 3, 4, 6 }}, { {{ 4, 5, 7 }}, {{ 5, 5, 5 }} } },
+            { {{ 1, 1, 1 }}, { {{ 1, 5, 7 }}, {{ 1, 1, 1 }} } },  /* empty */
+            { {{ 2, 0, 5 }}, { {{ 3, 5, 4 }}, {{ 1, 1, 1 }} } }   /* empty */
+        };
+        for ( auto const & box : boxes )
+        {
+            auto const & begin = box.first;
+            auto const & end   = box.second.first;
+            auto const & step  = box.second.second;
+            Range const range( size, begin, end, step );
+            auto it = range.begin();
+            unsigned int nElements = 0;
+            for ( auto i = begin[0]; i < end[0]; i += step[0] )
+            for ( auto j = begin[1]; j < end[1]; j += step[1] )
+            for ( auto k = begin[2]; k < end[2]; k += step[2] )
+            {
+                assert( it != range.end() );
+                assert( ( it->vecIndex == Range::Index{{ i, j, k }} ) );
+                assert( it->linIndex == convertVectorToLinearIndex( std::vector< unsigned int >{ i, j, k }, sizeVector ) );
+                ++it;
+                ++nElements;
+            }
+            assert( it == range.end() );
+            assert( range.size() == nElements );
+        }
+        #endif
+        return true;
+    }
+
+
+    /* each element must be mapped to a different offset inside the storage */
+    template< typename T_Layout >
+    inline bool testLayoutIsInjective( T_Layout const & layout )
+    {
+        #ifndef NDEBUG
+        std::vector< bool > used( layout.requiredSize(), false );
+        for ( auto const & element : VectorIndexRange< std::tuple_size< typename T_Layout::Index >::value,
+                                                       typename T_Layout::Index::value_type >( layout.extent() ) )
+        {
+            auto const offset = layout.toLinearIndex( element.vecIndex );
+            assert( offset < used.size() );
+            assert( not used[ offset ] );
+            used[ offset ] = true;
+        }
+        #endif
+        return true;
+    }
+
+    inline bool testLayouts( void )
+    {
+        #ifndef NDEBUG
+        using Index = std::array< unsigned int, 3 >;
+        Index const size = {{ 5, 9, 3 }};
+        std::vector< unsigned int > const sizeVector( size.begin(), size.end() );
+        std::vector< unsigned int > const sizeReversed( size.rbegin(), size.rend() );
+
+        RowMajorLayout   < 3, unsigned int > const rowMajor   ( size );
+        ColumnMajorLayout< 3, unsigned int > const columnMajor( size );
+        TiledLayout      < 3, 2, unsigned int > const tiled   ( size );
+        MortonLayout     < 3, unsigned int > const morton     ( size );
+
+        assert( rowMajor.requiredSize() == 5 * 9 * 3 );
+        assert( columnMajor.requiredSize() == 5 * 9 * 3 );
+        assert( tiled.requiredSize() == 2 * 3 * 1 * 64 );
+        for ( auto const & element : VectorIndexRange< 3, unsigned int >( size ) )
+        {
+            auto const & i = element.vecIndex;
+            assert( rowMajor.toLinearIndex( i ) == element.linIndex );
+            assert( columnMajor.toLinearIndex( i ) == convertVectorToLinearIndex( std::vector< unsigned int >{ i[2], i[1], i[0] }, sizeReversed ) );
+            assert( morton.toLinearIndex( i ) == BitFunctions::mortonEncode< unsigned int >( i ) );
+            /* tile index in a 2x3x1 grid of tiles, then row-major inside the 4x4x4 tile */
+            assert( tiled.toLinearIndex( i ) == ( ( i[0] / 4 ) * 3 + i[1] / 4 ) * 64 + ( i[0] % 4 ) * 16 + ( i[1] % 4 ) * 4 + i[2] );
+        }
+        testLayoutIsInjective( rowMajor );
+        testLayoutIsInjective( columnMajor );
+        testLayoutIsInjective( tiled );
+        testLayoutIsInjective( morton );
+
+        bool thrown = false;
+        try { MortonLayout< 3, unsigned short >( { 64, 2, 2 } ); }
+        catch ( std::invalid_argument const & ) { thrown = true; }
+        assert( thrown );
+
+        /* the same logical array in different layouts */
+        std::vector< double > rowMajorData( rowMajor.requiredSize() ), mortonData( morton.requiredSize() );
+        NdArrayView< double, 3, RowMajorLayout< 3, unsigned int > > const a( rowMajorData.data(), rowMajor );
+        NdArrayView< double, 3, MortonLayout< 3, unsigned int > > const b( mortonData.data(), morton );
+        for ( auto const & element : VectorIndexRange< 3, unsigned int >( size ) )
+            a[ element.vecIndex ] = b[ element.vecIndex ] = element.linIndex;
+        for ( unsigned int i = 0u; i < size[0]; ++i )
+        for ( unsigned int j = 0u; j < size[1]; ++j )
+        for ( unsigned int k = 0u; k < size[2]; ++k )
+        {
+            assert( a( i, j, k ) == ( i * 9 + j ) * 3 + k );
+            assert( b( i, j, k ) == a( i, j, k ) );
+        }
+        #endif
+        return true;
+    }
+
 
 } // namespace tests
+
+
+#ifdef MAIN_TEST_VECTORINDEX
+
+
+#include <iostream>
+
+
+int main()
+{
+    #ifdef NDEBUG
+        std::cout << "Tests are no-ops without assertions!\n";
+    #endif
+    tests::testVectorIndex();
+    tests::testFastDivider< unsigned char  >();
+    tests::testFastDivider< unsigned short >();
+    tests::testFastDivider< uint32_t       >();
+    tests::testFastDivider< uint64_t       >();
+    tests::testVectorIndexer();
+    tests::testVectorIndexRange();
+    tests::testLayouts();
+    std::cout << "vectorIndex tests OK\n";
+}
+
+
+#endif